@@ -70,7 +70,8 @@ strip_ansi() {
 }
 
 extract_time() {
-    strip_ansi "$1" | grep "Tiempo total:" | grep -oE '[0-9]+\.[0-9]+' | head -1
+    # Secuencial: "Tiempo wall (real):"   Paralelo: "Wall time (real):"
+    strip_ansi "$1" | grep -E "Tiempo wall \(real\):|Wall time \(real\):" | grep -oE '[0-9]+\.[0-9]+' | head -1
 }
 
 extract_compressed() {
@@ -82,12 +83,17 @@ extract_ratio() {
 }
 
 extract_threads() {
-    strip_ansi "$1" | grep "Hilos utilizados:" | grep -oE '[0-9]+' | head -1
+    strip_ansi "$1" | grep -oE 'PARALELO \([0-9]+ hilos\)' | grep -oE '[0-9]+' | head -1
+}
+
+extract_kernel() {
+    strip_ansi "$1" | grep "Kernel de escaneo:" | awk -F: '{print $2}' | awk '{print $1}' | head -1
 }
 
 # ─── Arrays para acumular resultados ───
 declare -a SEQ_TIMES
 declare -a PAR_TIMES
+declare -a SCALAR_TIMES
 
 # ─── Construir argumentos ───
 ARGS=""
@@ -112,14 +118,20 @@ for i in $(seq 1 "$ITERACIONES"); do
     PAR_T=$(extract_time "$PAR_OUTPUT")
     PAR_TIMES+=("$PAR_T")
 
+    # Secuencial con kernel escalar forzado (A/B del kernel SIMD)
+    SCALAR_OUTPUT=$(./rle_secuencial --scalar $ARGS 2>&1)
+    SCALAR_T=$(extract_time "$SCALAR_OUTPUT")
+    SCALAR_TIMES+=("$SCALAR_T")
+
     ITER_SPEEDUP=$(echo "scale=2; $SEQ_T / $PAR_T" | bc 2>/dev/null || echo "N/A")
-    printf "Seq=%.6fs  Par=%.6fs  Speedup=${GREEN}%sx${RESET}\n" "$SEQ_T" "$PAR_T" "$ITER_SPEEDUP"
+    printf "Seq=%.6fs  Par=%.6fs  Speedup=${GREEN}%sx${RESET}  Escalar=%.6fs\n" "$SEQ_T" "$PAR_T" "$ITER_SPEEDUP" "$SCALAR_T"
 done
 
 # ─── Extraer métricas constantes de la última ejecución ───
 COMPRESSED=$(extract_compressed "$SEQ_OUTPUT")
 RATIO=$(extract_ratio "$SEQ_OUTPUT")
 THREADS=$(extract_threads "$PAR_OUTPUT")
+KERNEL=$(extract_kernel "$SEQ_OUTPUT")
 
 # ─── Calcular estadísticas ───
 # Nota: Bash 3.2 (macOS) no soporta namerefs (local -n), así que
@@ -141,6 +153,13 @@ for val in "${PAR_TIMES[@]}"; do
 done
 PAR_AVG=$(echo "scale=6; $PAR_SUM / $ITERACIONES" | bc)
 
+SCALAR_SUM=0
+for val in "${SCALAR_TIMES[@]}"; do
+    SCALAR_SUM=$(echo "$SCALAR_SUM + $val" | bc)
+done
+SCALAR_AVG=$(echo "scale=6; $SCALAR_SUM / $ITERACIONES" | bc)
+SIMD_SPEEDUP=$(echo "scale=2; $SCALAR_AVG / $SEQ_AVG" | bc)
+
 SPEEDUP_AVG=$(echo "scale=2; $SEQ_AVG / $PAR_AVG" | bc)
 SPEEDUP_MIN=$(echo "scale=2; $SEQ_MIN / $PAR_MAX" | bc)
 SPEEDUP_MAX=$(echo "scale=2; $SEQ_MAX / $PAR_MIN" | bc)
@@ -174,6 +193,9 @@ echo -e "${CYAN}║${RESET}    Speedup rango:    ${SPEEDUP_MIN}x — ${SPEEDUP_M
 echo -e "${CYAN}║${RESET}    Eficiencia:       ${EFICIENCIA}% (speedup / hilos × 100)           ${CYAN}║${RESET}"
 echo -e "${CYAN}║${RESET}    Archivos iguales: ${FILES_MATCH} (verificación de corrección)         ${CYAN}║${RESET}"
 echo -e "${CYAN}║${RESET}                                                                  ${CYAN}║${RESET}"
+echo -e "${CYAN}║${RESET}  ${BOLD}KERNEL DE ESCANEO (secuencial):${RESET}                                ${CYAN}║${RESET}"
+echo -e "${CYAN}║${RESET}    ${KERNEL}: ${SEQ_AVG} s   escalar: ${SCALAR_AVG} s   (${SIMD_SPEEDUP}x)          ${CYAN}║${RESET}"
+echo -e "${CYAN}║${RESET}                                                                  ${CYAN}║${RESET}"
 echo -e "${CYAN}║${RESET}  ${BOLD}COMPRESIÓN:${RESET}                                                    ${CYAN}║${RESET}"
 echo -e "${CYAN}║${RESET}    Tamaño comprimido: ${COMPRESSED} bytes                            ${CYAN}║${RESET}"
 echo -e "${CYAN}║${RESET}    Ratio:             ${RATIO}%                                      ${CYAN}║${RESET}"
@@ -247,6 +269,11 @@ cat >> "$REPORTE" << REPORT_EOF
  Verificación de corrección:
    Los archivos .rle producidos por ambas versiones son: ${FILES_MATCH} idénticos
 
+ Kernel de escaneo de runs (versión secuencial):
+   ${KERNEL}:             ${SEQ_AVG} s (promedio)
+   escalar (--scalar):  ${SCALAR_AVG} s (promedio)
+   Speedup SIMD:        ${SIMD_SPEEDUP}x
+
  Compresión:
    Tamaño original:    50,331,648 bytes
    Tamaño comprimido:  ${COMPRESSED} bytes
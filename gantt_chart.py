@@ -3,14 +3,17 @@
 gantt_chart.py — Diagrama de Gantt: Planificación de Hilos y Gestión del SO
                Curso de Sistemas Operativos - UNSAAC
 
-Uso: python3 gantt_chart.py <csv_secuencial> <csv_paralelo> <output.png>
+Uso: python3 gantt_chart.py <csv_secuencial> <csv_paralelo> <output.png> [<csv_scaling>]
+
+Con el CSV de `rle_paralelo --scaling` se genera además <output>_scaling.png
+(speedup y eficiencia fuerte/débil con los ajustes de Amdahl y Gustafson).
 """
 
 import sys
 import os
 
 def parse_csv(filepath):
-    data = {'meta': {}, 'threads': [], 'pc_samples': {}}
+    data = {'meta': {}, 'threads': [], 'pc_samples': {}, 'decode': []}
     with open(filepath, 'r') as f:
         content = f.read().strip()
     sections = content.split('\n\n')
@@ -42,6 +45,14 @@ def parse_csv(filepath):
             if tid not in data['pc_samples']:
                 data['pc_samples'][tid] = []
             data['pc_samples'][tid].append(sample)
+
+    # Sección opcional: hilos de descompresión paralela
+    if len(sections) > 3:
+        lines = sections[3].strip().split('\n')
+        header = lines[0].split(',')
+        for line in lines[1:]:
+            vals = line.split(',')
+            data['decode'].append({k.strip(): v.strip() for k, v in zip(header, vals)})
     return data
 
 
@@ -163,7 +174,26 @@ def generate_gantt(seq_csv, par_csv, output_path):
     ax1b.text(wall_par / 2, 0, f'Padre (pthread_join) — {wall_par:.1f} ms',
               ha='center', va='center', color=ACC, fontsize=7, fontweight='bold')
 
-    ax1b.set_xlim(-wall_par * 0.02, wall_par * 1.1)
+    # Descompresión paralela: misma escala, a continuación de la compresión
+    x_max = wall_par
+    if par['decode']:
+        wall_dec = float(par['meta'].get('decode_wall_ms', 0))
+        dec_off = wall_par * 1.05
+        for t in par['decode']:
+            tid = int(t['decode_thread_id'])
+            start = float(t['start_ms'])
+            end = float(t['end_ms'])
+            c = TC[tid % len(TC)]
+            ax1b.barh(nt - tid, end - start, left=dec_off + start, height=0.65,
+                      color=c, alpha=0.45, edgecolor='white', linewidth=0.5, hatch='//')
+            ax1b.text(dec_off + start + (end - start) / 2, nt - tid, f'D-{tid}',
+                      ha='center', va='center', color='white', fontsize=7, fontweight='bold')
+        ax1b.barh(0, wall_dec, left=dec_off, height=0.35,
+                  color=ACC, alpha=0.25, edgecolor=ACC, linewidth=0.5, hatch='//')
+        ax1b.axvline(dec_off, color=G, linestyle=':', linewidth=1)
+        x_max = dec_off + wall_dec
+
+    ax1b.set_xlim(-wall_par * 0.02, x_max * 1.1)
     ax1b.set_xlabel('Tiempo (ms)', color=T, fontsize=9)
     yticks = list(range(0, nt + 1))
     ylabels = ['Padre'] + [f'Hilo {i}' for i in range(nt - 1, -1, -1)]
@@ -188,6 +218,9 @@ def generate_gantt(seq_csv, par_csv, output_path):
         mpatches.Patch(color='#3498DB', alpha=0.15, label='Wall time (incluye espera)'),
         mpatches.Patch(color=ACC, alpha=0.4, label='Padre esperando (join)'),
     ]
+    if par['decode']:
+        legend_elements.append(mpatches.Patch(facecolor='#3498DB', alpha=0.45, hatch='//',
+                                              label='Descompresión (D-n)'))
     ax1b.legend(handles=legend_elements, loc='lower right', fontsize=7,
                 facecolor=ABG, edgecolor=G, labelcolor=T)
 
@@ -555,8 +588,93 @@ def generate_gantt(seq_csv, par_csv, output_path):
     print(f"\n  Diagrama de Gantt generado: {output_path}")
 
 
+def parse_scaling_csv(filepath):
+    with open(filepath, 'r') as f:
+        sections = f.read().strip().split('\n\n')
+    lines = sections[0].strip().split('\n')
+    meta = dict(zip([k.strip() for k in lines[0].split(',')],
+                    [v.strip() for v in lines[1].split(',')]))
+    lines = sections[1].strip().split('\n')
+    header = [k.strip() for k in lines[0].split(',')]
+    points = [dict(zip(header, [v.strip() for v in line.split(',')])) for line in lines[1:]]
+    return meta, points
+
+
+def generate_scaling(scaling_csv, output_path):
+    try:
+        import matplotlib
+        matplotlib.use('Agg')
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print("Error: pip3 install matplotlib")
+        sys.exit(1)
+
+    meta, points = parse_scaling_csv(scaling_csv)
+    strong = [p for p in points if p['scaling'] == 'strong']
+    weak = [p for p in points if p['scaling'] == 'weak']
+    f = float(meta['amdahl_serial_fraction'])
+    a = float(meta['gustafson_serial_fraction'])
+
+    T = '#e6edf3'
+    G = '#21262d'
+    ABG = '#161b22'
+    ACC = '#F39C12'
+
+    fig, (ax1, ax2) = plt.subplots(1, 2, figsize=(18, 7))
+    fig.patch.set_facecolor('#0d1117')
+    fig.suptitle(f'ESCALABILIDAD — {meta["input"]} {meta["width"]}x{meta["height"]}  |  '
+                 f'afinidad {meta["affinity"]}, first-touch {"sí" if meta["first_touch"] == "1" else "no"}, '
+                 f'{meta["cpus"]} CPUs en {meta["numa_nodes"]} nodo(s)',
+                 color=ACC, fontsize=14, fontweight='bold')
+
+    # --- Speedup: medido, ideal y ajustes ---
+    ax1.set_facecolor(ABG)
+    ps = [int(p['threads']) for p in strong]
+    pmax = max(ps + [int(p['threads']) for p in weak] + [1])
+    xs = [1 + i * (pmax - 1) / 100 for i in range(101)]
+    ax1.plot(xs, xs, '--', color='#8b949e', linewidth=1, label='Ideal (S = p)')
+    ax1.plot(ps, [float(p['speedup']) for p in strong], 'o-', color='#3498DB',
+             linewidth=2, label='Fuerte (medido)')
+    ax1.plot(xs, [1 / (f + (1 - f) / x) for x in xs], ':', color='#3498DB',
+             label=f'Amdahl f = {f:.4f}')
+    ax1.plot([int(p['threads']) for p in weak], [float(p['speedup']) for p in weak], 's-',
+             color='#2ECC71', linewidth=2, label='Débil (speedup escalado)')
+    ax1.plot(xs, [x - a * (x - 1) for x in xs], ':', color='#2ECC71',
+             label=f'Gustafson a = {a:.4f}')
+    ax1.set_title('SPEEDUP vs HILOS', color=T, fontsize=12, fontweight='bold')
+    ax1.set_xlabel('Hilos (p)', color=T)
+    ax1.set_ylabel('Speedup', color=T)
+
+    # --- Eficiencia ---
+    ax2.set_facecolor(ABG)
+    ax2.plot(ps, [100 * float(p['efficiency']) for p in strong], 'o-', color='#3498DB',
+             linewidth=2, label='Fuerte')
+    ax2.plot([int(p['threads']) for p in weak], [100 * float(p['efficiency']) for p in weak],
+             's-', color='#2ECC71', linewidth=2, label='Débil')
+    ax2.axhline(100, linestyle='--', color='#8b949e', linewidth=1)
+    ax2.set_ylim(0, 110)
+    ax2.set_title('EFICIENCIA vs HILOS', color=T, fontsize=12, fontweight='bold')
+    ax2.set_xlabel('Hilos (p)', color=T)
+    ax2.set_ylabel('Eficiencia (%)', color=T)
+
+    for ax in (ax1, ax2):
+        ax.tick_params(colors=T)
+        ax.grid(True, color=G)
+        for spine in ax.spines.values():
+            spine.set_color(G)
+        ax.legend(facecolor=ABG, edgecolor=G, labelcolor=T, fontsize=9)
+
+    plt.savefig(output_path, dpi=150, facecolor=fig.get_facecolor(),
+                edgecolor='none', bbox_inches='tight')
+    plt.close()
+    print(f"  Gráfico de escalabilidad generado: {output_path}")
+
+
 if __name__ == '__main__':
     if len(sys.argv) < 4:
-        print(f"Uso: {sys.argv[0]} <csv_secuencial> <csv_paralelo> <output.png>")
+        print(f"Uso: {sys.argv[0]} <csv_secuencial> <csv_paralelo> <output.png> [<csv_scaling>]")
         sys.exit(1)
     generate_gantt(sys.argv[1], sys.argv[2], sys.argv[3])
+    if len(sys.argv) > 4:
+        root, ext = os.path.splitext(sys.argv[3])
+        generate_scaling(sys.argv[4], f'{root}_scaling{ext or ".png"}')
@@ -0,0 +1,1638 @@
+/*
+ * ============================================================================
+ *  librle.h — Biblioteca RLE reentrante: compresión y descompresión en memoria
+ *
+ *  Comprime y descomprime el contenedor .rle (rle_format.h) sobre buffers del
+ *  llamador, sin globales y sin imprimir nada: todo el estado vive en un
+ *  RLELib que cada llamador (o cada hilo) tiene por su cuenta. Los errores se
+ *  devuelven como RLE_LIB_E* y el motivo queda en librle_error(). Dos
+ *  backends detrás de la misma interfaz:
+ *
+ *    RLE_LIB_SEQUENTIAL   los tiles en orden, en el hilo que llama
+ *    RLE_LIB_THREADS      hilos creados por llamada que se reparten los tiles
+ *                         (o los chunks al descomprimir) con un contador atómico
+ *    RLE_LIB_POOL         como THREADS, pero los hilos se crean una vez en
+ *                         librle_init y esperan en una condición entre
+ *                         llamadas (servidor --serve: sin pthread_create por
+ *                         pedido); se terminan en librle_release
+ *
+ *  Acceso aleatorio por filas: cada chunk es un punto de sincronización (se
+ *  decodifica solo, sin estado previo), así que librle_decode_rows decodifica
+ *  únicamente los chunks que tocan [y0, y1). Con la entrada mapeada
+ *  (librle_file_open) solo se leen del disco esas páginas: la latencia de una
+ *  ventana depende de su alto más el de a lo sumo dos tiles en los bordes, no
+ *  del tamaño de la imagen. Comprimir con tile_rows = N (--tile N) deja un
+ *  punto de sincronización cada N filas.
+ *
+ *  Actualización incremental (librle_update_file): con la imagen nueva se
+ *  comparan las bandas contra el archivo existente por su raw_checksum y solo
+ *  las que cambiaron se re-codifican. Un .rle sin RLE_FLAG_RAW_CRC se
+ *  compara una sola vez decodificando las bandas anteriores; esa misma
+ *  actualización guarda el CRC32C de cada banda y el flag, y las siguientes
+ *  ya no decodifican. Los chunks nuevos y una tabla nueva se agregan al
+ *  final; recién después de un fsync se reescribe el header (32 bytes, un
+ *  solo pwrite) con el table_offset nuevo. Un lector, o un corte a mitad de
+ *  camino, ve la versión anterior completa o la nueva completa. Los chunks
+ *  reemplazados quedan como espacio muerto; cuando pasaría de la mitad del
+ *  archivo, en lugar de agregar se escribe el archivo compactado en
+ *  <path>.tmp y un rename lo pone en su lugar (fsync del archivo antes y del
+ *  directorio después).
+ *
+ *  Caché de chunks (lib->cache, rle_chunk_cache.h): cada tile se busca por el
+ *  XXH64 de sus bytes y un acierto copia el chunk ya codificado en lugar de
+ *  codificarlo. Con la caché puesta, además, los tiles cuyo chunk codificado
+ *  es idéntico al de un tile anterior de la misma imagen comparten sus datos:
+ *  dos entradas de la tabla con el mismo offset.
+ *
+ *  Alrededor del codec, lo que usan los dos programas: buffers de salida
+ *  (RLELibBuffer), carga de imágenes (librle_image_load: PPM/RAW mapeados,
+ *  el resto con stb_image si el programa lo incluyó antes) y el BMP por
+ *  bandas (librle_bmp_save). Sus reservas y syscalls se ven desde afuera con
+ *  RLELibHooks, sin que la biblioteca imprima nada.
+ *
+ *  La salida no depende del backend ni del número de hilos, y sin caché es
+ *  byte a byte la que escriben rle_secuencial y rle_paralelo con el mismo
+ *  modo, flags y --tile. La única memoria propia es el scratch de cada hilo
+ *  (planos del modo planar) y la tabla de chunks leída; se conserva entre
+ *  llamadas y se libera con librle_release.
+ *
+ *  Como stb_image.h: en un solo .c del programa
+ *
+ *    #define LIBRLE_IMPLEMENTATION
+ *    #include "librle.h"
+ *
+ *  o enlazar librle.a (make librle). Ejemplo:
+ *
+ *    RLELibConfig cfg;
+ *    librle_config_default(&cfg);
+ *    cfg.backend = RLE_LIB_THREADS;
+ *    RLELib lib;
+ *    librle_init(&lib, &cfg);
+ *    size_t cap = librle_compress_bound(&lib, w, h), len;
+ *    uint8_t *out = malloc(cap);
+ *    if (librle_compress(&lib, rgb, w, h, out, cap, &len) != RLE_LIB_OK)
+ *        fprintf(stderr, "%s\n", librle_error(&lib));
+ *    librle_release(&lib);
+ * ============================================================================
+ */
+
+#ifndef LIBRLE_H
+#define LIBRLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rle_chunk_cache.h"
+#include "rle_format.h"
+#include "rle_input.h"
+#include "rle_progress.h"
+#include "rle_simd.h"
+
+#ifndef LIBRLEDEF
+#define LIBRLEDEF extern
+#endif
+
+/* Códigos de retorno (0 = bien) */
+enum {
+    RLE_LIB_OK       =  0,
+    RLE_LIB_EINVAL   = -1,      /* argumento inválido: config, dimensiones, puntero NULL */
+    RLE_LIB_ENOSPC   = -2,      /* el buffer de salida no alcanza */
+    RLE_LIB_ENOMEM   = -3,      /* sin memoria para el scratch o la tabla */
+    RLE_LIB_EFORMAT  = -4,      /* la entrada no es un .rle válido */
+    RLE_LIB_ECORRUPT = -5,      /* CRC32C o longitud de algún chunk distintos */
+    RLE_LIB_EIO      = -6       /* no se pudo abrir o mapear el archivo (errno) */
+};
+
+typedef enum { RLE_LIB_SEQUENTIAL, RLE_LIB_THREADS, RLE_LIB_POOL } RLELibBackend;
+
+typedef struct {
+    RLELibBackend backend;
+    int      threads;           /* RLE_LIB_THREADS / RLE_LIB_POOL: hilos (0 = CPUs en línea) */
+    uint8_t  mode;              /* RLE_MODE_* */
+    uint8_t  flags;             /* RLE_FLAG_VARINT | RLE_FLAG_RAW_CRC | RLE_FLAG_CODEC */
+    uint32_t tile_rows;         /* filas por chunk (0 = las que caben en RLE_TILE_BYTES) */
+    int      force_scalar;      /* 1 = kernel de escaneo escalar */
+    int      bgr;               /* descompresión: píxeles en BGR (orden del BMP) */
+    int      verify_crc;        /* descompresión: comprobar el CRC32C de cada chunk comprimido */
+} RLELibConfig;
+
+/* Resultado de la última llamada */
+typedef struct {
+    uint32_t num_chunks;
+    size_t   bytes;             /* bytes escritos en la salida */
+    size_t   runs;              /* compresión: registros codificados */
+    uint32_t bad_chunks;        /* descompresión: chunks con CRC o longitud distintos */
+    uint32_t first_bad;         /* el primero de ellos (UINT32_MAX = ninguno) */
+    int      threads_used;
+    uint32_t cache_hits;        /* compresión con caché: tiles copiados sin codificar */
+    uint32_t shared_chunks;     /* tiles que apuntan a los datos de un chunk anterior */
+} RLELibStats;
+
+struct RLELibChunk;
+
+/*
+ * Instrumentación opcional del programa que usa la biblioteca (cualquier
+ * puntero puede ser NULL): syscall ve las llamadas al sistema de los
+ * buffers, de librle_image_load y de librle_bmp_save; los de memoria, cada
+ * RLELibBuffer (label es el de su init) y la imagen de stb_image; chunk,
+ * cada banda de librle_encode_chunk / librle_measure_chunk (measured = 1)
+ * con los instantes CLOCK_MONOTONIC de antes y después. chunk se llama
+ * desde el hilo que codifica; los demás, desde el que reserva.
+ */
+typedef struct {
+    void (*syscall)(const char *name, const char *real_syscall, const char *purpose);
+    void (*heap_alloc)(void *p, size_t n, const char *label);
+    void (*mapped_alloc)(void *p, size_t n, const char *label);
+    void (*heap_resize)(void *old, void *p, size_t n);
+    void (*heap_free)(void *p);
+    void (*chunk)(void *ctx, const struct RLELibChunk *c, int measured,
+                  uint64_t t0_ns, uint64_t t1_ns);
+} RLELibHooks;
+
+/*
+ * Buffer de salida: heap que crece duplicando en librle_buffer_push, mmap de
+ * peor caso (MAP_NORESERVE no compromete swap por la parte sin tocar) o
+ * arena con un header delante de data, así el .rle sale en un solo bloque.
+ * Con librle_buffer_wrap la memoria es del llamador y no se libera.
+ */
+typedef struct {
+    uint8_t           *data;
+    size_t             size;
+    size_t             capacity;
+    uint8_t           *block;      /* lo reservado (arena: data = block + header; NULL = ajeno) */
+    size_t             block_len;
+    int                mapped;     /* 1 = mmap, se libera con munmap */
+    int                reallocs;   /* realloc hechos por librle_buffer_push */
+    const RLELibHooks *hooks;
+} RLELibBuffer;
+
+/* RLE_LIB_OK o RLE_LIB_ENOMEM (con errno de malloc / mmap) */
+LIBRLEDEF int librle_buffer_init(RLELibBuffer *b, size_t cap, const RLELibHooks *hooks,
+                                 const char *label);
+LIBRLEDEF int librle_buffer_init_mapped(RLELibBuffer *b, size_t cap, const RLELibHooks *hooks,
+                                        const char *label);
+LIBRLEDEF int librle_buffer_init_arena(RLELibBuffer *b, size_t header, size_t payload,
+                                       const RLELibHooks *hooks, const char *label);
+LIBRLEDEF void librle_buffer_wrap(RLELibBuffer *b, uint8_t *data, size_t cap);
+LIBRLEDEF int librle_buffer_push(RLELibBuffer *b, const void *src, size_t n);
+LIBRLEDEF void librle_buffer_free(RLELibBuffer *b);
+
+struct RLELibWorker;
+struct RLELibPool;
+
+typedef struct {
+    RLELibConfig         cfg;
+    RLEScanKernel        kernel;        /* elegido en librle_init; se puede reemplazar */
+    RLEChunkCache       *cache;         /* compresión: caché de chunks (NULL = sin caché) */
+    const RLELibHooks   *hooks;         /* instrumentación del llamador (NULL = ninguna) */
+    RLELibStats          stats;
+    char                 error[160];
+    RLEChunkEntry       *table;         /* tabla de chunks de la última llamada */
+    uint32_t             table_cap;
+    struct RLELibWorker *workers;
+    int                  num_workers;
+    struct RLELibPool   *pool;          /* RLE_LIB_POOL: hilos persistentes */
+} RLELib;
+
+/* Secuencial, modo byte, count u8, tiles automáticos, RGB, sin CRC de chunks */
+LIBRLEDEF void librle_config_default(RLELibConfig *cfg);
+
+/* RLE_LIB_OK, RLE_LIB_EINVAL si la config no es válida, RLE_LIB_ENOMEM sin el pool */
+LIBRLEDEF int librle_init(RLELib *lib, const RLELibConfig *cfg);
+LIBRLEDEF void librle_release(RLELib *lib);
+
+/* Motivo del último error de lib; librle_strerror describe un código */
+LIBRLEDEF const char *librle_error(const RLELib *lib);
+LIBRLEDEF const char *librle_strerror(int code);
+
+/* Bytes que debe tener dst para comprimir cualquier imagen de w x h (0 = demasiado grande) */
+LIBRLEDEF size_t librle_compress_bound(const RLELib *lib, uint32_t w, uint32_t h);
+
+/*
+ * Comprime w x h píxeles RGB en dst, que debe tener al menos
+ * librle_compress_bound bytes. Deja en *out_len los bytes del .rle completo.
+ */
+LIBRLEDEF int librle_compress(RLELib *lib, const uint8_t *rgb, uint32_t w, uint32_t h,
+                              uint8_t *dst, size_t cap, size_t *out_len);
+
+/*
+ * Una banda (tile o strip) para codificar sola, con el modo, los flags, el
+ * kernel y la caché de lib: es lo que hace librle_compress por cada tile, y
+ * lo que usan los programas para armar el .rle con su propio reparto de
+ * tiles. Con dst (capacidad garantizada: rle_encoded_bound o lo medido) los
+ * registros se escriben ahí; sin dst se agregan a out. Con progress se
+ * publica in_base + entrada consumida y out_base + salida producida cada
+ * RLE_PROGRESS_STEP bytes de entrada.
+ */
+typedef struct RLELibChunk {
+    const uint8_t *band;
+    size_t         bytes;
+    uint8_t       *scratch;     /* rle_encoder_scratch_size(mode, bytes) (modo planar) */
+    uint8_t       *dst;
+    RLELibBuffer  *out;         /* sin dst */
+    int            codec;       /* >= 0: el de librle_measure_chunk; -1 = elegirlo */
+    int            crc;         /* 1 = calcular entry.checksum también sin caché */
+    RLEProgress   *progress;    /* NULL = no publicar */
+    size_t         in_base;
+    size_t         out_base;
+    void          *ctx;         /* para hooks->chunk */
+    uint32_t       index;       /* ídem: número de tile */
+    /* resultado */
+    RLEChunkEntry  entry;       /* length, codec, raw_checksum (y checksum) */
+    size_t         records;     /* registros codificados (0 si vino de la caché) */
+    int            hit;         /* 1 = copiado (o medido) de lib->cache */
+} RLELibChunk;
+
+/* RLE_LIB_OK, o el error de librle_buffer_push sin dst. Es seguro desde varios hilos */
+LIBRLEDEF int librle_encode_chunk(const RLELib *lib, RLELibChunk *c);
+/* Bytes (y entry.codec) que dejará librle_encode_chunk, sin escribirlos */
+LIBRLEDEF size_t librle_measure_chunk(const RLELib *lib, RLELibChunk *c);
+
+/* Lee y valida header y tabla de src (.rle v1 o legado); la tabla queda en lib->table */
+LIBRLEDEF int librle_info(RLELib *lib, const uint8_t *src, size_t len, RLEFileHeader *hdr);
+
+/* Descomprime src en rgb (width * height * 3 bytes, en BGR con cfg.bgr) */
+LIBRLEDEF int librle_decompress(RLELib *lib, const uint8_t *src, size_t len,
+                                uint8_t *rgb, size_t cap);
+
+/*
+ * Descomprime una tabla ya validada: el chunk i está en base + chunks[i].offset.
+ * Sirve para contenedores que el llamador ya tiene abiertos (RLEContainer).
+ */
+LIBRLEDEF int librle_decode_chunks(RLELib *lib, const RLEFileHeader *hdr,
+                                   const RLEChunkEntry *chunks, const uint8_t *base,
+                                   uint8_t *rgb, size_t cap);
+
+/*
+ * Como librle_decode_chunks pero solo las filas [y0, y1): rgb recibe
+ * (y1 - y0) * width * 3 bytes. Decodifica únicamente los chunks que se
+ * superponen con la ventana; los de los bordes pasan por el scratch del hilo.
+ */
+LIBRLEDEF int librle_decode_rows(RLELib *lib, const RLEFileHeader *hdr,
+                                 const RLEChunkEntry *chunks, const uint8_t *base,
+                                 uint32_t y0, uint32_t y1, uint8_t *rgb, size_t cap);
+
+/* Archivo .rle mapeado en memoria (solo lectura), con header y tabla validados */
+typedef struct {
+    const uint8_t *data;        /* mmap PROT_READ del archivo completo */
+    size_t         size;
+    RLEFileHeader  header;
+    RLEChunkEntry *chunks;      /* copia de la tabla (HEAP) */
+} RLELibFile;
+
+LIBRLEDEF int librle_file_open(RLELib *lib, RLELibFile *f, const char *path);
+LIBRLEDEF void librle_file_close(RLELibFile *f);
+
+/* Filas [y0, y1) de un archivo abierto con librle_file_open */
+LIBRLEDEF int librle_file_decode_rows(RLELib *lib, const RLELibFile *f,
+                                      uint32_t y0, uint32_t y1, uint8_t *rgb, size_t cap);
+
+/* Resultado de librle_update_file */
+typedef struct {
+    uint32_t num_chunks;        /* chunks del archivo */
+    uint32_t changed;           /* bandas distintas: re-codificadas y agregadas */
+    int      by_crc;            /* 1 = comparadas por raw_checksum, 0 = decodificando */
+    int      compacted;         /* 1 = reescrito sin espacio muerto */
+    uint64_t written;           /* bytes escritos (chunks nuevos + tabla, o el archivo compactado) */
+    uint64_t live;              /* bytes que referencia la versión nueva */
+    uint64_t dead;              /* bytes de chunks reemplazados que siguen en el archivo */
+    uint64_t file_size;         /* tamaño final del archivo */
+} RLELibUpdate;
+
+/*
+ * Actualiza en su lugar el .rle de path para que represente rgb (w x h, las
+ * mismas dimensiones). Conserva modo, bandas y flags del archivo (más
+ * RLE_FLAG_RAW_CRC, que se agrega la primera vez); solo se escriben los
+ * chunks que cambiaron, o el archivo entero si el espacio muerto pasaría de
+ * la mitad. Sin cambios, y con raw_checksum ya guardados, no se toca el
+ * archivo.
+ */
+LIBRLEDEF int librle_update_file(RLELib *lib, const char *path, const uint8_t *rgb,
+                                 uint32_t w, uint32_t h, RLELibUpdate *up);
+
+/* Imagen RGB de entrada */
+typedef struct {
+    uint32_t       width;
+    uint32_t       height;
+    uint8_t       *data;        /* RGB intercalado (dentro de input.map si se mapeó) */
+    RLEMappedInput input;       /* PPM P6 / RAW mapeados sin copia (input.map != NULL) */
+    int            channels;    /* canales del archivo antes de pasar a RGB */
+} RLELibImage;
+
+/*
+ * Carga path: PPM P6 de 8 bits (o RAW con raw_w x raw_h) se mapea y data
+ * apunta a los píxeles del archivo (PROT_READ, solo lectura); el resto pasa
+ * por stb_image si el programa lo incluyó antes que librle.h, si no es
+ * RLE_LIB_EFORMAT. RLE_LIB_EIO si no se pudo leer.
+ */
+LIBRLEDEF int librle_image_load(RLELib *lib, RLELibImage *img, const char *path,
+                                uint32_t raw_w, uint32_t raw_h);
+/* Desmapea la entrada o libera data (de stb_image o de malloc, p. ej. una imagen sintética) */
+LIBRLEDEF void librle_image_free(RLELibImage *img);
+
+/*
+ * Escribe pixels (w x h, en BGR con bgr = 1) como BMP de 24 bits: el archivo
+ * se crea con su tamaño final y los hilos de lib escriben bandas de filas con
+ * pwrite en su offset (rle_bmp.h), sin stdio y sin orden entre ellos.
+ */
+LIBRLEDEF int librle_bmp_save(RLELib *lib, const char *path, const uint8_t *pixels,
+                              uint32_t w, uint32_t h, int bgr);
+
+#endif /* LIBRLE_H */
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  IMPLEMENTACIÓN
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+#ifdef LIBRLE_IMPLEMENTATION
+#ifndef LIBRLE_IMPLEMENTED
+#define LIBRLE_IMPLEMENTED
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rle_codec.h"
+#include "rle_bmp.h"
+
+/* Una llamada en curso: lo que comparten los hilos */
+typedef struct {
+    const RLELib        *lib;
+    uint32_t             width;
+    uint32_t             num_items;     /* tiles o chunks */
+    atomic_uint          next;          /* siguiente tile / chunk sin reclamar */
+    /* compresión */
+    const uint8_t       *rgb;
+    uint32_t             height;
+    uint32_t             tile_rows;
+    uint8_t             *dst;           /* tile t en dst + base + t * tile_bound (hilos) */
+    size_t               base;
+    size_t               tile_bound;
+    /* descompresión */
+    const RLEFileHeader *hdr;
+    const RLEChunkEntry *chunks;        /* ítem k = chunk first + k */
+    uint32_t             first;
+    const uint8_t       *src;
+    uint8_t             *out;           /* fila y0 de la ventana */
+    uint32_t             y0;
+    uint32_t             y1;
+    /* BMP: num_items bandas de filas de rgb */
+    int                  fd;
+    int                  bgr;
+    /* actualización */
+    uint8_t             *changed;       /* 1 = la banda del chunk i difiere */
+    uint32_t            *raw_crc;       /* sin RLE_FLAG_RAW_CRC: CRC32C de las bandas iguales */
+    RLEChunkEntry       *fresh;         /* entradas nuevas de los chunks cambiados */
+} RLELibJob;
+
+struct RLELibWorker {
+    RLELibJob *job;
+    uint8_t   *scratch;                 /* planos separados del modo planar */
+    size_t     scratch_cap;
+    size_t     runs;
+    size_t     bytes;
+    uint32_t   hits;                    /* tiles copiados de la caché */
+    uint32_t   bad;
+    uint32_t   first_bad;
+    pthread_t  tid;
+};
+
+/*
+ * Hilos persistentes de RLE_LIB_POOL: el hilo k del pool hace de worker k
+ * (el 0 es siempre el que llama). librle_run sube gen y despierta a todos;
+ * los que no entran en la llamada vuelven a dormir.
+ */
+struct RLELibPool {
+    pthread_mutex_t lock;
+    pthread_cond_t  go;                 /* llamada nueva o stop */
+    pthread_cond_t  idle;               /* terminaron los workers de la llamada */
+    RLELib         *lib;
+    void         *(*fn)(void *);
+    unsigned        gen;
+    int             active;             /* workers de la llamada, contando el 0 */
+    int             running;            /* hilos del pool todavía dentro de fn */
+    int             stop;
+    int             num_threads;        /* hilos creados (workers 1..num_threads) */
+    struct RLELibPoolThread {
+        struct RLELibPool *pool;
+        int                idx;
+        pthread_t          tid;
+    } *threads;
+};
+
+static int librle_fail(RLELib *lib, int code, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(lib->error, sizeof(lib->error), fmt, ap);
+    va_end(ap);
+    return code;
+}
+
+static void *librle_pool_func(void *arg) {
+    struct RLELibPoolThread *t = (struct RLELibPoolThread *)arg;
+    struct RLELibPool *p = t->pool;
+    unsigned seen = 0;
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->stop && p->gen == seen)
+            pthread_cond_wait(&p->go, &p->lock);
+        if (p->stop) break;
+        seen = p->gen;
+        if (t->idx >= p->active) continue;
+        /* lib->workers puede haberse movido (librle_reserve) entre llamadas */
+        struct RLELibWorker *wk = &p->lib->workers[t->idx];
+        void *(*fn)(void *) = p->fn;
+        pthread_mutex_unlock(&p->lock);
+        fn(wk);
+        pthread_mutex_lock(&p->lock);
+        if (--p->running == 0)
+            pthread_cond_signal(&p->idle);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void librle_pool_stop(RLELib *lib) {
+    struct RLELibPool *p = lib->pool;
+    if (!p) return;
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->go);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->num_threads; i++)
+        pthread_join(p->threads[i].tid, NULL);
+    pthread_cond_destroy(&p->go);
+    pthread_cond_destroy(&p->idle);
+    pthread_mutex_destroy(&p->lock);
+    free(p->threads);
+    free(p);
+    lib->pool = NULL;
+}
+
+/* Crea los hilos del pool; si alguno no arranca, el pool queda con los que sí */
+static int librle_pool_start(RLELib *lib) {
+    long n = lib->cfg.threads > 0 ? lib->cfg.threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    struct RLELibPool *p = calloc(1, sizeof(*p));
+    if (!p || !(p->threads = calloc((size_t)n, sizeof(*p->threads)))) {
+        free(p);
+        return librle_fail(lib, RLE_LIB_ENOMEM, "Sin memoria para el pool de %ld hilos", n);
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->go, NULL);
+    pthread_cond_init(&p->idle, NULL);
+    p->lib = lib;
+    lib->pool = p;
+    for (int i = 0; i < n - 1; i++) {
+        p->threads[i].pool = p;
+        p->threads[i].idx = i + 1;
+        if (pthread_create(&p->threads[i].tid, NULL, librle_pool_func, &p->threads[i]) != 0)
+            break;
+        p->num_threads++;
+    }
+    return RLE_LIB_OK;
+}
+
+LIBRLEDEF void librle_config_default(RLELibConfig *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->backend = RLE_LIB_SEQUENTIAL;
+    cfg->mode = RLE_MODE_BYTE;
+}
+
+LIBRLEDEF int librle_init(RLELib *lib, const RLELibConfig *cfg) {
+    memset(lib, 0, sizeof(*lib));
+    lib->cfg = *cfg;
+    lib->kernel = rle_scan_select(cfg->force_scalar);
+    if (cfg->mode >= RLE_MODE_COUNT)
+        return librle_fail(lib, RLE_LIB_EINVAL, "Modo de codificación desconocido: %u", cfg->mode);
+    if (cfg->flags & ~RLE_FLAGS_KNOWN)
+        return librle_fail(lib, RLE_LIB_EINVAL, "Flags desconocidos: 0x%02x", cfg->flags);
+    if (cfg->backend != RLE_LIB_SEQUENTIAL && cfg->backend != RLE_LIB_THREADS &&
+        cfg->backend != RLE_LIB_POOL)
+        return librle_fail(lib, RLE_LIB_EINVAL, "Backend desconocido: %d", (int)cfg->backend);
+    if (cfg->backend == RLE_LIB_POOL)
+        return librle_pool_start(lib);
+    return RLE_LIB_OK;
+}
+
+LIBRLEDEF void librle_release(RLELib *lib) {
+    librle_pool_stop(lib);
+    for (int i = 0; i < lib->num_workers; i++)
+        free(lib->workers[i].scratch);
+    free(lib->workers);
+    free(lib->table);
+    lib->workers = NULL;
+    lib->num_workers = 0;
+    lib->table = NULL;
+    lib->table_cap = 0;
+}
+
+LIBRLEDEF const char *librle_error(const RLELib *lib) {
+    return lib->error[0] ? lib->error : "sin error";
+}
+
+LIBRLEDEF const char *librle_strerror(int code) {
+    switch (code) {
+    case RLE_LIB_OK:       return "sin error";
+    case RLE_LIB_EINVAL:   return "argumento inválido";
+    case RLE_LIB_ENOSPC:   return "buffer de salida insuficiente";
+    case RLE_LIB_ENOMEM:   return "sin memoria";
+    case RLE_LIB_EFORMAT:  return "formato .rle inválido";
+    case RLE_LIB_ECORRUPT: return "datos corruptos";
+    case RLE_LIB_EIO:      return "error de E/S";
+    default:               return "error desconocido";
+    }
+}
+
+/* ─── Buffers de salida ─── */
+
+static void librle_buffer_set(RLELibBuffer *b, uint8_t *block, size_t block_len, uint8_t *data,
+                              size_t cap, int mapped, const RLELibHooks *hooks) {
+    b->data = data;
+    b->size = 0;
+    b->capacity = cap;
+    b->block = block;
+    b->block_len = block_len;
+    b->mapped = mapped;
+    b->reallocs = 0;
+    b->hooks = hooks;
+}
+
+LIBRLEDEF int librle_buffer_init(RLELibBuffer *b, size_t cap, const RLELibHooks *hooks,
+                                 const char *label) {
+    if (cap < 1) cap = 1;
+    uint8_t *p = malloc(cap);
+    if (!p) return RLE_LIB_ENOMEM;
+    librle_buffer_set(b, p, cap, p, cap, 0, hooks);
+    if (hooks && hooks->syscall) hooks->syscall("malloc", "mmap/brk", label);
+    if (hooks && hooks->heap_alloc) hooks->heap_alloc(p, cap, label);
+    return RLE_LIB_OK;
+}
+
+LIBRLEDEF int librle_buffer_init_mapped(RLELibBuffer *b, size_t cap, const RLELibHooks *hooks,
+                                        const char *label) {
+    if (cap < 1) cap = 1;
+    void *p = mmap(NULL, cap, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return RLE_LIB_ENOMEM;
+    librle_buffer_set(b, p, cap, p, cap, 1, hooks);
+    if (hooks && hooks->syscall) hooks->syscall("mmap", "mmap", label);
+    if (hooks && hooks->mapped_alloc) hooks->mapped_alloc(p, cap, label);
+    return RLE_LIB_OK;
+}
+
+LIBRLEDEF int librle_buffer_init_arena(RLELibBuffer *b, size_t header, size_t payload,
+                                       const RLELibHooks *hooks, const char *label) {
+    uint8_t *p = malloc(header + payload ? header + payload : 1);
+    if (!p) return RLE_LIB_ENOMEM;
+    librle_buffer_set(b, p, header + payload, p + header, payload, 0, hooks);
+    if (hooks && hooks->syscall) hooks->syscall("malloc", "mmap/brk", label);
+    if (hooks && hooks->heap_alloc) hooks->heap_alloc(p, header + payload, label);
+    return RLE_LIB_OK;
+}
+
+LIBRLEDEF void librle_buffer_wrap(RLELibBuffer *b, uint8_t *data, size_t cap) {
+    librle_buffer_set(b, NULL, 0, data, cap, 0, NULL);
+}
+
+LIBRLEDEF int librle_buffer_push(RLELibBuffer *b, const void *src, size_t n) {
+    if (b->size + n > b->capacity) {
+        /* Solo crece el heap sin header: mmap, arena y memoria ajena tienen capacidad fija */
+        if (b->mapped || !b->block || b->block != b->data) return RLE_LIB_ENOSPC;
+        size_t cap = b->capacity;
+        while (b->size + n > cap) cap *= 2;
+        uint8_t *p = realloc(b->data, cap);
+        if (!p) return RLE_LIB_ENOMEM;
+        b->reallocs++;
+        if (b->hooks && b->hooks->heap_resize) b->hooks->heap_resize(b->data, p, cap);
+        b->data = b->block = p;
+        b->capacity = b->block_len = cap;
+    }
+    memcpy(b->data + b->size, src, n);
+    b->size += n;
+    return RLE_LIB_OK;
+}
+
+LIBRLEDEF void librle_buffer_free(RLELibBuffer *b) {
+    if (b->block) {
+        if (b->hooks && b->hooks->heap_free) b->hooks->heap_free(b->block);
+        if (b->mapped)
+            munmap(b->block, b->block_len);
+        else
+            free(b->block);
+    }
+    b->data = b->block = NULL;
+    b->size = b->capacity = b->block_len = 0;
+}
+
+/* Bytes RGB de w x h, o 0 si no entran en size_t (con margen para la cota 2x) */
+static size_t librle_raw_bytes(uint32_t w, uint32_t h) {
+    uint64_t raw = (uint64_t)w * h * 3;
+    return raw > SIZE_MAX / 4 ? 0 : (size_t)raw;
+}
+
+LIBRLEDEF size_t librle_compress_bound(const RLELib *lib, uint32_t w, uint32_t h) {
+    size_t raw = librle_raw_bytes(w, h);
+    if (raw == 0) return 0;
+    uint32_t tiles = rle_tile_count(h, rle_tile_rows(w, h, lib->cfg.tile_rows));
+    return rle_container_size(tiles, rle_encoded_bound(lib->cfg.mode, raw));
+}
+
+/* Hilos de la llamada: 1 en secuencial, si no cfg.threads (o las CPUs), como mucho uno por ítem */
+static int librle_thread_count(const RLELib *lib, uint32_t items) {
+    long n = 1;
+    if (lib->cfg.backend == RLE_LIB_POOL && lib->pool) {
+        n = lib->pool->num_threads + 1;
+    } else if (lib->cfg.backend == RLE_LIB_THREADS) {
+        n = lib->cfg.threads > 0 ? lib->cfg.threads : sysconf(_SC_NPROCESSORS_ONLN);
+        if (n < 1) n = 1;
+    }
+    if (items > 0 && (uint32_t)n > items) n = (long)items;
+    return (int)n;
+}
+
+/* Reserva n workers (conservando su scratch) y tabla para num_chunks entradas */
+static int librle_reserve(RLELib *lib, int n, size_t scratch, uint32_t num_chunks) {
+    if (n > lib->num_workers) {
+        struct RLELibWorker *w = realloc(lib->workers, (size_t)n * sizeof(*w));
+        if (!w) return librle_fail(lib, RLE_LIB_ENOMEM, "Sin memoria para %d hilos", n);
+        memset(w + lib->num_workers, 0, (size_t)(n - lib->num_workers) * sizeof(*w));
+        lib->workers = w;
+        lib->num_workers = n;
+    }
+    for (int i = 0; i < n; i++) {
+        struct RLELibWorker *wk = &lib->workers[i];
+        if (scratch > wk->scratch_cap) {
+            uint8_t *p = realloc(wk->scratch, scratch);
+            if (!p) return librle_fail(lib, RLE_LIB_ENOMEM, "Sin memoria para el scratch");
+            wk->scratch = p;
+            wk->scratch_cap = scratch;
+        }
+        wk->runs = wk->bytes = 0;
+        wk->hits = 0;
+        wk->bad = 0;
+        wk->first_bad = UINT32_MAX;
+    }
+    if (num_chunks > lib->table_cap) {
+        RLEChunkEntry *t = realloc(lib->table, (size_t)num_chunks * sizeof(RLEChunkEntry));
+        if (!t) return librle_fail(lib, RLE_LIB_ENOMEM, "Sin memoria para %u chunks", num_chunks);
+        lib->table = t;
+        lib->table_cap = num_chunks;
+    }
+    return RLE_LIB_OK;
+}
+
+/*
+ * Corre fn en n workers: n - 1 hilos nuevos más el que llama. Si algún
+ * pthread_create falla, los que sí arrancaron (y el que llama) se quedan con
+ * su parte: los ítems se reclaman de a uno, así que nadie espera a nadie.
+ */
+static int librle_run(RLELib *lib, RLELibJob *job, int n, void *(*fn)(void *)) {
+    int started = 1;
+    for (int i = 0; i < n; i++)
+        lib->workers[i].job = job;
+    struct RLELibPool *p = lib->pool;
+    if (p) {
+        /* Pool: n <= num_threads + 1 (librle_thread_count), sin pthread_create */
+        pthread_mutex_lock(&p->lock);
+        p->fn = fn;
+        p->active = n;
+        p->running = n - 1;
+        p->gen++;
+        pthread_cond_broadcast(&p->go);
+        pthread_mutex_unlock(&p->lock);
+        fn(&lib->workers[0]);
+        pthread_mutex_lock(&p->lock);
+        while (p->running > 0)
+            pthread_cond_wait(&p->idle, &p->lock);
+        pthread_mutex_unlock(&p->lock);
+        return n;
+    }
+    for (; started < n; started++)
+        if (pthread_create(&lib->workers[started].tid, NULL, fn, &lib->workers[started]) != 0)
+            break;
+    fn(&lib->workers[0]);
+    for (int i = 1; i < started; i++)
+        pthread_join(lib->workers[i].tid, NULL);
+    return started;
+}
+
+/* ─── Compresión ─── */
+
+static uint64_t librle_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * librle_encode_chunk con modo, flags y caché explícitos (la actualización
+ * codifica con los del archivo, sin caché). Caché: un acierto es una copia;
+ * un fallo se codifica, se mide y se agrega.
+ */
+static int librle_encode_with(const RLELib *lib, uint8_t mode, uint8_t flags,
+                              RLEChunkCache *cache, RLELibChunk *c) {
+    const RLELibHooks *hooks = lib->hooks;
+    uint64_t t0 = hooks && hooks->chunk ? librle_now_ns() : 0;
+    RLELibBuffer *out = c->out;
+    const size_t start = out ? out->size : 0;
+    uint32_t n_crc = 0;
+    int rc;
+    c->records = 0;
+    c->hit = 0;
+    memset(&c->entry, 0, sizeof(c->entry));
+
+    RLEChunkKey key;
+    uint64_t miss_t0 = 0;
+    if (cache) {
+        key = rle_chunk_key(c->band, c->bytes, mode, flags);
+        RLEChunkCacheEntry hit;
+        if (rle_chunk_cache_lookup(cache, &key, &hit)) {
+            if (c->dst)
+                memcpy(c->dst, hit.data, hit.length);
+            else if ((rc = librle_buffer_push(out, hit.data, hit.length)) != RLE_LIB_OK)
+                return rc;
+            c->entry.length = hit.length;
+            c->entry.checksum = hit.checksum;
+            c->entry.raw_checksum = hit.raw_checksum;
+            c->entry.codec = hit.codec;
+            c->hit = 1;
+            atomic_fetch_add_explicit(&cache->hits, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&cache->hit_bytes, c->bytes, memory_order_relaxed);
+            goto done;
+        }
+        miss_t0 = librle_now_ns();
+    }
+
+    RLEEncoder enc;
+    rle_encoder_init(&enc, &lib->kernel, mode, flags, c->band, c->bytes, c->scratch);
+    if (c->codec >= 0)
+        enc.codec = (uint8_t)c->codec;      /* la capacidad medida es la de ese codec */
+    size_t len = 0, n;
+    if (c->dst) {
+        /* Capacidad garantizada: la variante especializada escribe un paso entero */
+        const size_t step = c->progress ? RLE_PROGRESS_STEP : SIZE_MAX;
+        while ((n = rle_encode_some(&enc, c->dst + len, step)) != 0) {
+            len += n;
+            if (c->progress)
+                rle_progress_publish(c->progress, c->in_base + enc.pos, c->out_base + len);
+        }
+    } else {
+        /* El progreso cada RLE_PROGRESS_STEP bytes de entrada, no por run */
+        uint8_t rec[RLE_MAX_RECORD];
+        size_t publish_at = RLE_PROGRESS_STEP;
+        while ((n = rle_encode_next(&enc, rec)) != 0) {
+            if ((rc = librle_buffer_push(out, rec, n)) != RLE_LIB_OK)
+                return rc;
+            len += n;
+            if (c->progress && enc.pos >= publish_at) {
+                rle_progress_publish(c->progress, c->in_base + enc.pos, c->out_base + len);
+                publish_at = enc.pos + RLE_PROGRESS_STEP;
+            }
+        }
+    }
+    /* Una banda que no entró en su tamaño crudo se guarda tal cual (--adaptive) */
+    size_t final = rle_encoder_finish(&enc, c->dst, len);
+    if (!c->dst && final != len) {
+        out->size = start;
+        if ((rc = librle_buffer_push(out, c->band, c->bytes)) != RLE_LIB_OK)
+            return rc;
+    }
+    c->records = enc.records;
+    c->entry.length = final;
+    c->entry.codec = enc.codec;
+    c->entry.raw_checksum = rle_raw_checksum(flags, c->band, c->bytes);
+    if (c->crc || cache) {
+        n_crc = rle_crc32c(0, c->dst ? c->dst : out->data + start, final);
+        c->entry.checksum = n_crc;
+    }
+    if (cache) {
+        atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&cache->miss_bytes, c->bytes, memory_order_relaxed);
+        atomic_fetch_add_explicit(&cache->miss_ns, librle_now_ns() - miss_t0, memory_order_relaxed);
+        rle_chunk_cache_insert(cache, &key, c->dst ? c->dst : out->data + start, (uint32_t)final,
+                               n_crc, c->entry.raw_checksum, c->entry.codec);
+    }
+done:
+    if (c->progress)
+        rle_progress_publish(c->progress, c->in_base + c->bytes, c->out_base + c->entry.length);
+    if (hooks && hooks->chunk)
+        hooks->chunk(c->ctx, c, 0, t0, librle_now_ns());
+    return RLE_LIB_OK;
+}
+
+LIBRLEDEF int librle_encode_chunk(const RLELib *lib, RLELibChunk *c) {
+    return librle_encode_with(lib, lib->cfg.mode, lib->cfg.flags, lib->cache, c);
+}
+
+LIBRLEDEF size_t librle_measure_chunk(const RLELib *lib, RLELibChunk *c) {
+    const RLELibHooks *hooks = lib->hooks;
+    uint64_t t0 = hooks && hooks->chunk ? librle_now_ns() : 0;
+    memset(&c->entry, 0, sizeof(c->entry));
+    c->records = 0;
+    c->hit = 0;
+    RLEChunkCacheEntry hit;
+    if (lib->cache) {
+        RLEChunkKey key = rle_chunk_key(c->band, c->bytes, lib->cfg.mode, lib->cfg.flags);
+        c->hit = rle_chunk_cache_lookup(lib->cache, &key, &hit);
+    }
+    if (c->hit) {
+        c->entry.length = hit.length;       /* la misma banda codifica al mismo largo */
+        c->entry.codec = hit.codec;
+    } else {
+        RLEEncoder enc;
+        rle_encoder_init(&enc, &lib->kernel, lib->cfg.mode, lib->cfg.flags, c->band, c->bytes,
+                         c->scratch);
+        c->entry.length = rle_encoder_measure(&enc);
+        c->entry.codec = enc.codec;
+    }
+    if (hooks && hooks->chunk)
+        hooks->chunk(c->ctx, c, 1, t0, librle_now_ns());
+    return c->entry.length;
+}
+
+/* Codifica en dst la banda de e (start_row y num_rows ya puestos); completa length y CRCs */
+static size_t librle_encode_band(struct RLELibWorker *wk, uint8_t mode, uint8_t flags,
+                                 RLEChunkCache *cache, RLEChunkEntry *e, uint8_t *dst) {
+    const RLELibJob *job = wk->job;
+    RLELibChunk c;
+    memset(&c, 0, sizeof(c));
+    c.band = job->rgb + (size_t)e->start_row * job->width * 3;
+    c.bytes = (size_t)e->num_rows * job->width * 3;
+    c.scratch = wk->scratch;
+    c.dst = dst;
+    c.codec = -1;
+    c.crc = 1;
+    librle_encode_with(job->lib, mode, flags, cache, &c);   /* con dst no falla */
+    wk->runs += c.records;
+    wk->hits += (uint32_t)c.hit;
+    e->length = c.entry.length;
+    e->codec = c.entry.codec;
+    e->checksum = c.entry.checksum;
+    e->raw_checksum = c.entry.raw_checksum;
+    return e->length;
+}
+
+static size_t librle_encode_tile(struct RLELibWorker *wk, uint32_t t, uint8_t *dst) {
+    const RLELib *lib = wk->job->lib;
+    RLEChunkEntry *e = &lib->table[t];
+    memset(e, 0, sizeof(*e));
+    rle_tile_range(wk->job->height, wk->job->tile_rows, t, &e->start_row, &e->num_rows);
+    return librle_encode_band(wk, lib->cfg.mode, lib->cfg.flags, lib->cache, e, dst);
+}
+
+/*
+ * Chunks compartidos dentro de un archivo: slots es una tabla abierta
+ * (mask + 1 huecos, 0 = libre, si no índice de tile + 1) por CRC32C del
+ * chunk codificado. Devuelve un tile anterior cuyos bytes (ya en su lugar en
+ * dst) son idénticos a data, o registra t (offset ya puesto) y devuelve
+ * UINT32_MAX. La comparación es byte a byte: compartir nunca cambia lo que
+ * se decodifica.
+ */
+static uint32_t librle_share(uint32_t *slots, uint32_t mask, const RLEChunkEntry *table,
+                             const uint8_t *dst, uint32_t t, const uint8_t *data) {
+    const RLEChunkEntry *e = &table[t];
+    uint32_t i = e->checksum & mask;
+    for (; slots[i]; i = (i + 1) & mask) {
+        const RLEChunkEntry *o = &table[slots[i] - 1];
+        if (o->checksum == e->checksum && o->length == e->length &&
+            memcmp(dst + o->offset, data, e->length) == 0)
+            return slots[i] - 1;
+    }
+    slots[i] = t + 1;
+    return UINT32_MAX;
+}
+
+static void *librle_compress_func(void *arg) {
+    struct RLELibWorker *wk = (struct RLELibWorker *)arg;
+    RLELibJob *job = wk->job;
+    uint32_t t;
+    while ((t = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->num_items)
+        librle_encode_tile(wk, t, job->dst + job->base + (size_t)t * job->tile_bound);
+    return NULL;
+}
+
+LIBRLEDEF int librle_compress(RLELib *lib, const uint8_t *rgb, uint32_t w, uint32_t h,
+                              uint8_t *dst, size_t cap, size_t *out_len) {
+    memset(&lib->stats, 0, sizeof(lib->stats));
+    lib->stats.first_bad = UINT32_MAX;
+    lib->error[0] = '\0';
+    if (!rgb || !dst || w == 0 || h == 0)
+        return librle_fail(lib, RLE_LIB_EINVAL, "Imagen vacía o buffer NULL (%ux%u)", w, h);
+    size_t bound = librle_compress_bound(lib, w, h);
+    if (bound == 0)
+        return librle_fail(lib, RLE_LIB_EINVAL, "Imagen demasiado grande (%ux%u)", w, h);
+    if (cap < bound)
+        return librle_fail(lib, RLE_LIB_ENOSPC, "El buffer tiene %zu bytes, se necesitan %zu",
+                           cap, bound);
+
+    RLELibJob job;
+    memset(&job, 0, sizeof(job));
+    job.lib = lib;
+    job.rgb = rgb;
+    job.width = w;
+    job.height = h;
+    job.tile_rows = rle_tile_rows(w, h, lib->cfg.tile_rows);
+    job.num_items = rle_tile_count(h, job.tile_rows);
+    job.dst = dst;
+    job.base = rle_container_size(job.num_items, 0);
+    size_t tile_bytes = (size_t)job.tile_rows * w * 3;
+    job.tile_bound = rle_encoded_bound(lib->cfg.mode, tile_bytes);
+    atomic_init(&job.next, 0);
+
+    int n = librle_thread_count(lib, job.num_items);
+    int rc = librle_reserve(lib, n, rle_encoder_scratch_size(lib->cfg.mode, tile_bytes),
+                            job.num_items);
+    if (rc != RLE_LIB_OK) return rc;
+
+    /* Con caché, tabla de chunks compartidos (potencia de 2, al menos 2 huecos por tile) */
+    uint32_t *share = NULL, mask = 0;
+    if (lib->cache) {
+        uint32_t cap = 2;
+        while (cap < 2 * job.num_items) cap *= 2;
+        if (!(share = calloc(cap, sizeof(uint32_t))))
+            return librle_fail(lib, RLE_LIB_ENOMEM, "Sin memoria para %u chunks", job.num_items);
+        mask = cap - 1;
+    }
+
+    size_t off = job.base;
+    if (n == 1) {
+        /* Secuencial: cada tile va directo tras el anterior */
+        lib->workers[0].job = &job;
+        for (uint32_t t = 0; t < job.num_items; t++) {
+            size_t len = librle_encode_tile(&lib->workers[0], t, dst + off);
+            lib->table[t].offset = off;
+            uint32_t j = share ? librle_share(share, mask, lib->table, dst, t, dst + off) : UINT32_MAX;
+            if (j != UINT32_MAX) {
+                lib->table[t].offset = lib->table[j].offset;
+                lib->stats.shared_chunks++;
+            } else {
+                off += len;
+            }
+        }
+        lib->stats.threads_used = 1;
+    } else {
+        /* Hilos: cada tile en su hueco de peor caso; después se compactan en orden */
+        lib->stats.threads_used = librle_run(lib, &job, n, librle_compress_func);
+        for (uint32_t t = 0; t < job.num_items; t++) {
+            size_t from = job.base + (size_t)t * job.tile_bound;
+            lib->table[t].offset = off;
+            uint32_t j = share ? librle_share(share, mask, lib->table, dst, t, dst + from) : UINT32_MAX;
+            if (j != UINT32_MAX) {
+                lib->table[t].offset = lib->table[j].offset;
+                lib->stats.shared_chunks++;
+                continue;
+            }
+            if (from != off) memmove(dst + off, dst + from, lib->table[t].length);
+            off += lib->table[t].length;
+        }
+    }
+    free(share);
+    if (lib->cache)
+        atomic_fetch_add_explicit(&lib->cache->shared, lib->stats.shared_chunks, memory_order_relaxed);
+    for (int i = 0; i < n; i++) {
+        lib->stats.runs += lib->workers[i].runs;
+        lib->stats.cache_hits += lib->workers[i].hits;
+    }
+
+    RLEFileHeader hdr;
+    rle_header_init(&hdr, w, h, lib->cfg.mode, lib->cfg.flags, job.num_items);
+    memcpy(dst, &hdr, sizeof(hdr));
+    memcpy(dst + sizeof(hdr), lib->table, (size_t)job.num_items * sizeof(RLEChunkEntry));
+    lib->stats.num_chunks = job.num_items;
+    lib->stats.bytes = off;
+    if (out_len) *out_len = off;
+    return RLE_LIB_OK;
+}
+
+/* ─── Descompresión ─── */
+
+LIBRLEDEF int librle_info(RLELib *lib, const uint8_t *src, size_t len, RLEFileHeader *hdr) {
+    lib->error[0] = '\0';
+    if (!src || len < 8)
+        return librle_fail(lib, RLE_LIB_EFORMAT, "Entrada demasiado pequeña (%zu bytes)", len);
+
+    if (len >= sizeof(RLEFileHeader) && memcmp(src, RLE_MAGIC, 4) == 0) {
+        memcpy(hdr, src, sizeof(*hdr));
+        uint64_t table_bytes = (uint64_t)hdr->num_chunks * sizeof(RLEChunkEntry);
+        if (hdr->table_offset > len || table_bytes > len - hdr->table_offset)
+            return librle_fail(lib, RLE_LIB_EFORMAT, "Tabla de chunks truncada");
+        int rc = librle_reserve(lib, 0, 0, hdr->num_chunks);
+        if (rc != RLE_LIB_OK) return rc;
+        memcpy(lib->table, src + hdr->table_offset, (size_t)table_bytes);
+        if (rle_container_check(hdr, lib->table, len, lib->error, sizeof(lib->error)) != 0)
+            return RLE_LIB_EFORMAT;
+        return RLE_LIB_OK;
+    }
+
+    /* Formato legado: {width, height} + runs de bytes, un solo chunk */
+    uint32_t dims[2];
+    memcpy(dims, src, sizeof(dims));
+    rle_header_init(hdr, dims[0], dims[1], RLE_MODE_BYTE, 0, 1);
+    int rc = librle_reserve(lib, 0, 0, 1);
+    if (rc != RLE_LIB_OK) return rc;
+    memset(lib->table, 0, sizeof(RLEChunkEntry));
+    lib->table[0].offset = 8;
+    lib->table[0].length = len - 8;
+    lib->table[0].num_rows = dims[1];
+    lib->table[0].checksum = rle_crc32c(0, src + 8, len - 8);
+    return RLE_LIB_OK;
+}
+
+/*
+ * Decodifica el chunk i. Si cae entero dentro de [y0, y1) va directo a su
+ * lugar en la salida; si es un borde de la ventana se decodifica completo en
+ * el scratch (para poder comprobar su CRC) y se copian solo las filas pedidas.
+ */
+static void librle_decode_one(struct RLELibWorker *wk, uint32_t i) {
+    const RLELibJob *job = wk->job;
+    const RLELibConfig *cfg = &job->lib->cfg;
+    const RLEChunkEntry *e = &job->chunks[i];
+    const uint8_t *data = job->src + e->offset;
+    size_t row_bytes = (size_t)job->width * 3;
+    size_t band_size = (size_t)e->num_rows * row_bytes;
+    uint32_t lo = e->start_row > job->y0 ? e->start_row : job->y0;
+    uint32_t hi = e->start_row + e->num_rows < job->y1 ? e->start_row + e->num_rows : job->y1;
+    int whole = lo == e->start_row && hi == e->start_row + e->num_rows;
+    uint8_t *band = whole ? job->out + (size_t)(e->start_row - job->y0) * row_bytes : wk->scratch;
+
+    int bad = cfg->verify_crc && rle_crc32c(0, data, e->length) != e->checksum;
+    RLEDecoder d;
+    rle_decoder_init(&d, job->hdr->mode, job->hdr->flags, e->codec, data, e->length,
+                     band, band_size);
+    d.bgr = cfg->bgr;
+    while (rle_decode_some(&d, SIZE_MAX) != 0) {}
+    if (whole) {
+        wk->bytes += d.out;
+    } else {
+        size_t from = (size_t)(lo - e->start_row) * row_bytes, n = (size_t)(hi - lo) * row_bytes;
+        memcpy(job->out + (size_t)(lo - job->y0) * row_bytes, band + from, n);
+        wk->bytes += d.out > from ? (d.out - from < n ? d.out - from : n) : 0;
+    }
+    if (job->hdr->flags & RLE_FLAG_RAW_CRC) {
+        uint32_t crc = cfg->bgr ? rle_bgr_crc32c(band, d.out) : rle_crc32c(0, band, d.out);
+        bad |= crc != e->raw_checksum;
+    }
+    if (bad || d.out != band_size) {
+        wk->bad++;
+        if (i < wk->first_bad) wk->first_bad = i;
+    }
+}
+
+static void *librle_decode_func(void *arg) {
+    struct RLELibWorker *wk = (struct RLELibWorker *)arg;
+    RLELibJob *job = wk->job;
+    uint32_t k;
+    while ((k = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->num_items)
+        librle_decode_one(wk, job->first + k);
+    return NULL;
+}
+
+/* Primer chunk cuya banda termina después de la fila y (la tabla es contigua) */
+static uint32_t librle_chunk_at(const RLEFileHeader *hdr, const RLEChunkEntry *chunks, uint32_t y) {
+    uint32_t lo = 0, hi = hdr->num_chunks;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (chunks[mid].start_row + chunks[mid].num_rows <= y) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+LIBRLEDEF int librle_decode_rows(RLELib *lib, const RLEFileHeader *hdr,
+                                 const RLEChunkEntry *chunks, const uint8_t *base,
+                                 uint32_t y0, uint32_t y1, uint8_t *rgb, size_t cap) {
+    memset(&lib->stats, 0, sizeof(lib->stats));
+    lib->stats.first_bad = UINT32_MAX;
+    lib->error[0] = '\0';
+    if (y0 > y1 || y1 > hdr->height)
+        return librle_fail(lib, RLE_LIB_EINVAL, "Filas %u-%u fuera de la imagen (alto %u)",
+                           y0, y1, hdr->height);
+    size_t row_bytes = (size_t)hdr->width * 3, need = (size_t)(y1 - y0) * row_bytes;
+    if (!rgb || (!base && hdr->num_chunks > 0))
+        return librle_fail(lib, RLE_LIB_EINVAL, "Buffer NULL");
+    if (cap < need)
+        return librle_fail(lib, RLE_LIB_ENOSPC, "El buffer tiene %zu bytes, la ventana %zu",
+                           cap, need);
+
+    RLELibJob job;
+    memset(&job, 0, sizeof(job));
+    job.lib = lib;
+    job.width = hdr->width;
+    job.hdr = hdr;
+    job.chunks = chunks;
+    job.src = base;
+    job.out = rgb;
+    job.y0 = y0;
+    job.y1 = y1;
+    job.first = librle_chunk_at(hdr, chunks, y0);
+    uint32_t last = y1 > y0 ? librle_chunk_at(hdr, chunks, y1 - 1) : job.first;
+    job.num_items = y1 > y0 && job.first < hdr->num_chunks ? last - job.first + 1 : 0;
+    atomic_init(&job.next, 0);
+
+    /* Scratch para los chunks de los bordes que no entran enteros */
+    size_t scratch = 0;
+    for (uint32_t k = 0; k < job.num_items; k += job.num_items > 1 ? job.num_items - 1 : 1) {
+        const RLEChunkEntry *e = &chunks[job.first + k];
+        if (e->start_row < y0 || e->start_row + e->num_rows > y1) {
+            size_t band = (size_t)e->num_rows * row_bytes;
+            if (band > scratch) scratch = band;
+        }
+    }
+
+    int n = librle_thread_count(lib, job.num_items);
+    int rc = librle_reserve(lib, n, scratch, 0);
+    if (rc != RLE_LIB_OK) return rc;
+    lib->stats.threads_used = librle_run(lib, &job, n, librle_decode_func);
+
+    lib->stats.num_chunks = job.num_items;
+    for (int i = 0; i < n; i++) {
+        const struct RLELibWorker *wk = &lib->workers[i];
+        lib->stats.bytes += wk->bytes;
+        lib->stats.bad_chunks += wk->bad;
+        if (wk->first_bad < lib->stats.first_bad) lib->stats.first_bad = wk->first_bad;
+    }
+    if (lib->stats.bad_chunks)
+        return librle_fail(lib, RLE_LIB_ECORRUPT, "%u chunk(s) corruptos, el primero es el %u",
+                           lib->stats.bad_chunks, lib->stats.first_bad);
+    return RLE_LIB_OK;
+}
+
+LIBRLEDEF int librle_decode_chunks(RLELib *lib, const RLEFileHeader *hdr,
+                                   const RLEChunkEntry *chunks, const uint8_t *base,
+                                   uint8_t *rgb, size_t cap) {
+    return librle_decode_rows(lib, hdr, chunks, base, 0, hdr->height, rgb, cap);
+}
+
+LIBRLEDEF int librle_decompress(RLELib *lib, const uint8_t *src, size_t len,
+                                uint8_t *rgb, size_t cap) {
+    RLEFileHeader hdr;
+    int rc = librle_info(lib, src, len, &hdr);
+    if (rc != RLE_LIB_OK) return rc;
+    return librle_decode_chunks(lib, &hdr, lib->table, src, rgb, cap);
+}
+
+/* ─── Archivo mapeado ─── */
+
+LIBRLEDEF int librle_file_open(RLELib *lib, RLELibFile *f, const char *path) {
+    memset(f, 0, sizeof(*f));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return librle_fail(lib, RLE_LIB_EIO, "%s: %s", path, strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        return librle_fail(lib, RLE_LIB_EIO, "%s: %s", path, strerror(err));
+    }
+    if (st.st_size <= 0) {
+        close(fd);
+        return librle_fail(lib, RLE_LIB_EFORMAT, "%s: archivo vacío", path);
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                  /* el mapeo sigue válido sin el descriptor */
+    if (p == MAP_FAILED) return librle_fail(lib, RLE_LIB_EIO, "mmap %s: %s", path, strerror(errno));
+    /* Un visor pide ventanas sueltas: sin readahead del archivo entero */
+    madvise(p, (size_t)st.st_size, MADV_RANDOM);
+    f->data = p;
+    f->size = (size_t)st.st_size;
+
+    int rc = librle_info(lib, f->data, f->size, &f->header);
+    size_t table_bytes = (size_t)f->header.num_chunks * sizeof(RLEChunkEntry);
+    if (rc == RLE_LIB_OK && !(f->chunks = malloc(table_bytes ? table_bytes : 1)))
+        rc = librle_fail(lib, RLE_LIB_ENOMEM, "Sin memoria para la tabla de %s", path);
+    if (rc != RLE_LIB_OK) {
+        librle_file_close(f);
+        return rc;
+    }
+    memcpy(f->chunks, lib->table, table_bytes);
+    return RLE_LIB_OK;
+}
+
+LIBRLEDEF void librle_file_close(RLELibFile *f) {
+    if (f->data) munmap((void *)f->data, f->size);
+    free(f->chunks);
+    memset(f, 0, sizeof(*f));
+}
+
+LIBRLEDEF int librle_file_decode_rows(RLELib *lib, const RLELibFile *f,
+                                      uint32_t y0, uint32_t y1, uint8_t *rgb, size_t cap) {
+    return librle_decode_rows(lib, &f->header, f->chunks, f->data, y0, y1, rgb, cap);
+}
+
+/* ─── Actualización incremental ─── */
+
+/*
+ * 1 si la banda del chunk i en la imagen nueva difiere de la del archivo.
+ * Con RLE_FLAG_RAW_CRC alcanza con el CRC32C de la banda nueva (un cambio
+ * pasa inadvertido solo con una colisión, 2^-32); sin él se decodifica el
+ * chunk anterior en el scratch, se comparan los bytes y, si son iguales, se
+ * deja en raw_crc[i] el CRC32C que el archivo va a guardar desde ahora.
+ */
+static int librle_band_changed(struct RLELibWorker *wk, uint32_t i) {
+    const RLELibJob *job = wk->job;
+    const RLEChunkEntry *e = &job->chunks[i];
+    size_t bytes = (size_t)e->num_rows * job->width * 3;
+    const uint8_t *band = job->rgb + (size_t)e->start_row * job->width * 3;
+    if (job->hdr->flags & RLE_FLAG_RAW_CRC)
+        return rle_crc32c(0, band, bytes) != e->raw_checksum;
+
+    RLEDecoder d;
+    rle_decoder_init(&d, job->hdr->mode, job->hdr->flags, e->codec, job->src + e->offset,
+                     e->length, wk->scratch, bytes);
+    while (rle_decode_some(&d, SIZE_MAX) != 0) {}
+    if (d.out != bytes || memcmp(wk->scratch, band, bytes) != 0)
+        return 1;
+    job->raw_crc[i] = rle_crc32c(0, band, bytes);
+    return 0;
+}
+
+static void *librle_diff_func(void *arg) {
+    struct RLELibWorker *wk = (struct RLELibWorker *)arg;
+    RLELibJob *job = wk->job;
+    uint32_t i;
+    while ((i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->num_items)
+        job->changed[i] = (uint8_t)librle_band_changed(wk, i);
+    return NULL;
+}
+
+static void *librle_reencode_func(void *arg) {
+    struct RLELibWorker *wk = (struct RLELibWorker *)arg;
+    RLELibJob *job = wk->job;
+    uint32_t k;
+    while ((k = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->num_items)
+        librle_encode_band(wk, job->hdr->mode, job->hdr->flags, NULL, &job->fresh[k],
+                           job->dst + (size_t)k * job->tile_bound);
+    return NULL;
+}
+
+static int librle_offset_cmp(const void *a, const void *b) {
+    uint64_t x = ((const RLEChunkEntry *)a)->offset, y = ((const RLEChunkEntry *)b)->offset;
+    return (x > y) - (x < y);
+}
+
+static int librle_pwrite_all(int fd, const void *buf, size_t n, uint64_t off) {
+    const uint8_t *p = (const uint8_t *)buf;
+    while (n > 0) {
+        ssize_t w = pwrite(fd, p, n, (off_t)off);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+        off += (uint64_t)w;
+    }
+    return 0;
+}
+
+/*
+ * Bytes que referencia la tabla: header, tabla y cada chunk una vez (los
+ * compartidos tienen el mismo offset). Deja en byoff la tabla ordenada por
+ * offset con el índice de cada entrada en reserved, que es el orden en que
+ * librle_compact copia los chunks.
+ */
+static uint64_t librle_live_bytes(const RLEChunkEntry *table, RLEChunkEntry *byoff, uint32_t n) {
+    memcpy(byoff, table, (size_t)n * sizeof(RLEChunkEntry));
+    for (uint32_t i = 0; i < n; i++) byoff[i].reserved = i;
+    qsort(byoff, n, sizeof(RLEChunkEntry), librle_offset_cmp);
+    uint64_t live = sizeof(RLEFileHeader) + (uint64_t)n * sizeof(RLEChunkEntry);
+    for (uint32_t i = 0; i < n; i++)
+        if (i == 0 || byoff[i].offset != byoff[i - 1].offset) live += byoff[i].length;
+    return live;
+}
+
+/*
+ * Escribe en <path>.tmp la versión nueva sin espacio muerto (header, tabla y
+ * los chunks en orden de offset, como una compresión completa) y la pone en
+ * lugar de path con un rename: un lector con el archivo ya abierto sigue
+ * viendo el inodo anterior. Como en el camino de agregar, nada se da por
+ * hecho sin fsync: el del .tmp antes del rename y el del directorio después,
+ * que es el que deja la entrada nueva en disco. byoff es la tabla ordenada por offset con el
+ * índice de cada entrada en reserved; los chunks que están más allá de size
+ * vienen de fresh_data. Deja en *written el tamaño del archivo nuevo.
+ */
+static int librle_compact(RLELib *lib, const char *path, mode_t perm, RLEFileHeader *hdr,
+                          RLEChunkEntry *table, const RLEChunkEntry *byoff, uint32_t n,
+                          const uint8_t *map, size_t size, const uint8_t *fresh_data,
+                          uint64_t *written) {
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+        return librle_fail(lib, RLE_LIB_EINVAL, "Ruta demasiado larga: %s", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, perm & 0777);
+    if (fd < 0)
+        return librle_fail(lib, RLE_LIB_EIO, "%s: %s", tmp, strerror(errno));
+    size_t table_bytes = (size_t)n * sizeof(RLEChunkEntry);
+    uint64_t off = sizeof(RLEFileHeader) + table_bytes, prev = UINT64_MAX;
+    int err = 0;
+    for (uint32_t i = 0; i < n && !err; i++) {
+        RLEChunkEntry *e = &table[byoff[i].reserved];
+        if (byoff[i].offset != prev) {
+            const uint8_t *data = byoff[i].offset < size ? map + byoff[i].offset
+                                                         : fresh_data + (byoff[i].offset - size);
+            err = librle_pwrite_all(fd, data, e->length, off) != 0;
+            prev = byoff[i].offset;
+            off += e->length;
+        }
+        e->offset = off - e->length;    /* los compartidos siguen compartiendo */
+    }
+    hdr->table_offset = sizeof(RLEFileHeader);
+    err = err || librle_pwrite_all(fd, table, table_bytes, sizeof(RLEFileHeader)) != 0 ||
+          librle_pwrite_all(fd, hdr, sizeof(*hdr), 0) != 0 || fsync(fd) != 0;
+    int saved = errno;
+    if (close(fd) != 0 && !err) {
+        err = 1;
+        saved = errno;
+    }
+    if (!err && rename(tmp, path) != 0) {
+        err = 1;
+        saved = errno;
+    }
+    if (err) {
+        unlink(tmp);
+        return librle_fail(lib, RLE_LIB_EIO, "Compactación de %s: %s", path, strerror(saved));
+    }
+    memcpy(tmp, path, strlen(path) + 1);        /* dirname puede escribir su argumento */
+    int dfd = open(dirname(tmp), O_RDONLY);
+    if (dfd < 0 || fsync(dfd) != 0) {
+        saved = errno;
+        if (dfd >= 0) close(dfd);
+        return librle_fail(lib, RLE_LIB_EIO, "fsync del directorio de %s: %s", path, strerror(saved));
+    }
+    close(dfd);
+    *written = off;
+    return RLE_LIB_OK;
+}
+
+LIBRLEDEF int librle_update_file(RLELib *lib, const char *path, const uint8_t *rgb,
+                                 uint32_t w, uint32_t h, RLELibUpdate *up) {
+    memset(up, 0, sizeof(*up));
+    memset(&lib->stats, 0, sizeof(lib->stats));
+    lib->stats.first_bad = UINT32_MAX;
+    lib->error[0] = '\0';
+    if (!rgb || w == 0 || h == 0)
+        return librle_fail(lib, RLE_LIB_EINVAL, "Imagen vacía o buffer NULL (%ux%u)", w, h);
+
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return librle_fail(lib, RLE_LIB_EIO, "%s: %s", path, strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        return librle_fail(lib, RLE_LIB_EIO, "%s: %s", path, strerror(err));
+    }
+    size_t size = (size_t)st.st_size;
+    if (size < sizeof(RLEFileHeader)) {
+        close(fd);
+        return librle_fail(lib, RLE_LIB_EFORMAT, "%s: no es un contenedor .rle", path);
+    }
+    uint8_t *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        int err = errno;
+        close(fd);
+        return librle_fail(lib, RLE_LIB_EIO, "mmap %s: %s", path, strerror(err));
+    }
+
+    RLEFileHeader hdr;
+    RLEChunkEntry *table = NULL, *fresh = NULL, *byoff = NULL;
+    uint8_t *changed = NULL, *arena = NULL;
+    uint32_t *items = NULL, *raw_crc = NULL;
+    int rc = RLE_LIB_OK;
+    if (memcmp(map, RLE_MAGIC, 4) != 0) {
+        rc = librle_fail(lib, RLE_LIB_EFORMAT, "%s: formato legado sin tabla de chunks", path);
+        goto out;
+    }
+    if ((rc = librle_info(lib, map, size, &hdr)) != RLE_LIB_OK) goto out;
+    if (hdr.width != w || hdr.height != h) {
+        rc = librle_fail(lib, RLE_LIB_EINVAL, "La imagen es %ux%u y el .rle %ux%u",
+                         w, h, hdr.width, hdr.height);
+        goto out;
+    }
+    uint32_t n = hdr.num_chunks;
+    size_t table_bytes = (size_t)n * sizeof(RLEChunkEntry), max_band = 0;
+    table = malloc(table_bytes ? table_bytes : 1);
+    byoff = malloc(table_bytes ? table_bytes : 1);
+    changed = calloc(n ? n : 1, 1);
+    items = malloc((n ? n : 1) * sizeof(uint32_t));
+    raw_crc = malloc((n ? n : 1) * sizeof(uint32_t));
+    fresh = malloc(table_bytes ? table_bytes : 1);
+    if (!table || !byoff || !changed || !items || !raw_crc || !fresh) {
+        rc = librle_fail(lib, RLE_LIB_ENOMEM, "Sin memoria para la tabla de %u chunks", n);
+        goto out;
+    }
+    memcpy(table, lib->table, table_bytes);
+    for (uint32_t i = 0; i < n; i++)
+        if ((size_t)table[i].num_rows * w * 3 > max_band) max_band = (size_t)table[i].num_rows * w * 3;
+
+    /* Pasada 1: qué bandas cambiaron */
+    RLELibJob job;
+    memset(&job, 0, sizeof(job));
+    job.lib = lib;
+    job.rgb = rgb;
+    job.width = w;
+    job.height = h;
+    job.hdr = &hdr;
+    job.chunks = table;
+    job.src = map;
+    job.changed = changed;
+    job.raw_crc = raw_crc;
+    job.num_items = n;
+    atomic_init(&job.next, 0);
+    size_t scratch = rle_encoder_scratch_size(hdr.mode, max_band);
+    if (!(hdr.flags & RLE_FLAG_RAW_CRC) && max_band > scratch) scratch = max_band;
+    int threads = librle_thread_count(lib, n);
+    if ((rc = librle_reserve(lib, threads, scratch, 0)) != RLE_LIB_OK) goto out;
+    lib->stats.threads_used = librle_run(lib, &job, threads, librle_diff_func);
+
+    uint32_t num_changed = 0;
+    for (uint32_t i = 0; i < n; i++)
+        if (changed[i]) {
+            fresh[num_changed] = table[i];
+            items[num_changed++] = i;
+        }
+    up->num_chunks = n;
+    up->changed = num_changed;
+    up->by_crc = (hdr.flags & RLE_FLAG_RAW_CRC) != 0;
+    up->file_size = size;
+
+    /*
+     * Sin RLE_FLAG_RAW_CRC esta es la única vez que se decodifica: las bandas
+     * iguales guardan el CRC32C calculado al compararlas y las re-codificadas
+     * lo calculan al codificar (el flag no cambia los bytes del chunk).
+     */
+    if (!up->by_crc) {
+        for (uint32_t i = 0; i < n; i++)
+            if (!changed[i]) table[i].raw_checksum = raw_crc[i];
+        hdr.flags |= RLE_FLAG_RAW_CRC;
+    }
+
+    if (num_changed > 0 || !up->by_crc) {
+        /* Pasada 2: re-codificar cada banda en su hueco de peor caso */
+        size_t slot = rle_encoded_bound(hdr.mode, max_band);
+        arena = malloc((size_t)num_changed * slot + table_bytes);
+        if (!arena) {
+            rc = librle_fail(lib, RLE_LIB_ENOMEM, "Sin memoria para %u bandas", num_changed);
+            goto out;
+        }
+        if (num_changed > 0) {
+            job.num_items = num_changed;
+            job.fresh = fresh;
+            job.dst = arena;
+            job.tile_bound = slot;
+            atomic_init(&job.next, 0);
+            librle_run(lib, &job, librle_thread_count(lib, num_changed), librle_reencode_func);
+        }
+
+        /* Chunks nuevos compactados al final del archivo y, detrás, la tabla nueva */
+        uint64_t off = size;
+        size_t data = 0;
+        for (uint32_t k = 0; k < num_changed; k++) {
+            size_t from = (size_t)k * slot;
+            if (from != data) memmove(arena + data, arena + from, fresh[k].length);
+            fresh[k].offset = off + data;
+            table[items[k]] = fresh[k];
+            data += fresh[k].length;
+        }
+        for (int i = 0; i < threads; i++) lib->stats.runs += lib->workers[i].runs;
+        up->written = data + table_bytes;
+        up->file_size = size + up->written;
+        up->live = librle_live_bytes(table, byoff, n);
+        if (up->file_size - up->live > up->live) {
+            /* Más de la mitad del archivo sería espacio muerto: se reescribe entero */
+            if ((rc = librle_compact(lib, path, st.st_mode, &hdr, table, byoff, n, map, size,
+                                     arena, &up->written)) != RLE_LIB_OK)
+                goto out;
+            up->file_size = up->written;
+            up->compacted = 1;
+        } else {
+            memcpy(arena + data, table, table_bytes);
+            hdr.table_offset = off + data;
+            if (librle_pwrite_all(fd, arena, data + table_bytes, off) != 0 || fsync(fd) != 0 ||
+                librle_pwrite_all(fd, &hdr, sizeof(hdr), 0) != 0 || fsync(fd) != 0) {
+                rc = librle_fail(lib, RLE_LIB_EIO, "Escritura de %s: %s", path, strerror(errno));
+                goto out;
+            }
+        }
+        lib->stats.bytes = up->written;
+    } else {
+        up->live = librle_live_bytes(table, byoff, n);
+    }
+    up->dead = up->file_size - up->live;
+    lib->stats.num_chunks = num_changed;
+
+out:
+    free(arena);
+    free(fresh);
+    free(raw_crc);
+    free(items);
+    free(changed);
+    free(byoff);
+    free(table);
+    munmap(map, size);
+    close(fd);
+    return rc;
+}
+
+/* ─── Imágenes de entrada y BMP ─── */
+
+static void librle_syscall(const RLELib *lib, const char *name, const char *real,
+                           const char *purpose) {
+    if (lib->hooks && lib->hooks->syscall) lib->hooks->syscall(name, real, purpose);
+}
+
+LIBRLEDEF int librle_image_load(RLELib *lib, RLELibImage *img, const char *path,
+                                uint32_t raw_w, uint32_t raw_h) {
+    memset(img, 0, sizeof(*img));
+    lib->error[0] = '\0';
+    int r = rle_input_map(path, raw_w, raw_h, &img->input, lib->error, sizeof(lib->error));
+    if (r < 0) return RLE_LIB_EIO;
+    if (r == 0) {
+        img->width = img->input.width;
+        img->height = img->input.height;
+        img->data = (uint8_t *)img->input.pixels;   /* PROT_READ: solo se lee */
+        img->channels = 3;
+        librle_syscall(lib, "mmap", "mmap", "Mapear imagen de entrada (sin copia)");
+        librle_syscall(lib, "madvise", "madvise", "MADV_SEQUENTIAL + MADV_WILLNEED por banda");
+        return RLE_LIB_OK;
+    }
+#ifdef STBI_INCLUDE_STB_IMAGE_H
+    int w, h, channels;
+    img->data = stbi_load(path, &w, &h, &channels, 3);
+    if (!img->data)
+        return librle_fail(lib, RLE_LIB_EFORMAT, "Error cargando '%s': %s", path,
+                           stbi_failure_reason());
+    img->width = (uint32_t)w;
+    img->height = (uint32_t)h;
+    img->channels = channels;
+    librle_syscall(lib, "stbi_load", "open+read+mmap", "Cargar imagen desde disco (stb_image)");
+    if (lib->hooks && lib->hooks->heap_alloc)
+        lib->hooks->heap_alloc(img->data, (size_t)w * h * 3, "img.data (pixeles RGB imagen)");
+    return RLE_LIB_OK;
+#else
+    return librle_fail(lib, RLE_LIB_EFORMAT, "'%s' no es PPM P6 ni RAW (sin stb_image)", path);
+#endif
+}
+
+LIBRLEDEF void librle_image_free(RLELibImage *img) {
+    if (img->input.map)
+        rle_input_unmap(&img->input);       /* imagen mapeada: no es HEAP */
+    else if (img->data)
+#ifdef STBI_INCLUDE_STB_IMAGE_H
+        stbi_image_free(img->data);         /* stb_image usa su propio allocator */
+#else
+        free(img->data);
+#endif
+    img->data = NULL;
+}
+
+static void *librle_bmp_func(void *arg) {
+    struct RLELibWorker *wk = (struct RLELibWorker *)arg;
+    RLELibJob *job = wk->job;
+    uint32_t k, row0, rows;
+    while ((k = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed)) < job->num_items) {
+        rle_band_range(job->height, job->num_items, k, &row0, &rows);
+        if (rle_bmp_write_rows(job->fd, job->rgb + (size_t)row0 * job->width * 3, job->width,
+                               job->height, row0, rows, job->bgr, wk->scratch) != 0)
+            wk->bad++;
+    }
+    return NULL;
+}
+
+LIBRLEDEF int librle_bmp_save(RLELib *lib, const char *path, const uint8_t *pixels,
+                              uint32_t w, uint32_t h, int bgr) {
+    lib->error[0] = '\0';
+    int fd = rle_bmp_create(path, w, h);
+    if (fd < 0) return librle_fail(lib, RLE_LIB_EIO, "%s: %s", path, strerror(errno));
+    librle_syscall(lib, "open", "open", "Crear archivo BMP (header + ftruncate)");
+
+    /* Una banda contigua de filas por hilo; sin --decode-bgr cada uno usa su bloque de swizzle */
+    RLELibJob job;
+    memset(&job, 0, sizeof(job));
+    job.lib = lib;
+    job.rgb = pixels;
+    job.width = w;
+    job.height = h;
+    job.fd = fd;
+    job.bgr = bgr;
+    int n = librle_thread_count(lib, h ? h : 1);
+    job.num_items = (uint32_t)n;
+    atomic_init(&job.next, 0);
+    int rc = librle_reserve(lib, n, bgr ? 0 : rle_bmp_block_size(w), 0);
+    if (rc == RLE_LIB_OK) {
+        lib->stats.threads_used = librle_run(lib, &job, n, librle_bmp_func);
+        for (int i = 0; i < n; i++)
+            if (lib->workers[i].bad) rc = librle_fail(lib, RLE_LIB_EIO, "Error escribiendo '%s'", path);
+        librle_syscall(lib, bgr ? "pwritev" : "pwrite", bgr ? "pwritev" : "pwrite",
+                       "Escribir bandas del BMP en su offset");
+    }
+    librle_syscall(lib, "close", "close", "Cerrar archivo BMP");
+    close(fd);
+    return rc;
+}
+
+#endif /* LIBRLE_IMPLEMENTED */
+#endif /* LIBRLE_IMPLEMENTATION */
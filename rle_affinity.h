@@ -0,0 +1,194 @@
+/*
+ * ============================================================================
+ *  rle_affinity.h — Topología de CPUs / nodos NUMA y afinidad de hilos
+ *
+ *  Lo incluye rle_paralelo.c (--affinity, --first-touch, --scaling). La
+ *  topología se arma una vez al inicio:
+ *
+ *    CPUs      las que el proceso tiene permitidas (sched_getaffinity: respeta
+ *              taskset y cpusets), no todas las de la máquina
+ *    nodos     /sys/devices/system/node/nodeN/cpulist; sin ese directorio
+ *              (kernel sin NUMA, contenedores) todo queda en el nodo 0
+ *
+ *  Políticas de reparto del hilo i:
+ *
+ *    none      no se fija nada: decide el scheduler (comportamiento original)
+ *    compact   CPUs en orden (nodo, id): llena el nodo 0 antes de pasar al 1,
+ *              los hilos comparten caché y controlador de memoria
+ *    scatter   round-robin entre nodos: hilo i en el nodo i % nodos, para
+ *              sumar el ancho de banda de todos los controladores
+ *
+ *  En Linux se fija con pthread_setaffinity_np a una sola CPU. macOS no
+ *  permite fijar CPUs: THREAD_AFFINITY_POLICY solo agrupa hilos por tag
+ *  (mismo tag = compartir L2), así que compact usa un tag común y scatter un
+ *  tag por hilo.
+ * ============================================================================
+ */
+
+#ifndef RLE_AFFINITY_H
+#define RLE_AFFINITY_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
+#define RLE_TOPO_MAX_CPUS   1024
+#define RLE_TOPO_MAX_NODES  64
+
+typedef enum { RLE_AFFINITY_NONE, RLE_AFFINITY_COMPACT, RLE_AFFINITY_SCATTER } RLEAffinity;
+
+static inline const char *rle_affinity_name(RLEAffinity a) {
+    return a == RLE_AFFINITY_COMPACT ? "compact" : a == RLE_AFFINITY_SCATTER ? "scatter" : "none";
+}
+
+/* none / compact / scatter; -1 si el nombre no existe */
+static inline int rle_affinity_parse(const char *s, RLEAffinity *a) {
+    if (strcmp(s, "none") == 0)    { *a = RLE_AFFINITY_NONE;    return 0; }
+    if (strcmp(s, "compact") == 0) { *a = RLE_AFFINITY_COMPACT; return 0; }
+    if (strcmp(s, "scatter") == 0) { *a = RLE_AFFINITY_SCATTER; return 0; }
+    return -1;
+}
+
+typedef struct {
+    int num_cpus;
+    int num_nodes;
+    int cpu[RLE_TOPO_MAX_CPUS];         /* orden compacto: por nodo y, dentro, por id */
+    int node[RLE_TOPO_MAX_CPUS];        /* nodo de cpu[i] */
+    int node_first[RLE_TOPO_MAX_NODES]; /* índice en cpu[] de la primera CPU del nodo */
+    int node_count[RLE_TOPO_MAX_NODES];
+} RLETopology;
+
+#ifdef __linux__
+/* Marca en set[] las CPUs de una cpulist del kernel ("0-3,8,10-11") */
+static inline void rle_topo_parse_cpulist(const char *s, unsigned char *set) {
+    while (*s) {
+        char *end;
+        long a = strtol(s, &end, 10), b = a;
+        if (end == s) break;
+        if (*end == '-') b = strtol(end + 1, &end, 10);
+        for (long c = a; c <= b; c++)
+            if (c >= 0 && c < RLE_TOPO_MAX_CPUS) set[c] = 1;
+        s = *end == ',' ? end + 1 : end;
+        if (*s == '\n') break;
+    }
+}
+#endif
+
+static inline void rle_topo_init(RLETopology *t) {
+    memset(t, 0, sizeof(*t));
+    unsigned char allowed[RLE_TOPO_MAX_CPUS] = {0};
+    int cpu_node[RLE_TOPO_MAX_CPUS];
+    for (int c = 0; c < RLE_TOPO_MAX_CPUS; c++) cpu_node[c] = 0;
+    int max_node = 0;
+
+#ifdef __linux__
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (int c = 0; c < RLE_TOPO_MAX_CPUS && c < CPU_SETSIZE; c++)
+            if (CPU_ISSET(c, &mask)) allowed[c] = 1;
+    }
+    DIR *d = opendir("/sys/devices/system/node");
+    struct dirent *e;
+    while (d && (e = readdir(d)) != NULL) {
+        int n;
+        char tail;
+        if (sscanf(e->d_name, "node%d%c", &n, &tail) != 1 || n < 0 || n >= RLE_TOPO_MAX_NODES)
+            continue;
+        char path[300], list[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", e->d_name);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        if (fgets(list, sizeof(list), f)) {
+            unsigned char set[RLE_TOPO_MAX_CPUS] = {0};
+            rle_topo_parse_cpulist(list, set);
+            for (int c = 0; c < RLE_TOPO_MAX_CPUS; c++)
+                if (set[c]) cpu_node[c] = n;
+            if (n > max_node) max_node = n;
+        }
+        fclose(f);
+    }
+    if (d) closedir(d);
+#endif
+    int any = 0;
+    for (int c = 0; c < RLE_TOPO_MAX_CPUS; c++) any |= allowed[c];
+    if (!any) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long c = 0; c < n && c < RLE_TOPO_MAX_CPUS; c++) allowed[c] = 1;
+        if (n < 1) allowed[0] = 1;
+    }
+
+    /* Orden compacto; los nodos sin CPUs permitidas no cuentan */
+    for (int n = 0; n <= max_node; n++) {
+        int first = t->num_cpus;
+        for (int c = 0; c < RLE_TOPO_MAX_CPUS; c++) {
+            if (!allowed[c] || cpu_node[c] != n) continue;
+            t->cpu[t->num_cpus] = c;
+            t->node[t->num_cpus] = n;
+            t->num_cpus++;
+        }
+        if (t->num_cpus > first) {
+            t->node_first[t->num_nodes] = first;
+            t->node_count[t->num_nodes] = t->num_cpus - first;
+            t->num_nodes++;
+        }
+    }
+}
+
+/* Índice en t->cpu[] del hilo idx según la política; -1 con none */
+static inline int rle_topo_slot(const RLETopology *t, RLEAffinity a, int idx) {
+    if (a == RLE_AFFINITY_NONE || t->num_cpus == 0) return -1;
+    if (a == RLE_AFFINITY_COMPACT) return idx % t->num_cpus;
+    int n = idx % t->num_nodes;
+    return t->node_first[n] + (idx / t->num_nodes) % t->node_count[n];
+}
+
+/* CPU del hilo idx (-1 = sin fijar) */
+static inline int rle_topo_cpu(const RLETopology *t, RLEAffinity a, int idx) {
+    int s = rle_topo_slot(t, a, idx);
+    return s < 0 ? -1 : t->cpu[s];
+}
+
+/* Nodos distintos que ocupan los hilos 0..n-1 (0 con none: no se sabe) */
+static inline int rle_topo_nodes_used(const RLETopology *t, RLEAffinity a, int n) {
+    unsigned char seen[RLE_TOPO_MAX_NODES] = {0};
+    int used = 0;
+    for (int i = 0; i < n; i++) {
+        int s = rle_topo_slot(t, a, i);
+        if (s < 0) return 0;
+        int k = t->node[s] % RLE_TOPO_MAX_NODES;
+        if (!seen[k]) { seen[k] = 1; used++; }
+    }
+    return used;
+}
+
+/*
+ * Fija el hilo que llama a cpu; 0, o -1 con errno. cpu < 0 no hace nada, y
+ * fuera de Linux tampoco (macOS usa el tag de rle_affinity_tag al crearlo).
+ */
+static inline int rle_affinity_pin_self(int cpu) {
+    if (cpu < 0) return 0;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err) { errno = err; return -1; }
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+/* Tag de THREAD_AFFINITY_POLICY (macOS) del hilo idx */
+static inline int rle_affinity_tag(RLEAffinity a, int idx) {
+    return a == RLE_AFFINITY_COMPACT ? 1 : idx + 1;
+}
+
+#endif /* RLE_AFFINITY_H */
@@ -0,0 +1,648 @@
+/*
+ * ============================================================================
+ *  rle_aio.h — Escritura asíncrona de la salida (--aio)
+ *
+ *  Lo incluye rle_paralelo.c. La fase de escritura original hacía fopen +
+ *  fwrite por buffer en el hilo principal, después del join: con un disco
+ *  de latencia alta la cola de escritura pasa a ser buena parte del tiempo
+ *  total. Aquí cada escritura es (archivo, buffer, largo, offset): se envía
+ *  apenas el buffer está listo (--alloc arena: cada chunk al terminar su
+ *  tile, desde el hilo que lo comprimió) y rle_aio_finish espera al final.
+ *  El buffer tiene que seguir vivo y sin cambios hasta entonces.
+ *
+ *    uring      Linux: io_uring con syscalls directas (sin liburing), un
+ *               anillo de RLE_AIO_DEPTH SQEs. Los buffers registrados con
+ *               rle_aio_register van con IORING_OP_WRITE_FIXED (el kernel
+ *               no vuelve a fijar las páginas en cada escritura)
+ *    dispatch   macOS: dispatch_io sobre un canal DISPATCH_IO_RANDOM por
+ *               archivo, sin copia (dispatch_data con destructor vacío)
+ *    sync       pwrite en el momento: la misma interfaz sin asincronía,
+ *               también el respaldo si io_uring no está disponible
+ *
+ *  Con direct (--direct) el archivo se abre además con O_DIRECT (macOS:
+ *  F_NOCACHE). O_DIRECT exige buffer, offset y largo alineados a
+ *  RLE_AIO_ALIGN: la parte alineada de cada escritura va por ese fd y los
+ *  bordes sin alinear por el fd normal. Los bordes caen en bloques que
+ *  ninguna escritura directa toca, así que no se pisan con el page cache.
+ *
+ *  Con fsync (--fsync) rle_aio_finish espera las escrituras y después manda
+ *  un fsync por archivo, todos juntos (un solo io_uring_enter).
+ *
+ *  Todas las funciones son seguras entre hilos (un mutex por contexto): la
+ *  llamada solo arma SQEs y hace un io_uring_enter, no espera al disco salvo
+ *  que el anillo esté lleno.
+ * ============================================================================
+ */
+
+#ifndef RLE_AIO_H
+#define RLE_AIO_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#ifdef __NR_io_uring_setup
+#define RLE_AIO_HAVE_URING 1
+#endif
+#endif
+#endif
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#endif
+
+#define RLE_AIO_DEPTH       64          /* SQEs del anillo = escrituras en vuelo como máximo */
+#define RLE_AIO_MAX_FILES   4
+#define RLE_AIO_MAX_BUFS    64          /* slots de buffers registrados */
+#define RLE_AIO_ALIGN       4096        /* alineación de O_DIRECT */
+#define RLE_AIO_MAX_IO      (1u << 30)  /* bytes por SQE */
+
+typedef enum { RLE_AIO_SYNC, RLE_AIO_URING, RLE_AIO_DISPATCH, RLE_AIO_AUTO } RLEAioBackend;
+
+static inline const char *rle_aio_name(RLEAioBackend b) {
+    return b == RLE_AIO_URING ? "io_uring" : b == RLE_AIO_DISPATCH ? "dispatch_io"
+         : b == RLE_AIO_AUTO ? "auto" : "pwrite";
+}
+
+/* sync / uring / dispatch / auto; -1 si el nombre no existe */
+static inline int rle_aio_parse(const char *s, RLEAioBackend *b) {
+    if (strcmp(s, "sync") == 0)     { *b = RLE_AIO_SYNC;     return 0; }
+    if (strcmp(s, "uring") == 0)    { *b = RLE_AIO_URING;    return 0; }
+    if (strcmp(s, "dispatch") == 0) { *b = RLE_AIO_DISPATCH; return 0; }
+    if (strcmp(s, "auto") == 0)     { *b = RLE_AIO_AUTO;     return 0; }
+    return -1;
+}
+
+typedef struct {
+    int fd;
+    int dfd;                    /* O_DIRECT sobre el mismo archivo (-1 = sin direct) */
+#ifdef __APPLE__
+    dispatch_io_t chan;
+    dispatch_semaphore_t closed; /* el canal soltó el fd */
+#endif
+} RLEAioFile;
+
+typedef struct {
+    uint64_t writes;            /* llamadas a rle_aio_write */
+    uint64_t ops;               /* escrituras enviadas (una por tramo, más reenvíos) */
+    uint64_t submits;           /* io_uring_enter / pwrite / dispatch_io_write */
+    uint64_t completions;       /* CQEs de escritura (o handlers de dispatch_io) */
+    uint64_t requeued;          /* escrituras cortas reenviadas con el resto */
+    uint64_t fixed;             /* ops con IORING_OP_WRITE_FIXED */
+    uint64_t registers;         /* io_uring_register */
+    uint32_t files;             /* archivos abiertos */
+    uint32_t bufs;              /* buffers registrados */
+    uint32_t fsyncs;
+    uint32_t fsync_batches;
+    uint32_t max_inflight;
+    uint64_t bytes;
+    uint64_t direct_bytes;      /* de bytes, los que fueron por O_DIRECT */
+} RLEAioStats;
+
+#ifdef RLE_AIO_HAVE_URING
+typedef struct {
+    const uint8_t *buf;
+    uint64_t off;
+    uint32_t len;
+    int fd;
+    int slot;                   /* buffer registrado (-1 = IORING_OP_WRITE) */
+    int fsync;
+} RLEAioOp;
+#endif
+
+typedef struct {
+    RLEAioBackend backend;
+    int direct;
+    int fsync;
+    int error;                  /* errno de la primera operación fallida (0 = ninguna) */
+    int setup_errno;            /* por qué no se pudo usar el backend pedido (0 = se usó) */
+    int num_files;
+    RLEAioFile files[RLE_AIO_MAX_FILES];
+    RLEAioStats st;
+    pthread_mutex_t lock;
+#ifdef RLE_AIO_HAVE_URING
+    int ring_fd;
+    void *sq_map, *cq_map;
+    size_t sq_map_len, cq_map_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    unsigned *sq_head, *sq_tail, *sq_array, sq_mask;
+    unsigned *cq_head, *cq_tail, cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned pending;           /* SQEs armados sin enviar */
+    unsigned inflight;          /* ops enviadas sin CQE */
+    RLEAioOp ops[RLE_AIO_DEPTH];
+    int free_ops[RLE_AIO_DEPTH];
+    int num_free;
+    int bufs_sparse;            /* tabla dispersa de buffers creada */
+    const uint8_t *buf_base[RLE_AIO_MAX_BUFS];
+    size_t buf_len[RLE_AIO_MAX_BUFS];
+#endif
+#ifdef __APPLE__
+    dispatch_queue_t queue;
+    dispatch_group_t group;
+#endif
+} RLEAio;
+
+static inline void rle_aio_set_error(RLEAio *a, int err) {
+    if (!a->error) a->error = err;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  BACKEND io_uring (Linux)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+#ifdef RLE_AIO_HAVE_URING
+static inline int rle_uring_enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+static inline int rle_uring_init(RLEAio *a) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    a->ring_fd = (int)syscall(__NR_io_uring_setup, RLE_AIO_DEPTH, &p);
+    if (a->ring_fd < 0) return -1;
+
+    a->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    a->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if ((p.features & IORING_FEAT_SINGLE_MMAP) && a->cq_map_len > a->sq_map_len)
+        a->sq_map_len = a->cq_map_len;
+    a->sq_map = mmap(NULL, a->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     a->ring_fd, IORING_OFF_SQ_RING);
+    if (a->sq_map == MAP_FAILED) goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        a->cq_map = a->sq_map;
+        a->cq_map_len = 0;
+    } else {
+        a->cq_map = mmap(NULL, a->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         a->ring_fd, IORING_OFF_CQ_RING);
+        if (a->cq_map == MAP_FAILED) goto fail_sq;
+    }
+    a->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    a->sqes = mmap(NULL, a->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   a->ring_fd, IORING_OFF_SQES);
+    if (a->sqes == MAP_FAILED) goto fail_cq;
+
+    uint8_t *sq = a->sq_map, *cq = a->cq_map;
+    a->sq_head = (unsigned *)(sq + p.sq_off.head);
+    a->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    a->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+    a->sq_array = (unsigned *)(sq + p.sq_off.array);
+    a->cq_head = (unsigned *)(cq + p.cq_off.head);
+    a->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    a->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+    a->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    a->pending = a->inflight = 0;
+    a->num_free = RLE_AIO_DEPTH;
+    for (int i = 0; i < RLE_AIO_DEPTH; i++)
+        a->free_ops[i] = RLE_AIO_DEPTH - 1 - i;
+
+    /* Tabla de buffers vacía: cada rle_aio_register llena un slot (kernel >= 5.19) */
+    a->bufs_sparse = 0;
+#ifdef IORING_RSRC_REGISTER_SPARSE
+    struct io_uring_rsrc_register r;
+    memset(&r, 0, sizeof(r));
+    r.nr = RLE_AIO_MAX_BUFS;
+    r.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (syscall(__NR_io_uring_register, a->ring_fd, IORING_REGISTER_BUFFERS2, &r, sizeof(r)) == 0)
+        a->bufs_sparse = 1;
+    a->st.registers++;
+#endif
+    return 0;
+
+fail_cq:
+    if (a->cq_map_len) munmap(a->cq_map, a->cq_map_len);
+fail_sq:
+    munmap(a->sq_map, a->sq_map_len);
+fail:
+    {
+        int e = errno;
+        close(a->ring_fd);
+        errno = e;
+    }
+    return -1;
+}
+
+static inline void rle_uring_close(RLEAio *a) {
+    munmap(a->sqes, a->sqes_len);
+    if (a->cq_map_len) munmap(a->cq_map, a->cq_map_len);
+    munmap(a->sq_map, a->sq_map_len);
+    close(a->ring_fd);
+}
+
+/* Arma el SQE de la op idx en la cola (todavía sin enviar) */
+static inline void rle_uring_prep(RLEAio *a, int idx) {
+    const RLEAioOp *op = &a->ops[idx];
+    unsigned tail = *a->sq_tail;
+    unsigned s = tail & a->sq_mask;
+    struct io_uring_sqe *sqe = &a->sqes[s];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = op->fd;
+    sqe->user_data = (uint64_t)idx;
+    if (op->fsync) {
+        sqe->opcode = IORING_OP_FSYNC;
+    } else {
+        sqe->opcode = op->slot >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->addr = (uint64_t)(uintptr_t)op->buf;
+        sqe->len = op->len;
+        sqe->off = op->off;
+        sqe->buf_index = (uint16_t)(op->slot >= 0 ? op->slot : 0);
+    }
+    a->sq_array[s] = s;
+    __atomic_store_n(a->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    a->pending++;
+}
+
+/* Envía los SQEs armados; con wait > 0 espera además ese número de CQEs */
+static inline void rle_uring_submit(RLEAio *a, unsigned wait) {
+    while (a->pending || wait) {
+        int r = rle_uring_enter(a->ring_fd, a->pending, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+        a->st.submits++;
+        if (r < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            rle_aio_set_error(a, errno);
+            return;
+        }
+        a->inflight += (unsigned)r;
+        a->pending -= (unsigned)r;
+        if (a->inflight > a->st.max_inflight) a->st.max_inflight = a->inflight;
+        if (a->pending == 0) return;
+    }
+}
+
+/* Procesa los CQEs disponibles; las escrituras cortas vuelven a la cola */
+static inline int rle_uring_reap(RLEAio *a) {
+    int done = 0;
+    unsigned head = *a->cq_head;
+    while (head != __atomic_load_n(a->cq_tail, __ATOMIC_ACQUIRE)) {
+        const struct io_uring_cqe *cqe = &a->cqes[head & a->cq_mask];
+        int idx = (int)cqe->user_data;
+        int res = cqe->res;
+        head++;
+        a->inflight--;
+        RLEAioOp *op = &a->ops[idx];
+        if (op->fsync) {
+            if (res < 0) rle_aio_set_error(a, -res);
+        } else {
+            a->st.completions++;
+            if (res == -EINTR || res == -EAGAIN || (res > 0 && (uint32_t)res < op->len)) {
+                if (res > 0) {
+                    op->buf += res;
+                    op->off += (uint64_t)res;
+                    op->len -= (uint32_t)res;
+                }
+                a->st.requeued++;
+                a->st.ops++;
+                rle_uring_prep(a, idx);
+                continue;
+            }
+            if (res < 0) rle_aio_set_error(a, -res);
+            else if (res == 0) rle_aio_set_error(a, EIO);
+        }
+        a->free_ops[a->num_free++] = idx;
+        done++;
+    }
+    __atomic_store_n(a->cq_head, head, __ATOMIC_RELEASE);
+    return done;
+}
+
+/* Slot de una op libre; si el anillo está lleno espera completions */
+static inline int rle_uring_get_op(RLEAio *a) {
+    rle_uring_reap(a);
+    while (a->num_free == 0) {
+        rle_uring_submit(a, 1);
+        if (rle_uring_reap(a) == 0 && a->error && a->inflight == 0) return -1;
+    }
+    return a->free_ops[--a->num_free];
+}
+
+/* Buffer registrado que contiene [buf, buf + len), o -1 */
+static inline int rle_uring_slot(const RLEAio *a, const uint8_t *buf, size_t len) {
+    for (uint32_t i = 0; i < a->st.bufs; i++)
+        if (buf >= a->buf_base[i] && buf + len <= a->buf_base[i] + a->buf_len[i])
+            return (int)i;
+    return -1;
+}
+
+static inline int rle_uring_queue(RLEAio *a, int fd, const uint8_t *buf, size_t len, uint64_t off) {
+    while (len > 0) {
+        uint32_t n = len > RLE_AIO_MAX_IO ? RLE_AIO_MAX_IO : (uint32_t)len;
+        int idx = rle_uring_get_op(a);
+        if (idx < 0) return -1;
+        RLEAioOp *op = &a->ops[idx];
+        op->buf = buf;
+        op->off = off;
+        op->len = n;
+        op->fd = fd;
+        op->fsync = 0;
+        op->slot = rle_uring_slot(a, buf, n);
+        if (op->slot >= 0) a->st.fixed++;
+        a->st.ops++;
+        rle_uring_prep(a, idx);
+        buf += n;
+        off += n;
+        len -= n;
+    }
+    return 0;
+}
+#endif /* RLE_AIO_HAVE_URING */
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  BACKENDS dispatch_io (macOS) Y pwrite
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+#ifdef __APPLE__
+static inline void rle_dispatch_queue(RLEAio *a, RLEAioFile *f, const uint8_t *buf, size_t len,
+                                      uint64_t off) {
+    /* Destructor vacío: dispatch no copia ni libera, el buffer es del llamador */
+    dispatch_data_t data = dispatch_data_create(buf, len, a->queue, ^{});
+    dispatch_group_enter(a->group);
+    a->st.ops++;
+    a->st.submits++;
+    dispatch_io_write(f->chan, (off_t)off, data, a->queue, ^(bool done, dispatch_data_t rest, int err) {
+        (void)rest;
+        if (!done) return;
+        pthread_mutex_lock(&a->lock);
+        a->st.completions++;
+        if (err) rle_aio_set_error(a, err);
+        pthread_mutex_unlock(&a->lock);
+        dispatch_group_leave(a->group);
+    });
+    dispatch_release(data);
+}
+#endif
+
+static inline int rle_pwrite_all(RLEAio *a, int fd, const uint8_t *buf, size_t len, uint64_t off) {
+    a->st.ops++;
+    while (len > 0) {
+        ssize_t w = pwrite(fd, buf, len, (off_t)off);
+        a->st.submits++;
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            rle_aio_set_error(a, w < 0 ? errno : EIO);
+            return -1;
+        }
+        a->st.completions++;
+        buf += w;
+        off += (uint64_t)w;
+        len -= (size_t)w;
+    }
+    return 0;
+}
+
+static inline int rle_aio_queue(RLEAio *a, RLEAioFile *f, int fd, const uint8_t *buf, size_t len,
+                                uint64_t off) {
+    if (len == 0) return 0;
+#ifdef RLE_AIO_HAVE_URING
+    if (a->backend == RLE_AIO_URING) return rle_uring_queue(a, fd, buf, len, off);
+#endif
+#ifdef __APPLE__
+    if (a->backend == RLE_AIO_DISPATCH) {
+        (void)fd;
+        rle_dispatch_queue(a, f, buf, len, off);
+        return 0;
+    }
+#endif
+    (void)f;
+    return rle_pwrite_all(a, fd, buf, len, off);
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  INTERFAZ
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * Prepara el contexto con el backend pedido (auto = io_uring en Linux,
+ * dispatch_io en macOS). Si no está disponible queda en sync con
+ * setup_errno explicando por qué; nunca falla.
+ */
+static inline void rle_aio_init(RLEAio *a, RLEAioBackend backend, int direct, int fsync) {
+    memset(a, 0, sizeof(*a));
+    pthread_mutex_init(&a->lock, NULL);
+    a->direct = direct;
+    a->fsync = fsync;
+    if (backend == RLE_AIO_AUTO) {
+#ifdef __APPLE__
+        backend = RLE_AIO_DISPATCH;
+#else
+        backend = RLE_AIO_URING;
+#endif
+    }
+    a->backend = RLE_AIO_SYNC;
+    if (backend == RLE_AIO_URING) {
+#ifdef RLE_AIO_HAVE_URING
+        if (rle_uring_init(a) == 0) a->backend = RLE_AIO_URING;
+        else a->setup_errno = errno;
+#else
+        a->setup_errno = ENOSYS;
+#endif
+    } else if (backend == RLE_AIO_DISPATCH) {
+#ifdef __APPLE__
+        a->queue = dispatch_queue_create("rle.aio", DISPATCH_QUEUE_CONCURRENT);
+        a->group = dispatch_group_create();
+        a->backend = RLE_AIO_DISPATCH;
+#else
+        a->setup_errno = ENOSYS;
+#endif
+    }
+}
+
+/*
+ * Crea path (truncado) y devuelve su índice en el contexto, o -1 con errno.
+ * size > 0 fija el tamaño final de entrada (ftruncate): las escrituras
+ * directas no extienden el archivo y el orden de llegada no importa.
+ */
+static inline int rle_aio_open(RLEAio *a, const char *path, uint64_t size) {
+    if (a->num_files >= RLE_AIO_MAX_FILES) { errno = EMFILE; return -1; }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    if (size > 0 && ftruncate(fd, (off_t)size) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    RLEAioFile *f = &a->files[a->num_files];
+    f->fd = fd;
+    f->dfd = -1;
+#if defined(O_DIRECT)
+    /* Sin soporte (tmpfs, algunos FS de red) queda todo por el fd normal */
+    if (a->direct)
+        f->dfd = open(path, O_WRONLY | O_DIRECT);
+#elif defined(__APPLE__)
+    if (a->direct)
+        fcntl(fd, F_NOCACHE, 1);
+#endif
+#ifdef __APPLE__
+    if (a->backend == RLE_AIO_DISPATCH) {
+        dispatch_semaphore_t closed = dispatch_semaphore_create(0);
+        f->closed = closed;
+        f->chan = dispatch_io_create(DISPATCH_IO_RANDOM, fd, a->queue, ^(int err) {
+            (void)err;
+            dispatch_semaphore_signal(closed);
+        });
+    }
+#endif
+    pthread_mutex_lock(&a->lock);
+    int idx = a->num_files++;
+    a->st.files++;
+    pthread_mutex_unlock(&a->lock);
+    return idx;
+}
+
+/* Fija el tamaño final después de abrir (cuando recién se conoce) */
+static inline int rle_aio_set_size(RLEAio *a, int file, uint64_t size) {
+    if (file < 0 || file >= a->num_files) return -1;
+    return ftruncate(a->files[file].fd, (off_t)size);
+}
+
+/*
+ * Registra [buf, buf + len) como buffer fijo de io_uring: las escrituras que
+ * caen adentro van con IORING_OP_WRITE_FIXED. Devuelve 0, o -1 si no se pudo
+ * (otro backend, kernel viejo, memoria de un archivo mapeado, RLIMIT_MEMLOCK)
+ * y en ese caso esas escrituras siguen con IORING_OP_WRITE.
+ */
+static inline int rle_aio_register(RLEAio *a, const void *buf, size_t len) {
+#if defined(RLE_AIO_HAVE_URING) && defined(IORING_RSRC_REGISTER_SPARSE)
+    if (a->backend != RLE_AIO_URING || !a->bufs_sparse || len == 0 || len > RLE_AIO_MAX_IO)
+        return -1;
+    pthread_mutex_lock(&a->lock);
+    int r = -1;
+    if (a->st.bufs < RLE_AIO_MAX_BUFS) {
+        struct iovec iov = { (void *)buf, len };
+        struct io_uring_rsrc_update2 u;
+        memset(&u, 0, sizeof(u));
+        u.offset = a->st.bufs;
+        u.data = (uint64_t)(uintptr_t)&iov;
+        u.nr = 1;
+        a->st.registers++;
+        if (syscall(__NR_io_uring_register, a->ring_fd, IORING_REGISTER_BUFFERS_UPDATE,
+                    &u, sizeof(u)) == 1) {
+            a->buf_base[a->st.bufs] = buf;
+            a->buf_len[a->st.bufs] = len;
+            a->st.bufs++;
+            r = 0;
+        }
+    }
+    pthread_mutex_unlock(&a->lock);
+    return r;
+#else
+    (void)a; (void)buf; (void)len;
+    return -1;
+#endif
+}
+
+/*
+ * Envía la escritura de [buf, buf + len) en el offset off del archivo. No
+ * espera al disco (salvo con el anillo lleno, o con el backend sync).
+ * Devuelve 0, o -1 si ya hubo un error (queda en a->error).
+ */
+static inline int rle_aio_write(RLEAio *a, int file, const void *buf, size_t len, uint64_t off) {
+    if (file < 0 || file >= a->num_files) return -1;
+    const uint8_t *p = buf;
+    pthread_mutex_lock(&a->lock);
+    RLEAioFile *f = &a->files[file];
+    a->st.writes++;
+    a->st.bytes += len;
+    int r = 0;
+    uint64_t end = off + len;
+    uint64_t lo = (off + RLE_AIO_ALIGN - 1) / RLE_AIO_ALIGN * RLE_AIO_ALIGN;
+    uint64_t hi = end / RLE_AIO_ALIGN * RLE_AIO_ALIGN;
+    /* Buffer y archivo en la misma fase: el tramo [lo, hi) queda alineado en ambos */
+    if (f->dfd >= 0 && ((uint64_t)(uintptr_t)p - off) % RLE_AIO_ALIGN == 0 && hi > lo) {
+        r |= rle_aio_queue(a, f, f->fd, p, lo - off, off);
+        r |= rle_aio_queue(a, f, f->dfd, p + (lo - off), hi - lo, lo);
+        r |= rle_aio_queue(a, f, f->fd, p + (hi - off), end - hi, hi);
+        a->st.direct_bytes += hi - lo;
+    } else {
+        r = rle_aio_queue(a, f, f->fd, p, len, off);
+    }
+#ifdef RLE_AIO_HAVE_URING
+    if (a->backend == RLE_AIO_URING) rle_uring_submit(a, 0);
+#endif
+    if (a->error) r = -1;
+    pthread_mutex_unlock(&a->lock);
+    return r;
+}
+
+/*
+ * Espera todas las escrituras, manda los fsync en lote (con fsync) y cierra
+ * los archivos. Devuelve 0, o -1 con el errno de la primera falla en a->error.
+ * El contexto queda listo para otro rle_aio_init.
+ */
+static inline int rle_aio_finish(RLEAio *a) {
+    pthread_mutex_lock(&a->lock);
+#ifdef RLE_AIO_HAVE_URING
+    if (a->backend == RLE_AIO_URING) {
+        rle_uring_submit(a, 0);
+        while (a->inflight > 0 || a->pending > 0) {
+            rle_uring_submit(a, 1);
+            rle_uring_reap(a);
+            if (a->error && a->inflight == 0) break;
+        }
+        if (a->fsync && !a->error && a->num_files > 0) {
+            for (int i = 0; i < a->num_files; i++) {
+                int idx = a->free_ops[--a->num_free];
+                memset(&a->ops[idx], 0, sizeof(a->ops[idx]));
+                a->ops[idx].fd = a->files[i].fd;
+                a->ops[idx].fsync = 1;
+                rle_uring_prep(a, idx);
+            }
+            a->st.fsyncs += (uint32_t)a->num_files;
+            a->st.fsync_batches++;
+            rle_uring_submit(a, (unsigned)a->num_files);
+            while (a->inflight > 0) {
+                if (rle_uring_reap(a) == 0) rle_uring_submit(a, 1);
+                if (a->error && a->inflight == 0) break;
+            }
+        }
+        rle_uring_close(a);
+    }
+#endif
+#ifdef __APPLE__
+    if (a->backend == RLE_AIO_DISPATCH) {
+        pthread_mutex_unlock(&a->lock);
+        dispatch_group_wait(a->group, DISPATCH_TIME_FOREVER);
+        pthread_mutex_lock(&a->lock);
+        for (int i = 0; i < a->num_files; i++) {
+            dispatch_io_close(a->files[i].chan, 0);
+            dispatch_release(a->files[i].chan);
+            dispatch_semaphore_wait(a->files[i].closed, DISPATCH_TIME_FOREVER);
+            dispatch_release(a->files[i].closed);
+        }
+        dispatch_release(a->group);
+        dispatch_release(a->queue);
+    }
+#endif
+    if (a->backend != RLE_AIO_URING && a->fsync && !a->error && a->num_files > 0) {
+        for (int i = 0; i < a->num_files; i++) {
+#ifdef F_FULLFSYNC
+            if (fcntl(a->files[i].fd, F_FULLFSYNC) == 0) continue;
+#endif
+            if (fsync(a->files[i].fd) != 0) rle_aio_set_error(a, errno);
+        }
+        a->st.fsyncs += (uint32_t)a->num_files;
+        a->st.fsync_batches++;
+    }
+    for (int i = 0; i < a->num_files; i++) {
+        if (a->files[i].dfd >= 0) close(a->files[i].dfd);
+        if (close(a->files[i].fd) != 0) rle_aio_set_error(a, errno);
+    }
+    a->num_files = 0;
+    int r = a->error ? -1 : 0;
+    pthread_mutex_unlock(&a->lock);
+    pthread_mutex_destroy(&a->lock);
+    return r;
+}
+
+#endif /* RLE_AIO_H */
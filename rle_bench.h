@@ -0,0 +1,245 @@
+/*
+ * ============================================================================
+ *  rle_bench.h — Benchmark reproducible dentro del proceso (--bench)
+ *
+ *  Lo incluyen rle_secuencial.c y rle_paralelo.c. Con --bench el programa no
+ *  imprime ninguna visualización: comprime y descomprime cada entrada en
+ *  memoria (W corridas de calentamiento + K medidas) y emite un solo
+ *  documento JSON o CSV con la estadística de las K corridas:
+ *
+ *    mediana, p95, media, desviación estándar, mínimo   (ms)
+ *    MB/s sobre la mediana, ratio de compresión, verificación del round-trip
+ *
+ *  Las entradas son tres clases sintéticas del mismo tamaño, generadas de
+ *  forma determinista para que dos corridas sean comparables, las imágenes
+ *  del generador (rle_synth.h) y las fotos que se pasen como argumento:
+ *
+ *    flat       un solo gris: runs máximos, cota superior de MB/s
+ *    gradient   rampa horizontal de grises: runs de ~ancho/256 píxeles
+ *    noise      bytes pseudoaleatorios (xorshift32): casi sin runs, peor caso
+ *    synth      --bench-synth SPEC: run medio, ruido, correlación, skew
+ *    photo      archivo real (PPM mapeado o stb_image)
+ *
+ *  Además de los tiempos, cada fila lleva el desbalance de la compresión
+ *  (hilo más lento / promedio) y la memoria residente del proceso.
+ *
+ *  Los tiempos son CLOCK_MONOTONIC de la fase completa (crear hilos, comprimir
+ *  o decodificar, join); la carga del archivo y la escritura quedan fuera.
+ * ============================================================================
+ */
+
+#ifndef RLE_BENCH_H
+#define RLE_BENCH_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RLE_BENCH_MAX_ITERS   1000
+#define RLE_BENCH_MAX_INPUTS  64
+#define RLE_BENCH_MAX_SYNTH   16
+
+enum {
+    RLE_BENCH_FLAT,
+    RLE_BENCH_GRADIENT,
+    RLE_BENCH_NOISE,
+    RLE_BENCH_SYNTH,
+    RLE_BENCH_PHOTO,
+    RLE_BENCH_CLASSES
+};
+
+static inline const char *rle_bench_class_name(int cls) {
+    static const char *const names[RLE_BENCH_CLASSES] = { "flat", "gradient", "noise", "synth",
+                                                              "photo" };
+    return cls >= 0 && cls < RLE_BENCH_CLASSES ? names[cls] : "?";
+}
+
+/* Llena w x h píxeles RGB con una clase sintética (siempre la misma imagen) */
+static inline void rle_bench_fill(uint8_t *rgb, uint32_t w, uint32_t h, int cls) {
+    uint32_t state = 0x9E3779B9u;       /* semilla fija: noise reproducible */
+    for (uint32_t y = 0; y < h; y++) {
+        uint8_t *row = rgb + (size_t)y * w * 3;
+        for (uint32_t x = 0; x < w; x++) {
+            uint8_t *p = row + (size_t)x * 3;
+            /* Gris (R = G = B): los runs existen en los tres modos, también byte */
+            if (cls == RLE_BENCH_FLAT) {
+                p[0] = p[1] = p[2] = 0x80;
+            } else if (cls == RLE_BENCH_GRADIENT) {
+                p[0] = p[1] = p[2] = (uint8_t)((uint64_t)x * 256 / w);
+            } else {
+                for (int c = 0; c < 3; c++) {
+                    state ^= state << 13;
+                    state ^= state >> 17;
+                    state ^= state << 5;
+                    p[c] = (uint8_t)(state >> 24);
+                }
+            }
+        }
+    }
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  ESTADÍSTICA DE LAS CORRIDAS
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+typedef struct {
+    int    n;
+    double min, median, p95, mean, stddev;     /* segundos */
+} RLEBenchStats;
+
+static inline int rle_bench_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Ordena samples (n > 0) en su lugar; p95 por rango más cercano */
+static inline void rle_bench_stats(double *samples, int n, RLEBenchStats *st) {
+    memset(st, 0, sizeof(*st));
+    if (n <= 0) return;
+    qsort(samples, (size_t)n, sizeof(double), rle_bench_cmp);
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += samples[i];
+    double mean = sum / n, var = 0;
+    for (int i = 0; i < n; i++) var += (samples[i] - mean) * (samples[i] - mean);
+    int rank = (int)ceil(0.95 * n) - 1;
+    st->n = n;
+    st->min = samples[0];
+    st->median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    st->p95 = samples[rank < 0 ? 0 : rank];
+    st->mean = mean;
+    st->stddev = n > 1 ? sqrt(var / (n - 1)) : 0;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  RESULTADOS Y SALIDA (JSON / CSV)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+typedef struct {
+    const char    *input;       /* ruta de la foto o nombre de la clase */
+    int            cls;         /* RLE_BENCH_* */
+    uint32_t       width;
+    uint32_t       height;
+    int            threads;
+    size_t         raw_bytes;
+    size_t         rle_bytes;   /* contenedor completo (header + tabla + chunks) */
+    RLEBenchStats  compress;
+    RLEBenchStats  decompress;
+    int            verified;    /* 1 = la descompresión reproduce la entrada */
+    double         imbalance;   /* compresión: hilo más ocupado / promedio (1 = parejo) */
+    size_t         rss_bytes;   /* RSS tras la última compresión (entrada + salida) */
+    size_t         peak_rss_bytes;  /* pico de RSS del proceso hasta esta fila */
+} RLEBenchResult;
+
+typedef struct {
+    const char *program;        /* "rle_secuencial" / "rle_paralelo" */
+    const char *mode;           /* byte / pixel / planar */
+    const char *count;          /* u8 / varint */
+    const char *kernel;         /* kernel de escaneo elegido */
+    const char *variant;        /* variante especializada del codificador / decodificador */
+    const char *alloc;          /* --alloc */
+    uint32_t    tile_rows;      /* 0 = automático */
+    int         warmup;
+    int         iters;
+} RLEBenchConfig;
+
+static inline double rle_bench_mbps(size_t bytes, double secs) {
+    return secs > 0 ? bytes / (1024.0 * 1024.0) / secs : 0;
+}
+
+static inline void rle_bench_json_str(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static inline void rle_bench_json_stats(FILE *f, const char *name, const RLEBenchStats *st,
+                                        size_t raw_bytes) {
+    fprintf(f, "\"%s\": {\"median_ms\": %.4f, \"p95_ms\": %.4f, \"mean_ms\": %.4f, "
+               "\"stddev_ms\": %.4f, \"min_ms\": %.4f, \"mbps\": %.2f}",
+            name, st->median * 1e3, st->p95 * 1e3, st->mean * 1e3, st->stddev * 1e3,
+            st->min * 1e3, rle_bench_mbps(raw_bytes, st->median));
+}
+
+static inline void rle_bench_json(FILE *f, const RLEBenchConfig *cfg,
+                                  const RLEBenchResult *res, int n) {
+    fprintf(f, "{\n  \"program\": \"%s\",\n", cfg->program);
+    fprintf(f, "  \"config\": {\"mode\": \"%s\", \"count\": \"%s\", \"kernel\": \"%s\", "
+               "\"alloc\": \"%s\", \"tile_rows\": %u, \"warmup\": %d, \"iters\": %d,\n             "
+               "\"variant\": ",
+            cfg->mode, cfg->count, cfg->kernel, cfg->alloc, cfg->tile_rows,
+            cfg->warmup, cfg->iters);
+    rle_bench_json_str(f, cfg->variant);
+    fprintf(f, "},\n");
+    fprintf(f, "  \"results\": [");
+    for (int i = 0; i < n; i++) {
+        const RLEBenchResult *r = &res[i];
+        fprintf(f, "%s\n    {\"input\": ", i ? "," : "");
+        rle_bench_json_str(f, r->input);
+        fprintf(f, ", \"class\": \"%s\", \"width\": %u, \"height\": %u, \"threads\": %d, "
+                   "\"raw_bytes\": %zu, \"rle_bytes\": %zu, \"ratio\": %.4f, \"verified\": %s,\n     "
+                   "\"imbalance\": %.4f, \"rss_bytes\": %zu, \"peak_rss_bytes\": %zu,\n     ",
+                rle_bench_class_name(r->cls), r->width, r->height, r->threads,
+                r->raw_bytes, r->rle_bytes,
+                r->rle_bytes ? (double)r->raw_bytes / r->rle_bytes : 0.0,
+                r->verified ? "true" : "false", r->imbalance, r->rss_bytes, r->peak_rss_bytes);
+        rle_bench_json_stats(f, "compress", &r->compress, r->raw_bytes);
+        fprintf(f, ",\n     ");
+        rle_bench_json_stats(f, "decompress", &r->decompress, r->raw_bytes);
+        fprintf(f, "}");
+    }
+    fprintf(f, "\n  ]\n}\n");
+}
+
+/* Un campo CSV; si trae coma o comillas va entre comillas (RFC 4180) */
+static inline void rle_bench_csv_str(FILE *f, const char *s) {
+    if (!strpbrk(s, ",\"\n")) {
+        fputs(s, f);
+        return;
+    }
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+/* Una fila por (entrada, hilos); la configuración se repite en cada fila */
+static inline void rle_bench_csv(FILE *f, const RLEBenchConfig *cfg,
+                                 const RLEBenchResult *res, int n) {
+    fprintf(f, "program,mode,count,kernel,alloc,tile_rows,warmup,iters,variant,"
+               "input,class,width,height,threads,raw_bytes,rle_bytes,ratio,verified,"
+               "imbalance,rss_bytes,peak_rss_bytes");
+    static const char *const phases[2] = { "compress", "decompress" };
+    for (int p = 0; p < 2; p++)
+        fprintf(f, ",%s_median_ms,%s_p95_ms,%s_mean_ms,%s_stddev_ms,%s_min_ms,%s_mbps",
+                phases[p], phases[p], phases[p], phases[p], phases[p], phases[p]);
+    fprintf(f, "\n");
+    for (int i = 0; i < n; i++) {
+        const RLEBenchResult *r = &res[i];
+        fprintf(f, "%s,%s,%s,%s,%s,%u,%d,%d,", cfg->program, cfg->mode, cfg->count,
+                cfg->kernel, cfg->alloc, cfg->tile_rows, cfg->warmup, cfg->iters);
+        rle_bench_csv_str(f, cfg->variant);
+        fputc(',', f);
+        rle_bench_csv_str(f, r->input);
+        fprintf(f, ",%s,%u,%u,%d,%zu,%zu,%.4f,%d,%.4f,%zu,%zu", rle_bench_class_name(r->cls),
+                r->width, r->height, r->threads, r->raw_bytes, r->rle_bytes,
+                r->rle_bytes ? (double)r->raw_bytes / r->rle_bytes : 0.0, r->verified,
+                r->imbalance, r->rss_bytes, r->peak_rss_bytes);
+        const RLEBenchStats *st[2] = { &r->compress, &r->decompress };
+        for (int p = 0; p < 2; p++)
+            fprintf(f, ",%.4f,%.4f,%.4f,%.4f,%.4f,%.2f", st[p]->median * 1e3, st[p]->p95 * 1e3,
+                    st[p]->mean * 1e3, st[p]->stddev * 1e3, st[p]->min * 1e3,
+                    rle_bench_mbps(r->raw_bytes, st[p]->median));
+        fprintf(f, "\n");
+    }
+}
+
+#endif /* RLE_BENCH_H */
@@ -0,0 +1,297 @@
+/*
+ * ============================================================================
+ *  rle_bmp.h — Escritura rápida del BMP de salida (24 bits, de abajo arriba)
+ *
+ *  Lo incluyen rle_secuencial.c y rle_paralelo.c. Un BMP guarda cada fila en
+ *  BGR, con padding a múltiplo de 4 bytes, y la última fila primero. La
+ *  versión original hacía un swizzle byte a byte a un buffer de una fila
+ *  (con memset por fila) y un fwrite por fila: h llamadas a stdio.
+ *
+ *    rle_bmp_create       header + ftruncate al tamaño final: cada banda se
+ *                         escribe luego en su offset, en cualquier orden y
+ *                         desde cualquier hilo, con pwrite
+ *    rle_bmp_write_rows   RGB: arma bloques de ~RLE_BMP_BLOCK bytes con filas
+ *                         ya invertidas y con padding, swizzle vectorizado
+ *                         (SSSE3 / NEON), un pwrite por bloque
+ *                         BGR (decodificador con bgr = 1): sin copia, un
+ *                         pwritev con las filas del buffer y el padding
+ *
+ *  rle_rgb_swap intercambia R y B (la misma operación va en ambos sentidos);
+ *  rle_bgr_first_diff y rle_bgr_crc32c comparan o resumen una banda BGR
+ *  como si fuera RGB, para verificar sin convertir la imagen entera.
+ * ============================================================================
+ */
+
+#ifndef RLE_BMP_H
+#define RLE_BMP_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "rle_format.h"
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define RLE_BMP_SSSE3 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RLE_BMP_NEON 1
+#endif
+
+#define BMP_HEADER_SIZE (14 + 40)
+#define RLE_BMP_BLOCK   (1u << 20)     /* bytes por pwrite en rle_bmp_write_rows */
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static inline size_t rle_bmp_stride(uint32_t w) {
+    return ((size_t)w * 3 + 3) & ~(size_t)3;
+}
+
+/* Tamaño de bloque para rle_bmp_write_rows: ~RLE_BMP_BLOCK, al menos una fila */
+static inline size_t rle_bmp_block_size(uint32_t w) {
+    size_t stride = rle_bmp_stride(w);
+    return stride > RLE_BMP_BLOCK ? stride : RLE_BMP_BLOCK / stride * stride;
+}
+
+/* File header (14 bytes) + info header (40 bytes) de un BMP de 24 bits */
+static inline void rle_bmp_fill_header(uint8_t *hdr, uint32_t w, uint32_t h) {
+    uint32_t row_stride = (uint32_t)rle_bmp_stride(w);
+    uint32_t pixel_data_size = row_stride * h;
+    uint32_t file_size = BMP_HEADER_SIZE + pixel_data_size;
+
+    memset(hdr, 0, BMP_HEADER_SIZE);
+    uint8_t *fh = hdr;
+    fh[0] = 'B'; fh[1] = 'M';
+    fh[2] = file_size & 0xFF;
+    fh[3] = (file_size >> 8) & 0xFF;
+    fh[4] = (file_size >> 16) & 0xFF;
+    fh[5] = (file_size >> 24) & 0xFF;
+    uint32_t offset = BMP_HEADER_SIZE;
+    fh[10] = offset & 0xFF;
+    fh[11] = (offset >> 8) & 0xFF;
+
+    uint8_t *ih = hdr + 14;
+    ih[0] = 40;
+    ih[4] = w & 0xFF; ih[5] = (w >> 8) & 0xFF;
+    ih[6] = (w >> 16) & 0xFF; ih[7] = (w >> 24) & 0xFF;
+    ih[8] = h & 0xFF; ih[9] = (h >> 8) & 0xFF;
+    ih[10] = (h >> 16) & 0xFF; ih[11] = (h >> 24) & 0xFF;
+    ih[12] = 1;
+    ih[14] = 24;
+    ih[20] = pixel_data_size & 0xFF;
+    ih[21] = (pixel_data_size >> 8) & 0xFF;
+    ih[22] = (pixel_data_size >> 16) & 0xFF;
+    ih[23] = (pixel_data_size >> 24) & 0xFF;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  SWIZZLE RGB ↔ BGR
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static inline void rle_rgb_swap_scalar(uint8_t *dst, const uint8_t *src, size_t npix) {
+    for (size_t x = 0; x < npix; x++) {
+        uint8_t r = src[3 * x], g = src[3 * x + 1], b = src[3 * x + 2];
+        dst[3 * x] = b;
+        dst[3 * x + 1] = g;
+        dst[3 * x + 2] = r;
+    }
+}
+
+#ifdef RLE_BMP_SSSE3
+/*
+ * pshufb de 16 bytes: 5 píxeles (15 bytes) por paso; el byte 16 se copia tal
+ * cual y lo sobrescribe el paso siguiente. Quedan al menos 16 bytes leíbles
+ * y escribibles en cada paso; la cola va por la versión escalar.
+ */
+__attribute__((target("ssse3")))
+static inline void rle_rgb_swap_ssse3(uint8_t *dst, const uint8_t *src, size_t npix) {
+    const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    size_t n = 3 * npix, i = 0;
+    for (; i + 16 <= n; i += 15) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+    rle_rgb_swap_scalar(dst + i, src + i, (n - i) / 3);
+}
+
+static inline int rle_rgb_swap_ssse3_available(void) {
+    static int avail = -1;          /* carrera benigna: todos escriben lo mismo */
+    if (avail < 0) {
+        __builtin_cpu_init();
+        avail = __builtin_cpu_supports("ssse3") ? 1 : 0;
+    }
+    return avail;
+}
+#endif
+
+#ifdef RLE_BMP_NEON
+/* vld3/vst3 separan y vuelven a intercalar los canales: 16 píxeles por paso */
+static inline void rle_rgb_swap_neon(uint8_t *dst, const uint8_t *src, size_t npix) {
+    size_t x = 0;
+    for (; x + 16 <= npix; x += 16) {
+        uint8x16x3_t v = vld3q_u8(src + 3 * x);
+        uint8x16_t r = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = r;
+        vst3q_u8(dst + 3 * x, v);
+    }
+    rle_rgb_swap_scalar(dst + 3 * x, src + 3 * x, npix - x);
+}
+#endif
+
+/* dst[x] = src[x] con R y B intercambiados; dst == src permitido */
+static inline void rle_rgb_swap(uint8_t *dst, const uint8_t *src, size_t npix) {
+#if defined(RLE_BMP_SSSE3)
+    if (rle_rgb_swap_ssse3_available()) {
+        rle_rgb_swap_ssse3(dst, src, npix);
+        return;
+    }
+#elif defined(RLE_BMP_NEON)
+    rle_rgb_swap_neon(dst, src, npix);
+    return;
+#endif
+    rle_rgb_swap_scalar(dst, src, npix);
+}
+
+static inline const char *rle_rgb_swap_name(void) {
+#if defined(RLE_BMP_SSSE3)
+    return rle_rgb_swap_ssse3_available() ? "SSSE3" : "escalar";
+#elif defined(RLE_BMP_NEON)
+    return "NEON";
+#else
+    return "escalar";
+#endif
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  VERIFICACIÓN DE BANDAS BGR
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+#define RLE_BGR_SWAP_PIXELS 4096        /* píxeles por bloque en la pila (12 KB) */
+
+/* Primer byte (en orden RGB) donde bgr difiere de rgb; n si son iguales. n múltiplo de 3 */
+static inline size_t rle_bgr_first_diff(const uint8_t *bgr, const uint8_t *rgb, size_t n) {
+    uint8_t tmp[3 * RLE_BGR_SWAP_PIXELS];
+    for (size_t off = 0; off < n; off += sizeof(tmp)) {
+        size_t len = n - off < sizeof(tmp) ? n - off : sizeof(tmp);
+        rle_rgb_swap(tmp, bgr + off, len / 3);
+        if (memcmp(tmp, rgb + off, len) != 0) {
+            size_t i = 0;
+            while (tmp[i] == rgb[off + i]) i++;
+            return off + i;
+        }
+    }
+    return n;
+}
+
+/* CRC32C de la banda como RGB (igual a rle_crc32c de la banda original) */
+static inline uint32_t rle_bgr_crc32c(const uint8_t *bgr, size_t n) {
+    uint8_t tmp[3 * RLE_BGR_SWAP_PIXELS];
+    uint32_t crc = 0;
+    for (size_t off = 0; off < n; off += sizeof(tmp)) {
+        size_t len = n - off < sizeof(tmp) ? n - off : sizeof(tmp);
+        rle_rgb_swap(tmp, bgr + off, len / 3);
+        crc = rle_crc32c(crc, tmp, len);
+    }
+    return crc;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  ESCRITURA POR BANDAS
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * Crea path con el header y el tamaño final (ftruncate, sin escribir los
+ * píxeles todavía). Devuelve el fd, o -1 con mensaje en stderr.
+ */
+static inline int rle_bmp_create(const char *path, uint32_t w, uint32_t h) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    uint8_t hdr[BMP_HEADER_SIZE];
+    rle_bmp_fill_header(hdr, w, h);
+    off_t total = BMP_HEADER_SIZE + (off_t)rle_bmp_stride(w) * h;
+    if (pwrite(fd, hdr, BMP_HEADER_SIZE, 0) != BMP_HEADER_SIZE || ftruncate(fd, total) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Offset en el archivo de la fila y de la imagen (la última fila va primero) */
+static inline off_t rle_bmp_row_offset(uint32_t w, uint32_t h, uint32_t y) {
+    return BMP_HEADER_SIZE + (off_t)(h - 1 - y) * (off_t)rle_bmp_stride(w);
+}
+
+/* BGR: un pwritev por tanda de filas, cada una seguida de su padding */
+static inline int rle_bmp_write_rows_bgr(int fd, const uint8_t *pixels, uint32_t w, uint32_t h,
+                                         uint32_t row0, uint32_t rows) {
+    static const uint8_t zero[4] = {0};
+    const size_t row_bytes = (size_t)w * 3;
+    const size_t pad = rle_bmp_stride(w) - row_bytes;
+    struct iovec iov[IOV_MAX];
+    const int per_call = pad ? IOV_MAX / 2 : IOV_MAX;
+
+    /* En el archivo la banda va de la fila row0 + rows - 1 a la fila row0 */
+    uint32_t done = 0;
+    while (done < rows) {
+        uint32_t y_top = row0 + rows - 1 - done;
+        int n = 0;
+        size_t bytes = 0;
+        for (uint32_t k = 0; k < (uint32_t)per_call && done + k < rows; k++) {
+            iov[n].iov_base = (void *)(pixels + (size_t)(y_top - k - row0) * row_bytes);
+            iov[n++].iov_len = row_bytes;
+            if (pad) {
+                iov[n].iov_base = (void *)zero;
+                iov[n++].iov_len = pad;
+            }
+            bytes += row_bytes + pad;
+        }
+        if (pwritev(fd, iov, n, rle_bmp_row_offset(w, h, y_top)) != (ssize_t)bytes) return -1;
+        done += pad ? (uint32_t)n / 2 : (uint32_t)n;
+    }
+    return 0;
+}
+
+/*
+ * Escribe las filas [row0, row0 + rows) de una imagen w x h en su posición
+ * del BMP. pixels apunta a la fila row0 (RGB, o BGR si bgr). block es un
+ * buffer del llamador de rle_bmp_block_size(w) bytes (no se usa con bgr).
+ * Devuelve 0, o -1 si falló algún pwrite.
+ */
+static inline int rle_bmp_write_rows(int fd, const uint8_t *pixels, uint32_t w, uint32_t h,
+                                     uint32_t row0, uint32_t rows, int bgr, uint8_t *block) {
+    if (bgr)
+        return rle_bmp_write_rows_bgr(fd, pixels, w, h, row0, rows);
+
+    const size_t row_bytes = (size_t)w * 3;
+    const size_t stride = rle_bmp_stride(w);
+    const uint32_t per_block = (uint32_t)(rle_bmp_block_size(w) / stride);
+    uint32_t done = 0;
+    while (done < rows) {
+        uint32_t y_top = row0 + rows - 1 - done;
+        uint32_t n = rows - done < per_block ? rows - done : per_block;
+        for (uint32_t k = 0; k < n; k++) {
+            uint8_t *dst = block + (size_t)k * stride;
+            rle_rgb_swap(dst, pixels + (size_t)(y_top - k - row0) * row_bytes, w);
+            memset(dst + row_bytes, 0, stride - row_bytes);
+        }
+        size_t bytes = (size_t)n * stride;
+        if (pwrite(fd, block, bytes, rle_bmp_row_offset(w, h, y_top)) != (ssize_t)bytes)
+            return -1;
+        done += n;
+    }
+    return 0;
+}
+
+#endif /* RLE_BMP_H */
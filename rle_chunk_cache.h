@@ -0,0 +1,365 @@
+/*
+ * ============================================================================
+ *  rle_chunk_cache.h — Caché de chunks por contenido (--chunk-cache)
+ *
+ *  Lo incluyen librle.h y rle_paralelo.c. Muchas bandas se repiten exactas
+ *  entre imágenes de un lote (márgenes en blanco, cuadros repetidos,
+ *  encabezados) y dentro de una misma imagen (las bandas del generador
+ *  sintético). La codificación de una banda depende solo de sus bytes, del
+ *  modo y de los flags, así que el chunk ya codificado se puede reutilizar:
+ *
+ *    clave     XXH64 de los bytes RGB de la banda + largo + modo + flags
+ *    valor     el chunk codificado, su CRC32C, el raw_checksum y su codec
+ *              (RLE_FLAG_CODEC: el que eligió --adaptive)
+ *
+ *  Un acierto copia el chunk en lugar de codificarlo. Un falso acierto exige
+ *  una colisión de 64 bits entre bandas del mismo largo (2^-64 por par).
+ *
+ *  La tabla es de direccionamiento abierto bajo un mutex: se consulta una vez
+ *  por banda (cientos de KB de trabajo), así que el lock no se nota. Los
+ *  datos de cada entrada son un bloque propio que no se mueve al crecer la
+ *  tabla, y la copia de un acierto se hace fuera del lock. Al llegar a
+ *  max_bytes de datos deja de insertar (no hay expulsión).
+ *
+ *  Persistencia (--chunk-cache-file ARCHIVO), little-endian:
+ *
+ *    "RLECCHE1" u32 versión u32 entradas
+ *    entrada × N    32 bytes (hash, raw_len, length, checksum, raw_checksum,
+ *                   mode, flags, codec), seguida de los length bytes del chunk
+ *
+ *  Al cargar se verifica el CRC32C de cada chunk; el archivo se reescribe
+ *  completo en ARCHIVO.tmp y se renombra, así un corte no lo deja a medias.
+ * ============================================================================
+ */
+
+#ifndef RLE_CHUNK_CACHE_H
+#define RLE_CHUNK_CACHE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rle_format.h"
+
+#define RLE_CHUNK_CACHE_MAGIC      "RLECCHE1"
+#define RLE_CHUNK_CACHE_VERSION    1
+#define RLE_CHUNK_CACHE_MAX_BYTES  (256u * 1024u * 1024u)   /* datos de chunks en memoria */
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  HASH XXH64 DE LA BANDA
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+#define RLE_XXH_P1 0x9E3779B185EBCA87ull
+#define RLE_XXH_P2 0xC2B2AE3D27D4EB4Full
+#define RLE_XXH_P3 0x165667B19E3779F9ull
+#define RLE_XXH_P4 0x85EBCA77C2B2AE63ull
+#define RLE_XXH_P5 0x27D4EB2F165667C5ull
+
+static inline uint64_t rle_xxh_rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline uint64_t rle_xxh_read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t rle_xxh_round(uint64_t acc, uint64_t in) {
+    acc += in * RLE_XXH_P2;
+    return rle_xxh_rotl(acc, 31) * RLE_XXH_P1;
+}
+
+static inline uint64_t rle_xxh_merge(uint64_t acc, uint64_t v) {
+    acc ^= rle_xxh_round(0, v);
+    return acc * RLE_XXH_P1 + RLE_XXH_P4;
+}
+
+/* XXH64 (semilla 0): cuatro carriles de 8 bytes, varias veces más rápido que un hash por byte */
+static inline uint64_t rle_hash64(const void *data, size_t n) {
+    const uint8_t *p = (const uint8_t *)data, *end = p + n;
+    uint64_t h;
+    if (n >= 32) {
+        uint64_t v1 = RLE_XXH_P1 + RLE_XXH_P2, v2 = RLE_XXH_P2, v3 = 0, v4 = -RLE_XXH_P1;
+        for (; end - p >= 32; p += 32) {
+            v1 = rle_xxh_round(v1, rle_xxh_read64(p));
+            v2 = rle_xxh_round(v2, rle_xxh_read64(p + 8));
+            v3 = rle_xxh_round(v3, rle_xxh_read64(p + 16));
+            v4 = rle_xxh_round(v4, rle_xxh_read64(p + 24));
+        }
+        h = rle_xxh_rotl(v1, 1) + rle_xxh_rotl(v2, 7) + rle_xxh_rotl(v3, 12) + rle_xxh_rotl(v4, 18);
+        h = rle_xxh_merge(h, v1);
+        h = rle_xxh_merge(h, v2);
+        h = rle_xxh_merge(h, v3);
+        h = rle_xxh_merge(h, v4);
+    } else {
+        h = RLE_XXH_P5;
+    }
+    h += (uint64_t)n;
+    for (; end - p >= 8; p += 8) {
+        h ^= rle_xxh_round(0, rle_xxh_read64(p));
+        h = rle_xxh_rotl(h, 27) * RLE_XXH_P1 + RLE_XXH_P4;
+    }
+    if (end - p >= 4) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        h ^= (uint64_t)v * RLE_XXH_P1;
+        h = rle_xxh_rotl(h, 23) * RLE_XXH_P2 + RLE_XXH_P3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= (uint64_t)*p * RLE_XXH_P5;
+        h = rle_xxh_rotl(h, 11) * RLE_XXH_P1;
+    }
+    h ^= h >> 33;
+    h *= RLE_XXH_P2;
+    h ^= h >> 29;
+    h *= RLE_XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  TABLA
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+typedef struct {
+    uint64_t hash;
+    uint64_t raw_len;           /* bytes RGB de la banda */
+    uint8_t  mode;
+    uint8_t  flags;
+} RLEChunkKey;
+
+typedef struct {
+    RLEChunkKey key;
+    uint32_t    length;         /* bytes del chunk codificado */
+    uint32_t    checksum;       /* CRC32C del chunk */
+    uint32_t    raw_checksum;   /* el de la tabla de chunks (0 sin RLE_FLAG_RAW_CRC) */
+    uint32_t    codec;          /* RLE_CODEC_* del chunk */
+    uint8_t    *data;           /* NULL = hueco libre */
+} RLEChunkCacheEntry;
+
+typedef struct {
+    pthread_mutex_t     lock;
+    RLEChunkCacheEntry *slots;
+    uint32_t            cap;            /* potencia de 2 (0 = sin reservar) */
+    uint32_t            count;
+    size_t              data_bytes;
+    size_t              max_bytes;
+    uint32_t            loaded;         /* entradas leídas del archivo */
+    /* Contadores (relaxed: solo se leen al final) */
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+    atomic_uint_fast64_t hit_bytes;     /* bytes RGB que no hubo que codificar */
+    atomic_uint_fast64_t miss_bytes;
+    atomic_uint_fast64_t miss_ns;       /* tiempo de codificación de los fallos */
+    atomic_uint_fast64_t full;          /* inserciones descartadas por max_bytes */
+    atomic_uint_fast64_t shared;        /* tiles que reusan un chunk anterior del mismo archivo */
+} RLEChunkCache;
+
+static inline void rle_chunk_cache_init(RLEChunkCache *c, size_t max_bytes) {
+    memset(c, 0, sizeof(*c));
+    pthread_mutex_init(&c->lock, NULL);
+    c->max_bytes = max_bytes;
+    atomic_init(&c->hits, 0);
+    atomic_init(&c->misses, 0);
+    atomic_init(&c->hit_bytes, 0);
+    atomic_init(&c->miss_bytes, 0);
+    atomic_init(&c->miss_ns, 0);
+    atomic_init(&c->full, 0);
+    atomic_init(&c->shared, 0);
+}
+
+static inline void rle_chunk_cache_destroy(RLEChunkCache *c) {
+    for (uint32_t i = 0; i < c->cap; i++)
+        free(c->slots[i].data);
+    free(c->slots);
+    pthread_mutex_destroy(&c->lock);
+    memset(c, 0, sizeof(*c));
+}
+
+static inline RLEChunkKey rle_chunk_key(const uint8_t *band, size_t n, uint8_t mode, uint8_t flags) {
+    RLEChunkKey k;
+    memset(&k, 0, sizeof(k));
+    k.hash = rle_hash64(band, n);
+    k.raw_len = n;
+    k.mode = mode;
+    k.flags = flags;
+    return k;
+}
+
+static inline int rle_chunk_key_eq(const RLEChunkKey *a, const RLEChunkKey *b) {
+    return a->hash == b->hash && a->raw_len == b->raw_len && a->mode == b->mode &&
+           a->flags == b->flags;
+}
+
+/* Hueco de k: el que ya la tiene o el primero libre (con el lock tomado) */
+static inline RLEChunkCacheEntry *rle_chunk_cache_slot(RLEChunkCacheEntry *slots, uint32_t cap,
+                                                       const RLEChunkKey *k) {
+    uint32_t i = (uint32_t)k->hash & (cap - 1);
+    while (slots[i].data && !rle_chunk_key_eq(&slots[i].key, k))
+        i = (i + 1) & (cap - 1);
+    return &slots[i];
+}
+
+/* Duplica la tabla al pasar el 50% de ocupación; -1 sin memoria */
+static inline int rle_chunk_cache_grow(RLEChunkCache *c) {
+    if (c->cap && (c->count + 1) * 2 <= c->cap) return 0;
+    uint32_t cap = c->cap ? c->cap * 2 : 1024;
+    RLEChunkCacheEntry *slots = calloc(cap, sizeof(*slots));
+    if (!slots) return -1;
+    for (uint32_t i = 0; i < c->cap; i++)
+        if (c->slots[i].data)
+            *rle_chunk_cache_slot(slots, cap, &c->slots[i].key) = c->slots[i];
+    free(c->slots);
+    c->slots = slots;
+    c->cap = cap;
+    return 0;
+}
+
+/*
+ * Busca k; en un acierto deja en *out la entrada (out->data no se libera
+ * mientras viva la caché) y devuelve 1. No toca los contadores.
+ */
+static inline int rle_chunk_cache_lookup(RLEChunkCache *c, const RLEChunkKey *k,
+                                         RLEChunkCacheEntry *out) {
+    pthread_mutex_lock(&c->lock);
+    int hit = 0;
+    if (c->cap) {
+        RLEChunkCacheEntry *e = rle_chunk_cache_slot(c->slots, c->cap, k);
+        if (e->data) {
+            *out = *e;
+            hit = 1;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+    return hit;
+}
+
+/* Copia el chunk codificado de k; si otro hilo ya lo agregó, o no hay lugar, no hace nada */
+static inline void rle_chunk_cache_insert(RLEChunkCache *c, const RLEChunkKey *k,
+                                          const uint8_t *data, uint32_t length,
+                                          uint32_t checksum, uint32_t raw_checksum,
+                                          uint32_t codec) {
+    uint8_t *copy = malloc(length ? length : 1);
+    if (!copy) return;
+    memcpy(copy, data, length);
+    pthread_mutex_lock(&c->lock);
+    RLEChunkCacheEntry *e = NULL;
+    if (c->data_bytes + length > c->max_bytes) {
+        atomic_fetch_add_explicit(&c->full, 1, memory_order_relaxed);
+    } else if (rle_chunk_cache_grow(c) == 0) {
+        e = rle_chunk_cache_slot(c->slots, c->cap, k);
+        if (e->data) {
+            e = NULL;
+        } else {
+            e->key = *k;
+            e->length = length;
+            e->checksum = checksum;
+            e->raw_checksum = raw_checksum;
+            e->codec = codec;
+            e->data = copy;
+            c->count++;
+            c->data_bytes += length;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+    if (!e) free(copy);
+}
+
+/* Tiempo de codificación ahorrado por los aciertos, al ritmo medido en los fallos (segundos) */
+static inline double rle_chunk_cache_saved_s(RLEChunkCache *c) {
+    uint64_t mb = atomic_load(&c->miss_bytes), ns = atomic_load(&c->miss_ns);
+    return mb ? (double)atomic_load(&c->hit_bytes) * ns / mb / 1e9 : 0;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  PERSISTENCIA
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+typedef struct {
+    uint64_t hash;
+    uint64_t raw_len;
+    uint32_t length;
+    uint32_t checksum;
+    uint32_t raw_checksum;
+    uint8_t  mode;
+    uint8_t  flags;
+    uint8_t  codec;             /* 0 (RUNS) en las cachés anteriores a --adaptive */
+    uint8_t  pad;
+} RLEChunkCacheRecord;
+
+_Static_assert(sizeof(RLEChunkCacheRecord) == 32, "RLEChunkCacheRecord debe ocupar 32 bytes");
+
+/*
+ * Agrega a la caché las entradas de path. Un archivo inexistente no es un
+ * error (primera corrida); uno inválido deja lo leído hasta ahí y devuelve -1.
+ */
+static inline int rle_chunk_cache_load(RLEChunkCache *c, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    char magic[8];
+    uint32_t version, count;
+    if (fread(magic, 1, 8, f) != 8 || memcmp(magic, RLE_CHUNK_CACHE_MAGIC, 8) != 0 ||
+        fread(&version, 4, 1, f) != 1 || version != RLE_CHUNK_CACHE_VERSION ||
+        fread(&count, 4, 1, f) != 1) {
+        fprintf(stderr, "  %s: no es una caché de chunks v%d\n", path, RLE_CHUNK_CACHE_VERSION);
+        fclose(f);
+        return -1;
+    }
+    uint8_t *buf = NULL;
+    size_t buf_cap = 0;
+    int rc = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        RLEChunkCacheRecord r;
+        if (fread(&r, sizeof(r), 1, f) != 1) { rc = -1; break; }
+        if (r.length > buf_cap) {
+            uint8_t *p = realloc(buf, r.length);
+            if (!p) { rc = -1; break; }
+            buf = p;
+            buf_cap = r.length;
+        }
+        if (fread(buf, 1, r.length, f) != r.length || rle_crc32c(0, buf, r.length) != r.checksum) {
+            rc = -1;
+            break;
+        }
+        RLEChunkKey k = { r.hash, r.raw_len, r.mode, r.flags };
+        if (r.codec >= RLE_CODEC_COUNT) { rc = -1; break; }
+        rle_chunk_cache_insert(c, &k, buf, r.length, r.checksum, r.raw_checksum, r.codec);
+        c->loaded++;
+    }
+    if (rc != 0)
+        fprintf(stderr, "  %s: caché truncada o corrupta tras %u entradas\n", path, c->loaded);
+    free(buf);
+    fclose(f);
+    return rc;
+}
+
+/* Escribe la caché completa en path.tmp y la renombra a path; 0 o -1 */
+static inline int rle_chunk_cache_save(RLEChunkCache *c, const char *path) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) { perror("fopen caché"); return -1; }
+    uint32_t version = RLE_CHUNK_CACHE_VERSION;
+    int ok = fwrite(RLE_CHUNK_CACHE_MAGIC, 1, 8, f) == 8 && fwrite(&version, 4, 1, f) == 1 &&
+             fwrite(&c->count, 4, 1, f) == 1;
+    for (uint32_t i = 0; ok && i < c->cap; i++) {
+        const RLEChunkCacheEntry *e = &c->slots[i];
+        if (!e->data) continue;
+        RLEChunkCacheRecord r = { e->key.hash, e->key.raw_len, e->length, e->checksum,
+                                  e->raw_checksum, e->key.mode, e->key.flags,
+                                  (uint8_t)e->codec, 0 };
+        ok = fwrite(&r, sizeof(r), 1, f) == 1 && fwrite(e->data, 1, e->length, f) == e->length;
+    }
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) {
+        perror("guardar caché");
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+#endif /* RLE_CHUNK_CACHE_H */
@@ -0,0 +1,897 @@
+/*
+ * ============================================================================
+ *  rle_codec.h — Codificación de runs por modo (byte / píxel / planar)
+ *
+ *  Lo incluyen rle_secuencial.c y rle_paralelo.c. El modo se guarda en el
+ *  byte "mode" del header del contenedor (rle_format.h) y el decodificador
+ *  despacha según ese byte:
+ *
+ *    RLE_MODE_BYTE    (count u8, valor u8)        stream RGB intercalado
+ *    RLE_MODE_PIXEL   (count u8, R u8, G u8, B u8) píxeles completos de 3 bytes
+ *    RLE_MODE_PLANAR  (count u8, valor u8)        planos R, G y B de la banda,
+ *                                                  uno tras otro
+ *
+ *  En todos los modos un run nunca cruza el final de la banda (ni el de un
+ *  plano en modo planar), así que cada chunk se decodifica por separado.
+ *
+ *  Con RLE_FLAG_VARINT (byte "flags" del header) el count se guarda en
+ *  LEB128 (7 bits por byte, bit alto = continúa) y deja de tener el tope de
+ *  255: un fondo plano de una fila entera es un solo registro en vez de uno
+ *  cada 255 bytes. Los counts < 128 siguen ocupando 1 byte.
+ *
+ *  Con RLE_FLAG_CODEC (--adaptive) cada chunk lleva su propio codec en la
+ *  tabla (RLEChunkEntry.codec), elegido por el encoder al empezar la banda:
+ *
+ *    RLE_CODEC_RUNS      los registros de arriba, según el modo
+ *    RLE_CODEC_PACKBITS  control u8: c < 128 = literal de c + 1 unidades
+ *                        (siguen sus bytes), c > 128 = la unidad siguiente
+ *                        repetida 257 - c veces; la unidad es un píxel en
+ *                        modo pixel y un byte en byte / planar
+ *    RLE_CODEC_STORED    la banda RGB sin tocar; decodificar es un memcpy
+ *
+ *  La elección sale de una muestra: unas ventanas repartidas por la banda se
+ *  codifican con runs y con PackBits, y gana el más chico; si ninguno ahorra
+ *  al menos 1/32 de la muestra, la banda se guarda tal cual. Si la muestra
+ *  se equivocó y la banda completa ocupa más que sin comprimir, se guarda
+ *  tal cual igual (rle_encoder_finish): ningún chunk supera a su banda.
+ *
+ *  Encoder y decoder trabajan por pasos (un run / un bloque de salida por
+ *  llamada) para que los hilos sigan muestreando el PC y publicando su
+ *  progreso entre pasos, igual que el bucle original. Para RLE_CODEC_RUNS
+ *  rle_encode_some y rle_decode_some usan además variantes especializadas
+ *  por unidad (1 o 3 bytes), count (u8 / varint) y kernel de escaneo,
+ *  elegidas una vez por banda (ver VARIANTES ESPECIALIZADAS). Con RLEDecoder.bgr = 1
+ *  el decoder escribe la banda directamente en BGR, el orden del BMP
+ *  (--decode-bgr): el swizzle de la salida desaparece.
+ *
+ *  Verificación después de comprimir (--verify):
+ *
+ *    decode     decodificar a una imagen nueva (para el BMP) y comparar cada
+ *               banda con la original en el mismo hilo que la decodificó
+ *    stream     recorrer los runs contra la banda original sin escribir nada
+ *               (RLEVerifier): sin buffer de salida, corta en el primer byte
+ *               distinto
+ *    checksum   no decodificar: guardar el CRC32C de cada banda sin comprimir
+ *               en la tabla (RLE_FLAG_RAW_CRC); se comprueba al descomprimir
+ * ============================================================================
+ */
+
+#ifndef RLE_CODEC_H
+#define RLE_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rle_format.h"
+#include "rle_simd.h"
+
+/* Unidades de un literal o de una repetición PackBits */
+#define RLE_PACKBITS_MAX  128
+
+/*
+ * Tamaño máximo de un registro: el literal PackBits de 128 píxeles (un
+ * registro de runs ocupa como mucho un count LEB128 de 64 bits + valor RGB).
+ */
+#define RLE_MAX_VARINT  10
+#define RLE_MAX_RECORD  (1 + RLE_PACKBITS_MAX * 3)
+
+/* Bytes por llamada al encoder de una banda RLE_CODEC_STORED */
+#define RLE_STORED_STEP  (RLE_PACKBITS_MAX * 3)
+
+/* rle_encoder_measure: salida descartable por llamada a rle_encode_some */
+#define RLE_MEASURE_BUF  4096
+
+/* Muestra de --adaptive: ventanas de píxeles enteros repartidas por la banda */
+#define RLE_SAMPLE_WINDOWS  8
+#define RLE_SAMPLE_BYTES    1536
+
+static inline const char *rle_mode_name(uint8_t mode) {
+    switch (mode) {
+    case RLE_MODE_BYTE:   return "byte";
+    case RLE_MODE_PIXEL:  return "pixel";
+    case RLE_MODE_PLANAR: return "planar";
+    default:              return "?";
+    }
+}
+
+/* Devuelve el modo para "byte" / "pixel" / "planar", o -1 */
+static inline int rle_mode_parse(const char *s) {
+    for (int m = 0; m < RLE_MODE_COUNT; m++)
+        if (strcmp(s, rle_mode_name((uint8_t)m)) == 0) return m;
+    return -1;
+}
+
+static inline const char *rle_codec_name(uint32_t codec) {
+    switch (codec) {
+    case RLE_CODEC_RUNS:     return "runs";
+    case RLE_CODEC_PACKBITS: return "packbits";
+    case RLE_CODEC_STORED:   return "stored";
+    default:                 return "?";
+    }
+}
+
+/* "12 runs, 3 packbits, 8 stored": chunks por codec para las métricas de --adaptive */
+static inline void rle_codec_summary(char *buf, size_t len, const uint32_t counts[RLE_CODEC_COUNT]) {
+    snprintf(buf, len, "%u %s, %u %s, %u %s", counts[0], rle_codec_name(0),
+             counts[1], rle_codec_name(1), counts[2], rle_codec_name(2));
+}
+
+/* Descripción del formato del count para las métricas */
+static inline const char *rle_count_name(uint8_t flags) {
+    return (flags & RLE_FLAG_VARINT) ? "varint" : "u8";
+}
+
+typedef enum { RLE_VERIFY_DECODE, RLE_VERIFY_STREAM, RLE_VERIFY_CHECKSUM, RLE_VERIFY_COUNT } RLEVerifyMode;
+
+static inline const char *rle_verify_name(int v) {
+    static const char *const names[RLE_VERIFY_COUNT] = { "decode", "stream", "checksum" };
+    return v >= 0 && v < RLE_VERIFY_COUNT ? names[v] : "?";
+}
+
+/* Devuelve el modo para "decode" / "stream" / "checksum", o -1 */
+static inline int rle_verify_parse(const char *s) {
+    for (int v = 0; v < RLE_VERIFY_COUNT; v++)
+        if (strcmp(s, rle_verify_name(v)) == 0) return v;
+    return -1;
+}
+
+/* Escribe v en LEB128; devuelve los bytes usados (1..RLE_MAX_VARINT) */
+static inline size_t rle_varint_put(uint8_t *out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+/* Lee un LEB128 de como mucho avail bytes; devuelve los bytes usados (0 = truncado) */
+static inline size_t rle_varint_get(const uint8_t *p, size_t avail, uint64_t *v) {
+    uint64_t r = 0;
+    for (size_t n = 0; n < avail && n < RLE_MAX_VARINT; n++) {
+        r |= (uint64_t)(p[n] & 0x7F) << (7 * n);
+        if (!(p[n] & 0x80)) { *v = r; return n + 1; }
+    }
+    return 0;
+}
+
+/* Escribe el count de un registro (u8 o LEB128 según flags) */
+static inline size_t rle_count_put(uint8_t flags, uint8_t *out, size_t count) {
+    if (flags & RLE_FLAG_VARINT) return rle_varint_put(out, count);
+    out[0] = (uint8_t)count;
+    return 1;
+}
+
+/* Bytes de memoria auxiliar que necesita el encoder para una banda */
+static inline size_t rle_encoder_scratch_size(uint8_t mode, size_t band_bytes) {
+    return mode == RLE_MODE_PLANAR ? band_bytes : 0;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  ENCODER
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+typedef struct RLEEncoder {
+    const RLEScanKernel *kernel;
+    uint8_t mode;
+    uint8_t flags;              /* RLE_FLAG_* */
+    uint8_t codec;              /* RLE_CODEC_* de la banda (RUNS sin RLE_FLAG_CODEC) */
+    size_t max_count;           /* 255, o sin tope con RLE_FLAG_VARINT */
+    const uint8_t *band;        /* banda RGB original (la que copia RLE_CODEC_STORED) */
+    const uint8_t *src;         /* stream a codificar (planar: planos separados) */
+    size_t len;                 /* bytes del stream */
+    size_t seg;                 /* los runs no cruzan múltiplos de seg */
+    size_t pos;                 /* bytes consumidos hasta ahora */
+    size_t records;             /* registros escritos hasta ahora */
+    /* Variante de RLE_CODEC_RUNS para (unidad, count, kernel), de rle_runs_encoder */
+    size_t (*runs)(struct RLEEncoder *e, uint8_t *out, size_t step);
+} RLEEncoder;
+
+static inline size_t rle_scan_units(const RLEEncoder *e, const uint8_t *p, size_t n) {
+    return e->mode == RLE_MODE_PIXEL ? rle_scan_px_run(e->kernel, p, n)
+                                     : rle_scan_run(e->kernel, p, n);
+}
+
+/*
+ * Registro PackBits desde p (avail bytes hasta el fin del segmento). Una
+ * repetición conviene desde 2 píxeles o 3 bytes; las más cortas quedan
+ * dentro del literal.
+ */
+static inline size_t rle_packbits_next(RLEEncoder *e, const uint8_t *p, size_t avail,
+                                       uint8_t *out) {
+    const size_t unit = e->mode == RLE_MODE_PIXEL ? 3 : 1;
+    const size_t min_rep = unit == 3 ? 2 : 3;
+    size_t units = avail / unit;
+    size_t cap = units < RLE_PACKBITS_MAX ? units : RLE_PACKBITS_MAX;
+
+    size_t run = rle_scan_units(e, p, cap);
+    if (run >= min_rep) {
+        out[0] = (uint8_t)(257 - run);
+        memcpy(out + 1, p, unit);
+        e->pos += run * unit;
+        return 1 + unit;
+    }
+    size_t k = run;
+    while (k < cap) {
+        size_t left = cap - k;
+        size_t r = rle_scan_units(e, p + k * unit, left < min_rep ? left : min_rep);
+        if (r >= min_rep) break;
+        k += r;
+    }
+    out[0] = (uint8_t)(k - 1);
+    memcpy(out + 1, p, k * unit);
+    e->pos += k * unit;
+    return 1 + k * unit;
+}
+
+/* Escribe el siguiente registro en out (<= RLE_MAX_RECORD bytes); 0 = fin */
+static inline size_t rle_encode_next(RLEEncoder *e, uint8_t *out) {
+    if (e->pos >= e->len) return 0;
+    if (e->codec == RLE_CODEC_STORED) {
+        size_t n = e->len - e->pos < RLE_STORED_STEP ? e->len - e->pos : RLE_STORED_STEP;
+        memcpy(out, e->band + e->pos, n);
+        e->pos += n;
+        e->records++;
+        return n;
+    }
+    size_t avail = e->seg - e->pos % e->seg;
+    const uint8_t *p = e->src + e->pos;
+    e->records++;
+
+    if (e->codec == RLE_CODEC_PACKBITS)
+        return rle_packbits_next(e, p, avail, out);
+
+    if (e->mode == RLE_MODE_PIXEL) {
+        size_t npx = avail / 3;
+        size_t count = rle_scan_px_run(e->kernel, p, npx < e->max_count ? npx : e->max_count);
+        size_t n = rle_count_put(e->flags, out, count);
+        out[n] = p[0];
+        out[n + 1] = p[1];
+        out[n + 2] = p[2];
+        e->pos += 3 * count;
+        return n + 3;
+    }
+
+    size_t count = rle_scan_run(e->kernel, p, avail < e->max_count ? avail : e->max_count);
+    size_t n = rle_count_put(e->flags, out, count);
+    out[n] = p[0];
+    e->pos += count;
+    return n + 1;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  VARIANTES ESPECIALIZADAS
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * rle_encode_next decide en cada registro el codec, el modo y el formato
+ * del count, y los runs de 3 o más bytes pasan por el puntero del kernel.
+ * Para RLE_CODEC_RUNS (todas las bandas sin --adaptive, casi todas con)
+ * cada combinación de unidad (1 byte: modos byte y planar; 3: modo pixel),
+ * count (u8 / varint) y kernel tiene su propio bucle, generado por
+ * RLE_RUNS_ENCODER: las tres cosas quedan fijas en compilación y el
+ * escaneo vectorizado se inlinea (la variante AVX2 se compila entera con
+ * target("avx2")). rle_runs_encoder la elige al iniciar la banda
+ * comparando el kernel con los de rle_scan_select, que ya detectó la CPU;
+ * un kernel reemplazado a mano usa la variante "indirecta", que lo llama
+ * por puntero. Todas escriben los mismos registros que rle_encode_next.
+ *
+ * El decoder hace lo mismo por modo y count con RLE_RUNS_DECODER (solo
+ * RGB: con bgr sigue el camino general).
+ */
+
+#define RLE_SCAN_INDIRECT(p, n)     e->kernel->fn(p, n)
+#define RLE_SCAN_PX_INDIRECT(p, n)  e->kernel->fn_px(p, n)
+
+/* Registros de runs hasta consumir step bytes más (o el final), en out */
+#define RLE_RUNS_ENCODER(NAME, ATTR, UNIT, VARINT, SCAN)                               \
+ATTR static size_t NAME(RLEEncoder *e, uint8_t *out, size_t step) {                    \
+    const uint8_t *src = e->src;                                                       \
+    const size_t len = e->len, seg = e->seg, start = e->pos;                           \
+    const size_t max = (VARINT) ? SIZE_MAX : 255;                                      \
+    if (start >= len) return 0;                                                        \
+    size_t pos = start, seg_end = pos - pos % seg + seg, records = 0;                  \
+    uint8_t *o = out;                                                                  \
+    while (pos < len && pos - start < step) {                                          \
+        if (pos == seg_end) seg_end += seg;                                            \
+        const uint8_t *p = src + pos;                                                  \
+        size_t n = (seg_end - pos) / (UNIT), count;                                    \
+        if (n > max) n = max;                                                          \
+        if ((UNIT) == 3)                                                               \
+            count = n < 2 || memcmp(p, p + 3, 3) != 0 ? 1 : SCAN(p, n);               \
+        else                                                                           \
+            count = n < 2 || p[1] != p[0] ? 1 : n < 3 || p[2] != p[0] ? 2 : SCAN(p, n); \
+        if (VARINT) o += rle_varint_put(o, count);                                     \
+        else *o++ = (uint8_t)count;                                                    \
+        memcpy(o, p, (UNIT));                                                          \
+        o += (UNIT);                                                                   \
+        pos += (UNIT) * count;                                                         \
+        records++;                                                                     \
+    }                                                                                  \
+    e->pos = pos;                                                                      \
+    e->records += records;                                                             \
+    return (size_t)(o - out);                                                          \
+}
+
+/* Las cuatro (unidad, count) de un kernel: rle_runs_{b,px}_{u8,var}_<sufijo> */
+#define RLE_RUNS_ENCODERS(SUFFIX, ATTR, SCAN, SCAN_PX)                                 \
+    RLE_RUNS_ENCODER(rle_runs_b_u8_##SUFFIX, ATTR, 1, 0, SCAN)                         \
+    RLE_RUNS_ENCODER(rle_runs_b_var_##SUFFIX, ATTR, 1, 1, SCAN)                        \
+    RLE_RUNS_ENCODER(rle_runs_px_u8_##SUFFIX, ATTR, 3, 0, SCAN_PX)                     \
+    RLE_RUNS_ENCODER(rle_runs_px_var_##SUFFIX, ATTR, 3, 1, SCAN_PX)
+
+RLE_RUNS_ENCODERS(indirect, , RLE_SCAN_INDIRECT, RLE_SCAN_PX_INDIRECT)
+RLE_RUNS_ENCODERS(scalar, , rle_scan_scalar, rle_scan_px_scalar)
+#if defined(RLE_SIMD_X86)
+RLE_RUNS_ENCODERS(sse2, , rle_scan_sse2, rle_scan_px_sse2)
+RLE_RUNS_ENCODERS(avx2, __attribute__((target("avx2"))), rle_scan_avx2, rle_scan_px_avx2)
+#elif defined(RLE_SIMD_NEON)
+RLE_RUNS_ENCODERS(neon, , rle_scan_neon, rle_scan_px_neon)
+#endif
+
+typedef size_t (*rle_runs_fn)(RLEEncoder *e, uint8_t *out, size_t step);
+
+/* Variante para el kernel k; en *simd queda su nombre ("indirecto" si k no es uno conocido) */
+static inline rle_runs_fn rle_runs_encoder(const RLEScanKernel *k, uint8_t mode, uint8_t flags,
+                                           const char **simd) {
+    const int px = mode == RLE_MODE_PIXEL, v = (flags & RLE_FLAG_VARINT) != 0;
+#define RLE_RUNS_PICK(SUFFIX, NAME) do {                                               \
+        if (simd) *simd = NAME;                                                        \
+        return px ? (v ? rle_runs_px_var_##SUFFIX : rle_runs_px_u8_##SUFFIX)           \
+                  : (v ? rle_runs_b_var_##SUFFIX : rle_runs_b_u8_##SUFFIX);            \
+    } while (0)
+#if defined(RLE_SIMD_X86)
+    if (k->fn == rle_scan_avx2 && k->fn_px == rle_scan_px_avx2) RLE_RUNS_PICK(avx2, "AVX2");
+    if (k->fn == rle_scan_sse2 && k->fn_px == rle_scan_px_sse2) RLE_RUNS_PICK(sse2, "SSE2");
+#elif defined(RLE_SIMD_NEON)
+    if (k->fn == rle_scan_neon && k->fn_px == rle_scan_px_neon) RLE_RUNS_PICK(neon, "NEON");
+#endif
+    if (k->fn == rle_scan_scalar && k->fn_px == rle_scan_px_scalar) RLE_RUNS_PICK(scalar, "escalar");
+    RLE_RUNS_PICK(indirect, "indirecto");
+#undef RLE_RUNS_PICK
+}
+
+/*
+ * Nombre de las variantes que corren con (k, mode, flags), para informes y
+ * --bench: "enc <unidad>/<count>/<kernel>, dec <modo>/<count>"; con
+ * RLE_FLAG_CODEC las bandas PackBits / STORED usan el camino general.
+ */
+static inline void rle_variant_name(char *buf, size_t len, const RLEScanKernel *k,
+                                    uint8_t mode, uint8_t flags) {
+    const char *simd = "?";
+    rle_runs_encoder(k, mode, flags, &simd);
+    snprintf(buf, len, "enc %s/%s/%s, dec %s/%s%s", mode == RLE_MODE_PIXEL ? "px24" : "b8",
+             rle_count_name(flags), simd, rle_mode_name(mode), rle_count_name(flags),
+             (flags & RLE_FLAG_CODEC) ? " (+general)" : "");
+}
+
+/*
+ * Codifica registros en out hasta haber consumido al menos step bytes más
+ * del stream, o hasta el final: el equivalente por pasos de llamar a
+ * rle_encode_next en un bucle. La salida es de como mucho
+ * rle_encoded_bound(mode, step) + RLE_MAX_RECORD bytes. Devuelve los bytes
+ * escritos (0 = fin); los registros se suman a e->records.
+ */
+static inline size_t rle_encode_some(RLEEncoder *e, uint8_t *out, size_t step) {
+    if (e->codec == RLE_CODEC_RUNS)
+        return e->runs(e, out, step);
+    const size_t start = e->pos;
+    size_t len = 0, n;
+    while (e->pos - start < step && (n = rle_encode_next(e, out + len)) != 0)
+        len += n;
+    return len;
+}
+
+/* Bytes que produce codec sobre [pos, pos + n) del stream (sin cruzar un segmento) */
+static inline size_t rle_encoder_sample(const RLEEncoder *e, uint8_t codec, size_t pos, size_t n) {
+    RLEEncoder w = *e;
+    w.codec = codec;
+    w.src = e->src + pos;
+    w.len = w.seg = n;
+    w.pos = 0;
+    uint8_t rec[RLE_MAX_RECORD];
+    size_t total = 0, k;
+    while ((k = rle_encode_next(&w, rec)) != 0)
+        total += k;
+    return total;
+}
+
+/*
+ * Codec de la banda según la muestra: hasta RLE_SAMPLE_WINDOWS ventanas de
+ * RLE_SAMPLE_BYTES repartidas por el stream (en planar, dentro de un plano)
+ * codificadas con runs y con PackBits.
+ */
+static inline uint8_t rle_encoder_choose(const RLEEncoder *e) {
+    if (e->len == 0) return RLE_CODEC_RUNS;
+    size_t win = e->seg < RLE_SAMPLE_BYTES ? e->seg : RLE_SAMPLE_BYTES;
+    size_t nwin = e->len / win < RLE_SAMPLE_WINDOWS ? e->len / win : RLE_SAMPLE_WINDOWS;
+    size_t stride = e->len / nwin;
+    size_t sampled = 0, runs = 0, packbits = 0;
+    for (size_t i = 0; i < nwin; i++) {
+        size_t pos = i * stride;
+        if (e->mode == RLE_MODE_PIXEL) pos -= pos % 3;
+        if (pos % e->seg + win > e->seg) pos = pos - pos % e->seg + e->seg - win;
+        runs += rle_encoder_sample(e, RLE_CODEC_RUNS, pos, win);
+        packbits += rle_encoder_sample(e, RLE_CODEC_PACKBITS, pos, win);
+        sampled += win;
+    }
+    size_t best = runs <= packbits ? runs : packbits;
+    if (best >= sampled - sampled / 32) return RLE_CODEC_STORED;
+    return runs <= packbits ? RLE_CODEC_RUNS : RLE_CODEC_PACKBITS;
+}
+
+/*
+ * Prepara la codificación de una banda RGB de band_bytes bytes.
+ * En modo planar, scratch debe tener rle_encoder_scratch_size() bytes: ahí se
+ * separan los planos R, G y B antes de codificar. Con RLE_FLAG_CODEC elige
+ * además el codec de la banda (e->codec, va a RLEChunkEntry.codec).
+ */
+static inline void rle_encoder_init(RLEEncoder *e, const RLEScanKernel *kernel,
+                                    uint8_t mode, uint8_t flags, const uint8_t *band,
+                                    size_t band_bytes, uint8_t *scratch) {
+    e->kernel = kernel;
+    e->mode = mode;
+    e->flags = flags;
+    e->codec = RLE_CODEC_RUNS;
+    e->max_count = (flags & RLE_FLAG_VARINT) ? SIZE_MAX : 255;
+    e->band = band;
+    e->src = band;
+    e->len = band_bytes;
+    e->seg = band_bytes;
+    e->pos = 0;
+    e->records = 0;
+    e->runs = rle_runs_encoder(kernel, mode, flags, NULL);
+    if (mode == RLE_MODE_PLANAR) {
+        size_t npix = band_bytes / 3;
+        for (size_t i = 0; i < npix; i++) {
+            scratch[i]            = band[3 * i];
+            scratch[npix + i]     = band[3 * i + 1];
+            scratch[2 * npix + i] = band[3 * i + 2];
+        }
+        e->src = scratch;
+        e->seg = npix;
+    }
+    if (flags & RLE_FLAG_CODEC)
+        e->codec = rle_encoder_choose(e);
+}
+
+/*
+ * Cierre de una banda de len bytes codificados: con RLE_FLAG_CODEC, si
+ * ocupó más que la banda cruda pasa a RLE_CODEC_STORED y, con dst (el
+ * inicio del chunk), la copia ahí. Devuelve el largo final del chunk.
+ */
+static inline size_t rle_encoder_finish(RLEEncoder *e, uint8_t *dst, size_t len) {
+    if (!(e->flags & RLE_FLAG_CODEC) || e->codec == RLE_CODEC_STORED || len <= e->len)
+        return len;
+    e->codec = RLE_CODEC_STORED;
+    if (dst)
+        memcpy(dst, e->band, e->len);
+    return e->len;
+}
+
+/*
+ * Peor caso del stream codificado de una banda (todos los runs de 1): la
+ * reserva de --alloc bound. Con varint un count c ocupa <= c bytes, así que
+ * la cota sirve para ambos formatos de count; PackBits agrega un byte cada
+ * 128 unidades, también por debajo.
+ */
+static inline size_t rle_encoded_bound(uint8_t mode, size_t band_bytes) {
+    return mode == RLE_MODE_PIXEL ? band_bytes / 3 * 4 : band_bytes * 2;
+}
+
+/*
+ * Primera pasada de --alloc exact: recorre la banda sin escribir y devuelve
+ * los bytes exactos que producirá el encoder. Lo deja rebobinado (en modo
+ * planar los planos ya separados se reutilizan en la segunda pasada) y con
+ * el codec final: si la banda no entra, la segunda pasada ya sale STORED.
+ */
+static inline size_t rle_encoder_measure(RLEEncoder *e) {
+    uint8_t buf[RLE_MEASURE_BUF];
+    const size_t step = (sizeof(buf) - RLE_MAX_RECORD) / 2;    /* cota de 2 bytes por byte */
+    size_t total = 0, n;
+    while ((n = rle_encode_some(e, buf, step)) != 0)
+        total += n;
+    e->pos = 0;
+    e->records = 0;
+    return rle_encoder_finish(e, NULL, total);
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  DECODER
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+typedef struct {
+    uint8_t mode;
+    uint8_t flags;              /* RLE_FLAG_* */
+    uint8_t codec;              /* RLE_CODEC_* del chunk (RLEChunkEntry.codec) */
+    const uint8_t *src;
+    size_t len;                 /* bytes comprimidos del chunk */
+    size_t in;                  /* bytes comprimidos consumidos */
+    uint8_t *dst;               /* banda RGB de destino */
+    size_t out_len;             /* bytes de la banda */
+    size_t out;                 /* bytes escritos (en orden del stream) */
+    int bgr;                    /* 1 = escribir la banda en BGR (listo para el BMP) */
+} RLEDecoder;
+
+static inline void rle_decoder_init(RLEDecoder *d, uint8_t mode, uint8_t flags, uint32_t codec,
+                                    const uint8_t *src, size_t len,
+                                    uint8_t *dst, size_t out_len) {
+    d->mode = mode;
+    d->flags = flags;
+    d->codec = (uint8_t)codec;
+    d->src = src;
+    d->len = len;
+    d->in = 0;
+    d->dst = dst;
+    d->out_len = out_len;
+    d->out = 0;
+    d->bgr = 0;
+}
+
+/*
+ * Run de count bytes del stream RGB desde pos, escrito en BGR: el byte pos
+ * va a pos + 2 - 2 * (pos % 3). Los píxeles completos del run ocupan los
+ * mismos bytes en ambos órdenes (memset); solo los extremos se mueven.
+ */
+static inline void rle_fill_bgr(uint8_t *dst, size_t pos, uint8_t v, size_t count) {
+    size_t end = pos + count;
+    for (; pos < end && pos % 3; pos++)
+        dst[pos + 2 - 2 * (pos % 3)] = v;
+    size_t full = (end - pos) / 3 * 3;
+    memset(dst + pos, v, full);
+    for (pos += full; pos < end; pos++)
+        dst[pos + 2 - 2 * (pos % 3)] = v;
+}
+
+/* Como rle_fill_bgr pero copiando count bytes RGB de src (literales y STORED) */
+static inline void rle_copy_bgr(uint8_t *dst, size_t pos, const uint8_t *src, size_t count) {
+    size_t end = pos + count;
+    for (; pos < end && pos % 3; pos++)
+        dst[pos + 2 - 2 * (pos % 3)] = *src++;
+    for (; end - pos >= 3; pos += 3, src += 3) {
+        dst[pos]     = src[2];
+        dst[pos + 1] = src[1];
+        dst[pos + 2] = src[0];
+    }
+    for (; pos < end; pos++)
+        dst[pos + 2 - 2 * (pos % 3)] = *src++;
+}
+
+/*
+ * Próximo registro de un chunk RUNS o PACKBITS: *val apunta a la primera
+ * unidad y *count son las unidades. Devuelve 1 para una repetición de *val,
+ * 2 para un literal (count unidades seguidas desde *val) y 0 si el registro
+ * está truncado (y deja d->in al final).
+ */
+static inline int rle_record_get(RLEDecoder *d, const uint8_t **val, size_t *count) {
+    const size_t unit = d->mode == RLE_MODE_PIXEL ? 3 : 1;
+    const uint8_t *p = d->src + d->in;
+    const size_t avail = d->len - d->in;
+
+    if (d->codec == RLE_CODEC_PACKBITS) {
+        uint8_t c = p[0];
+        size_t units = c < 128 ? (size_t)c + 1 : c > 128 ? 257 - (size_t)c : 0;
+        size_t need = c < 128 ? units * unit : c > 128 ? unit : 0;     /* 128 = no-op */
+        if (need > avail - 1) {
+            d->in = d->len;
+            return 0;
+        }
+        *val = p + 1;
+        *count = units;
+        d->in += 1 + need;
+        return c < 128 ? 2 : 1;
+    }
+
+    size_t n;
+    if (d->flags & RLE_FLAG_VARINT) {
+        uint64_t v = 0;
+        n = rle_varint_get(p, avail, &v);
+        *count = (size_t)v;
+    } else {
+        n = 1;
+        *count = p[0];
+    }
+    if (n == 0 || unit > avail - n) {
+        d->in = d->len;
+        return 0;
+    }
+    *val = p + n;
+    d->in += n + unit;
+    return 1;
+}
+
+/*
+ * Escribe count unidades en la banda: *val repetido o, con lit, val[0..count).
+ * Lo que excede la banda (o el plano) se recorta.
+ */
+static inline void rle_decode_put(RLEDecoder *d, const uint8_t *val, size_t count, int lit) {
+    if (d->mode == RLE_MODE_PIXEL) {
+        size_t room = (d->out_len - d->out) / 3;
+        if (count > room) count = room;
+        const size_t c0 = d->bgr ? 2 : 0, c2 = 2 - c0;     /* canal del byte 0 y del 2 */
+        uint8_t *o = d->dst + d->out;
+        if (lit) {
+            for (size_t j = 0; j < count; j++, o += 3, val += 3) {
+                o[0] = val[c0];
+                o[1] = val[1];
+                o[2] = val[c2];
+            }
+        } else {
+            for (size_t j = 0; j < count; j++, o += 3) {
+                o[0] = val[c0];
+                o[1] = val[1];
+                o[2] = val[c2];
+            }
+        }
+        d->out += 3 * count;
+    } else if (d->mode == RLE_MODE_PLANAR) {
+        size_t npix = d->out_len / 3;
+        size_t plane = d->out / npix;
+        size_t idx = d->out % npix;
+        if (count > npix - idx) count = npix - idx;
+        uint8_t *o = d->dst + 3 * idx + (d->bgr ? 2 - plane : plane);
+        if (lit) {
+            for (size_t j = 0; j < count; j++, o += 3)
+                *o = val[j];
+        } else {
+            for (size_t j = 0; j < count; j++, o += 3)
+                *o = val[0];
+        }
+        d->out += count;
+    } else {
+        if (count > d->out_len - d->out) count = d->out_len - d->out;
+        if (lit && d->bgr)
+            rle_copy_bgr(d->dst, d->out, val, count);
+        else if (lit)
+            memcpy(d->dst + d->out, val, count);
+        else if (d->bgr)
+            rle_fill_bgr(d->dst, d->out, val[0], count);
+        else
+            memset(d->dst + d->out, val[0], count);
+        d->out += count;
+    }
+}
+
+/* Run de count píxeles iguales a val[0..3): el primero y después memcpy duplicando */
+static inline void rle_fill_px(uint8_t *o, const uint8_t *val, size_t count) {
+    if (count == 0) return;
+    memcpy(o, val, 3);
+    for (size_t done = 3, total = 3 * count; done < total; ) {
+        size_t n = done < total - done ? done : total - done;
+        memcpy(o + done, o, n);
+        done += n;
+    }
+}
+
+/* rle_decode_some de un chunk RLE_CODEC_RUNS en RGB con el modo y el count fijos */
+#define RLE_RUNS_DECODER(NAME, MODE, VARINT)                                           \
+static size_t NAME(RLEDecoder *d, size_t step) {                                       \
+    const uint8_t *src = d->src;                                                       \
+    uint8_t *dst = d->dst;                                                             \
+    const size_t len = d->len, out_len = d->out_len, start = d->out;                   \
+    const size_t unit = (MODE) == RLE_MODE_PIXEL ? 3 : 1, npix = out_len / 3;          \
+    size_t in = d->in, out = start;                                                    \
+    while (out - start < step && in < len && out < out_len) {                          \
+        size_t count, n;                                                               \
+        if (VARINT) {                                                                  \
+            uint64_t v = 0;                                                            \
+            n = rle_varint_get(src + in, len - in, &v);                                \
+            count = (size_t)v;                                                         \
+        } else {                                                                       \
+            n = 1;                                                                     \
+            count = src[in];                                                           \
+        }                                                                              \
+        if (n == 0 || unit > len - in - n) {    /* registro truncado */                \
+            in = len;                                                                  \
+            break;                                                                     \
+        }                                                                              \
+        const uint8_t *val = src + in + n;                                             \
+        in += n + unit;                                                                \
+        if ((MODE) == RLE_MODE_PIXEL) {                                                \
+            if (count > (out_len - out) / 3) count = (out_len - out) / 3;              \
+            rle_fill_px(dst + out, val, count);                                        \
+            out += 3 * count;                                                          \
+        } else if ((MODE) == RLE_MODE_PLANAR) {                                        \
+            size_t plane = out / npix, idx = out - plane * npix;                       \
+            if (count > npix - idx) count = npix - idx;                                \
+            uint8_t *o = dst + 3 * idx + plane;                                        \
+            for (size_t j = 0; j < count; j++, o += 3)                                 \
+                *o = val[0];                                                           \
+            out += count;                                                              \
+        } else {                                                                       \
+            if (count > out_len - out) count = out_len - out;                          \
+            memset(dst + out, val[0], count);                                          \
+            out += count;                                                              \
+        }                                                                              \
+    }                                                                                  \
+    d->in = in;                                                                        \
+    d->out = out;                                                                      \
+    return out - start;                                                                \
+}
+
+RLE_RUNS_DECODER(rle_runs_dec_byte_u8, RLE_MODE_BYTE, 0)
+RLE_RUNS_DECODER(rle_runs_dec_byte_var, RLE_MODE_BYTE, 1)
+RLE_RUNS_DECODER(rle_runs_dec_pixel_u8, RLE_MODE_PIXEL, 0)
+RLE_RUNS_DECODER(rle_runs_dec_pixel_var, RLE_MODE_PIXEL, 1)
+RLE_RUNS_DECODER(rle_runs_dec_planar_u8, RLE_MODE_PLANAR, 0)
+RLE_RUNS_DECODER(rle_runs_dec_planar_var, RLE_MODE_PLANAR, 1)
+
+/*
+ * Decodifica registros hasta haber escrito al menos `step` bytes más, o hasta
+ * agotar la entrada o la banda. Devuelve los bytes escritos en esta llamada
+ * (0 = terminado). Los runs que exceden la banda se recortan.
+ */
+static inline size_t rle_decode_some(RLEDecoder *d, size_t step) {
+    const size_t start = d->out;
+
+    if (d->codec == RLE_CODEC_RUNS && !d->bgr) {
+        const int v = (d->flags & RLE_FLAG_VARINT) != 0;
+        if (d->mode == RLE_MODE_PIXEL)
+            return v ? rle_runs_dec_pixel_var(d, step) : rle_runs_dec_pixel_u8(d, step);
+        if (d->mode == RLE_MODE_PLANAR)
+            return v ? rle_runs_dec_planar_var(d, step) : rle_runs_dec_planar_u8(d, step);
+        return v ? rle_runs_dec_byte_var(d, step) : rle_runs_dec_byte_u8(d, step);
+    }
+
+    if (d->codec == RLE_CODEC_STORED) {
+        size_t n = d->len - d->in < d->out_len - d->out ? d->len - d->in : d->out_len - d->out;
+        if (n > step) n = step;
+        if (d->bgr)
+            rle_copy_bgr(d->dst, d->out, d->src + d->in, n);
+        else
+            memcpy(d->dst + d->out, d->src + d->in, n);
+        d->in += n;
+        d->out += n;
+        return n;
+    }
+
+    while (d->out - start < step && d->in < d->len && d->out < d->out_len) {
+        const uint8_t *val;
+        size_t count;
+        int kind = rle_record_get(d, &val, &count);
+        if (kind == 0) break;                   /* registro truncado */
+        rle_decode_put(d, val, count, kind == 2);
+    }
+    return d->out - start;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  VERIFICACIÓN SIN MATERIALIZAR (--verify stream)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+typedef struct {
+    RLEDecoder     d;           /* estado del stream (d.dst no se usa) */
+    const uint8_t *expect;      /* banda RGB original */
+    size_t         mismatch;    /* primer byte distinto de la banda (SIZE_MAX = ninguno) */
+} RLEVerifier;
+
+static inline void rle_verifier_init(RLEVerifier *v, uint8_t mode, uint8_t flags, uint32_t codec,
+                                     const uint8_t *src, size_t len,
+                                     const uint8_t *expect, size_t band) {
+    rle_decoder_init(&v->d, mode, flags, codec, src, len, NULL, band);
+    v->expect = expect;
+    v->mismatch = SIZE_MAX;
+}
+
+/* Posición en la banda del byte número pos del stream (planar: plano a plano) */
+static inline size_t rle_verify_band_offset(const RLEDecoder *d, size_t pos) {
+    if (d->mode != RLE_MODE_PLANAR || d->codec == RLE_CODEC_STORED) return pos;
+    size_t npix = d->out_len / 3;
+    return 3 * (pos % npix) + pos / npix;
+}
+
+/* Primer byte distinto entre a y b (n si son iguales); solo se llama tras un memcmp fallido */
+static inline size_t rle_first_diff(const uint8_t *a, const uint8_t *b, size_t n) {
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) i++;
+    return i;
+}
+
+/*
+ * Compara count unidades (como rle_decode_put) con la banda original.
+ * Devuelve 0 si coinciden, o 1 con el primer byte distinto en v->mismatch.
+ */
+static inline int rle_verify_put(RLEVerifier *v, const uint8_t *val, size_t count, int lit) {
+    RLEDecoder *d = &v->d;
+    if (d->mode == RLE_MODE_PIXEL) {
+        size_t room = (d->out_len - d->out) / 3;
+        if (count > room) count = room;
+        const uint8_t *e = v->expect + d->out;
+        if (lit) {
+            if (memcmp(e, val, 3 * count) != 0) {
+                v->mismatch = d->out + rle_first_diff(e, val, 3 * count);
+                return 1;
+            }
+        } else if (count > 0 && (memcmp(e, val, 3) != 0 ||
+                                 memcmp(e, e + 3, 3 * (count - 1)) != 0)) {
+            /* Primer píxel igual al valor y cada píxel igual al anterior */
+            size_t j = 0;
+            while (e[j] == val[j % 3]) j++;
+            v->mismatch = d->out + j;
+            return 1;
+        }
+        d->out += 3 * count;
+    } else if (d->mode == RLE_MODE_PLANAR) {
+        size_t npix = d->out_len / 3;
+        size_t plane = d->out / npix;
+        size_t idx = d->out % npix;
+        if (count > npix - idx) count = npix - idx;
+        const uint8_t *e = v->expect + 3 * idx + plane;
+        for (size_t j = 0; j < count; j++, e += 3) {
+            if (*e != val[lit ? j : 0]) {
+                v->mismatch = 3 * (idx + j) + plane;
+                return 1;
+            }
+        }
+        d->out += count;
+    } else {
+        if (count > d->out_len - d->out) count = d->out_len - d->out;
+        const uint8_t *e = v->expect + d->out;
+        if (lit) {
+            if (memcmp(e, val, count) != 0) {
+                v->mismatch = d->out + rle_first_diff(e, val, count);
+                return 1;
+            }
+        } else if (count > 0 && (e[0] != val[0] || memcmp(e, e + 1, count - 1) != 0)) {
+            size_t j = 0;
+            while (e[j] == val[0]) j++;
+            v->mismatch = d->out + j;
+            return 1;
+        }
+        d->out += count;
+    }
+    return 0;
+}
+
+/*
+ * Como rle_decode_some, pero compara cada run con la banda original en lugar
+ * de escribirlo. Devuelve los bytes comparados (0 = terminado o distinto);
+ * en el primer byte que no coincide se detiene y lo deja en v->mismatch. Un
+ * stream que no llega a cubrir la banda también cuenta como distinto.
+ */
+static inline size_t rle_verify_some(RLEVerifier *v, size_t step) {
+    RLEDecoder *d = &v->d;
+    if (v->mismatch != SIZE_MAX) return 0;
+    const size_t start = d->out;
+
+    if (d->codec == RLE_CODEC_STORED) {
+        size_t n = d->len - d->in < d->out_len - d->out ? d->len - d->in : d->out_len - d->out;
+        if (n > step) n = step;
+        const uint8_t *e = v->expect + d->out, *r = d->src + d->in;
+        if (memcmp(e, r, n) != 0) {
+            v->mismatch = d->out + rle_first_diff(e, r, n);
+            return 0;
+        }
+        d->in += n;
+        d->out += n;
+    }
+
+    while (d->codec != RLE_CODEC_STORED &&
+           d->out - start < step && d->in < d->len && d->out < d->out_len) {
+        const uint8_t *val;
+        size_t count;
+        int kind = rle_record_get(d, &val, &count);
+        if (kind == 0) break;                   /* registro truncado */
+        if (rle_verify_put(v, val, count, kind == 2) != 0) return 0;
+    }
+    if (d->in >= d->len && d->out < d->out_len) {
+        v->mismatch = rle_verify_band_offset(d, d->out);
+        return 0;
+    }
+    return d->out - start;
+}
+
+/* Decodifica un chunk completo; devuelve los bytes escritos en dst */
+static inline size_t rle_decode_chunk(uint8_t mode, uint8_t flags, uint32_t codec,
+                                      const uint8_t *src, size_t len,
+                                      uint8_t *dst, size_t out_len) {
+    RLEDecoder d;
+    rle_decoder_init(&d, mode, flags, codec, src, len, dst, out_len);
+    while (rle_decode_some(&d, SIZE_MAX) != 0) {}
+    return d.out;
+}
+
+#endif /* RLE_CODEC_H */
@@ -0,0 +1,548 @@
+/*
+ * ============================================================================
+ *  rle_format.h — Contenedor .rle indexado por chunks (compartido)
+ *
+ *  Lo incluyen rle_secuencial.c y rle_paralelo.c para que ambos programas
+ *  escriban y lean exactamente el mismo formato.
+ *
+ *  Formato v1 (little-endian, igual que el header {width,height} original):
+ *
+ *    Offset 0    RLEFileHeader            32 bytes
+ *    Offset 32   RLEChunkEntry × N        40 bytes cada una (tabla de chunks)
+ *    Offset ...  datos chunk 0, chunk 1, ... (runs RLE)
+ *
+ *  Cada chunk es una banda de filas completas [start_row, start_row+num_rows)
+ *  y se decodifica de forma independiente: los runs nunca cruzan el borde de
+ *  una banda. Con la tabla se puede saltar directo a una banda (acceso
+ *  aleatorio) o repartir la descompresión entre varios hilos.
+ *
+ *  Formato legado (sin índice, versiones anteriores del proyecto):
+ *
+ *    [width u32][height u32][runs (count, valor)...]
+ *
+ *  rle_container_open() acepta ambos; el legado se expone como 1 solo chunk.
+ * ============================================================================
+ */
+
+#ifndef RLE_FORMAT_H
+#define RLE_FORMAT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define RLE_MAGIC           "RLEC"
+#define RLE_FORMAT_VERSION  1
+
+/* Codificación de los runs (byte "mode" del header, ver rle_codec.h) */
+#define RLE_MODE_BYTE       0   /* (count u8, valor u8) sobre el stream RGB intercalado */
+#define RLE_MODE_PIXEL      1   /* (count u8, R, G, B) sobre píxeles completos */
+#define RLE_MODE_PLANAR     2   /* (count u8, valor u8) sobre los planos R, G, B de la banda */
+#define RLE_MODE_COUNT      3
+
+/* Bits del byte "flags" del header */
+#define RLE_FLAG_VARINT     0x01    /* count en LEB128 en lugar de u8 (sin tope de 255) */
+#define RLE_FLAG_RAW_CRC    0x02    /* raw_checksum de cada chunk: CRC32C de la banda RGB */
+#define RLE_FLAG_CODEC      0x04    /* codec propio por chunk en RLEChunkEntry.codec (--adaptive) */
+#define RLE_FLAGS_KNOWN     (RLE_FLAG_VARINT | RLE_FLAG_RAW_CRC | RLE_FLAG_CODEC)
+
+/* Codec de un chunk (RLEChunkEntry.codec, ver rle_codec.h); sin RLE_FLAG_CODEC siempre RUNS */
+#define RLE_CODEC_RUNS      0   /* registros (count, valor) del modo del header */
+#define RLE_CODEC_PACKBITS  1   /* PackBits: literales de hasta 128 unidades y repeticiones */
+#define RLE_CODEC_STORED    2   /* la banda RGB tal cual: decodificar es un memcpy */
+#define RLE_CODEC_COUNT     3
+
+typedef struct {
+    char     magic[4];          /* "RLEC" */
+    uint16_t version;           /* RLE_FORMAT_VERSION */
+    uint8_t  mode;              /* RLE_MODE_* */
+    uint8_t  flags;             /* RLE_FLAG_* */
+    uint32_t width;
+    uint32_t height;
+    uint32_t num_chunks;
+    uint32_t reserved;
+    uint64_t table_offset;      /* offset absoluto de la tabla de chunks */
+} RLEFileHeader;
+
+typedef struct {
+    uint64_t offset;            /* offset absoluto de los datos del chunk */
+    uint64_t length;            /* bytes comprimidos del chunk */
+    uint32_t start_row;         /* primera fila de la banda */
+    uint32_t num_rows;          /* filas de la banda */
+    uint32_t checksum;          /* CRC32C de los bytes comprimidos */
+    uint32_t raw_checksum;      /* RLE_FLAG_RAW_CRC: CRC32C de la banda sin comprimir (si no, 0) */
+    uint32_t codec;             /* RLE_FLAG_CODEC: RLE_CODEC_* del chunk (si no, 0) */
+    uint32_t reserved;          /* reservado para futuras versiones (0) */
+} RLEChunkEntry;
+
+_Static_assert(sizeof(RLEFileHeader) == 32, "RLEFileHeader debe ocupar 32 bytes");
+_Static_assert(sizeof(RLEChunkEntry) == 40, "RLEChunkEntry debe ocupar 40 bytes");
+
+/* Archivo .rle abierto en memoria (contenedor v1 o formato legado) */
+typedef struct {
+    RLEFileHeader  header;
+    RLEChunkEntry *chunks;      /* tabla de chunks (HEAP) */
+    uint8_t       *file_data;   /* archivo completo (HEAP) */
+    size_t         file_size;
+    int            legacy;      /* 1 = formato antiguo {width,height}+runs */
+} RLEContainer;
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  CHECKSUM CRC32C (Castagnoli, polinomio reflejado 0x82F63B78)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static const uint32_t rle_crc32c_table[256] = {
+    0x00000000u, 0xf26b8303u, 0xe13b70f7u, 0x1350f3f4u, 0xc79a971fu, 0x35f1141cu,
+    0x26a1e7e8u, 0xd4ca64ebu, 0x8ad958cfu, 0x78b2dbccu, 0x6be22838u, 0x9989ab3bu,
+    0x4d43cfd0u, 0xbf284cd3u, 0xac78bf27u, 0x5e133c24u, 0x105ec76fu, 0xe235446cu,
+    0xf165b798u, 0x030e349bu, 0xd7c45070u, 0x25afd373u, 0x36ff2087u, 0xc494a384u,
+    0x9a879fa0u, 0x68ec1ca3u, 0x7bbcef57u, 0x89d76c54u, 0x5d1d08bfu, 0xaf768bbcu,
+    0xbc267848u, 0x4e4dfb4bu, 0x20bd8edeu, 0xd2d60dddu, 0xc186fe29u, 0x33ed7d2au,
+    0xe72719c1u, 0x154c9ac2u, 0x061c6936u, 0xf477ea35u, 0xaa64d611u, 0x580f5512u,
+    0x4b5fa6e6u, 0xb93425e5u, 0x6dfe410eu, 0x9f95c20du, 0x8cc531f9u, 0x7eaeb2fau,
+    0x30e349b1u, 0xc288cab2u, 0xd1d83946u, 0x23b3ba45u, 0xf779deaeu, 0x05125dadu,
+    0x1642ae59u, 0xe4292d5au, 0xba3a117eu, 0x4851927du, 0x5b016189u, 0xa96ae28au,
+    0x7da08661u, 0x8fcb0562u, 0x9c9bf696u, 0x6ef07595u, 0x417b1dbcu, 0xb3109ebfu,
+    0xa0406d4bu, 0x522bee48u, 0x86e18aa3u, 0x748a09a0u, 0x67dafa54u, 0x95b17957u,
+    0xcba24573u, 0x39c9c670u, 0x2a993584u, 0xd8f2b687u, 0x0c38d26cu, 0xfe53516fu,
+    0xed03a29bu, 0x1f682198u, 0x5125dad3u, 0xa34e59d0u, 0xb01eaa24u, 0x42752927u,
+    0x96bf4dccu, 0x64d4cecfu, 0x77843d3bu, 0x85efbe38u, 0xdbfc821cu, 0x2997011fu,
+    0x3ac7f2ebu, 0xc8ac71e8u, 0x1c661503u, 0xee0d9600u, 0xfd5d65f4u, 0x0f36e6f7u,
+    0x61c69362u, 0x93ad1061u, 0x80fde395u, 0x72966096u, 0xa65c047du, 0x5437877eu,
+    0x4767748au, 0xb50cf789u, 0xeb1fcbadu, 0x197448aeu, 0x0a24bb5au, 0xf84f3859u,
+    0x2c855cb2u, 0xdeeedfb1u, 0xcdbe2c45u, 0x3fd5af46u, 0x7198540du, 0x83f3d70eu,
+    0x90a324fau, 0x62c8a7f9u, 0xb602c312u, 0x44694011u, 0x5739b3e5u, 0xa55230e6u,
+    0xfb410cc2u, 0x092a8fc1u, 0x1a7a7c35u, 0xe811ff36u, 0x3cdb9bddu, 0xceb018deu,
+    0xdde0eb2au, 0x2f8b6829u, 0x82f63b78u, 0x709db87bu, 0x63cd4b8fu, 0x91a6c88cu,
+    0x456cac67u, 0xb7072f64u, 0xa457dc90u, 0x563c5f93u, 0x082f63b7u, 0xfa44e0b4u,
+    0xe9141340u, 0x1b7f9043u, 0xcfb5f4a8u, 0x3dde77abu, 0x2e8e845fu, 0xdce5075cu,
+    0x92a8fc17u, 0x60c37f14u, 0x73938ce0u, 0x81f80fe3u, 0x55326b08u, 0xa759e80bu,
+    0xb4091bffu, 0x466298fcu, 0x1871a4d8u, 0xea1a27dbu, 0xf94ad42fu, 0x0b21572cu,
+    0xdfeb33c7u, 0x2d80b0c4u, 0x3ed04330u, 0xccbbc033u, 0xa24bb5a6u, 0x502036a5u,
+    0x4370c551u, 0xb11b4652u, 0x65d122b9u, 0x97baa1bau, 0x84ea524eu, 0x7681d14du,
+    0x2892ed69u, 0xdaf96e6au, 0xc9a99d9eu, 0x3bc21e9du, 0xef087a76u, 0x1d63f975u,
+    0x0e330a81u, 0xfc588982u, 0xb21572c9u, 0x407ef1cau, 0x532e023eu, 0xa145813du,
+    0x758fe5d6u, 0x87e466d5u, 0x94b49521u, 0x66df1622u, 0x38cc2a06u, 0xcaa7a905u,
+    0xd9f75af1u, 0x2b9cd9f2u, 0xff56bd19u, 0x0d3d3e1au, 0x1e6dcdeeu, 0xec064eedu,
+    0xc38d26c4u, 0x31e6a5c7u, 0x22b65633u, 0xd0ddd530u, 0x0417b1dbu, 0xf67c32d8u,
+    0xe52cc12cu, 0x1747422fu, 0x49547e0bu, 0xbb3ffd08u, 0xa86f0efcu, 0x5a048dffu,
+    0x8ecee914u, 0x7ca56a17u, 0x6ff599e3u, 0x9d9e1ae0u, 0xd3d3e1abu, 0x21b862a8u,
+    0x32e8915cu, 0xc083125fu, 0x144976b4u, 0xe622f5b7u, 0xf5720643u, 0x07198540u,
+    0x590ab964u, 0xab613a67u, 0xb831c993u, 0x4a5a4a90u, 0x9e902e7bu, 0x6cfbad78u,
+    0x7fab5e8cu, 0x8dc0dd8fu, 0xe330a81au, 0x115b2b19u, 0x020bd8edu, 0xf0605beeu,
+    0x24aa3f05u, 0xd6c1bc06u, 0xc5914ff2u, 0x37faccf1u, 0x69e9f0d5u, 0x9b8273d6u,
+    0x88d28022u, 0x7ab90321u, 0xae7367cau, 0x5c18e4c9u, 0x4f48173du, 0xbd23943eu,
+    0xf36e6f75u, 0x0105ec76u, 0x12551f82u, 0xe03e9c81u, 0x34f4f86au, 0xc69f7b69u,
+    0xd5cf889du, 0x27a40b9eu, 0x79b737bau, 0x8bdcb4b9u, 0x988c474du, 0x6ae7c44eu,
+    0xbe2da0a5u, 0x4c4623a6u, 0x5f16d052u, 0xad7d5351u,
+};
+
+/*
+ * Con SSE4.2 (x86-64) o la extensión CRC de ARMv8 el CRC32C es una
+ * instrucción cada 8 bytes en lugar de una consulta a la tabla por byte:
+ * mismo polinomio, mismo resultado. Importa para RLE_FLAG_RAW_CRC, que
+ * recorre la imagen completa sin comprimir.
+ */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RLE_CRC32C_HW 1
+__attribute__((target("sse4.2")))
+static inline uint32_t rle_crc32c_hw(uint32_t crc, const uint8_t *p, size_t n) {
+    uint64_t c = (uint32_t)~crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = __builtin_ia32_crc32di(c, v);
+    }
+    uint32_t c32 = (uint32_t)c;
+    while (n--)
+        c32 = __builtin_ia32_crc32qi(c32, *p++);
+    return ~c32;
+}
+
+static inline int rle_crc32c_hw_available(void) {
+    static int avail = -1;          /* carrera benigna: todos escriben lo mismo */
+    if (avail < 0) {
+        __builtin_cpu_init();
+        avail = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+    }
+    return avail;
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define RLE_CRC32C_HW 1
+static inline uint32_t rle_crc32c_hw(uint32_t crc, const uint8_t *p, size_t n) {
+    crc = ~crc;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+    }
+    while (n--)
+        crc = __crc32cb(crc, *p++);
+    return ~crc;
+}
+
+static inline int rle_crc32c_hw_available(void) { return 1; }
+#endif
+
+/* crc = 0 para empezar; se puede encadenar sobre varios bloques */
+static inline uint32_t rle_crc32c(uint32_t crc, const void *data, size_t n) {
+    const uint8_t *p = (const uint8_t *)data;
+#ifdef RLE_CRC32C_HW
+    if (rle_crc32c_hw_available())
+        return rle_crc32c_hw(crc, p, n);
+#endif
+    crc = ~crc;
+    while (n--)
+        crc = rle_crc32c_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  REPARTO DE FILAS EN BANDAS
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * Banda i de n: height/n filas, y las primeras height%n bandas llevan una
+ * fila extra. rle_paralelo lo usa para el tramo inicial de tiles de cada
+ * hilo (aplicado sobre el número de tiles en lugar de filas).
+ */
+static inline void rle_band_range(uint32_t height, uint32_t n, uint32_t i,
+                                  uint32_t *start_row, uint32_t *num_rows) {
+    uint32_t rows_per = height / n;
+    uint32_t extra = height % n;
+    *start_row = i * rows_per + (i < extra ? i : extra);
+    *num_rows = rows_per + (i < extra ? 1 : 0);
+}
+
+/* Bytes de píxeles por tile cuando no se indica --tile */
+#define RLE_TILE_BYTES      (256u * 1024u)
+
+/*
+ * Filas por tile: las pedidas con --tile (requested > 0) o las que caben en
+ * RLE_TILE_BYTES, al menos 1. Cada tile es un chunk del contenedor; el
+ * reparto depende solo de la imagen, no del número de cores, así que
+ * rle_secuencial (tiles en orden) y rle_paralelo (tiles con work stealing)
+ * escriben la misma tabla.
+ */
+static inline uint32_t rle_tile_rows(uint32_t width, uint32_t height, uint32_t requested) {
+    uint64_t row_bytes = (uint64_t)width * 3;
+    uint64_t rows = requested > 0 ? requested
+                                  : (row_bytes ? RLE_TILE_BYTES / row_bytes : 1);
+    if (rows < 1) rows = 1;
+    if (rows > height && height > 0) rows = height;
+    return (uint32_t)rows;
+}
+
+static inline uint32_t rle_tile_count(uint32_t height, uint32_t tile_rows) {
+    return (height + tile_rows - 1) / tile_rows;
+}
+
+/* Tile i: tile_rows filas desde i * tile_rows (el último puede ser más bajo) */
+static inline void rle_tile_range(uint32_t height, uint32_t tile_rows, uint32_t i,
+                                  uint32_t *start_row, uint32_t *num_rows) {
+    *start_row = i * tile_rows;
+    *num_rows = height - *start_row < tile_rows ? height - *start_row : tile_rows;
+}
+
+/* Tamaño total del archivo: header + tabla + datos */
+static inline size_t rle_container_size(uint32_t num_chunks, size_t payload) {
+    return sizeof(RLEFileHeader) + (size_t)num_chunks * sizeof(RLEChunkEntry) + payload;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  ESCRITURA DEL CONTENEDOR
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * Rellena el header y completa offset/checksum de cada entrada (los datos de
+ * los chunks van consecutivos tras la tabla). El llamador rellena start_row,
+ * num_rows y length de cada entrada.
+ */
+static inline void rle_header_init(RLEFileHeader *hdr, uint32_t width, uint32_t height,
+                                   uint8_t mode, uint8_t flags, uint32_t num_chunks) {
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, RLE_MAGIC, 4);
+    hdr->version = RLE_FORMAT_VERSION;
+    hdr->mode = mode;
+    hdr->flags = flags;
+    hdr->width = width;
+    hdr->height = height;
+    hdr->num_chunks = num_chunks;
+    hdr->table_offset = sizeof(RLEFileHeader);
+}
+
+static inline void rle_container_fill(RLEFileHeader *hdr, uint32_t width, uint32_t height,
+                                      uint8_t mode, uint8_t flags, RLEChunkEntry *chunks,
+                                      const uint8_t *const *chunk_data,
+                                      uint32_t num_chunks) {
+    rle_header_init(hdr, width, height, mode, flags, num_chunks);
+
+    uint64_t off = rle_container_size(num_chunks, 0);
+    for (uint32_t i = 0; i < num_chunks; i++) {
+        chunks[i].offset = off;
+        chunks[i].checksum = rle_crc32c(0, chunk_data[i], chunks[i].length);
+        chunks[i].reserved = 0;
+        off += chunks[i].length;
+    }
+}
+
+/*
+ * Escribe header + tabla + datos.
+ * Devuelve 0 si todo se escribió, -1 si falló algún fwrite.
+ */
+static inline int rle_container_write(FILE *f, uint32_t width, uint32_t height,
+                                      uint8_t mode, uint8_t flags, RLEChunkEntry *chunks,
+                                      const uint8_t *const *chunk_data,
+                                      uint32_t num_chunks) {
+    RLEFileHeader hdr;
+    rle_container_fill(&hdr, width, height, mode, flags, chunks, chunk_data, num_chunks);
+
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) return -1;
+    if (num_chunks > 0 &&
+        fwrite(chunks, sizeof(RLEChunkEntry), num_chunks, f) != num_chunks) return -1;
+    for (uint32_t i = 0; i < num_chunks; i++) {
+        if (chunks[i].length > 0 &&
+            fwrite(chunk_data[i], 1, chunks[i].length, f) != chunks[i].length) return -1;
+    }
+    return 0;
+}
+
+/*
+ * Arena con el layout final del archivo: el llamador reservó
+ * rle_container_size(n, payload) bytes y los chunks ya están escritos en su
+ * lugar, consecutivos desde rle_container_size(n, 0). Aquí solo se escriben
+ * header y tabla al inicio; después el archivo sale con un único fwrite.
+ */
+static inline void rle_container_finish(uint8_t *arena, uint32_t width, uint32_t height,
+                                        uint8_t mode, uint8_t flags, RLEChunkEntry *chunks,
+                                        const uint8_t *const *chunk_data,
+                                        uint32_t num_chunks) {
+    RLEFileHeader hdr;
+    rle_container_fill(&hdr, width, height, mode, flags, chunks, chunk_data, num_chunks);
+    memcpy(arena, &hdr, sizeof(hdr));
+    memcpy(arena + sizeof(hdr), chunks, (size_t)num_chunks * sizeof(RLEChunkEntry));
+}
+
+/* raw_checksum de un chunk: CRC32C de la banda sin comprimir con RLE_FLAG_RAW_CRC, si no 0 */
+static inline uint32_t rle_raw_checksum(uint8_t flags, const uint8_t *band, size_t n) {
+    return (flags & RLE_FLAG_RAW_CRC) ? rle_crc32c(0, band, n) : 0;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  ESCRITURA INCREMENTAL (--stream, un chunk por strip de filas)
+ *
+ *  El número de strips se conoce de antemano, así que se escribe el hueco de
+ *  header + tabla, los chunks se agregan en orden a medida que se comprimen
+ *  y al final se vuelve al inicio a escribir el header y la tabla ya
+ *  completos. El resultado es un contenedor v1 normal.
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+typedef struct {
+    FILE          *f;
+    RLEChunkEntry *chunks;      /* tabla del llamador (start_row/num_rows ya puestos) */
+    uint32_t       num_chunks;
+    uint32_t       next;        /* próximo chunk a agregar */
+    uint64_t       offset;      /* offset absoluto del próximo chunk */
+} RLEStreamWriter;
+
+static inline int rle_stream_begin(RLEStreamWriter *w, FILE *f, RLEChunkEntry *chunks,
+                                   uint32_t num_chunks) {
+    w->f = f;
+    w->chunks = chunks;
+    w->num_chunks = num_chunks;
+    w->next = 0;
+    w->offset = rle_container_size(num_chunks, 0);
+
+    RLEFileHeader placeholder;
+    memset(&placeholder, 0, sizeof(placeholder));
+    if (fwrite(&placeholder, sizeof(placeholder), 1, f) != 1) return -1;
+    if (num_chunks > 0 &&
+        fwrite(chunks, sizeof(RLEChunkEntry), num_chunks, f) != num_chunks) return -1;
+    return 0;
+}
+
+/*
+ * Agrega el chunk siguiente. checksum = rle_crc32c(0, data, len), calculado
+ * por el llamador (en rle_paralelo fuera de la sección crítica).
+ */
+static inline int rle_stream_append(RLEStreamWriter *w, const uint8_t *data, size_t len,
+                                    uint32_t checksum) {
+    if (w->next >= w->num_chunks) return -1;
+    RLEChunkEntry *e = &w->chunks[w->next++];
+    e->offset = w->offset;
+    e->length = len;
+    e->checksum = checksum;
+    e->reserved = 0;
+    w->offset += len;
+    if (len > 0 && fwrite(data, 1, len, w->f) != len) return -1;
+    return 0;
+}
+
+/* Reescribe header y tabla al inicio; falla si faltan chunks por agregar */
+static inline int rle_stream_end(RLEStreamWriter *w, uint32_t width, uint32_t height,
+                                 uint8_t mode, uint8_t flags) {
+    if (w->next != w->num_chunks) return -1;
+    RLEFileHeader hdr;
+    rle_header_init(&hdr, width, height, mode, flags, w->num_chunks);
+    if (fseek(w->f, 0, SEEK_SET) != 0) return -1;
+    if (fwrite(&hdr, sizeof(hdr), 1, w->f) != 1) return -1;
+    if (w->num_chunks > 0 &&
+        fwrite(w->chunks, sizeof(RLEChunkEntry), w->num_chunks, w->f) != w->num_chunks)
+        return -1;
+    return fflush(w->f) == 0 ? 0 : -1;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  LECTURA DEL CONTENEDOR (v1 y legado)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static inline void rle_container_close(RLEContainer *c) {
+    free(c->chunks);
+    free(c->file_data);
+    memset(c, 0, sizeof(*c));
+}
+
+static inline const uint8_t *rle_chunk_data(const RLEContainer *c, uint32_t i) {
+    return c->file_data + c->chunks[i].offset;
+}
+
+/*
+ * Valida header y tabla contra el tamaño real del archivo sin imprimir nada
+ * (lo usa librle.h): 0, o -1 con el motivo en err.
+ */
+static inline int rle_container_check(const RLEFileHeader *h, const RLEChunkEntry *chunks,
+                                      size_t file_size, char *err, size_t err_len) {
+    if (h->version != RLE_FORMAT_VERSION) {
+        snprintf(err, err_len, "Versión de formato no soportada: %u", h->version);
+        return -1;
+    }
+    if (h->mode >= RLE_MODE_COUNT) {
+        snprintf(err, err_len, "Modo de codificación desconocido: %u", h->mode);
+        return -1;
+    }
+    if (h->flags & ~RLE_FLAGS_KNOWN) {
+        snprintf(err, err_len, "Flags de formato desconocidos: 0x%02x", h->flags);
+        return -1;
+    }
+    uint64_t expected_row = 0;
+    for (uint32_t i = 0; i < h->num_chunks; i++) {
+        const RLEChunkEntry *e = &chunks[i];
+        if (e->offset > file_size || e->length > file_size - e->offset) {
+            snprintf(err, err_len, "Chunk %u fuera de los límites del archivo", i);
+            return -1;
+        }
+        if (e->codec >= RLE_CODEC_COUNT || (e->codec && !(h->flags & RLE_FLAG_CODEC))) {
+            snprintf(err, err_len, "Chunk %u: codec desconocido %u", i, e->codec);
+            return -1;
+        }
+        if (e->start_row != expected_row) {
+            snprintf(err, err_len, "Chunk %u: fila inicial %u, se esperaba %llu",
+                     i, e->start_row, (unsigned long long)expected_row);
+            return -1;
+        }
+        expected_row += e->num_rows;
+    }
+    if (expected_row != h->height) {
+        snprintf(err, err_len, "La tabla de chunks cubre %llu filas de %u",
+                 (unsigned long long)expected_row, h->height);
+        return -1;
+    }
+    return 0;
+}
+
+/* Valida header y tabla contra el tamaño real del archivo */
+static inline int rle_container_validate(const RLEContainer *c) {
+    char err[128];
+    if (rle_container_check(&c->header, c->chunks, c->file_size, err, sizeof(err)) != 0) {
+        fprintf(stderr, "  %s\n", err);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Carga un archivo .rle completo en memoria y deja la tabla de chunks lista.
+ * Si el archivo no empieza con "RLEC" se interpreta como formato legado.
+ * Devuelve 0 o -1 (con mensaje en stderr).
+ */
+static inline int rle_container_open(const char *path, RLEContainer *c) {
+    memset(c, 0, sizeof(*c));
+
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror("fopen rle"); return -1; }
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (fsize < 8) {
+        fprintf(stderr, "  Archivo '%s' demasiado pequeño (%ld bytes)\n", path, fsize);
+        fclose(f);
+        return -1;
+    }
+    c->file_size = (size_t)fsize;
+    c->file_data = malloc(c->file_size);
+    if (!c->file_data) { perror("malloc rle"); fclose(f); return -1; }
+    size_t got = fread(c->file_data, 1, c->file_size, f);
+    fclose(f);
+    if (got != c->file_size) {
+        fprintf(stderr, "  Lectura incompleta de '%s'\n", path);
+        rle_container_close(c);
+        return -1;
+    }
+
+    if (c->file_size >= sizeof(RLEFileHeader) &&
+        memcmp(c->file_data, RLE_MAGIC, 4) == 0) {
+        memcpy(&c->header, c->file_data, sizeof(RLEFileHeader));
+        uint64_t table_bytes = (uint64_t)c->header.num_chunks * sizeof(RLEChunkEntry);
+        if (c->header.table_offset > c->file_size ||
+            table_bytes > c->file_size - c->header.table_offset) {
+            fprintf(stderr, "  Tabla de chunks truncada en '%s'\n", path);
+            rle_container_close(c);
+            return -1;
+        }
+        c->chunks = malloc(table_bytes ? table_bytes : 1);
+        if (!c->chunks) { perror("malloc tabla"); rle_container_close(c); return -1; }
+        memcpy(c->chunks, c->file_data + c->header.table_offset, table_bytes);
+        if (rle_container_validate(c) != 0) {
+            rle_container_close(c);
+            return -1;
+        }
+        return 0;
+    }
+
+    /* Formato legado: {width, height} + runs, sin índice → 1 chunk */
+    uint32_t dims[2];
+    memcpy(dims, c->file_data, sizeof(dims));
+    c->legacy = 1;
+    memcpy(c->header.magic, RLE_MAGIC, 4);
+    c->header.version = RLE_FORMAT_VERSION;
+    c->header.mode = RLE_MODE_BYTE;
+    c->header.width = dims[0];
+    c->header.height = dims[1];
+    c->header.num_chunks = 1;
+    c->chunks = calloc(1, sizeof(RLEChunkEntry));
+    if (!c->chunks) { perror("calloc tabla"); rle_container_close(c); return -1; }
+    c->chunks[0].offset = 8;
+    c->chunks[0].length = c->file_size - 8;
+    c->chunks[0].start_row = 0;
+    c->chunks[0].num_rows = dims[1];
+    c->chunks[0].checksum = rle_crc32c(0, c->file_data + 8, c->file_size - 8);
+    return 0;
+}
+
+/*
+ * Recalcula el CRC32C de cada chunk y lo compara con la tabla.
+ * Devuelve el número de chunks corruptos (0 = archivo íntegro).
+ */
+static inline uint32_t rle_container_verify(const RLEContainer *c) {
+    uint32_t bad = 0;
+    for (uint32_t i = 0; i < c->header.num_chunks; i++) {
+        const RLEChunkEntry *e = &c->chunks[i];
+        if (rle_crc32c(0, rle_chunk_data(c, i), e->length) != e->checksum)
+            bad++;
+    }
+    return bad;
+}
+
+#endif /* RLE_FORMAT_H */
@@ -0,0 +1,263 @@
+/*
+ * ============================================================================
+ *  rle_input.h — Entrada sin copia (mmap) para imágenes PPM y RAW
+ *
+ *  Lo incluyen librle.h (librle_image_load) y, para --stream,
+ *  rle_secuencial.c y rle_paralelo.c. Para formatos que ya guardan RGB de
+ *  8 bits tal cual, no hace falta decodificar con stb_image ni copiar a un
+ *  buffer nuevo: se mapea el archivo y img.data apunta directamente a la
+ *  región de píxeles.
+ *
+ *    PPM binario (P6, maxval 255)   header de texto + RGB intercalado
+ *    RAW (--raw-size WxH)           RGB intercalado sin header (los .raw
+ *                                   que escriben estos mismos programas)
+ *
+ *  Cualquier otro formato (PNG, JPG, BMP en BGR invertido, PPM de 16 bits,
+ *  ...) devuelve 1 y el llamador sigue con stb_image como antes.
+ *
+ *  El mapeo se marca MADV_SEQUENTIAL (lectura hacia adelante) y cada hilo
+ *  pide su banda con rle_input_prefetch() (MADV_WILLNEED) antes de empezar,
+ *  para que el kernel lea por adelantado las páginas de esa banda.
+ *
+ *  Con --stream la imagen no se mapea entera: RLEStripInput lee strips de
+ *  filas con pread() en buffers del llamador, así la memoria del proceso no
+ *  depende del tamaño de la imagen (sirve para archivos más grandes que la RAM).
+ * ============================================================================
+ */
+
+#ifndef RLE_INPUT_H
+#define RLE_INPUT_H
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RLE_INPUT_PPM   1
+#define RLE_INPUT_RAW   2
+
+typedef struct {
+    uint8_t       *map;         /* mmap del archivo completo (NULL = no mapeado) */
+    size_t         map_size;
+    const uint8_t *pixels;      /* RGB dentro del mapeo */
+    uint32_t       width;
+    uint32_t       height;
+    int            format;      /* RLE_INPUT_* */
+} RLEMappedInput;
+
+/* Siguiente entero del header PPM (saltando espacios y comentarios '#') */
+static inline int rle_ppm_field(const uint8_t *p, size_t n, size_t *pos, uint32_t *out) {
+    size_t i = *pos;
+    for (;;) {
+        while (i < n && (p[i] == ' ' || p[i] == '\t' || p[i] == '\r' || p[i] == '\n')) i++;
+        if (i < n && p[i] == '#') {
+            while (i < n && p[i] != '\n') i++;
+            continue;
+        }
+        break;
+    }
+    if (i >= n || p[i] < '0' || p[i] > '9') return -1;
+    uint64_t v = 0;
+    while (i < n && p[i] >= '0' && p[i] <= '9') {
+        v = v * 10 + (uint64_t)(p[i] - '0');
+        if (v > UINT32_MAX) return -1;
+        i++;
+    }
+    *out = (uint32_t)v;
+    *pos = i;
+    return 0;
+}
+
+/*
+ * Devuelve el offset de los píxeles de un PPM P6 de 8 bits, o 0 si el
+ * archivo no tiene esa forma (el llamador usa entonces stb_image).
+ */
+static inline size_t rle_ppm_data_offset(const uint8_t *p, size_t n,
+                                         uint32_t *w, uint32_t *h) {
+    if (n < 3 || p[0] != 'P' || p[1] != '6') return 0;
+    size_t pos = 2;
+    uint32_t maxval;
+    if (rle_ppm_field(p, n, &pos, w) != 0 || rle_ppm_field(p, n, &pos, h) != 0 ||
+        rle_ppm_field(p, n, &pos, &maxval) != 0)
+        return 0;
+    if (maxval != 255 || pos >= n) return 0;
+    return pos + 1;                     /* un solo espacio separa header y datos */
+}
+
+static inline void rle_input_unmap(RLEMappedInput *in) {
+    if (in->map) munmap(in->map, in->map_size);
+    memset(in, 0, sizeof(*in));
+}
+
+/*
+ * Mapea path si es PPM P6 de 8 bits, o RAW cuando raw_w/raw_h > 0.
+ * Devuelve 0 (mapeado, in->pixels listo), 1 (formato no soportado, usar
+ * stb_image) o -1 (error de E/S, con el motivo en err; no imprime nada).
+ */
+static inline int rle_input_map(const char *path, uint32_t raw_w, uint32_t raw_h,
+                                RLEMappedInput *in, char *err, size_t err_len) {
+    memset(in, 0, sizeof(*in));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        snprintf(err, err_len, "open '%s': %s", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        snprintf(err, err_len, "fstat '%s': %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if (st.st_size <= 0) { close(fd); return 1; }
+
+    in->map_size = (size_t)st.st_size;
+    void *m = mmap(NULL, in->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int map_errno = errno;
+    close(fd);
+    if (m == MAP_FAILED) {
+        snprintf(err, err_len, "mmap '%s': %s", path, strerror(map_errno));
+        in->map_size = 0;
+        return -1;
+    }
+    in->map = (uint8_t *)m;
+
+    size_t offset;
+    if (raw_w > 0 && raw_h > 0) {
+        in->width = raw_w;
+        in->height = raw_h;
+        in->format = RLE_INPUT_RAW;
+        offset = 0;
+    } else {
+        offset = rle_ppm_data_offset(in->map, in->map_size, &in->width, &in->height);
+        in->format = RLE_INPUT_PPM;
+        if (offset == 0 || in->width == 0 || in->height == 0) {
+            rle_input_unmap(in);
+            return 1;
+        }
+    }
+
+    size_t need = (size_t)in->width * in->height * 3;
+    size_t have = offset < in->map_size ? in->map_size - offset : 0;
+    if (need > have) {
+        snprintf(err, err_len, "'%s': se esperaban %zu bytes de píxeles (%u x %u RGB), hay %zu",
+                 path, need, in->width, in->height, have);
+        rle_input_unmap(in);
+        return -1;
+    }
+    in->pixels = in->map + offset;
+    madvise(in->map, in->map_size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+/* Pide al kernel las páginas de [p, p + len) por adelantado (banda de un hilo) */
+static inline void rle_input_prefetch(const uint8_t *p, size_t len) {
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)p & ~(page - 1);
+    uintptr_t end = (uintptr_t)p + len;
+    if (end > start)
+        madvise((void *)start, end - start, MADV_WILLNEED);
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  LECTURA POR STRIPS (--stream)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+typedef struct {
+    int      fd;
+    uint64_t data_offset;       /* inicio de los píxeles (tras el header PPM) */
+    uint32_t width;
+    uint32_t height;
+    int      format;            /* RLE_INPUT_* */
+} RLEStripInput;
+
+/* pread() completo (reintenta lecturas parciales); 0 o -1 */
+static inline int rle_pread_full(int fd, void *buf, size_t len, uint64_t off) {
+    uint8_t *p = (uint8_t *)buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)off);
+        if (n <= 0) return -1;
+        p += n;
+        off += (uint64_t)n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static inline void rle_strip_close(RLEStripInput *in) {
+    if (in->fd >= 0) close(in->fd);
+    in->fd = -1;
+}
+
+/*
+ * Abre path para leer por strips: PPM P6 de 8 bits, o RAW con raw_w/raw_h.
+ * Mismos códigos que rle_input_map(): 0, 1 (formato no soportado) o -1.
+ */
+static inline int rle_strip_open(const char *path, uint32_t raw_w, uint32_t raw_h,
+                                 RLEStripInput *in) {
+    memset(in, 0, sizeof(*in));
+    in->fd = open(path, O_RDONLY);
+    if (in->fd < 0) { perror("open"); return -1; }
+    struct stat st;
+    if (fstat(in->fd, &st) != 0) { perror("fstat"); rle_strip_close(in); return -1; }
+    size_t file_size = (size_t)st.st_size;
+
+    if (raw_w > 0 && raw_h > 0) {
+        in->width = raw_w;
+        in->height = raw_h;
+        in->format = RLE_INPUT_RAW;
+    } else {
+        /* El header PPM es texto corto: basta con el primer bloque */
+        uint8_t head[4096];
+        size_t n = file_size < sizeof(head) ? file_size : sizeof(head);
+        if (rle_pread_full(in->fd, head, n, 0) != 0) {
+            perror("pread");
+            rle_strip_close(in);
+            return -1;
+        }
+        in->data_offset = rle_ppm_data_offset(head, n, &in->width, &in->height);
+        in->format = RLE_INPUT_PPM;
+        if (in->data_offset == 0 || in->width == 0 || in->height == 0) {
+            rle_strip_close(in);
+            return 1;
+        }
+    }
+
+    uint64_t need = (uint64_t)in->width * in->height * 3;
+    uint64_t have = in->data_offset < file_size ? file_size - in->data_offset : 0;
+    if (need > have) {
+        fprintf(stderr, "  '%s': se esperaban %llu bytes de píxeles (%u x %u RGB), hay %llu\n",
+                path, (unsigned long long)need, in->width, in->height,
+                (unsigned long long)have);
+        rle_strip_close(in);
+        return -1;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(in->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return 0;
+}
+
+/* Lee las filas [row, row + rows) en dst (rows * width * 3 bytes) */
+static inline int rle_strip_read(const RLEStripInput *in, uint32_t row, uint32_t rows,
+                                 uint8_t *dst) {
+    size_t row_bytes = (size_t)in->width * 3;
+    return rle_pread_full(in->fd, dst, rows * row_bytes,
+                          in->data_offset + (uint64_t)row * row_bytes);
+}
+
+/* Pide al kernel que lea por adelantado las filas [row, row + rows) */
+static inline void rle_strip_readahead(const RLEStripInput *in, uint32_t row, uint32_t rows) {
+#ifdef POSIX_FADV_WILLNEED
+    size_t row_bytes = (size_t)in->width * 3;
+    posix_fadvise(in->fd, (off_t)(in->data_offset + (uint64_t)row * row_bytes),
+                  (off_t)(rows * row_bytes), POSIX_FADV_WILLNEED);
+#else
+    (void)in; (void)row; (void)rows;
+#endif
+}
+
+#endif /* RLE_INPUT_H */
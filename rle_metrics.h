@@ -0,0 +1,383 @@
+/*
+ * ============================================================================
+ *  rle_metrics.h — Métricas en vivo para monitoreo (--metrics-file / --metrics-listen)
+ *
+ *  Lo incluye rle_paralelo.c. Las visualizaciones de SO se imprimen al
+ *  terminar; estas métricas se leen mientras corre un lote (--batch) o el
+ *  servidor (--serve):
+ *
+ *    - Cada hilo de trabajo tiene un RLEMetricsThread en su propia línea de
+ *      caché y es el único que lo escribe: sus "sumas" son load + store
+ *      relaxed, sin instrucciones atómicas de lectura-modificación ni locks.
+ *      Se actualiza una vez por unidad de trabajo (imagen o pedido), no por
+ *      run, así que el costo es un par de clock_gettime por imagen.
+ *    - Un hilo reportero lee los contadores con loads relaxed cada
+ *      intervalo, calcula tasas sobre la ventana (throughput, fracción
+ *      ocupada de cada hilo) y arma el texto en un RLEMetricsText.
+ *
+ *  Formatos: texto de exposición de Prometheus (0.0.4) y un documento JSON.
+ *  Los datos del proceso (RSS, CPU) los pone el llamador en RLEMetricsProc.
+ * ============================================================================
+ */
+
+#ifndef RLE_METRICS_H
+#define RLE_METRICS_H
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rle_progress.h"
+
+#define RLE_METRICS_INTERVAL_MS 1000    /* --metrics-interval por defecto */
+
+/*
+ * Contadores de un hilo. busy_since != 0 mientras el hilo trabaja (ns de
+ * CLOCK_MONOTONIC del inicio del tramo); busy_ns suma los tramos cerrados.
+ * Al cerrar un tramo se limpia busy_since antes de sumar busy_ns (release),
+ * y el lector carga busy_ns (acquire) antes que busy_since: en el peor caso
+ * una lectura pierde el tramo que acaba de cerrarse, nunca lo cuenta dos veces.
+ */
+typedef struct {
+    _Alignas(RLE_CACHE_LINE) atomic_uint_fast64_t busy_ns;
+    atomic_uint_fast64_t busy_since;
+    atomic_uint_fast64_t items;         /* unidades de trabajo de este hilo */
+    atomic_uint_fast64_t bytes_in;
+    atomic_uint_fast64_t bytes_out;
+    const char          *role;          /* "worker", "writer", "executor" */
+} RLEMetricsThread;
+
+_Static_assert(sizeof(RLEMetricsThread) % RLE_CACHE_LINE == 0,
+               "RLEMetricsThread debe ocupar líneas de caché completas");
+
+typedef struct {
+    const char           *kind;         /* "batch" / "serve" */
+    RLEMetricsThread     *threads;      /* rle_cacheline_calloc, uno por hilo */
+    int                   num_threads;
+    uint64_t              t0_ns;
+    uint64_t              items_expected;   /* 0 = sin total conocido (servidor) */
+    uint64_t              queue_cap;
+    atomic_uint_fast64_t  queue_depth;  /* lo actualiza quien encola o desencola */
+    atomic_uint_fast64_t  done;         /* terminados (done y errors solo los escribe */
+    atomic_uint_fast64_t  errors;       /* la última etapa: escritor o ejecutor) */
+    atomic_int            running;
+} RLEMetrics;
+
+/* Lo que el reportero lee del proceso en cada muestra */
+typedef struct {
+    size_t rss_bytes;
+    size_t virtual_bytes;
+    double cpu_user_s;
+    double cpu_sys_s;
+} RLEMetricsProc;
+
+/* Estado del reportero entre muestras (solo lo toca ese hilo) */
+typedef struct {
+    uint64_t  t_ns;
+    uint64_t  bytes_in;
+    uint64_t  items;
+    double    in_bps;               /* bytes de entrada por segundo en la última ventana */
+    double    items_ps;
+    uint64_t *busy_ns;              /* por hilo, al cierre de la ventana anterior */
+    uint64_t *busy_max;             /* por hilo, el mayor busy leído: el contador nunca baja */
+    double   *utilization;          /* fracción ocupada por hilo en la última ventana */
+} RLEMetricsWindow;
+
+static inline uint64_t rle_metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  LADO DE LOS HILOS DE TRABAJO (t = NULL: métricas apagadas)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static inline void rle_metrics_add(atomic_uint_fast64_t *c, uint64_t v) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v,
+                          memory_order_relaxed);
+}
+
+static inline void rle_metrics_begin(RLEMetricsThread *t) {
+    if (t) atomic_store_explicit(&t->busy_since, rle_metrics_now_ns(), memory_order_relaxed);
+}
+
+static inline void rle_metrics_end(RLEMetricsThread *t, uint64_t in, uint64_t out) {
+    if (!t) return;
+    uint64_t since = atomic_load_explicit(&t->busy_since, memory_order_relaxed);
+    uint64_t now = rle_metrics_now_ns();
+    rle_metrics_add(&t->items, 1);
+    rle_metrics_add(&t->bytes_in, in);
+    rle_metrics_add(&t->bytes_out, out);
+    atomic_store_explicit(&t->busy_since, 0, memory_order_relaxed);
+    atomic_store_explicit(&t->busy_ns,
+                          atomic_load_explicit(&t->busy_ns, memory_order_relaxed) +
+                          (since && now > since ? now - since : 0),
+                          memory_order_release);
+}
+
+static inline void rle_metrics_queue(RLEMetrics *m, uint64_t depth) {
+    if (m->threads) atomic_store_explicit(&m->queue_depth, depth, memory_order_relaxed);
+}
+
+/* Una imagen o pedido terminado; la llama siempre el mismo hilo */
+static inline void rle_metrics_done(RLEMetrics *m, int ok) {
+    if (!m->threads) return;
+    rle_metrics_add(&m->done, 1);
+    if (!ok) rle_metrics_add(&m->errors, 1);
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  LADO DEL REPORTERO
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static inline int rle_metrics_init(RLEMetrics *m, const char *kind, int num_threads) {
+    memset(m, 0, sizeof(*m));
+    m->threads = rle_cacheline_calloc((size_t)num_threads, sizeof(RLEMetricsThread));
+    if (!m->threads) return -1;
+    m->kind = kind;
+    m->num_threads = num_threads;
+    m->t0_ns = rle_metrics_now_ns();
+    atomic_init(&m->queue_depth, 0);
+    atomic_init(&m->done, 0);
+    atomic_init(&m->errors, 0);
+    atomic_init(&m->running, 1);
+    for (int i = 0; i < num_threads; i++)
+        m->threads[i].role = "worker";
+    return 0;
+}
+
+static inline void rle_metrics_release(RLEMetrics *m) {
+    free(m->threads);
+    m->threads = NULL;
+}
+
+/* Ocupado acumulado de un hilo hasta now, incluido el tramo en curso */
+static inline uint64_t rle_metrics_busy(const RLEMetricsThread *t, uint64_t now) {
+    uint64_t busy = atomic_load_explicit(&t->busy_ns, memory_order_acquire);
+    uint64_t since = atomic_load_explicit(&t->busy_since, memory_order_relaxed);
+    return busy + (since && now > since ? now - since : 0);
+}
+
+static inline uint64_t rle_metrics_sum(const RLEMetrics *m, size_t offset) {
+    uint64_t sum = 0;
+    for (int i = 0; i < m->num_threads; i++)
+        sum += atomic_load_explicit((const atomic_uint_fast64_t *)((const char *)&m->threads[i] + offset),
+                                    memory_order_relaxed);
+    return sum;
+}
+
+#define RLE_METRICS_SUM(m, field) rle_metrics_sum((m), offsetof(RLEMetricsThread, field))
+
+static inline int rle_metrics_window_init(RLEMetricsWindow *w, const RLEMetrics *m) {
+    memset(w, 0, sizeof(*w));
+    w->busy_ns = calloc((size_t)m->num_threads, sizeof(uint64_t));
+    w->busy_max = calloc((size_t)m->num_threads, sizeof(uint64_t));
+    w->utilization = calloc((size_t)m->num_threads, sizeof(double));
+    if (!w->busy_ns || !w->busy_max || !w->utilization) {
+        free(w->busy_ns);
+        free(w->busy_max);
+        free(w->utilization);
+        return -1;
+    }
+    w->t_ns = m->t0_ns;
+    return 0;
+}
+
+static inline void rle_metrics_window_release(RLEMetricsWindow *w) {
+    free(w->busy_ns);
+    free(w->busy_max);
+    free(w->utilization);
+}
+
+/*
+ * rle_metrics_busy sin retrocesos: una lectura que contó un tramo abierto
+ * puede ir seguida de otra que ya no lo ve (busy_since limpio, busy_ns aún
+ * sin sumar) y da menos. Para el lector el valor se queda en el anterior
+ * hasta que el tramo aparece en busy_ns.
+ */
+static inline uint64_t rle_metrics_window_busy(const RLEMetrics *m, RLEMetricsWindow *w, int i,
+                                               uint64_t now) {
+    uint64_t busy = rle_metrics_busy(&m->threads[i], now);
+    if (busy < w->busy_max[i]) busy = w->busy_max[i];
+    w->busy_max[i] = busy;
+    return busy;
+}
+
+/* Cierra la ventana actual: tasas desde la muestra anterior */
+static inline void rle_metrics_tick(const RLEMetrics *m, RLEMetricsWindow *w) {
+    uint64_t now = rle_metrics_now_ns();
+    double dt = (double)(now - w->t_ns) / 1e9;
+    if (dt <= 0) return;
+    uint64_t in = RLE_METRICS_SUM(m, bytes_in);
+    uint64_t items = atomic_load_explicit(&m->done, memory_order_relaxed);
+    w->in_bps = (double)(in - w->bytes_in) / dt;
+    w->items_ps = (double)(items - w->items) / dt;
+    w->bytes_in = in;
+    w->items = items;
+    for (int i = 0; i < m->num_threads; i++) {
+        uint64_t busy = rle_metrics_window_busy(m, w, i, now);   /* >= busy_ns[i] */
+        double u = (double)(busy - w->busy_ns[i]) / 1e9 / dt;
+        w->utilization[i] = u > 1 ? 1 : u;
+        w->busy_ns[i] = busy;
+    }
+    w->t_ns = now;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  TEXTO DE SALIDA
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/* Texto que crece duplicando; se reutiliza entre muestras (len = 0) */
+typedef struct {
+    char   *buf;
+    size_t  len;
+    size_t  cap;
+    int     failed;
+} RLEMetricsText;
+
+static inline void rle_metrics_printf(RLEMetricsText *t, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static inline void rle_metrics_printf(RLEMetricsText *t, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        size_t room = t->cap - t->len;
+        int n = t->buf ? vsnprintf(t->buf + t->len, room, fmt, ap) : -1;
+        va_end(ap);
+        if (t->buf && n >= 0 && (size_t)n < room) {
+            t->len += (size_t)n;
+            return;
+        }
+        if (t->buf && n < 0) {
+            t->failed = 1;
+            return;
+        }
+        size_t cap = t->cap ? t->cap * 2 : 4096;
+        while (t->buf && cap - t->len <= (size_t)n) cap *= 2;
+        char *p = realloc(t->buf, cap);
+        if (!p) {
+            t->failed = 1;
+            return;
+        }
+        t->buf = p;
+        t->cap = cap;
+    }
+}
+
+static inline void rle_metrics_prom_head(RLEMetricsText *t, const char *name, const char *type,
+                                         const char *help) {
+    rle_metrics_printf(t, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/* Texto de exposición de Prometheus (text/plain; version=0.0.4) */
+static inline void rle_metrics_prometheus(RLEMetricsText *t, const RLEMetrics *m,
+                                          RLEMetricsWindow *w, const RLEMetricsProc *p) {
+    uint64_t now = rle_metrics_now_ns();
+    t->len = 0;
+    rle_metrics_prom_head(t, "rle_info", "gauge", "Programa y tipo de corrida");
+    rle_metrics_printf(t, "rle_info{program=\"rle_paralelo\",kind=\"%s\"} 1\n", m->kind);
+    rle_metrics_prom_head(t, "rle_running", "gauge", "1 mientras la corrida sigue");
+    rle_metrics_printf(t, "rle_running %d\n", atomic_load(&m->running));
+    rle_metrics_prom_head(t, "rle_uptime_seconds", "gauge", "Segundos desde el inicio de la corrida");
+    rle_metrics_printf(t, "rle_uptime_seconds %.3f\n", (double)(now - m->t0_ns) / 1e9);
+    rle_metrics_prom_head(t, "rle_items_total", "counter", "Imágenes o pedidos terminados");
+    rle_metrics_printf(t, "rle_items_total %llu\n",
+                       (unsigned long long)atomic_load_explicit(&m->done, memory_order_relaxed));
+    if (m->items_expected) {
+        rle_metrics_prom_head(t, "rle_items_expected", "gauge", "Imágenes del lote");
+        rle_metrics_printf(t, "rle_items_expected %llu\n", (unsigned long long)m->items_expected);
+    }
+    rle_metrics_prom_head(t, "rle_errors_total", "counter", "Imágenes o pedidos con error");
+    rle_metrics_printf(t, "rle_errors_total %llu\n",
+                       (unsigned long long)atomic_load_explicit(&m->errors, memory_order_relaxed));
+    rle_metrics_prom_head(t, "rle_input_bytes_total", "counter", "Bytes de entrada procesados");
+    rle_metrics_printf(t, "rle_input_bytes_total %llu\n", (unsigned long long)RLE_METRICS_SUM(m, bytes_in));
+    rle_metrics_prom_head(t, "rle_output_bytes_total", "counter", "Bytes de salida producidos");
+    rle_metrics_printf(t, "rle_output_bytes_total %llu\n", (unsigned long long)RLE_METRICS_SUM(m, bytes_out));
+    rle_metrics_prom_head(t, "rle_throughput_bytes_per_second", "gauge",
+                          "Entrada por segundo en el último intervalo");
+    rle_metrics_printf(t, "rle_throughput_bytes_per_second %.1f\n", w->in_bps);
+    rle_metrics_prom_head(t, "rle_queue_depth", "gauge", "Trabajos en cola");
+    rle_metrics_printf(t, "rle_queue_depth %llu\n",
+                       (unsigned long long)atomic_load_explicit(&m->queue_depth, memory_order_relaxed));
+    rle_metrics_prom_head(t, "rle_queue_capacity", "gauge", "Capacidad de la cola");
+    rle_metrics_printf(t, "rle_queue_capacity %llu\n", (unsigned long long)m->queue_cap);
+
+    rle_metrics_prom_head(t, "rle_thread_busy", "gauge", "1 si el hilo está trabajando");
+    for (int i = 0; i < m->num_threads; i++)
+        rle_metrics_printf(t, "rle_thread_busy{thread=\"%d\",role=\"%s\"} %d\n", i, m->threads[i].role,
+                           atomic_load_explicit(&m->threads[i].busy_since, memory_order_relaxed) != 0);
+    rle_metrics_prom_head(t, "rle_thread_busy_seconds_total", "counter", "Tiempo ocupado del hilo");
+    for (int i = 0; i < m->num_threads; i++)
+        rle_metrics_printf(t, "rle_thread_busy_seconds_total{thread=\"%d\",role=\"%s\"} %.6f\n", i,
+                           m->threads[i].role, (double)rle_metrics_window_busy(m, w, i, now) / 1e9);
+    rle_metrics_prom_head(t, "rle_thread_utilization_ratio", "gauge",
+                          "Fracción ocupada del hilo en el último intervalo");
+    for (int i = 0; i < m->num_threads; i++)
+        rle_metrics_printf(t, "rle_thread_utilization_ratio{thread=\"%d\",role=\"%s\"} %.4f\n", i,
+                           m->threads[i].role, w->utilization[i]);
+    rle_metrics_prom_head(t, "rle_thread_items_total", "counter", "Unidades de trabajo del hilo");
+    for (int i = 0; i < m->num_threads; i++)
+        rle_metrics_printf(t, "rle_thread_items_total{thread=\"%d\",role=\"%s\"} %llu\n", i,
+                           m->threads[i].role,
+                           (unsigned long long)atomic_load_explicit(&m->threads[i].items,
+                                                                    memory_order_relaxed));
+
+    rle_metrics_prom_head(t, "process_resident_memory_bytes", "gauge", "RSS del proceso");
+    rle_metrics_printf(t, "process_resident_memory_bytes %zu\n", p->rss_bytes);
+    rle_metrics_prom_head(t, "process_virtual_memory_bytes", "gauge", "Memoria virtual del proceso");
+    rle_metrics_printf(t, "process_virtual_memory_bytes %zu\n", p->virtual_bytes);
+    rle_metrics_prom_head(t, "process_cpu_seconds_total", "counter", "CPU de usuario y de sistema");
+    rle_metrics_printf(t, "process_cpu_seconds_total %.6f\n", p->cpu_user_s + p->cpu_sys_s);
+    rle_metrics_prom_head(t, "rle_cpu_seconds_total", "counter", "CPU del proceso por modo");
+    rle_metrics_printf(t, "rle_cpu_seconds_total{mode=\"user\"} %.6f\n", p->cpu_user_s);
+    rle_metrics_printf(t, "rle_cpu_seconds_total{mode=\"system\"} %.6f\n", p->cpu_sys_s);
+}
+
+/* El mismo contenido como documento JSON */
+static inline void rle_metrics_json(RLEMetricsText *t, const RLEMetrics *m,
+                                    RLEMetricsWindow *w, const RLEMetricsProc *p) {
+    uint64_t now = rle_metrics_now_ns();
+    t->len = 0;
+    rle_metrics_printf(t, "{\n  \"program\": \"rle_paralelo\", \"kind\": \"%s\", \"running\": %s,\n",
+                       m->kind, atomic_load(&m->running) ? "true" : "false");
+    rle_metrics_printf(t, "  \"timestamp\": %lld, \"uptime_s\": %.3f,\n", (long long)time(NULL),
+                       (double)(now - m->t0_ns) / 1e9);
+    rle_metrics_printf(t, "  \"items\": %llu, \"items_expected\": %llu, \"errors\": %llu,\n",
+                       (unsigned long long)atomic_load_explicit(&m->done, memory_order_relaxed),
+                       (unsigned long long)m->items_expected,
+                       (unsigned long long)atomic_load_explicit(&m->errors, memory_order_relaxed));
+    uint64_t in = RLE_METRICS_SUM(m, bytes_in);
+    double up = (double)(now - m->t0_ns) / 1e9;
+    rle_metrics_printf(t, "  \"bytes_in\": %llu, \"bytes_out\": %llu, \"throughput_mbps\": %.2f, "
+                          "\"avg_mbps\": %.2f, \"items_per_s\": %.2f,\n",
+                       (unsigned long long)in, (unsigned long long)RLE_METRICS_SUM(m, bytes_out),
+                       w->in_bps / (1024.0 * 1024.0), up > 0 ? in / (1024.0 * 1024.0) / up : 0.0,
+                       w->items_ps);
+    rle_metrics_printf(t, "  \"queue_depth\": %llu, \"queue_capacity\": %llu,\n",
+                       (unsigned long long)atomic_load_explicit(&m->queue_depth, memory_order_relaxed),
+                       (unsigned long long)m->queue_cap);
+    rle_metrics_printf(t, "  \"rss_bytes\": %zu, \"virtual_bytes\": %zu, \"cpu_user_s\": %.3f, "
+                          "\"cpu_sys_s\": %.3f,\n",
+                       p->rss_bytes, p->virtual_bytes, p->cpu_user_s, p->cpu_sys_s);
+    rle_metrics_printf(t, "  \"threads\": [");
+    for (int i = 0; i < m->num_threads; i++) {
+        const RLEMetricsThread *th = &m->threads[i];
+        rle_metrics_printf(t, "%s\n    {\"thread\": %d, \"role\": \"%s\", \"busy\": %s, \"busy_s\": %.6f, "
+                              "\"utilization\": %.4f, \"items\": %llu}",
+                           i ? "," : "", i, th->role,
+                           atomic_load_explicit(&th->busy_since, memory_order_relaxed) ? "true" : "false",
+                           (double)rle_metrics_window_busy(m, w, i, now) / 1e9, w->utilization[i],
+                           (unsigned long long)atomic_load_explicit(&th->items, memory_order_relaxed));
+    }
+    rle_metrics_printf(t, "\n  ]\n}\n");
+}
+
+#endif /* RLE_METRICS_H */
@@ -14,6 +14,10 @@
  * ============================================================================
  */
 
+#if !defined(__APPLE__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE         /* Linux: sched_getcpu(), malloc_usable_size() */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,7 +30,21 @@
 #include <dirent.h>
 #include <signal.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#ifdef __APPLE__
 #include <malloc/malloc.h>  /* macOS: malloc_size() */
+#else
+#include <malloc.h>         /* Linux: malloc_usable_size() equivale a malloc_size() */
+#include <sched.h>
+#define malloc_size malloc_usable_size
+#endif
 
 #ifdef __APPLE__
 #include <mach/mach.h>
@@ -40,6 +58,48 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+/* Contenedor .rle indexado por chunks (compartido con rle_secuencial.c) */
+#include "rle_format.h"
+
+/* Kernel SIMD de búsqueda de runs (compartido con rle_secuencial.c) */
+#include "rle_simd.h"
+
+/* Codificación por modo: byte / píxel / planar (compartido con rle_secuencial.c) */
+#include "rle_codec.h"
+
+/* Entrada sin copia (mmap) para PPM y RAW (compartido con rle_secuencial.c) */
+#include "rle_input.h"
+
+/* Contadores de progreso alineados a línea de caché (compartido con rle_secuencial.c) */
+#include "rle_progress.h"
+#include "rle_profile.h"
+#include "rle_perf.h"
+#include "rle_bench.h"
+#include "rle_synth.h"
+#include "rle_affinity.h"
+
+/* Caché de chunks por contenido (--chunk-cache, compartida con librle.h) */
+#include "rle_chunk_cache.h"
+
+/* BMP de salida: swizzle vectorizado y escritura por bandas (compartido con rle_secuencial.c) */
+#include "rle_bmp.h"
+
+/* Escritura asíncrona de la salida: io_uring / dispatch_io / pwrite (--aio) */
+#include "rle_aio.h"
+
+/* Protocolo del servidor de compresión (--serve) */
+#include "rle_serve.h"
+
+/* Métricas en vivo para monitoreo (--metrics-file / --metrics-listen) */
+#include "rle_metrics.h"
+
+/* Trace de planificación para Perfetto / chrome://tracing (--trace) */
+#include "rle_trace.h"
+
+/* API reentrante en memoria (compartida con rle_secuencial.c): la implementación va en este .c */
+#define LIBRLE_IMPLEMENTATION
+#include "librle.h"
+
 /* ═══════════════════════════════════════════════════════════════════════════
  *  SEGMENTO DATA: Variables globales (inicializadas y no inicializadas)
  * ═══════════════════════════════════════════════════════════════════════════ */
@@ -47,13 +107,118 @@
 /* Variables en segmento DATA (inicializadas) */
 static int g_initialized_var = 42;
 static const char *g_program_name = "RLE Paralelo";
-static int g_num_threads_config = 8;
+static int g_num_threads_config = -1;         /* --threads N (-1 = un hilo por core online) */
 
 /* Variables en segmento BSS (no inicializadas, se inicializan a 0) */
 static int g_uninitialized_var;
 static size_t g_total_runs_global;
 static atomic_size_t g_total_runs_atomic;
 
+/* Kernel de escaneo de runs elegido al inicio (SIMD o escalar con --scalar) */
+static RLEScanKernel g_scan;
+
+/*
+ * Reserva del buffer de salida de cada hilo (--alloc):
+ *   grow  = estimación inicial + realloc duplicando en librle_buffer_push
+ *   bound = peor caso (rle_encoded_bound) en mmap MAP_NORESERVE: solo se
+ *           tocan (y cuentan como minflt) las páginas realmente escritas
+ *   exact = primera pasada que mide el stream y malloc del tamaño justo
+ *   arena = como exact, pero todos los hilos escriben en un único bloque con
+ *           el layout final del .rle (ver OutputArena)
+ * En bound, exact y arena la capacidad está garantizada y los registros se escriben
+ * directo en el buffer, sin chequeo de capacidad por run.
+ */
+typedef enum { ALLOC_GROW, ALLOC_BOUND, ALLOC_EXACT, ALLOC_ARENA, ALLOC_COUNT } AllocMode;
+static const char *g_alloc_names[ALLOC_COUNT] = { "grow", "bound", "exact", "arena" };
+static AllocMode g_alloc_mode = ALLOC_BOUND;
+
+/* Modo de codificación de los runs (--mode, por defecto byte) */
+static uint8_t g_rle_mode = RLE_MODE_BYTE;
+
+/*
+ * Flags del formato (RLE_FLAG_VARINT con --varint, RLE_FLAG_RAW_CRC con --verify checksum,
+ * RLE_FLAG_CODEC con --adaptive)
+ */
+static uint8_t g_rle_flags = 0;
+
+/* --verify decode|stream|checksum: cómo se comprueba la salida (RLEVerifyMode) */
+static int g_verify = RLE_VERIFY_DECODE;
+static atomic_int g_verify_stop;               /* un hilo encontró una diferencia: los demás cortan */
+static int g_decode_bgr = 0;                   /* --decode-bgr: decodificar en BGR, BMP sin swizzle */
+static int g_rows = 0;                         /* -d ... --rows Y0:Y1: solo esas filas */
+static uint32_t g_rows_y0, g_rows_y1;
+static int g_update = 0;                       /* --update: reescribir solo las bandas cambiadas */
+static int g_use_cache = 0;                    /* --chunk-cache: reusar chunks de bandas idénticas */
+static const char *g_cache_file;               /* --chunk-cache-file: persistir la caché entre corridas */
+static RLEChunkCache g_chunk_cache;
+
+/* Opciones de entrada (la imagen se carga con librle_image_load) */
+static uint32_t g_raw_width, g_raw_height;     /* --raw-size WxH */
+static int g_write_raw = 1;                    /* --no-raw lo desactiva */
+
+/*
+ * --aio sync|uring|dispatch|auto: .raw y .rle salen por rle_aio.h en lugar de
+ * fopen + fwrite. Con --alloc arena cada chunk se envía al terminar su tile,
+ * desde el hilo que lo comprimió; la espera va después de la verificación.
+ */
+static int g_aio_on = 0;
+static RLEAioBackend g_aio_backend = RLE_AIO_AUTO;
+static int g_aio_direct = 0;                   /* --direct: O_DIRECT (macOS: F_NOCACHE) */
+static int g_aio_fsync = 0;                    /* --fsync: fsync en lote antes de terminar */
+static RLEAio g_aio;
+static int g_aio_rle = -1;                     /* índice del .rle en g_aio (-1 = no abierto) */
+
+/*
+ * --metrics-file ARCHIVO / --metrics-listen [HOST:]PUERTO: métricas en vivo de
+ * --batch y --serve (rle_metrics.h), cada --metrics-interval MS.
+ */
+static const char *g_metrics_file;
+static const char *g_metrics_listen;
+static int g_metrics_interval_ms = RLE_METRICS_INTERVAL_MS;
+static RLEMetrics g_metrics;                   /* threads = NULL: apagadas */
+
+/*
+ * --trace ARCHIVO: trace de la compresión de una imagen y de -d (rle_trace.h).
+ * bufs[0] es el hilo principal (carga, E/S y fases); después van los
+ * compresores y los descompresores, cada uno con su tid en el visor.
+ */
+static const char *g_trace_path;
+static struct {
+    RLETraceBuf *bufs;
+    int          num_bufs;
+    int          cap;
+    uint64_t     t0_ns;
+} g_trace;
+
+/* --tile ROWS: filas por tile/chunk (0 = automático, ~RLE_TILE_BYTES por tile) */
+static uint32_t g_tile_rows = 0;
+
+/* --stream ROWS: comprimir por strips de ROWS filas (0 = imagen entera en memoria) */
+static uint32_t g_stream_rows = 0;
+static int g_stream_inflight = 0;              /* --inflight N: strips en vuelo (0 = uno por core) */
+static int g_pipeline = 0;                     /* --pipeline: lector, compresores y escritor solapados */
+static int g_progress_bench = 0;               /* --progress-bench: costo de publicar el progreso */
+static int g_profile_hz = 0;                   /* --profile HZ: muestreo SIGPROF (0 = apagado) */
+static int g_perf = 0;                         /* --perf: contadores de hardware por hilo */
+
+/* Afinidad y NUMA (rle_affinity.h) */
+static RLETopology g_topo;                     /* CPUs permitidas y su nodo, al inicio */
+static RLEAffinity g_affinity = RLE_AFFINITY_NONE;  /* --affinity none|compact|scatter */
+static int g_first_touch = 0;                  /* --first-touch: bandas de entrada en el nodo del hilo */
+static int g_scaling = 0;                      /* --scaling: barrido fuerte y débil de hilos */
+
+/* --bench: corridas medidas sin visualizaciones (rle_bench.h) */
+static int g_bench = 0;
+static int g_bench_iters = 10;                 /* --bench-iters K: corridas que cuentan */
+static int g_bench_warmup = 2;                 /* --bench-warmup W: corridas descartadas */
+static int g_bench_csv = 0;                    /* --bench-csv: CSV en lugar de JSON */
+static const char *g_bench_out;                /* --bench-out ARCHIVO (NULL = stdout) */
+static uint32_t g_bench_width = 2048, g_bench_height = 2048;   /* --bench-size WxH */
+
+/* --synth SPEC: comprimir una imagen del generador (rle_synth.h) en lugar de un archivo */
+static int g_use_synth = 0;
+static RLESynthParams g_synth;
+
 /* ═══════════════════════════════════════════════════════════════════════════
  *  INFRAESTRUCTURA DE SEGUIMIENTO (Phase, Syscall, Heap, Signal, Context)
  * ═══════════════════════════════════════════════════════════════════════════ */
@@ -69,7 +234,8 @@ static SyscallEntry g_syscall_table[32];
 static int g_num_tracked_syscalls = 0;
 
 /* Heap tracking (max 64 entries) */
-typedef struct { void *addr; size_t requested_size; size_t actual_size; const char *label; int freed; } HeapAllocation;
+typedef struct { void *addr; size_t requested_size; size_t actual_size; const char *label; int freed;
+                 size_t initial_size; int resizes; } HeapAllocation;
 static HeapAllocation g_heap_log[64];
 static int g_num_heap_entries = 0;
 
@@ -86,17 +252,11 @@ static long g_baseline_minflt = 0, g_baseline_majflt = 0;
  *  ESTRUCTURAS DE DATOS
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-typedef struct {
-    uint32_t width;
-    uint32_t height;
-    uint8_t *data;
-} Image;
-
-typedef struct {
-    uint8_t *data;
-    size_t size;
-    size_t capacity;
-} Buffer;
+/*
+ * Imagen (RLELibImage) y buffer de salida (RLELibBuffer) son los de
+ * librle.h. Con --alloc arena el buffer de cada hilo envuelve su tramo de
+ * g_arena (librle_buffer_wrap) y no se libera aparte.
+ */
 
 /*
  * ThreadArg: Argumentos y estado de cada hilo de trabajo
@@ -107,10 +267,14 @@ typedef struct {
  *   - Progreso atómico para monitoreo
  *   - Información del sistema (TID, mach_port, stack)
  */
-/* Máximo de muestras del PC (Program Counter) por hilo */
-#define MAX_PC_SAMPLES 256
+/*
+ * Marcas del PC en puntos fijos del hilo (inicio, tras reservar el buffer, fin):
+ * fuera del bucle caliente. Las muestras del PC durante la ejecución las
+ * toma el profiler por SIGPROF (--profile HZ, rle_profile.h).
+ */
+#define MAX_PC_SAMPLES 8
 
-/* Estructura para una muestra del PC/IP y estado del hilo */
+/* Estructura para una marca del PC/IP y estado del hilo */
 typedef struct {
     double     timestamp_ms;   /* Tiempo relativo desde inicio de compresión */
     uintptr_t  pc_addr;        /* Program Counter (dirección de instrucción) */
@@ -132,10 +296,15 @@ typedef struct {
     size_t byte_offset;         /* Offset en bytes desde inicio de img.data */
 
     /* Datos de salida (escritura exclusiva) */
-    Buffer result;
+    RLELibBuffer result;
 
-    /* Progreso atómico (lock-free) */
-    atomic_size_t pixels_done;
+    /*
+     * Progreso atómico (lock-free), publicado cada RLE_PROGRESS_STEP bytes. Al
+     * estar alineado ocupa su propia línea de caché, y ThreadArg queda alineado
+     * y de tamaño múltiplo de la línea: los hilos vecinos del arreglo de args
+     * (rle_cacheline_calloc) no comparten líneas entre sí.
+     */
+    RLEProgress progress;
 
     /* Métricas de CPU por hilo */
     double cpu_time_user;
@@ -145,19 +314,103 @@ typedef struct {
     struct timespec ts_start;       /* Momento en que el hilo inicia */
     struct timespec ts_end;         /* Momento en que el hilo termina */
 
-    /* Muestreo del PC (Program Counter) y core asignado */
+    /* Marcas del PC (Program Counter) y core asignado */
     PCSample pc_samples[MAX_PC_SAMPLES];
     int      num_pc_samples;
+    RLEProfRing *prof;          /* --profile: ring de muestras SIGPROF (NULL = apagado) */
+    RLETraceBuf *trace;         /* --trace: eventos de este hilo (NULL = apagado) */
+    RLEPerfCounters perf;       /* --perf: ciclos, instrucciones, branches, misses */
 
-    /* Referencia al tiempo base (t0 de la compresión) */
+    /* Referencia al tiempo base (t0 de la compresión o descompresión) */
     struct timespec *t0_ref;
 
+    /* Descompresión: chunks asignados y destino dentro de la imagen final */
+    const RLEChunkEntry *dec_chunks;    /* Tabla de chunks (compartida, read-only) */
+    const uint8_t *const *dec_src;      /* Datos comprimidos de cada chunk */
+    uint32_t dec_first;                 /* Primer chunk asignado a este hilo */
+    uint32_t dec_count;                 /* Número de chunks consecutivos */
+    uint8_t *dec_out;                   /* Imagen decodificada (compartida, bandas disjuntas) */
+    uint32_t dec_width;
+    uint8_t dec_mode;                   /* Modo del header (RLE_MODE_*) */
+    uint8_t dec_flags;                  /* Flags del header (RLE_FLAG_*) */
+    size_t dec_bytes;                   /* Bytes escritos (o verificados) por este hilo */
+    const uint8_t *dec_expect;          /* --verify: imagen original contra la que comparar */
+    int dec_bgr;                        /* --decode-bgr: dec_out queda en BGR */
+    uint32_t dec_bad;                   /* chunks que no coinciden (verificación o CRC) */
+    uint32_t dec_bad_chunk;             /* primer chunk distinto */
+    size_t dec_bad_offset;              /* byte distinto en su banda (SIZE_MAX = solo falló el CRC) */
+
+    /* Planificador de tiles: trabajo hecho por el hilo */
+    uint32_t tiles_done;                /* tiles comprimidos por este hilo */
+    uint32_t tiles_stolen;              /* de ellos, robados a otros hilos */
+    int first_tile;                     /* --alloc exact/arena: tiles medidos (-1 = ninguno) */
+    size_t bytes_done;                  /* bytes de entrada comprimidos hasta ahora */
+
+    int core_affinity;          /* Último core observado (-1 si no se conoce) */
+    int pin_cpu;                /* --affinity: CPU a la que se fija al arrancar (-1 = ninguna) */
 #ifdef __APPLE__
     mach_port_t mach_thread;
-    int core_affinity;          /* Último core observado */
 #endif
 } ThreadArg;
 
+/*
+ * Planificador de la compresión: la imagen se corta en tiles de filas
+ * completas (1 tile = 1 chunk del .rle, rle_tile_rows) y cada hilo arranca con
+ * un tramo contiguo de tiles en su deque. El dueño toma tiles por la cabeza,
+ * en orden de filas; al quedarse sin trabajo roba la mitad final del deque
+ * con más tiles pendientes. Como nunca se agregan tareas, cada deque es solo
+ * un rango [head, tail) empaquetado en un uint64_t atómico: tomar y robar son
+ * un CAS cada uno, sin mutex.
+ */
+typedef struct {
+    /* Una línea de caché por deque: los CAS de un hilo no invalidan la del vecino */
+    _Alignas(RLE_CACHE_LINE) _Atomic uint64_t range;   /* head (32 bits bajos) | tail (32 bits altos) */
+} TileDeque;
+
+typedef struct {
+    uint32_t start_row;
+    uint32_t num_rows;
+    int      owner;             /* hilo que lo comprimió */
+    int      next;              /* --alloc exact/arena: siguiente tile del mismo hilo */
+    size_t   offset;            /* en result.data del dueño (arena: offset en el .rle) */
+    size_t   length;            /* bytes comprimidos */
+    uint32_t raw_crc;           /* RLE_FLAG_RAW_CRC: CRC32C de la banda sin comprimir */
+    uint32_t codec;             /* RLE_CODEC_* (--adaptive; exact/arena: el de la medición) */
+} TileTask;
+
+typedef struct {
+    const uint8_t *pixels;      /* img.data */
+    uint32_t       width;
+    uint32_t       tile_rows;
+    uint32_t       num_tiles;
+    TileTask      *tiles;       /* HEAP, en orden de filas */
+    TileDeque     *deques;      /* HEAP, uno por hilo */
+    int            num_threads;
+    int            mapped;      /* entrada mapeada: prefetch de cada tile antes de leerlo */
+} TileScheduler;
+
+static TileScheduler g_sched;
+
+/*
+ * --alloc arena: un solo bloque con el layout final del archivo
+ * (header + tabla + tile 0 + tile 1 ...). Cada hilo mide sus tiles (con robo)
+ * y espera en la barrera; el último en llegar hace la suma de prefijos de los
+ * tamaños en orden de filas, reserva el bloque y despierta al resto, que
+ * escribe cada tile directo en su offset. Después del join el archivo sale
+ * con un único fwrite y la verificación decodifica desde la misma arena.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  ready;
+    int             arrived;
+    int             num_threads;
+    uint8_t        *base;       /* HEAP, rle_container_size(n, payload) bytes */
+    size_t          total;
+} OutputArena;
+
+static OutputArena g_arena = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                               0, 0, NULL, 0 };
+
 /* ═══════════════════════════════════════════════════════════════════════════
  *  INFORMACIÓN DEL SISTEMA OPERATIVO
  * ═══════════════════════════════════════════════════════════════════════════ */
@@ -175,14 +428,17 @@ static void get_memory_info(size_t *rss, size_t *virtual_size) {
         *virtual_size = 0;
     }
 #else
+    *rss = 0;
+    *virtual_size = 0;
     FILE *f = fopen("/proc/self/statm", "r");
     if (f) {
         long virt_pages, res_pages;
-        fscanf(f, "%ld %ld", &virt_pages, &res_pages);
+        if (fscanf(f, "%ld %ld", &virt_pages, &res_pages) == 2) {
+            long page_size = sysconf(_SC_PAGESIZE);
+            *virtual_size = virt_pages * page_size;
+            *rss = res_pages * page_size;
+        }
         fclose(f);
-        long page_size = sysconf(_SC_PAGESIZE);
-        *virtual_size = virt_pages * page_size;
-        *rss = res_pages * page_size;
     }
 #endif
 }
@@ -216,11 +472,17 @@ static void get_process_cpu_times(double *user_s, double *sys_s) {
  *  FUNCIONES AUXILIARES DE SEGUIMIENTO
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-static void track_syscall(const char *name, const char *real_syscall, const char *purpose) {
+/*
+ * Suma count llamadas a la fase indicada. Con --pipeline las etapas corren a
+ * la vez en hilos distintos, así que cada etapa cuenta sus syscalls y el hilo
+ * principal las registra al final en la fase de esa etapa.
+ */
+static void track_syscall_phase(const char *name, const char *real_syscall, const char *purpose,
+                                ProgramPhase phase, int count) {
     for (int i = 0; i < g_num_tracked_syscalls; i++) {
         if (strcmp(g_syscall_table[i].name, name) == 0) {
-            g_syscall_table[i].count_by_phase[g_current_phase]++;
-            g_syscall_table[i].total++;
+            g_syscall_table[i].count_by_phase[phase] += count;
+            g_syscall_table[i].total += count;
             return;
         }
     }
@@ -230,12 +492,16 @@ static void track_syscall(const char *name, const char *real_syscall, const char
         e->real_syscall = real_syscall;
         e->purpose = purpose;
         memset(e->count_by_phase, 0, sizeof(e->count_by_phase));
-        e->count_by_phase[g_current_phase] = 1;
-        e->total = 1;
+        e->count_by_phase[phase] = count;
+        e->total = count;
         g_num_tracked_syscalls++;
     }
 }
 
+static void track_syscall(const char *name, const char *real_syscall, const char *purpose) {
+    track_syscall_phase(name, real_syscall, purpose, g_current_phase, 1);
+}
+
 static void track_heap_alloc(void *addr, size_t requested, const char *label) {
     if (!addr || g_num_heap_entries >= 64) return;
     HeapAllocation *h = &g_heap_log[g_num_heap_entries];
@@ -244,9 +510,39 @@ static void track_heap_alloc(void *addr, size_t requested, const char *label) {
     h->actual_size = malloc_size(addr);
     h->label = label;
     h->freed = 0;
+    h->initial_size = requested;
+    h->resizes = 0;
+    g_num_heap_entries++;
+}
+
+/* Reserva fuera del allocator (mmap): el tamaño real son páginas completas */
+static void track_mapped_alloc(void *addr, size_t requested, const char *label) {
+    if (!addr || g_num_heap_entries >= 64) return;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    HeapAllocation *h = &g_heap_log[g_num_heap_entries];
+    h->addr = addr;
+    h->requested_size = requested;
+    h->actual_size = (requested + page - 1) / page * page;
+    h->label = label;
+    h->freed = 0;
+    h->initial_size = requested;
+    h->resizes = 0;
     g_num_heap_entries++;
 }
 
+/* realloc: la entrada conserva el tamaño inicial para mostrar el antes/después */
+static void track_heap_resize(void *old_addr, void *new_addr, size_t requested) {
+    for (int i = 0; i < g_num_heap_entries; i++) {
+        if (g_heap_log[i].addr == old_addr && !g_heap_log[i].freed) {
+            g_heap_log[i].addr = new_addr;
+            g_heap_log[i].requested_size = requested;
+            g_heap_log[i].actual_size = malloc_size(new_addr);
+            g_heap_log[i].resizes++;
+            return;
+        }
+    }
+}
+
 static void track_heap_free(void *addr) {
     for (int i = 0; i < g_num_heap_entries; i++) {
         if (g_heap_log[i].addr == addr && !g_heap_log[i].freed) {
@@ -256,7 +552,16 @@ static void track_heap_free(void *addr) {
     }
 }
 
+/* --serve: extremo de escritura del pipe que despierta el poll del servidor */
+static volatile sig_atomic_t g_signal_wake = -1;
+
 static void demo_signal_handler(int sig) {
+    if ((sig == SIGINT || sig == SIGTERM) && g_signal_wake >= 0) {
+        int saved = errno;
+        ssize_t r = write(g_signal_wake, "", 1);
+        (void)r;
+        errno = saved;
+    }
     for (int i = 0; i < g_num_signals; i++) {
         if (g_signal_table[i].signum == sig) {
             g_signal_table[i].received_count++;
@@ -301,53 +606,91 @@ static void capture_baseline_ctx(void) {
 }
 
 /* ═══════════════════════════════════════════════════════════════════════════
- *  BUFFER DINÁMICO
+ *  LIBRLE: BUFFERS, CARGA DE IMAGEN Y BMP CON EL SEGUIMIENTO DE ESTE PROGRAMA
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-static void buffer_init(Buffer *buf, size_t cap) {
-    buf->data = malloc(cap);
-    if (!buf->data) { perror("malloc"); exit(1); }
-    buf->size = 0;
-    buf->capacity = cap;
-    track_syscall("malloc", "mmap/sbrk", "Reservar memoria dinamica para buffer");
-    track_heap_alloc(buf->data, cap, "Buffer RLE (por hilo)");
+/*
+ * Los buffers, librle_image_load y librle_bmp_save reportan a las tablas de
+ * syscalls y heap; con --trace, cada tile de librle_encode_chunk va al trace
+ * de su hilo (chunk, puesto en lib_init).
+ */
+static RLELibHooks g_lib_hooks = {
+    .syscall = track_syscall, .heap_alloc = track_heap_alloc, .mapped_alloc = track_mapped_alloc,
+    .heap_resize = track_heap_resize, .heap_free = track_heap_free,
+};
+
+/* Hilo principal: cargar la imagen (stb_image o PPM/RAW mapeados) y escribir el BMP por bandas */
+static RLELib g_lib;
+
+/* Sin memoria para el buffer de salida el programa no puede seguir (como un malloc fallido) */
+static void buffer_check(int rc) {
+    if (rc != RLE_LIB_OK) {
+        fprintf(stderr, "buffer de salida: %s\n", librle_strerror(rc));
+        exit(1);
+    }
 }
 
-static void buffer_push(Buffer *buf, const uint8_t *bytes, size_t n) {
-    while (buf->size + n > buf->capacity) {
-        buf->capacity *= 2;
-        buf->data = realloc(buf->data, buf->capacity);
-        if (!buf->data) { perror("realloc"); exit(1); }
+/*
+ * Barrera de --alloc arena: cuando vuelve, cada tile tiene su offset en la
+ * arena y buf apunta al primer tile del hilo (need = suma de sus tiles).
+ */
+static void arena_buffer_init(RLELibBuffer *buf, ThreadArg *ta, size_t need) {
+    OutputArena *a = &g_arena;
+    pthread_mutex_lock(&a->lock);
+    if (++a->arrived == a->num_threads) {
+        size_t off = rle_container_size(g_sched.num_tiles, 0);
+        for (uint32_t t = 0; t < g_sched.num_tiles; t++) {
+            g_sched.tiles[t].offset = off;
+            off += g_sched.tiles[t].length;
+        }
+        /* --direct: arena alineada como el archivo, así los chunks salen por O_DIRECT */
+        if (g_aio_rle >= 0 && g_aio_direct) {
+            void *p = NULL;
+            a->base = posix_memalign(&p, RLE_AIO_ALIGN, off) == 0 ? p : NULL;
+        } else {
+            a->base = malloc(off);
+        }
+        if (!a->base) { perror("malloc arena"); exit(1); }
+        a->total = off;
+        track_syscall("malloc", "mmap/sbrk", "Reservar arena de salida compartida");
+        track_heap_alloc(a->base, off, "Arena .rle (compartida)");
+        if (g_aio_rle >= 0) {
+            rle_aio_set_size(&g_aio, g_aio_rle, off);
+            rle_aio_register(&g_aio, a->base, off);
+        }
+        pthread_cond_broadcast(&a->ready);
+    } else {
+        while (!a->base)
+            pthread_cond_wait(&a->ready, &a->lock);
     }
-    memcpy(buf->data + buf->size, bytes, n);
-    buf->size += n;
-}
+    pthread_mutex_unlock(&a->lock);
 
-/* ═══════════════════════════════════════════════════════════════════════════
- *  CARGA DE IMAGEN (PNG, JPG, BMP, GIF, TGA, PSD, HDR, PIC via stb_image)
- * ═══════════════════════════════════════════════════════════════════════════ */
+    librle_buffer_wrap(buf, a->base + (ta->first_tile >= 0 ? g_sched.tiles[ta->first_tile].offset
+                                                          : rle_container_size(g_sched.num_tiles, 0)),
+                       need);
+}
 
-static int load_image(const char *path, Image *img) {
-    int w, h, channels;
-    /* stb_image carga en RGB (3 canales) para mayor volumen de datos */
-    uint8_t *pixels = stbi_load(path, &w, &h, &channels, 3);
-    if (!pixels) {
-        fprintf(stderr, "  Error cargando '%s': %s\n", path, stbi_failure_reason());
+/* Carga path con librle_image_load y muestra qué se cargó; -1 con el motivo en stderr */
+static int open_image(const char *path, RLELibImage *img) {
+    if (librle_image_load(&g_lib, img, path, g_raw_width, g_raw_height) != RLE_LIB_OK) {
+        fprintf(stderr, "  %s\n", librle_error(&g_lib));
         return -1;
     }
-    img->width = (uint32_t)w;
-    img->height = (uint32_t)h;
-    img->data = pixels;  /* stb_image usa malloc internamente → datos en HEAP */
-    track_syscall("stbi_load", "open+read+mmap", "Cargar imagen desde disco (stb_image)");
-    track_heap_alloc(pixels, (size_t)w * h * 3, "img.data (pixeles RGB imagen)");
-    printf("\n  \033[32mImagen cargada:\033[0m %s\n", path);
-    printf("    Dimensiones: %d x %d px (%d canales originales → RGB)\n", w, h, channels);
-    printf("    Tamaño datos: %zu bytes (%.2f MB)\n\n",
-           (size_t)w * h * 3, (size_t)w * h * 3 / (1024.0 * 1024.0));
+    size_t bytes = (size_t)img->width * img->height * 3;
+    if (img->input.map) {
+        printf("\n  \033[32mImagen mapeada (sin copia):\033[0m %s\n", path);
+        printf("    Dimensiones: %u x %u px (%s, RGB tal cual en el archivo)\n",
+               img->width, img->height, img->input.format == RLE_INPUT_RAW ? "RAW" : "PPM P6");
+    } else {
+        printf("\n  \033[32mImagen cargada:\033[0m %s\n", path);
+        printf("    Dimensiones: %u x %u px (%d canales originales → RGB)\n",
+               img->width, img->height, img->channels);
+    }
+    printf("    Tamaño datos: %zu bytes (%.2f MB)\n\n", bytes, bytes / (1024.0 * 1024.0));
     return 0;
 }
 
-static void generate_synthetic(Image *img, uint32_t w, uint32_t h) {
+static void generate_synthetic(RLELibImage *img, uint32_t w, uint32_t h) {
     img->width = w;
     img->height = h;
     size_t pixel_bytes = (size_t)w * h * 3;
@@ -370,6 +713,13 @@ static void generate_synthetic(Image *img, uint32_t w, uint32_t h) {
  *  FUNCIÓN DEL HILO DE COMPRESIÓN
  * ═══════════════════════════════════════════════════════════════════════════ */
 
+/* Hilos de trabajo: --threads N, o uno por core online */
+static int worker_threads(void) {
+    if (g_num_threads_config > 0) return g_num_threads_config;
+    int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : n;
+}
+
 /* Obtener el core actual donde ejecuta el hilo (macOS) */
 static int get_current_core(void) {
 #ifdef __APPLE__
@@ -387,9 +737,131 @@ static double ts_relative_ms(const struct timespec *t0, const struct timespec *t
            (t->tv_nsec - t0->tv_nsec) / 1e6;
 }
 
+static void record_pc_sample(ThreadArg *ta, uintptr_t pc, size_t pixels_at);
+static void *rle_thread_func(void *arg);
+
+static inline uint64_t tile_range_pack(uint32_t head, uint32_t tail) {
+    return (uint64_t)tail << 32 | head;
+}
+
+/*
+ * Siguiente tile para el hilo: el próximo de su deque, o si está vacío la
+ * mitad final del deque con más tiles pendientes (el primero de lo robado se
+ * devuelve y el resto queda en el deque propio). -1 = no queda trabajo.
+ */
+static int tile_next(ThreadArg *ta) {
+    TileDeque *own = &g_sched.deques[ta->thread_idx];
+    uint64_t r = atomic_load(&own->range);
+    while ((uint32_t)r < (uint32_t)(r >> 32)) {
+        if (atomic_compare_exchange_weak(&own->range, &r,
+                                         tile_range_pack((uint32_t)r + 1, (uint32_t)(r >> 32))))
+            return (int)(uint32_t)r;
+    }
+
+    for (;;) {
+        int victim = -1;
+        uint32_t best = 0;
+        for (int k = 1; k < g_sched.num_threads; k++) {
+            int v = (ta->thread_idx + k) % g_sched.num_threads;
+            uint64_t vr = atomic_load(&g_sched.deques[v].range);
+            uint32_t head = (uint32_t)vr, tail = (uint32_t)(vr >> 32);
+            if (tail > head && tail - head > best) {
+                best = tail - head;
+                victim = v;
+            }
+        }
+        if (victim < 0) return -1;
+
+        TileDeque *dq = &g_sched.deques[victim];
+        uint64_t vr = atomic_load(&dq->range);
+        uint32_t head = (uint32_t)vr, tail = (uint32_t)(vr >> 32);
+        if (head >= tail) continue;
+        uint32_t take = (tail - head + 1) / 2;
+        if (!atomic_compare_exchange_strong(&dq->range, &vr, tile_range_pack(head, tail - take)))
+            continue;
+        ta->tiles_stolen += take;
+        atomic_store(&own->range, tile_range_pack(tail - take + 1, tail));
+        RLETraceEvent *e = rle_trace_instant(ta->trace, "sched", "robo");
+        rle_trace_arg(e, "victima", victim);
+        rle_trace_arg(e, "tiles", take);
+        rle_trace_arg(e, "primero", tail - take);
+        return (int)(tail - take);
+    }
+}
+
+/* Bytes de entrada de un tile y puntero a su primera fila dentro de img.data */
+static const uint8_t *tile_pixels(const TileTask *tile, size_t *bytes) {
+    size_t row_bytes = (size_t)g_sched.width * 3;
+    *bytes = (size_t)tile->num_rows * row_bytes;
+    return g_sched.pixels + (size_t)tile->start_row * row_bytes;
+}
+
+/*
+ * Comprime el tile t con librle_encode_chunk. Con dst (bound/exact/arena,
+ * capacidad garantizada) los registros van directo ahí; sin dst (grow) se
+ * agregan a out. Publica el progreso contando los bytes de todas las tiles
+ * del hilo.
+ */
+static size_t compress_tile(ThreadArg *ta, int t, uint8_t *scratch, RLELibBuffer *out, uint8_t *dst) {
+    TileTask *tile = &g_sched.tiles[t];
+    size_t bytes;
+    const uint8_t *src = tile_pixels(tile, &bytes);
+    if (g_sched.mapped)
+        rle_input_prefetch(src, bytes);
+
+    /* exact/arena: la capacidad medida es la del codec de la medición */
+    int measured = g_alloc_mode == ALLOC_EXACT || g_alloc_mode == ALLOC_ARENA;
+    RLELibChunk c = {
+        .band = src, .bytes = bytes, .scratch = scratch, .dst = dst, .out = out,
+        .codec = measured ? (int)tile->codec : -1,
+        .progress = &ta->progress, .in_base = ta->bytes_done, .out_base = out->size,
+        .ctx = ta, .index = (uint32_t)t,
+    };
+    buffer_check(librle_encode_chunk(&g_lib, &c));
+    ta->bytes_done += bytes;
+    tile->owner = ta->thread_idx;
+    tile->length = c.entry.length;
+    tile->codec = c.entry.codec;
+    tile->raw_crc = c.entry.raw_checksum;
+    ta->tiles_done++;
+    return c.entry.length;
+}
+
+/* --trace (hooks->chunk de g_lib): tramo de un tile y cambios de contexto del hilo */
+static void trace_chunk(void *ctx, const RLELibChunk *c, int measured, uint64_t t0, uint64_t t1) {
+    ThreadArg *ta = (ThreadArg *)ctx;
+    if (!ta || !ta->trace) return;
+    RLETraceEvent *e = rle_trace_span(ta->trace, "compress", measured ? "medir" : "tile", t0, t1);
+    rle_trace_arg(e, "tile", c->index);
+    rle_trace_arg(e, "bytes_in", (int64_t)c->bytes);
+    rle_trace_arg(e, "bytes_out", (int64_t)c->entry.length);
+    rle_trace_arg(e, "codec", c->entry.codec);
+    rle_trace_ctxsw(ta->trace);
+}
+
+static void lib_init(void) {
+    RLELibConfig cfg;
+    librle_config_default(&cfg);
+    cfg.backend = RLE_LIB_THREADS;
+    cfg.threads = worker_threads();
+    cfg.mode = g_rle_mode;
+    cfg.flags = g_rle_flags;
+    librle_init(&g_lib, &cfg);
+    g_lib.kernel = g_scan;
+    g_lib.cache = g_use_cache ? &g_chunk_cache : NULL;
+    /* Sin --trace el hook queda NULL y librle no lee la hora por tile */
+    if (g_trace_path)
+        g_lib_hooks.chunk = trace_chunk;
+    g_lib.hooks = &g_lib_hooks;
+}
+
 static void *rle_thread_func(void *arg) {
     ThreadArg *ta = (ThreadArg *)arg;
 
+    /* --affinity: fijar la CPU antes de tocar memoria (first touch en el nodo local) */
+    if (rle_affinity_pin_self(ta->pin_cpu) != 0)
+        ta->pin_cpu = -1;
+
     /* Capturar información del hilo */
     int stack_var = 0;  /* Variable local para obtener dirección del stack */
     ta->stack_addr = &stack_var;
@@ -403,91 +875,123 @@ static void *rle_thread_func(void *arg) {
     ta->core_affinity = ta->thread_idx % (int)sysconf(_SC_NPROCESSORS_ONLN);
 #else
     ta->system_tid = (uint64_t)pthread_self();
+    ta->core_affinity = get_current_core();
 #endif
 
     /* Registrar inicio del hilo */
     clock_gettime(CLOCK_MONOTONIC, &ta->ts_start);
-
-    /* === MUESTRA PC #0: Inicio del hilo (antes de buffer_init) === */
-    if (ta->num_pc_samples < MAX_PC_SAMPLES) {
-        struct timespec now;
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        ta->pc_samples[ta->num_pc_samples] = (PCSample){
-            .timestamp_ms = ts_relative_ms(ta->t0_ref, &now),
-            .pc_addr = (uintptr_t)rle_thread_func,  /* PC: inicio de función */
-            .core_id = get_current_core(),
-            .pixels_at = 0
-        };
-        ta->num_pc_samples++;
+    if (ta->prof)
+        rle_prof_thread_start(ta->prof, &ta->progress);
+    if (g_perf)
+        rle_perf_start(&ta->perf);
+    rle_trace_ctxsw(ta->trace);
+
+    /* === MARCA PC #0: Inicio del hilo (antes de reservar el buffer) === */
+    record_pc_sample(ta, (uintptr_t)rle_thread_func, 0);
+
+    /* Modo planar: planos R, G, B del tile más alto */
+    uint8_t *scratch = NULL;
+    size_t scratch_size = rle_encoder_scratch_size(g_rle_mode,
+                                                   (size_t)g_sched.tile_rows * g_sched.width * 3);
+    if (scratch_size > 0) {
+        scratch = malloc(scratch_size);
+        if (!scratch) { perror("malloc"); exit(1); }
+        track_heap_alloc(scratch, scratch_size, "Planos RGB (modo planar, por hilo)");
     }
 
-    /* Inicializar buffer de salida */
-    buffer_init(&ta->result, ta->num_pixels * 2 / 2 + 256);
-
-    /* === MUESTRA PC #1: Después de buffer_init === */
-    if (ta->num_pc_samples < MAX_PC_SAMPLES) {
-        struct timespec now;
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        ta->pc_samples[ta->num_pc_samples] = (PCSample){
-            .timestamp_ms = ts_relative_ms(ta->t0_ref, &now),
-            .pc_addr = (uintptr_t)buffer_init,
-            .core_id = get_current_core(),
-            .pixels_at = 0
-        };
-        ta->num_pc_samples++;
+    ta->bytes_done = 0;
+
+    int t;
+    if (g_alloc_mode == ALLOC_EXACT || g_alloc_mode == ALLOC_ARENA) {
+        /*
+         * Primera pasada: medir tiles (con robo). Al vaciarse los deques el
+         * conjunto de tiles del hilo ya no cambia, y la segunda pasada
+         * comprime exactamente esas tiles en la capacidad medida.
+         */
+        size_t need = 0;
+        int *link = &ta->first_tile;
+        while ((t = tile_next(ta)) >= 0) {
+            TileTask *tile = &g_sched.tiles[t];
+            size_t bytes;
+            const uint8_t *src = tile_pixels(tile, &bytes);
+            RLELibChunk c = { .band = src, .bytes = bytes, .scratch = scratch,
+                              .ctx = ta, .index = (uint32_t)t };
+            tile->length = librle_measure_chunk(&g_lib, &c);
+            tile->codec = c.entry.codec;
+            tile->owner = ta->thread_idx;
+            tile->next = -1;
+            *link = t;
+            link = &tile->next;
+            need += tile->length;
+        }
+        *link = -1;
+        if (g_alloc_mode == ALLOC_ARENA)
+            arena_buffer_init(&ta->result, ta, need);
+        else
+            buffer_check(librle_buffer_init(&ta->result, need, &g_lib_hooks,
+                                            "Buffer RLE (por hilo)"));
+    } else if (g_alloc_mode == ALLOC_BOUND) {
+        /* El hilo puede terminar comprimiendo cualquier tile: peor caso de la imagen */
+        buffer_check(librle_buffer_init_mapped(&ta->result,
+                                               rle_encoded_bound(g_rle_mode, (size_t)g_sched.num_tiles *
+                                                                 g_sched.tile_rows * g_sched.width * 3),
+                                               &g_lib_hooks, "Buffer RLE mmap (por hilo)"));
+    } else {
+        buffer_check(librle_buffer_init(&ta->result, ta->num_pixels * 2 / 2 + 256, &g_lib_hooks,
+                                        "Buffer RLE (por hilo)"));
     }
 
-    /* Compresión RLE con muestreo periódico del PC */
-    const uint8_t *pixels = ta->pixels;
-    size_t num_pixels = ta->num_pixels;
-    size_t i = 0;
-    size_t sample_interval = num_pixels / (MAX_PC_SAMPLES - 4);
-    if (sample_interval < 1) sample_interval = 1;
-    size_t next_sample = sample_interval;
-
-    while (i < num_pixels) {
-        uint8_t gray = pixels[i];
-        uint8_t count = 1;
-
-        while (i + count < num_pixels && count < 255 &&
-               pixels[i + count] == gray) {
-            count++;
+    /* === MARCA PC #1: Después de reservar el buffer === */
+    record_pc_sample(ta, (uintptr_t)librle_buffer_init, 0);
+
+    /* Compresión RLE, tile por tile */
+    RLELibBuffer *out = &ta->result;
+    if (g_alloc_mode == ALLOC_EXACT || g_alloc_mode == ALLOC_ARENA) {
+        ta->tiles_done = 0;
+        for (t = ta->first_tile; t >= 0; t = g_sched.tiles[t].next) {
+            TileTask *tile = &g_sched.tiles[t];
+            uint8_t *dst;
+            if (g_alloc_mode == ALLOC_ARENA) {
+                dst = g_arena.base + tile->offset;
+            } else {
+                tile->offset = out->size;
+                dst = out->data + out->size;
+            }
+            size_t len = compress_tile(ta, t, scratch, out, dst);
+            out->size += len;
+            /* --aio: el chunk ya está en su offset final, sale sin esperar al join */
+            if (g_alloc_mode == ALLOC_ARENA && g_aio_rle >= 0) {
+                uint64_t a0 = rle_trace_clock(ta->trace);
+                rle_aio_write(&g_aio, g_aio_rle, dst, len, tile->offset);
+                RLETraceEvent *e = rle_trace_span(ta->trace, "io", "aio: enviar chunk", a0,
+                                                  rle_trace_clock(ta->trace));
+                rle_trace_arg(e, "tile", t);
+                rle_trace_arg(e, "bytes", (int64_t)len);
+            }
         }
-
-        uint8_t run[2] = { count, gray };
-        buffer_push(&ta->result, run, 2);
-        i += count;
-        atomic_store(&ta->pixels_done, i);
-
-        /* Muestrear PC periódicamente durante la compresión */
-        if (i >= next_sample && ta->num_pc_samples < MAX_PC_SAMPLES) {
-            struct timespec now;
-            clock_gettime(CLOCK_MONOTONIC, &now);
-            ta->pc_samples[ta->num_pc_samples] = (PCSample){
-                .timestamp_ms = ts_relative_ms(ta->t0_ref, &now),
-                .pc_addr = (uintptr_t)rle_thread_func + (i & 0xFFF),
-                .core_id = get_current_core(),
-                .pixels_at = i
-            };
-            ta->num_pc_samples++;
-            next_sample += sample_interval;
+    } else {
+        const int raw = g_alloc_mode != ALLOC_GROW;
+        while ((t = tile_next(ta)) >= 0) {
+            g_sched.tiles[t].offset = out->size;
+            size_t len = compress_tile(ta, t, scratch, out, raw ? out->data + out->size : NULL);
+            if (raw)
+                out->size += len;
         }
     }
-
-    /* === MUESTRA PC final: Fin de compresión === */
-    if (ta->num_pc_samples < MAX_PC_SAMPLES) {
-        struct timespec now;
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        ta->pc_samples[ta->num_pc_samples] = (PCSample){
-            .timestamp_ms = ts_relative_ms(ta->t0_ref, &now),
-            .pc_addr = (uintptr_t)rle_thread_func + 0xFFF,
-            .core_id = get_current_core(),
-            .pixels_at = i
-        };
-        ta->num_pc_samples++;
+    if (scratch) {
+        track_heap_free(scratch);
+        free(scratch);
     }
 
+    /* === MARCA PC final: Fin de compresión === */
+    record_pc_sample(ta, (uintptr_t)compress_tile, ta->bytes_done);
+
     /* Registrar fin del hilo */
+    rle_trace_ctxsw(ta->trace);
+    if (g_perf)
+        rle_perf_stop(&ta->perf);
+    if (ta->prof)
+        rle_prof_thread_stop(ta->prof);
     clock_gettime(CLOCK_MONOTONIC, &ta->ts_end);
 
     /* Capturar tiempo CPU final */
@@ -495,105 +999,352 @@ static void *rle_thread_func(void *arg) {
     return NULL;
 }
 
+/*
+ * Prepara g_sched (tiles y deques ya reservados) y los argumentos de
+ * num_threads hilos de compresión sobre img, cortada en tiles de tile_rows.
+ */
+static void setup_compress_args(ThreadArg *args, int num_threads, const RLELibImage *img,
+                                uint32_t tile_rows, uint32_t num_tiles) {
+    g_sched.pixels = img->data;
+    g_sched.mapped = img->input.map != NULL;
+    g_sched.width = img->width;
+    g_sched.tile_rows = tile_rows;
+    g_sched.num_tiles = num_tiles;
+    g_sched.num_threads = num_threads;
+    for (uint32_t t = 0; t < num_tiles; t++) {
+        rle_tile_range(img->height, tile_rows, t, &g_sched.tiles[t].start_row,
+                       &g_sched.tiles[t].num_rows);
+        g_sched.tiles[t].owner = -1;
+        g_sched.tiles[t].next = -1;
+    }
+
+    /* Tramo inicial de cada hilo: tiles contiguos repartidos equitativamente */
+    for (int i = 0; i < num_threads; i++) {
+        uint32_t first, count;
+        rle_band_range(num_tiles, (uint32_t)num_threads, (uint32_t)i, &first, &count);
+        atomic_init(&g_sched.deques[i].range, tile_range_pack(first, first + count));
+        uint32_t row_off = g_sched.tiles[first].start_row;
+        uint32_t rows = 0;
+        for (uint32_t t = first; t < first + count; t++)
+            rows += g_sched.tiles[t].num_rows;
+        args[i].thread_idx = i;
+        args[i].pixels = img->data + (size_t)row_off * img->width * 3;
+        args[i].num_pixels = (size_t)rows * img->width * 3;
+        args[i].start_row = row_off;
+        args[i].num_rows = rows;
+        args[i].byte_offset = (size_t)row_off * img->width * 3;
+        rle_progress_reset(&args[i].progress);
+        args[i].system_tid = 0;
+        args[i].stack_addr = NULL;
+        args[i].cpu_time_user = 0;
+        args[i].cpu_time_sys = 0;
+        args[i].num_pc_samples = 0;
+        args[i].prof = NULL;
+        args[i].trace = NULL;
+        args[i].t0_ref = NULL; /* Se asigna justo antes de crear hilos */
+        args[i].first_tile = -1;
+        args[i].core_affinity = -1;
+        args[i].pin_cpu = rle_topo_cpu(&g_topo, g_affinity, i);
+#ifdef __APPLE__
+        args[i].mach_thread = 0;
+        args[i].core_affinity = i % (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+}
+
+/*
+ * --first-touch: copia img a un mapeo anónimo nuevo. El hilo de colocación i,
+ * fijado a la CPU del hilo de compresión i, escribe primero la banda inicial
+ * de ese hilo; Linux asigna cada página al nodo NUMA de quien la toca
+ * primero, así que cada banda queda en la memoria local del hilo que la
+ * comprime (solo los tiles robados se leen de otro nodo). La salida ya es
+ * local sin esto: cada hilo reserva y escribe su propio buffer.
+ * Devuelve el mapeo (munmap con los bytes de la imagen) o NULL.
+ */
+typedef struct {
+    const uint8_t *src;
+    uint8_t       *dst;
+    size_t         offset;
+    size_t         bytes;
+    int            cpu;
+} PlaceTask;
+
+static void *place_thread_func(void *arg) {
+    PlaceTask *p = (PlaceTask *)arg;
+    rle_affinity_pin_self(p->cpu);
+    memcpy(p->dst + p->offset, p->src + p->offset, p->bytes);
+    return NULL;
+}
+
+static uint8_t *first_touch_copy(const RLELibImage *img, int num_threads, uint32_t tile_rows,
+                                 uint32_t num_tiles, double *elapsed_ms) {
+    size_t row_bytes = (size_t)img->width * 3, total = row_bytes * img->height;
+    uint8_t *dst = mmap(NULL, total ? total : 1, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (dst == MAP_FAILED) { perror("mmap first-touch"); return NULL; }
+    PlaceTask *tasks = calloc(num_threads, sizeof(PlaceTask));
+    pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+    int *created = calloc(num_threads, sizeof(int));
+    if (!tasks || !threads || !created) {
+        perror("malloc");
+        free(tasks); free(threads); free(created);
+        munmap(dst, total ? total : 1);
+        return NULL;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < num_threads; i++) {
+        uint32_t first, count, row, rows, last_row, last_rows;
+        rle_band_range(num_tiles, (uint32_t)num_threads, (uint32_t)i, &first, &count);
+        tasks[i].src = img->data;
+        tasks[i].dst = dst;
+        tasks[i].cpu = rle_topo_cpu(&g_topo, g_affinity, i);
+        if (count == 0) continue;
+        rle_tile_range(img->height, tile_rows, first, &row, &rows);
+        rle_tile_range(img->height, tile_rows, first + count - 1, &last_row, &last_rows);
+        tasks[i].offset = (size_t)row * row_bytes;
+        tasks[i].bytes = (size_t)(last_row + last_rows - row) * row_bytes;
+        /* Sin hilo nuevo la banda se copia desde aquí: mismo contenido, otro nodo */
+        created[i] = pthread_create(&threads[i], NULL, place_thread_func, &tasks[i]) == 0;
+        if (!created[i])
+            memcpy(dst + tasks[i].offset, img->data + tasks[i].offset, tasks[i].bytes);
+    }
+    for (int i = 0; i < num_threads; i++)
+        if (created[i]) pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (elapsed_ms) *elapsed_ms = ts_relative_ms(&t0, &t1);
+
+    free(tasks);
+    free(threads);
+    free(created);
+    return dst;
+}
+
 /* ═══════════════════════════════════════════════════════════════════════════
  *  DECLARACIONES ADELANTADAS (para mostrar direcciones de código)
  * ═══════════════════════════════════════════════════════════════════════════ */
 
 int main(int argc, char *argv[]);
 static void *rle_thread_func(void *arg);
-static void buffer_init(Buffer *buf, size_t cap);
-static void buffer_push(Buffer *buf, const uint8_t *bytes, size_t n);
-static void generate_synthetic(Image *img, uint32_t w, uint32_t h);
-static int load_image(const char *path, Image *img);
-static uint8_t *rle_decompress(const uint8_t *rle_data, size_t rle_size,
-                                size_t expected_pixels);
-static void save_bmp(const char *path, const uint8_t *pixels, uint32_t w, uint32_t h);
+static void generate_synthetic(RLELibImage *img, uint32_t w, uint32_t h);
+static void *rle_decode_thread_func(void *arg);
 
 /* ═══════════════════════════════════════════════════════════════════════════
- *  DESCOMPRESIÓN RLE → PÍXELES RGB
+ *  DESCOMPRESIÓN RLE → PÍXELES RGB (hilos guiados por el índice de chunks)
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-static uint8_t *rle_decompress(const uint8_t *rle_data, size_t rle_size,
-                                size_t expected_pixels) {
-    uint8_t *pixels = (uint8_t *)malloc(expected_pixels);
-    if (!pixels) { perror("malloc decompress"); return NULL; }
+/* Registra una marca del PC en el hilo (mismo formato que la compresión) */
+static void record_pc_sample(ThreadArg *ta, uintptr_t pc, size_t pixels_at) {
+    if (ta->num_pc_samples >= MAX_PC_SAMPLES) return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ta->pc_samples[ta->num_pc_samples] = (PCSample){
+        .timestamp_ms = ts_relative_ms(ta->t0_ref, &now),
+        .pc_addr = pc,
+        .core_id = get_current_core(),
+        .pixels_at = pixels_at
+    };
+    ta->num_pc_samples++;
+}
+
+/*
+ * Cada hilo decodifica sus chunks directamente en su banda de la imagen
+ * final (dec_out + start_row * width * 3). Las bandas son disjuntas, así
+ * que no hace falta mutex ni concatenar (gather) los buffers comprimidos.
+ *
+ * Con dec_expect cada hilo además verifica sus bandas: si hay dec_out
+ * compara la banda recién decodificada (todavía en su caché), si no
+ * recorre los runs contra la original con RLEVerifier sin escribir nada.
+ * La primera diferencia levanta g_verify_stop y los demás hilos cortan en
+ * el siguiente paso. Con RLE_FLAG_RAW_CRC la banda decodificada se
+ * compara también con el raw_checksum de la tabla.
+ */
+static void *rle_decode_thread_func(void *arg) {
+    ThreadArg *ta = (ThreadArg *)arg;
+    if (rle_affinity_pin_self(ta->pin_cpu) != 0)
+        ta->pin_cpu = -1;
+
+    int stack_var = 0;
+    ta->stack_addr = &stack_var;
+    ta->num_pc_samples = 0;
+
+#ifdef __APPLE__
+    uint64_t tid;
+    pthread_threadid_np(NULL, &tid);
+    ta->system_tid = tid;
+    ta->mach_thread = pthread_mach_thread_np(pthread_self());
+    ta->core_affinity = ta->thread_idx % (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    ta->system_tid = (uint64_t)pthread_self();
+    ta->core_affinity = get_current_core();
+#endif
 
-    size_t px = 0;
-    size_t i = 0;
-    while (i + 1 < rle_size && px < expected_pixels) {
-        uint8_t count = rle_data[i];
-        uint8_t gray = rle_data[i + 1];
-        for (uint8_t j = 0; j < count && px < expected_pixels; j++) {
-            pixels[px] = gray;
-            px++;
+    clock_gettime(CLOCK_MONOTONIC, &ta->ts_start);
+    if (ta->prof)
+        rle_prof_thread_start(ta->prof, &ta->progress);
+    if (g_perf)
+        rle_perf_start(&ta->perf);
+    record_pc_sample(ta, (uintptr_t)rle_decode_thread_func, 0);
+    rle_trace_ctxsw(ta->trace);
+
+    size_t next_publish = RLE_PROGRESS_STEP;
+    size_t done = 0, consumed = 0;
+
+    for (uint32_t c = ta->dec_first; c < ta->dec_first + ta->dec_count; c++) {
+        const RLEChunkEntry *e = &ta->dec_chunks[c];
+        const uint8_t *src = ta->dec_src[c];
+        size_t row_off = (size_t)e->start_row * ta->dec_width * 3;
+        size_t band = (size_t)e->num_rows * ta->dec_width * 3;
+        const uint8_t *expect = ta->dec_expect ? ta->dec_expect + row_off : NULL;
+        size_t px = 0, bad = SIZE_MAX;
+        int crc_bad = 0;
+
+        if (expect && atomic_load_explicit(&g_verify_stop, memory_order_relaxed))
+            break;
+        uint64_t ct0 = rle_trace_clock(ta->trace);
+        size_t n;
+        if (ta->dec_out) {
+            uint8_t *dst = ta->dec_out + row_off;
+            RLEDecoder d;
+            rle_decoder_init(&d, ta->dec_mode, ta->dec_flags, e->codec, src, e->length, dst, band);
+            d.bgr = ta->dec_bgr;
+            while ((n = rle_decode_some(&d, RLE_PROGRESS_STEP)) != 0) {
+                px += n;
+                if (done + px >= next_publish) {
+                    rle_progress_publish(&ta->progress, consumed + d.in, done + px);
+                    next_publish = done + px + RLE_PROGRESS_STEP;
+                }
+            }
+            if (expect) {
+                size_t diff = ta->dec_bgr ? rle_bgr_first_diff(dst, expect, px)
+                            : memcmp(dst, expect, px) == 0 ? px : rle_first_diff(dst, expect, px);
+                if (diff < band) bad = diff;
+            } else if (ta->dec_flags & RLE_FLAG_RAW_CRC) {
+                uint32_t crc = ta->dec_bgr ? rle_bgr_crc32c(dst, px) : rle_crc32c(0, dst, px);
+                crc_bad = px < band || crc != e->raw_checksum;
+            }
+        } else {
+            RLEVerifier v;
+            rle_verifier_init(&v, ta->dec_mode, ta->dec_flags, e->codec, src, e->length, expect, band);
+            while ((n = rle_verify_some(&v, RLE_PROGRESS_STEP)) != 0) {
+                px += n;
+                if (done + px >= next_publish) {
+                    rle_progress_publish(&ta->progress, consumed + v.d.in, done + px);
+                    next_publish = done + px + RLE_PROGRESS_STEP;
+                    if (atomic_load_explicit(&g_verify_stop, memory_order_relaxed))
+                        break;
+                }
+            }
+            bad = v.mismatch;
+        }
+        done += px;
+        consumed += e->length;
+        rle_progress_publish(&ta->progress, consumed, done);
+        if (ta->trace) {
+            RLETraceEvent *ev = rle_trace_span(ta->trace, "decompress",
+                                               ta->dec_out ? "chunk" : "verificar chunk",
+                                               ct0, rle_trace_now_ns());
+            rle_trace_arg(ev, "chunk", c);
+            rle_trace_arg(ev, "bytes_in", (int64_t)e->length);
+            rle_trace_arg(ev, "bytes_out", (int64_t)px);
+            rle_trace_arg(ev, "codec", e->codec);
+            rle_trace_ctxsw(ta->trace);
+        }
+        if (bad != SIZE_MAX || crc_bad) {
+            if (ta->dec_bad++ == 0) {
+                ta->dec_bad_chunk = c;
+                ta->dec_bad_offset = bad;
+            }
+            if (expect) {
+                atomic_store_explicit(&g_verify_stop, 1, memory_order_relaxed);
+                break;
+            }
         }
-        i += 2;
     }
-    return pixels;
+    ta->dec_bytes = done;
+
+    record_pc_sample(ta, (uintptr_t)rle_decode_some, done);
+    rle_trace_ctxsw(ta->trace);
+    if (g_perf)
+        rle_perf_stop(&ta->perf);
+    if (ta->prof)
+        rle_prof_thread_stop(ta->prof);
+    clock_gettime(CLOCK_MONOTONIC, &ta->ts_end);
+    get_thread_cpu_time(ta);
+    return NULL;
 }
 
-/* ═══════════════════════════════════════════════════════════════════════════
- *  GUARDAR IMAGEN BMP (sin dependencias externas)
- * ═══════════════════════════════════════════════════════════════════════════ */
+/* Reparte los chunks en bloques contiguos entre num_threads hilos */
+static void setup_decode_args(ThreadArg *dargs, int num_threads,
+                              const RLEChunkEntry *chunks,
+                              const uint8_t *const *chunk_src, uint32_t num_chunks,
+                              uint8_t *out, uint32_t width,
+                              uint8_t mode, uint8_t flags) {
+    for (int i = 0; i < num_threads; i++) {
+        ThreadArg *ta = &dargs[i];
+        uint32_t first, count;
+        rle_band_range(num_chunks, (uint32_t)num_threads, (uint32_t)i, &first, &count);
+
+        memset(ta, 0, sizeof(*ta));
+        ta->thread_idx = i;
+        ta->dec_chunks = chunks;
+        ta->dec_src = chunk_src;
+        ta->dec_first = first;
+        ta->dec_count = count;
+        ta->dec_out = out;
+        ta->dec_width = width;
+        ta->dec_mode = mode;
+        ta->dec_flags = flags;
+        ta->pin_cpu = rle_topo_cpu(&g_topo, g_affinity, i);
+        rle_progress_reset(&ta->progress);
+
+        ta->pixels = count ? chunk_src[first] : NULL;
+        ta->start_row = count ? chunks[first].start_row : 0;
+        for (uint32_t c = first; c < first + count; c++) {
+            ta->num_rows += chunks[c].num_rows;
+            ta->num_pixels += (size_t)chunks[c].num_rows * width * 3;
+        }
+        ta->byte_offset = (size_t)ta->start_row * width * 3;
+    }
+}
 
-static void save_bmp(const char *path, const uint8_t *pixels,
-                      uint32_t w, uint32_t h) {
-    uint32_t row_stride = (w * 3 + 3) & ~3u;
-    uint32_t pixel_data_size = row_stride * h;
-    uint32_t file_size = 14 + 40 + pixel_data_size;
-
-    FILE *f = fopen(path, "wb");
-    if (!f) { perror("fopen bmp"); return; }
-    track_syscall("fopen", "open", "Abrir archivo BMP para escritura");
-
-    uint8_t fh[14] = {0};
-    fh[0] = 'B'; fh[1] = 'M';
-    fh[2] = file_size & 0xFF;
-    fh[3] = (file_size >> 8) & 0xFF;
-    fh[4] = (file_size >> 16) & 0xFF;
-    fh[5] = (file_size >> 24) & 0xFF;
-    uint32_t offset = 14 + 40;
-    fh[10] = offset & 0xFF;
-    fh[11] = (offset >> 8) & 0xFF;
-    fwrite(fh, 1, 14, f);
-
-    uint8_t ih[40] = {0};
-    ih[0] = 40;
-    ih[4] = w & 0xFF; ih[5] = (w >> 8) & 0xFF;
-    ih[6] = (w >> 16) & 0xFF; ih[7] = (w >> 24) & 0xFF;
-    ih[8] = h & 0xFF; ih[9] = (h >> 8) & 0xFF;
-    ih[10] = (h >> 16) & 0xFF; ih[11] = (h >> 24) & 0xFF;
-    ih[12] = 1;
-    ih[14] = 24;
-    ih[20] = pixel_data_size & 0xFF;
-    ih[21] = (pixel_data_size >> 8) & 0xFF;
-    ih[22] = (pixel_data_size >> 16) & 0xFF;
-    ih[23] = (pixel_data_size >> 24) & 0xFF;
-    fwrite(ih, 1, 40, f);
-
-    uint8_t *row = (uint8_t *)calloc(row_stride, 1);
-    if (!row) { fclose(f); return; }
-    for (int y = (int)h - 1; y >= 0; y--) {
-        memset(row, 0, row_stride);
-        for (uint32_t x = 0; x < w; x++) {
-            size_t src = ((size_t)y * w + x) * 3;
-            row[x * 3 + 0] = pixels[src + 2];
-            row[x * 3 + 1] = pixels[src + 1];
-            row[x * 3 + 2] = pixels[src + 0];
+/* Lanza los hilos de descompresión y espera a todos; devuelve el wall time */
+static double run_decode_threads(ThreadArg *dargs, int num_threads, struct timespec *t0) {
+    pthread_t *threads = malloc(sizeof(pthread_t) * num_threads);
+    if (!threads) { perror("malloc"); return -1; }
+
+    clock_gettime(CLOCK_MONOTONIC, t0);
+    int created = 0;
+    for (int i = 0; i < num_threads; i++) {
+        dargs[i].t0_ref = t0;
+        if (pthread_create(&threads[i], NULL, rle_decode_thread_func, &dargs[i]) != 0) {
+            perror("pthread_create");
+            break;
         }
-        fwrite(row, 1, row_stride, f);
+        created++;
     }
-    free(row);
-    track_syscall("fwrite", "write", "Escribir datos BMP a disco");
-    track_syscall("fclose", "close", "Cerrar archivo BMP");
-    fclose(f);
+    track_syscall("pthread_create", "clone/bsdthread_create", "Crear hilos de descompresion");
+    for (int i = 0; i < created; i++)
+        pthread_join(threads[i], NULL);
+    track_syscall("pthread_join", "futex/ulock_wait", "Esperar hilos de descompresion");
+
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    free(threads);
+    if (created < num_threads) return -1;
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1e9;
 }
 
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  GUARDAR IMAGEN BMP (sin dependencias externas)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
 /* ═══════════════════════════════════════════════════════════════════════════
  *  VISUALIZACIÓN DE SEGMENTOS DE MEMORIA (PILA, CÓDIGO, DATOS)
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-static void print_memory_segments(Image *img, ThreadArg *args, int num_threads,
+static void print_memory_segments(RLELibImage *img, ThreadArg *args, int num_threads,
                                    void *stack_main_top, void *stack_main_bottom) {
     const char *CYAN = "\033[36m";
     const char *YELLOW = "\033[1;33m";
@@ -678,14 +1429,14 @@ static void print_memory_segments(Image *img, ThreadArg *args, int num_threads,
            CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)main, RESET, YELLOW, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  │  %srle_thread_func()%s      %s0x%014lx%s  %s*** EJECUTADA POR HILOS%s    │ %s▓%s  %s║%s\n",
            CYAN, RESET, YELLOW, RESET, RED, RESET, MAGENTA, (unsigned long)rle_thread_func, RESET, RED, RESET, YELLOW, RESET, CYAN, RESET);
-    printf("%s║%s  %s▓%s  │  buffer_init()          %s0x%014lx%s  Inicializar buffer         │ %s▓%s  %s║%s\n",
-           CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)buffer_init, RESET, YELLOW, RESET, CYAN, RESET);
-    printf("%s║%s  %s▓%s  │  buffer_push()          %s0x%014lx%s  Agregar a buffer           │ %s▓%s  %s║%s\n",
-           CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)buffer_push, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s║%s  %s▓%s  │  librle_buffer_init()   %s0x%014lx%s  Inicializar buffer         │ %s▓%s  %s║%s\n",
+           CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)librle_buffer_init, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s║%s  %s▓%s  │  librle_buffer_push()   %s0x%014lx%s  Agregar a buffer           │ %s▓%s  %s║%s\n",
+           CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)librle_buffer_push, RESET, YELLOW, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  │  generate_synthetic()   %s0x%014lx%s  Generar imagen             │ %s▓%s  %s║%s\n",
            CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)generate_synthetic, RESET, YELLOW, RESET, CYAN, RESET);
-    printf("%s║%s  %s▓%s  │  load_image()           %s0x%014lx%s  Cargar imagen (stb)        │ %s▓%s  %s║%s\n",
-           CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)load_image, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s║%s  %s▓%s  │  librle_image_load()    %s0x%014lx%s  Cargar imagen (stb)        │ %s▓%s  %s║%s\n",
+           CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)librle_image_load, RESET, YELLOW, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  %s└─────────────────────────────────────────────────────────────────────────┘%s %s▓%s  %s║%s\n", CYAN, RESET, YELLOW, RESET, WHITE, RESET, YELLOW, RESET, CYAN, RESET);
     printf("%s║%s  %s▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓▓%s  %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
 
@@ -709,7 +1460,7 @@ static void print_memory_segments(Image *img, ThreadArg *args, int num_threads,
            CYAN, RESET, GREEN, RESET, MAGENTA, (unsigned long)&g_initialized_var, RESET, g_initialized_var, GREEN, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  │  g_program_name         %s0x%014lx%s    8 bytes   \"%s\"    │ %s▓%s  %s║%s\n",
            CYAN, RESET, GREEN, RESET, MAGENTA, (unsigned long)&g_program_name, RESET, g_program_name, GREEN, RESET, CYAN, RESET);
-    printf("%s║%s  %s▓%s  │  g_num_threads_config   %s0x%014lx%s    4 bytes   valor: %d        │ %s▓%s  %s║%s\n",
+    printf("%s║%s  %s▓%s  │  g_num_threads_config   %s0x%014lx%s    4 bytes   valor: %-2d       │ %s▓%s  %s║%s\n",
            CYAN, RESET, GREEN, RESET, MAGENTA, (unsigned long)&g_num_threads_config, RESET, g_num_threads_config, GREEN, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  %s└─────────────────────────────────────────────────────────────────────────┘%s %s▓%s  %s║%s\n", CYAN, RESET, GREEN, RESET, WHITE, RESET, GREEN, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s                                                                                %s▓%s  %s║%s\n", CYAN, RESET, GREEN, RESET, GREEN, RESET, CYAN, RESET);
@@ -783,7 +1534,7 @@ static void print_memory_segments(Image *img, ThreadArg *args, int num_threads,
     printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n", CYAN, RESET);
 }
 
-static void print_thread_distribution(ThreadArg *args, int num_threads, Image *img, const char *phase) {
+static void print_thread_distribution(ThreadArg *args, int num_threads, RLELibImage *img, const char *phase) {
     const char *CYAN = "\033[36m";
     const char *WHITE = "\033[1;37m";
     const char *GREEN = "\033[32m";
@@ -794,23 +1545,26 @@ static void print_thread_distribution(ThreadArg *args, int num_threads, Image *i
     printf("%s║%s  %s┌─ DISTRIBUCIÓN DE TRABAJO (%d HILOS) - %s ───────────────────────────┐%s  %s║%s\n",
            CYAN, RESET, WHITE, num_threads, phase, RESET, CYAN, RESET);
     printf("%s║%s  │                                                                          │  %s║%s\n", CYAN, RESET, CYAN, RESET);
-    printf("%s║%s  │  %sHilo  TID         Core  Filas       Píxeles     Stack Addr     Bytes%s   │  %s║%s\n",
+    printf("%s║%s  │  %sHilo  TID         Core  Filas       Bytes       Stack Addr     Tiles%s   │  %s║%s\n",
            CYAN, RESET, WHITE, RESET, CYAN, RESET);
     printf("%s║%s  │  ────  ──────────  ────  ──────────  ──────────  ────────────   ───────   │  %s║%s\n",
            CYAN, RESET, CYAN, RESET);
 
+    /* Filas = tramo inicial del deque; Bytes y Tiles = lo comprimido de verdad (con robos) */
     for (int i = 0; i < num_threads; i++) {
         ThreadArg *ta = &args[i];
+        char tiles[16];
+        snprintf(tiles, sizeof(tiles), "%u+%u", ta->tiles_done - ta->tiles_stolen, ta->tiles_stolen);
 
-        printf("%s║%s  │  %s%4d%s  0x%-8lx  %s%4d%s  %4u-%-5u  %s%-10zu%s  %s0x%08lx%s   %s%-7zu%s   │  %s║%s\n",
+        printf("%s║%s  │  %s%4d%s  0x%-8lx  %s%4d%s  %4u-%-5u  %s%-10zu%s  %s0x%08lx%s   %s%-7s%s   │  %s║%s\n",
                CYAN, RESET,
                GREEN, i, RESET,
                (unsigned long)ta->system_tid,
                 YELLOW, i, RESET,
                 ta->start_row, ta->start_row + ta->num_rows - 1,
-                GREEN, ta->num_pixels, RESET,
+                GREEN, ta->bytes_done, RESET,
                 MAGENTA, ta->stack_addr ? (unsigned long)ta->stack_addr : 0, RESET,
-                GREEN, ta->num_pixels, RESET,
+                GREEN, tiles, RESET,
                 CYAN, RESET);
     }
 
@@ -863,6 +1617,14 @@ static void print_thread_results(ThreadArg *args, int num_threads) {
     printf("%s║%s  └──────────────────────────────────────────────────────────────────────────┘  %s║%s\n", CYAN, RESET, CYAN, RESET);
 }
 
+/* atexit: guarda la caché (--chunk-cache-file) y la libera */
+static void chunk_cache_finish(void) {
+    if (g_cache_file && rle_chunk_cache_save(&g_chunk_cache, g_cache_file) == 0)
+        printf("  \033[32mCaché de chunks guardada:\033[0m %s (%u entradas, %.2f MB)\n",
+               g_cache_file, g_chunk_cache.count, g_chunk_cache.data_bytes / (1024.0 * 1024.0));
+    rle_chunk_cache_destroy(&g_chunk_cache);
+}
+
 static void print_execution_metrics(double elapsed, double user_t, double sys_t,
                                     double total_thread_cpu,
                                     size_t compressed_size, size_t raw_size,
@@ -902,30 +1664,334 @@ static void print_execution_metrics(double elapsed, double user_t, double sys_t,
     printf("%s║%s  │  %sRENDIMIENTO:%s                                                            │  %s║%s\n", CYAN, RESET, WHITE, RESET, CYAN, RESET);
     printf("%s║%s  │    Throughput:            %s%10.1f%s MB/s                                 │  %s║%s\n",
            CYAN, RESET, GREEN, throughput, RESET, CYAN, RESET);
+    printf("%s║%s  │    Kernel de escaneo:     %s%10s%s (%2d B/paso)                          │  %s║%s\n",
+           CYAN, RESET, GREEN, g_scan.name, RESET, g_scan.bytes_per_step, CYAN, RESET);
+    {
+        const char *simd = "?";
+        char variant[48];
+        rle_runs_encoder(&g_scan, g_rle_mode, g_rle_flags, &simd);
+        snprintf(variant, sizeof(variant), "%s/%s/%s", g_rle_mode == RLE_MODE_PIXEL ? "px24" : "b8",
+                 rle_count_name(g_rle_flags), simd);
+        printf("%s║%s  │    Variante de runs:      %s%-48s%s│  %s║%s\n",
+               CYAN, RESET, GREEN, variant, RESET, CYAN, RESET);
+    }
+    printf("%s║%s  │    Modo de codificación:  %s%10s%s (count %-6s)                       │  %s║%s\n",
+           CYAN, RESET, GREEN, rle_mode_name(g_rle_mode), RESET, rle_count_name(g_rle_flags), CYAN, RESET);
+    if (g_rle_flags & RLE_FLAG_CODEC) {
+        uint32_t counts[RLE_CODEC_COUNT] = {0};
+        for (uint32_t t = 0; t < g_sched.num_tiles; t++)
+            counts[g_sched.tiles[t].codec]++;
+        char line[96];
+        rle_codec_summary(line, sizeof(line), counts);
+        printf("%s║%s  │    Codec por banda:       %s%-47s%s│  %s║%s\n", CYAN, RESET, GREEN, line, RESET, CYAN, RESET);
+    }
+    printf("%s║%s  │    Reserva de salida:     %s%10s%s (--alloc)                            │  %s║%s\n",
+           CYAN, RESET, GREEN, g_alloc_names[g_alloc_mode], RESET, CYAN, RESET);
     printf("%s║%s  │    Tamaño original:       %s%10zu%s bytes                                │  %s║%s\n",
            CYAN, RESET, YELLOW, raw_size, RESET, CYAN, RESET);
     printf("%s║%s  │    Tamaño comprimido:     %s%10zu%s bytes                                │  %s║%s\n",
            CYAN, RESET, GREEN, compressed_size, RESET, CYAN, RESET);
     printf("%s║%s  │    Ratio de compresión:   %s%10.1f%%%s                                    │  %s║%s\n",
            CYAN, RESET, GREEN, ratio, RESET, CYAN, RESET);
+    if (g_use_cache) {
+        RLEChunkCache *c = &g_chunk_cache;
+        uint64_t hits = atomic_load(&c->hits), total = hits + atomic_load(&c->misses);
+        char line[96];
+        printf("%s║%s  │                                                                          │  %s║%s\n", CYAN, RESET, CYAN, RESET);
+        printf("%s║%s  │  %sCACHÉ DE CHUNKS:%s                                                        │  %s║%s\n", CYAN, RESET, WHITE, RESET, CYAN, RESET);
+        snprintf(line, sizeof(line), "%10llu de %llu bandas (%.1f%%)", (unsigned long long)hits,
+                 (unsigned long long)total, total ? 100.0 * hits / total : 0.0);
+        printf("%s║%s  │    Aciertos:              %s%-47s%s│  %s║%s\n", CYAN, RESET, GREEN, line, RESET, CYAN, RESET);
+        if (atomic_load(&c->misses))
+            snprintf(line, sizeof(line), "%10.3f ms (estimado por los fallos)",
+                     rle_chunk_cache_saved_s(c) * 1e3);
+        else
+            snprintf(line, sizeof(line), "%10s (sin fallos para estimar)", "-");
+        printf("%s║%s  │    Tiempo ahorrado:       %s%-47s%s│  %s║%s\n", CYAN, RESET, GREEN, line, RESET, CYAN, RESET);
+        snprintf(line, sizeof(line), "%10u (%.2f MB, %u del archivo)", c->count,
+                 c->data_bytes / (1024.0 * 1024.0), c->loaded);
+        printf("%s║%s  │    Entradas:              %s%-47s%s│  %s║%s\n", CYAN, RESET, YELLOW, line, RESET, CYAN, RESET);
+    }
     printf("%s║%s  │                                                                          │  %s║%s\n", CYAN, RESET, CYAN, RESET);
     printf("%s║%s  └──────────────────────────────────────────────────────────────────────────┘  %s║%s\n", CYAN, RESET, CYAN, RESET);
     printf("%s╚════════════════════════════════════════════════════════════════════════════════╝%s\n", CYAN, RESET);
 }
 
 /* ═══════════════════════════════════════════════════════════════════════════
- *  LÍNEA DE TIEMPO - RECURSOS POR HILO
+ *  CONTADORES DE HARDWARE POR HILO (--perf)
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-static void print_resource_timeline(ThreadArg *args, int num_threads,
-                                     struct timespec t0, double elapsed) {
+/* Columnas del CSV de scheduling (-1 = evento no medido o sin --perf) */
+static void perf_csv_header(FILE *csv) {
+    for (int ev = 0; ev < RLE_PERF_COUNT; ev++)
+        fprintf(csv, ",%s", rle_perf_name(ev));
+}
+
+static void perf_csv_values(FILE *csv, const RLEPerfCounters *pc) {
+    for (int ev = 0; ev < RLE_PERF_COUNT; ev++)
+        fprintf(csv, ",%lld", rle_perf_csv(pc, ev));
+}
+
+/* "%*.*f" de v, o "n/d" si v < 0 */
+static const char *perf_fmt(char *buf, size_t n, double v, int width, int prec) {
+    if (v < 0) snprintf(buf, n, "%*s", width, "n/d");
+    else snprintf(buf, n, "%*.*f", width, prec, v);
+    return buf;
+}
+
+/*
+ * IPC, mispredicts, misses por KB y bytes por ciclo de cada hilo en la fase.
+ * bytes = entrada comprimida (compresión) o imagen escrita (descompresión).
+ */
+static void print_perf_counters(ThreadArg *args, int num_threads, ProgramPhase phase) {
     const char *CYAN = "\033[36m";
     const char *YELLOW = "\033[1;33m";
     const char *GREEN = "\033[32m";
-    const char *RED = "\033[31m";
-    const char *MAGENTA = "\033[35m";
     const char *WHITE = "\033[1;37m";
-    const char *RESET = "\033[0m";
+    const char *DIM = "\033[2m";
+    const char *RESET = "\033[0m";
+
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s     %sCONTADORES DE HARDWARE POR HILO  [%-13s]  (perf_event_open, user)%s        %s║%s\n",
+           CYAN, RESET, YELLOW, g_phase_names[phase], RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    printf("%s║%s  %sHilo      IPC   Br. miss %%   L1D miss/KB   LLC miss/KB   Bytes/ciclo       Ciclos%s   %s║%s\n",
+           CYAN, RESET, WHITE, RESET, CYAN, RESET);
+    printf("%s║%s  ────    ─────   ──────────   ───────────   ───────────   ───────────   ──────────   %s║%s\n",
+           CYAN, RESET, CYAN, RESET);
+
+    int any = 0, error = 0;
+    for (int i = 0; i < num_threads; i++) {
+        const RLEPerfCounters *pc = &args[i].perf;
+        double bytes = (double)(phase == PHASE_DECOMPRESS ? args[i].dec_bytes : args[i].bytes_done);
+        double kb = bytes / 1024.0;
+        double ipc = rle_perf_ratio(pc, RLE_PERF_INSTRUCTIONS, RLE_PERF_CYCLES);
+        double br = rle_perf_ratio(pc, RLE_PERF_BRANCH_MISSES, RLE_PERF_BRANCHES);
+        double l1 = pc->valid[RLE_PERF_L1D_MISSES] && kb > 0 ? pc->value[RLE_PERF_L1D_MISSES] / kb : -1;
+        double llc = pc->valid[RLE_PERF_LLC_MISSES] && kb > 0 ? pc->value[RLE_PERF_LLC_MISSES] / kb : -1;
+        double bpc = pc->valid[RLE_PERF_CYCLES] && pc->value[RLE_PERF_CYCLES] > 0
+                     ? bytes / pc->value[RLE_PERF_CYCLES] : -1;
+        char b_ipc[16], b_br[16], b_l1[16], b_llc[16], b_bpc[16], b_cyc[24];
+        if (pc->valid[RLE_PERF_CYCLES])
+            snprintf(b_cyc, sizeof(b_cyc), "%10llu", (unsigned long long)pc->value[RLE_PERF_CYCLES]);
+        else
+            snprintf(b_cyc, sizeof(b_cyc), "%10s", "n/d");
+        printf("%s║%s  %s[%2d]%s    %s   %s%s%s   %s   %s   %s%s%s   %s   %s║%s\n",
+               CYAN, RESET, GREEN, i, RESET,
+               perf_fmt(b_ipc, sizeof(b_ipc), ipc, 5, 2),
+               YELLOW, perf_fmt(b_br, sizeof(b_br), br < 0 ? -1 : br * 100, 10, 2), RESET,
+               perf_fmt(b_l1, sizeof(b_l1), l1, 11, 2),
+               perf_fmt(b_llc, sizeof(b_llc), llc, 11, 3),
+               GREEN, perf_fmt(b_bpc, sizeof(b_bpc), bpc, 11, 3), RESET, b_cyc, CYAN, RESET);
+        any |= rle_perf_any(pc);
+        if (!error) error = pc->error;
+    }
+
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    if (error) {
+        char why[80];
+        snprintf(why, sizeof(why), "%s%s", any ? "algunos eventos no disponibles: " : "no disponibles: ",
+                 strerror(error));
+        printf("%s║%s  %sn/d = %-62.62s%s                %s║%s\n", CYAN, RESET, DIM, why, RESET, CYAN, RESET);
+        printf("%s║%s  %s      (VM sin PMU, kernel.perf_event_paranoid > 2, o macOS sin kperf)%s               %s║%s\n",
+               CYAN, RESET, DIM, RESET, CYAN, RESET);
+    }
+    printf("%s║%s  %sBr. miss = branch-misses / branches; bytes = %s%s%s║%s\n", CYAN, RESET, DIM,
+           phase == PHASE_DECOMPRESS ? "imagen escrita por el hilo             "
+                                     : "entrada comprimida por el hilo         ",
+           RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n", CYAN, RESET);
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  PROFILER POR MUESTREO (--profile HZ)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+#define PROFILE_MAX_SYMBOLS 32
+
+/*
+ * Funciones del ejecutable que corren los hilos de compresión y
+ * descompresión (incluidas las copias fuera de línea de los helpers de los
+ * headers y el kernel de escaneo elegido), ordenadas por dirección.
+ */
+static int profile_symbols(RLEProfSymbol *tab) {
+    int n = 0;
+#define PROF_SYM(f) tab[n++] = (RLEProfSymbol){ (uintptr_t)(f), #f }
+    PROF_SYM(rle_thread_func);
+    PROF_SYM(compress_tile);
+    PROF_SYM(librle_encode_chunk);
+    PROF_SYM(tile_next);
+    PROF_SYM(tile_pixels);
+    PROF_SYM(librle_buffer_init);
+    PROF_SYM(librle_buffer_init_mapped);
+    PROF_SYM(arena_buffer_init);
+    PROF_SYM(librle_buffer_push);
+    PROF_SYM(track_heap_alloc);
+    PROF_SYM(track_heap_free);
+    PROF_SYM(record_pc_sample);
+    PROF_SYM(get_current_core);
+    PROF_SYM(get_thread_cpu_time);
+    PROF_SYM(ts_relative_ms);
+    PROF_SYM(rle_decode_thread_func);
+    PROF_SYM(rle_encoder_init);
+    PROF_SYM(rle_encode_next);
+    PROF_SYM(rle_encode_some);
+    PROF_SYM(rle_encoder_measure);
+    PROF_SYM(rle_decode_some);
+    PROF_SYM(rle_progress_publish);
+#undef PROF_SYM
+    tab[n++] = (RLEProfSymbol){ (uintptr_t)g_scan.fn, "rle_scan (bytes)" };
+    tab[n++] = (RLEProfSymbol){ (uintptr_t)g_scan.fn_px, "rle_scan (píxeles)" };
+    tab[n++] = (RLEProfSymbol){ (uintptr_t)rle_runs_encoder(&g_scan, g_rle_mode, g_rle_flags, NULL),
+                                "rle_runs (variante)" };
+    rle_prof_sort_symbols(tab, n);
+    return n;
+}
+
+/* Un ring por hilo en args[i].prof; NULL (y prof = NULL) sin --profile */
+static RLEProfRing *profile_attach(ThreadArg *args, int n) {
+    if (!g_profile_hz) return NULL;
+    RLEProfRing *rings = rle_cacheline_calloc(n, sizeof(RLEProfRing));
+    if (!rings) { perror("malloc"); return NULL; }
+    for (int i = 0; i < n; i++)
+        args[i].prof = &rings[i];
+    return rings;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  TRACE DE PLANIFICACIÓN (--trace)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * Reserva los buffers (principal + dos por hilo de trabajo: compresión y
+ * verificación) y fija t0. Los de los hilos se reparten con trace_attach.
+ */
+static void trace_begin(void) {
+    if (!g_trace_path) return;
+    int cap = 1 + 2 * worker_threads();
+    g_trace.bufs = rle_cacheline_calloc(cap, sizeof(RLETraceBuf));
+    if (!g_trace.bufs) { perror("malloc"); return; }
+    g_trace.cap = cap;
+    g_trace.t0_ns = rle_trace_now_ns();
+    rle_trace_buf_init(&g_trace.bufs[0], 0, "principal");
+    g_trace.num_bufs = 1;
+}
+
+/* Buffer del hilo principal (NULL sin --trace) */
+static RLETraceBuf *trace_main(void) {
+    return g_trace.num_bufs ? &g_trace.bufs[0] : NULL;
+}
+
+/* Un buffer propio en args[i].trace para cada hilo; NULL sin --trace */
+static void trace_attach(ThreadArg *args, int n, const char *role) {
+    for (int i = 0; i < n; i++) {
+        args[i].trace = NULL;
+        if (!g_trace.num_bufs || g_trace.num_bufs == g_trace.cap) continue;
+        RLETraceBuf *b = &g_trace.bufs[g_trace.num_bufs];
+        char name[40];
+        snprintf(name, sizeof(name), "%s %d", role, i);
+        rle_trace_buf_init(b, g_trace.num_bufs++, name);
+        args[i].trace = b;
+    }
+}
+
+/* Tramo del hilo principal desde t0 hasta ahora; bytes < 0 = sin tamaño */
+static void trace_main_span(const char *cat, const char *name, uint64_t t0, int64_t bytes) {
+    RLETraceEvent *e = rle_trace_span(trace_main(), cat, name, t0, rle_trace_clock(trace_main()));
+    if (bytes >= 0) rle_trace_arg(e, "bytes", bytes);
+}
+
+static uint64_t timespec_ns(const struct timespec *t) {
+    return (uint64_t)t->tv_sec * 1000000000ull + (uint64_t)t->tv_nsec;
+}
+
+/* Vuelca todos los buffers a g_trace_path y los libera */
+static void trace_finish(const char *what) {
+    if (!g_trace.num_bufs) return;
+    RLETraceBuf **bufs = malloc(g_trace.num_bufs * sizeof(*bufs));
+    FILE *f = bufs ? fopen(g_trace_path, "w") : NULL;
+    size_t dropped = 0;
+    long n = -1;
+    if (f) {
+        /* Modo, count y alloc son los de la compresión; con -d manda el header del .rle */
+        const char *const meta[][2] = {
+            { "program", "rle_paralelo" }, { "phase", what }, { "kernel", g_scan.name },
+            { "mode", rle_mode_name(g_rle_mode) }, { "count", rle_count_name(g_rle_flags) },
+            { "alloc", g_alloc_names[g_alloc_mode] },
+        };
+        int n_meta = strcmp(what, "compress") == 0 ? (int)(sizeof(meta) / sizeof(meta[0])) : 3;
+        for (int i = 0; i < g_trace.num_bufs; i++) {
+            bufs[i] = &g_trace.bufs[i];
+            dropped += bufs[i]->dropped;
+        }
+        n = rle_trace_write(f, bufs, g_trace.num_bufs, g_trace.t0_ns, getpid(), "rle_paralelo",
+                            meta, n_meta);
+        if (fclose(f) != 0) n = -1;
+    }
+    if (n >= 0) {
+        track_syscall("fopen", "open", "Exportar trace de planificación (--trace)");
+        printf("  \033[32mTrace exportado:\033[0m %s (%ld eventos, %d hilos%s; ui.perfetto.dev o "
+               "chrome://tracing)\n\n", g_trace_path, n, g_trace.num_bufs,
+               dropped ? ", con eventos perdidos" : "");
+    } else {
+        fprintf(stderr, "  Error escribiendo el trace '%s': %s\n", g_trace_path, strerror(errno));
+    }
+    free(bufs);
+    for (int i = 0; i < g_trace.num_bufs; i++)
+        rle_trace_buf_release(&g_trace.bufs[i]);
+    free(g_trace.bufs);
+    memset(&g_trace, 0, sizeof(g_trace));
+}
+
+static double prof_sample_ms(const struct timespec *t0, const RLEProfSample *s) {
+    uint64_t base = (uint64_t)t0->tv_sec * 1000000000ull + (uint64_t)t0->tv_nsec;
+    return ((double)s->t_ns - (double)base) / 1e6;
+}
+
+/*
+ * Sección del Gantt CSV: marcas del PC y muestras SIGPROF de cada hilo,
+ * intercaladas por tiempo. La columna source distingue unas de otras.
+ */
+static void write_pc_samples_csv(FILE *csv, const ThreadArg *args, int num_threads,
+                                 const struct timespec *t0) {
+    fprintf(csv, "thread_id,sample_idx,timestamp_ms,pc_addr,core_id,pixels_at,source\n");
+    for (int i = 0; i < num_threads; i++) {
+        const ThreadArg *ta = &args[i];
+        unsigned ns = ta->prof ? rle_prof_count(ta->prof) : 0;
+        int m = 0, idx = 0;
+        unsigned k = 0;
+        while (m < ta->num_pc_samples || k < ns) {
+            const RLEProfSample *ps = k < ns ? rle_prof_at(ta->prof, k) : NULL;
+            double ts = ps ? prof_sample_ms(t0, ps) : 0;
+            if (m < ta->num_pc_samples && (!ps || ta->pc_samples[m].timestamp_ms <= ts)) {
+                const PCSample *mk = &ta->pc_samples[m++];
+                fprintf(csv, "%d,%d,%.4f,0x%lx,%d,%zu,marca\n", i, idx++, mk->timestamp_ms,
+                        (unsigned long)mk->pc_addr, mk->core_id, mk->pixels_at);
+            } else {
+                fprintf(csv, "%d,%d,%.4f,0x%lx,%d,%zu,sigprof\n", i, idx++, ts,
+                        (unsigned long)ps->pc, (int)ps->core, ps->bytes_at);
+                k++;
+            }
+        }
+    }
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  LÍNEA DE TIEMPO - RECURSOS POR HILO
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static void print_resource_timeline(ThreadArg *args, int num_threads,
+                                     struct timespec t0, double elapsed,
+                                     ProgramPhase phase) {
+    const char *CYAN = "\033[36m";
+    const char *YELLOW = "\033[1;33m";
+    const char *GREEN = "\033[32m";
+    const char *RED = "\033[31m";
+    const char *MAGENTA = "\033[35m";
+    const char *WHITE = "\033[1;37m";
+    const char *RESET = "\033[0m";
     const char *DIM = "\033[2m";
 
     /* Colores únicos por hilo */
@@ -949,7 +2015,7 @@ static void print_resource_timeline(ThreadArg *args, int num_threads,
     printf("%s║%s     %s   ██║   ██║███████╗██║ ╚═╝ ██║██║     ╚██████╔╝%s                                %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
     printf("%s║%s     %s   ╚═╝   ╚═╝╚══════╝╚═╝     ╚═╝╚═╝      ╚═════╝%s                                %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
     printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
-    printf("%s║%s     %sLÍNEA DE TIEMPO - RECURSOS ASIGNADOS A CADA HILO%s                                %s║%s\n", CYAN, RESET, WHITE, RESET, CYAN, RESET);
+    printf("%s║%s     %sLÍNEA DE TIEMPO - RECURSOS ASIGNADOS A CADA HILO  [%-13s]%s                %s║%s\n", CYAN, RESET, WHITE, g_phase_names[phase], RESET, CYAN, RESET);
     printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
     printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
 
@@ -985,7 +2051,8 @@ static void print_resource_timeline(ThreadArg *args, int num_threads,
                MAGENTA, args[i].stack_addr ? (unsigned long)args[i].stack_addr : 0, RESET,
                (unsigned long)args[i].pixels,
                RED, RESET,
-               (unsigned long)args[i].result.data,
+               (unsigned long)(args[i].dec_out ? args[i].dec_out + args[i].byte_offset
+                                               : args[i].result.data),
                GREEN, RESET,
                CYAN, RESET);
     }
@@ -1068,8 +2135,10 @@ static void print_resource_timeline(ThreadArg *args, int num_threads,
     printf("%s║%s  │  %sLeyenda:%s                                                                        │  %s║%s\n", CYAN, RESET, WHITE, RESET, CYAN, RESET);
     printf("%s║%s  │    %s░▓%s PADRE: ░=creando hilos  ▓=join/recoger  %s·%s=bloqueado (sin CPU)            │  %s║%s\n",
            CYAN, RESET, MAGENTA, RESET, DIM, RESET, CYAN, RESET);
-    printf("%s║%s  │    %s██%s HIJOS: Ejecutando compresión RLE (cada color = 1 hilo)                    │  %s║%s\n",
-           CYAN, RESET, GREEN, RESET, CYAN, RESET);
+    printf("%s║%s  │    %s██%s HIJOS: Ejecutando %s (cada color = 1 hilo)                 │  %s║%s\n",
+           CYAN, RESET, GREEN, RESET,
+           phase == PHASE_DECOMPRESS ? "descompresión RLE" : "compresión RLE   ",
+           CYAN, RESET);
     printf("%s║%s  │                                                                                  │  %s║%s\n", CYAN, RESET, CYAN, RESET);
 
     printf("%s║%s  └──────────────────────────────────────────────────────────────────────────────────┘  %s║%s\n", CYAN, RESET, CYAN, RESET);
@@ -1092,7 +2161,7 @@ static void print_resource_timeline(ThreadArg *args, int num_threads,
                 GREEN, dur_i * 1000, RESET,
                 MAGENTA, args[i].cpu_time_user * 1000, RESET,
                 MAGENTA, args[i].cpu_time_sys * 1000, RESET,
-                GREEN, args[i].num_pixels, RESET,
+                GREEN, args[i].bytes_done, RESET,
                 CYAN, RESET);
     }
 
@@ -1138,6 +2207,74 @@ static void print_resource_timeline(ThreadArg *args, int num_threads,
     printf("%s║%s  │                                                                                  │  %s║%s\n", CYAN, RESET, CYAN, RESET);
     printf("%s║%s  └──────────────────────────────────────────────────────────────────────────────────┘  %s║%s\n", CYAN, RESET, CYAN, RESET);
 
+    /* ─── Recurso 4: Muestreo del PC por SIGPROF (--profile) ─── */
+    if (num_threads > 0 && args[0].prof) {
+        RLEProfSymbol tab[PROFILE_MAX_SYMBOLS];
+        int ntab = profile_symbols(tab);
+        char line[128];
+
+        printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+        snprintf(line, sizeof(line), "MUESTREO DEL PC (SIGPROF a %d Hz de CPU por hilo) ", g_profile_hz);
+        printf("%s║%s  %s┌─ %s", CYAN, RESET, WHITE, line);
+        for (int c = (int)strlen(line); c < 80; c++) printf("─");
+        printf("┐%s  %s║%s\n", RESET, CYAN, RESET);
+        printf("%s║%s  │                                                                                  │  %s║%s\n", CYAN, RESET, CYAN, RESET);
+        printf("%s║%s  │  %sHilo  Muestras  Perdidas  Cores  Migr.  Funciones (%% de las muestras)%s           │  %s║%s\n",
+               CYAN, RESET, WHITE, RESET, CYAN, RESET);
+        printf("%s║%s  │  ────  ────────  ────────  ─────  ─────  ────────────────────────────────────    │  %s║%s\n",
+               CYAN, RESET, CYAN, RESET);
+
+        /* Totales por función sobre todos los hilos */
+        const char *names[PROFILE_MAX_SYMBOLS + 2];
+        unsigned counts[PROFILE_MAX_SYMBOLS + 2];
+        int distinct = 0;
+        unsigned total = 0;
+        for (int i = 0; i < num_threads && i < 8; i++) {
+            RLEProfSummary sum;
+            rle_prof_summarize(args[i].prof, tab, ntab, &sum);
+            char top[96] = "";
+            size_t used = 0;
+            for (int t = 0; t < sum.num_top && t < 2; t++)
+                used += snprintf(top + used, sizeof(top) - used, "%s%s %.0f%%", t ? ", " : "",
+                                 sum.top_name[t], 100.0 * sum.top_count[t] / sum.samples);
+            printf("%s║%s  │  %s[%d]%s   %s%8u%s  %8u  %5d  %5u  %-36.36s    │  %s║%s\n",
+                   CYAN, RESET, GREEN, i, RESET, YELLOW, sum.samples, RESET, sum.lost,
+                   sum.cores, sum.migrations, sum.samples ? top : "(sin muestras)", CYAN, RESET);
+        }
+        for (int i = 0; i < num_threads; i++) {
+            unsigned ns = rle_prof_count(args[i].prof);
+            for (unsigned k = 0; k < ns; k++) {
+                const char *name = rle_prof_symbolize(tab, ntab, rle_prof_at(args[i].prof, k)->pc);
+                int j = 0;
+                while (j < distinct && names[j] != name) j++;
+                if (j == distinct) { names[distinct] = name; counts[distinct++] = 0; }
+                counts[j]++;
+                total++;
+            }
+        }
+
+        printf("%s║%s  │                                                                                  │  %s║%s\n", CYAN, RESET, CYAN, RESET);
+        printf("%s║%s  │  %sTotal por función (%6u muestras):%s                                            │  %s║%s\n",
+               CYAN, RESET, WHITE, total, RESET, CYAN, RESET);
+        for (int t = 0; t < distinct && t < 6; t++) {
+            int best = t;
+            for (int j = t + 1; j < distinct; j++)
+                if (counts[j] > counts[best]) best = j;
+            const char *nm = names[t]; names[t] = names[best]; names[best] = nm;
+            unsigned c = counts[t]; counts[t] = counts[best]; counts[best] = c;
+            double pct = 100.0 * counts[t] / total;
+            int bar = (int)(pct / 100.0 * 30 + 0.5);
+            printf("%s║%s  │    %-24s %s%8u%s  %5.1f%%  %s", CYAN, RESET, names[t], GREEN, counts[t],
+                   RESET, pct, MAGENTA);
+            for (int b = 0; b < 30; b++) printf(b < bar ? "█" : " ");
+            printf("%s     │  %s║%s\n", RESET, CYAN, RESET);
+        }
+        printf("%s║%s  │                                                                                  │  %s║%s\n", CYAN, RESET, CYAN, RESET);
+        printf("%s║%s  │  %sPC real del ucontext; función = símbolo registrado más cercano ≤ PC%s             │  %s║%s\n",
+               CYAN, RESET, DIM, RESET, CYAN, RESET);
+        printf("%s║%s  └──────────────────────────────────────────────────────────────────────────────────┘  %s║%s\n", CYAN, RESET, CYAN, RESET);
+    }
+
     printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n", CYAN, RESET);
 }
 
@@ -1245,9 +2382,12 @@ static void print_heap_visualization(void) {
     printf("%s║%s  │ %s#   Direccion         Solicitado     Real (malloc_size)  Etiqueta%s              │ %s║%s\n", CYAN, RESET, WHITE, RESET, CYAN, RESET);
     printf("%s║%s  │ ──  ────────────────   ────────────   ──────────────────  ──────────────────────│ %s║%s\n", CYAN, RESET, CYAN, RESET);
 
-    size_t total_requested = 0, total_actual = 0;
+    size_t total_requested = 0, total_actual = 0, total_initial = 0;
+    int total_resizes = 0;
     for (int i = 0; i < g_num_heap_entries; i++) {
         HeapAllocation *h = &g_heap_log[i];
+        total_initial += h->initial_size;
+        total_resizes += h->resizes;
         const char *status_color = h->freed ? RED : GREEN;
         const char *status_str = h->freed ? "[LIBRE]" : "[ACTIVO]";
         printf("%s║%s  │ %s%-2d%s  %s0x%014lx%s   %s%10zu B%s   %s%10zu B%s    %s%-18s%s %s%s%s│ %s║%s\n",
@@ -1269,6 +2409,9 @@ static void print_heap_visualization(void) {
            CYAN, RESET, DIM, total_actual - total_requested,
            total_requested > 0 ? (total_actual - total_requested) * 100.0 / total_requested : 0,
            RESET, CYAN, RESET);
+    printf("%s║%s  │ %sReserva --alloc %-5s: inicial %10zu B → final %10zu B, %3d realloc%s │ %s║%s\n",
+           CYAN, RESET, YELLOW, g_alloc_names[g_alloc_mode], total_initial, total_requested,
+           total_resizes, RESET, CYAN, RESET);
     printf("%s║%s  %s└─────────────────────────────────────────────────────────────────────────────────┘%s %s║%s\n", CYAN, RESET, WHITE, RESET, CYAN, RESET);
     printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
 
@@ -1316,7 +2459,7 @@ static void print_global_variables(void) {
            CYAN, RESET, MAGENTA, (unsigned long)&g_initialized_var, RESET, g_initialized_var, CYAN, RESET);
     printf("%s║%s  │  g_program_name         %s0x%014lx%s  8 B    \"%s\"           │    %s║%s\n",
            CYAN, RESET, MAGENTA, (unsigned long)&g_program_name, RESET, g_program_name, CYAN, RESET);
-    printf("%s║%s  │  g_num_threads_config   %s0x%014lx%s  4 B    valor: %d                │    %s║%s\n",
+    printf("%s║%s  │  g_num_threads_config   %s0x%014lx%s  4 B    valor: %-2d               │    %s║%s\n",
            CYAN, RESET, MAGENTA, (unsigned long)&g_num_threads_config, RESET, g_num_threads_config, CYAN, RESET);
     printf("%s║%s  %s└──────────────────────────────────────────────────────────────────────────────┘%s    %s║%s\n", CYAN, RESET, WHITE, RESET, CYAN, RESET);
     printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
@@ -1461,7 +2604,7 @@ static void print_ipc_visualization(ThreadArg *args, int num_threads, size_t tot
     printf("%s║%s  │  %s1. Memoria compartida%s (img.data leida por todos los hilos)                   │  %s║%s\n", CYAN, RESET, GREEN, RESET, CYAN, RESET);
     printf("%s║%s  │     → Todos los hilos leen del mismo buffer sin copia. Solo lectura = seguro. │  %s║%s\n", CYAN, RESET, CYAN, RESET);
     printf("%s║%s  │                                                                                │  %s║%s\n", CYAN, RESET, CYAN, RESET);
-    printf("%s║%s  │  %s2. Variables atomicas%s (pixels_done, g_total_runs_atomic)                     │  %s║%s\n", CYAN, RESET, GREEN, RESET, CYAN, RESET);
+    printf("%s║%s  │  %s2. Variables atomicas%s (progress, g_total_runs_atomic)                        │  %s║%s\n", CYAN, RESET, GREEN, RESET, CYAN, RESET);
     printf("%s║%s  │     → Operaciones lock-free con garantia de coherencia (CAS/LOCK prefix).     │  %s║%s\n", CYAN, RESET, CYAN, RESET);
     printf("%s║%s  │                                                                                │  %s║%s\n", CYAN, RESET, CYAN, RESET);
     printf("%s║%s  │  %s3. Argumentos de hilo%s (main escribe ThreadArg, worker lee)                   │  %s║%s\n", CYAN, RESET, GREEN, RESET, CYAN, RESET);
@@ -1723,193 +2866,4009 @@ static void print_error_handling_demo(void) {
 }
 
 /* ═══════════════════════════════════════════════════════════════════════════
- *  FUNCIÓN PRINCIPAL
+ *  MODO DESCOMPRESIÓN: leer un .rle (contenedor indexado o formato legado)
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-int main(int argc, char *argv[]) {
-    /* Inicializar seguimiento de SO */
-    setup_signal_handlers();
-    capture_baseline_ctx();
-    g_current_phase = PHASE_INIT;
-
-    /* Variables en STACK - marcadores */
-    int stack_marker_top = 0;
-    Image img;
-    int used_stb = 0;
-    char input_path[512] = {0};
-
-    /* Inicializar variable atómica global */
-    atomic_init(&g_total_runs_atomic, 0);
-
-    /* Cargar imagen: argumento, menú interactivo, o sintética */
-    if (argc >= 2) {
-        strncpy(input_path, argv[1], sizeof(input_path) - 1);
-        if (load_image(input_path, &img) != 0) {
-            return 1;
-        }
-        used_stb = 1;
-    } else {
-        /* Escanear carpeta image/ y listar imágenes disponibles */
-        const char *img_dir = "image";
-        char files[64][256];
-        int nfiles = 0;
-
-        DIR *dir = opendir(img_dir);
-        if (dir) {
-            struct dirent *entry;
-            while ((entry = readdir(dir)) != NULL && nfiles < 64) {
-                const char *name = entry->d_name;
-                size_t len = strlen(name);
-                if (len < 5) continue;
-                const char *ext = name + len - 4;
-                const char *ext3 = name + len - 3;
-                if (strcasecmp(ext, ".png") == 0 || strcasecmp(ext, ".jpg") == 0 ||
-                    strcasecmp(ext, ".bmp") == 0 || strcasecmp(ext, ".gif") == 0 ||
-                    strcasecmp(ext, ".tga") == 0 || strcasecmp(ext, ".psd") == 0 ||
-                    strcasecmp(ext, ".hdr") == 0 || strcasecmp(ext3, ".jpeg") == 0) {
-                    strncpy(files[nfiles], name, 255);
-                    files[nfiles][255] = '\0';
-                    nfiles++;
-                }
-            }
-            closedir(dir);
-        }
+static int decompress_file(const char *path) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RED = "\033[31m";
+    const char *RESET = "\033[0m";
 
-        printf("\n\033[1;36m╔══════════════════════════════════════════════════════════════╗\033[0m\n");
-        printf("\033[1;36m║\033[0m  \033[1;33mCOMPRESIÓN RLE - MODO PARALELO\033[0m                              \033[1;36m║\033[0m\n");
-        printf("\033[1;36m╠══════════════════════════════════════════════════════════════╣\033[0m\n");
-        printf("\033[1;36m║\033[0m                                                              \033[1;36m║\033[0m\n");
-        printf("\033[1;36m║\033[0m  \033[1;37mImágenes disponibles en /%s/:\033[0m                              \033[1;36m║\033[0m\n", img_dir);
-        printf("\033[1;36m║\033[0m                                                              \033[1;36m║\033[0m\n");
+    g_current_phase = PHASE_DECOMPRESS;
+    RLEContainer rc;
+    uint64_t read_t0 = rle_trace_clock(trace_main());
+    if (rle_container_open(path, &rc) != 0) return 1;
+    track_syscall("fopen", "open", "Abrir archivo RLE para lectura");
+    track_syscall("fread", "read", "Leer archivo RLE completo");
+
+    uint32_t w = rc.header.width, h = rc.header.height;
+    size_t raw_size = (size_t)w * h * 3;
+    uint32_t bad = rle_container_verify(&rc);
+    trace_main_span("io", "leer .rle", read_t0, -1);
+
+    uint8_t *decoded = malloc(raw_size ? raw_size : 1);
+    if (!decoded) { perror("malloc decompress"); rle_container_close(&rc); return 1; }
+    track_heap_alloc(decoded, raw_size, "Imagen decodificada");
+
+    /* Un hilo por core (como la compresión); cada uno toma chunks contiguos */
+    int num_threads = worker_threads();
+    if (rc.header.num_chunks > 0 && (uint32_t)num_threads > rc.header.num_chunks)
+        num_threads = (int)rc.header.num_chunks;
+
+    const uint8_t **chunk_src = malloc((rc.header.num_chunks + 1) * sizeof(*chunk_src));
+    ThreadArg *dargs = rle_cacheline_calloc(num_threads, sizeof(ThreadArg));
+    if (!chunk_src || !dargs) {
+        perror("malloc");
+        free(chunk_src); free(dargs); free(decoded); rle_container_close(&rc);
+        return 1;
+    }
+    for (uint32_t i = 0; i < rc.header.num_chunks; i++)
+        chunk_src[i] = rle_chunk_data(&rc, i);
 
-        if (nfiles == 0) {
-            printf("\033[1;36m║\033[0m    \033[31m(No se encontraron imágenes en /%s/)\033[0m                  \033[1;36m║\033[0m\n", img_dir);
-        } else {
-            for (int i = 0; i < nfiles; i++) {
-                printf("\033[1;36m║\033[0m    \033[1;32m[%d]\033[0m %-50s  \033[1;36m║\033[0m\n", i + 1, files[i]);
-            }
-        }
+    struct timespec td_start;
+    setup_decode_args(dargs, num_threads, rc.chunks, chunk_src, rc.header.num_chunks,
+                      decoded, w, rc.header.mode, rc.header.flags);
+    for (int i = 0; i < num_threads; i++)
+        dargs[i].dec_bgr = g_decode_bgr;
+    RLEProfRing *prof_rings = profile_attach(dargs, num_threads);
+    trace_attach(dargs, num_threads, "descompresor");
+    double decomp_time = run_decode_threads(dargs, num_threads, &td_start);
+    trace_main_span("phase", "descompresión", timespec_ns(&td_start), (int64_t)raw_size);
+
+    size_t total_out = 0;
+    uint32_t raw_bad = 0;
+    for (int i = 0; i < num_threads; i++) {
+        total_out += dargs[i].dec_bytes;
+        raw_bad += dargs[i].dec_bad;
+    }
 
-        printf("\033[1;36m║\033[0m                                                              \033[1;36m║\033[0m\n");
-        printf("\033[1;36m║\033[0m    \033[1;33m[0]\033[0m Usar imagen sintética (4096x4096)                    \033[1;36m║\033[0m\n");
-        printf("\033[1;36m║\033[0m    \033[1;35m[B]\033[0m Buscar archivo con explorador de archivos...         \033[1;36m║\033[0m\n");
-        printf("\033[1;36m║\033[0m                                                              \033[1;36m║\033[0m\n");
-        printf("\033[1;36m╚══════════════════════════════════════════════════════════════╝\033[0m\n");
-        printf("\n  Seleccione imagen (número o 'b'): ");
-        fflush(stdout);
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                    %s*** DESCOMPRESIÓN DE ARCHIVO .RLE ***%s                          %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s  %sArchivo:%s                  %s%-50s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, path, RESET, CYAN, RESET);
+    printf("%s║%s  %sFormato:%s                  %s%-50s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN,
+           rc.legacy ? "legado {width,height} + runs (sin índice)" : "contenedor RLEC v1 indexado",
+           RESET, CYAN, RESET);
+    printf("%s║%s  %sDimensiones:%s              %u x %u px, %u chunk(s)                               %s║%s\n",
+           CYAN, RESET, WHITE, RESET, w, h, rc.header.num_chunks, CYAN, RESET);
+    char mode_desc[64];
+    snprintf(mode_desc, sizeof(mode_desc), "%s (count %s)",
+             rle_mode_name(rc.header.mode), rle_count_name(rc.header.flags));
+    printf("%s║%s  %sModo de codificación:%s     %s%-50s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, mode_desc, RESET, CYAN, RESET);
+    for (uint32_t i = 0; i < rc.header.num_chunks && i < 8; i++) {
+        const RLEChunkEntry *e = &rc.chunks[i];
+        printf("%s║%s    chunk[%u]  filas %5u-%-5u  offset %10llu  %10llu B  crc32c 0x%08x        %s║%s\n",
+               CYAN, RESET, i, e->start_row, e->start_row + e->num_rows - 1,
+               (unsigned long long)e->offset, (unsigned long long)e->length,
+               e->checksum, CYAN, RESET);
+    }
+    printf("%s║%s  %sTiempo de descompresión:%s  %s%12.6f%s segundos (%d hilos)                           %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, decomp_time, RESET, num_threads, CYAN, RESET);
+    printf("%s║%s  %sChecksums:%s                %s%s%s                                                    %s║%s\n",
+           CYAN, RESET, WHITE, RESET, bad ? RED : GREEN,
+           bad ? "ERROR - chunks corruptos" : "CORRECTOS (CRC32C por chunk)", RESET, CYAN, RESET);
+    if (rc.header.flags & RLE_FLAG_RAW_CRC) {
+        /* --verify checksum: CRC32C de cada banda decodificada contra raw_checksum */
+        char raw_desc[64];
+        if (raw_bad)
+            snprintf(raw_desc, sizeof(raw_desc), "ERROR - %u banda(s) distintas", raw_bad);
+        else
+            snprintf(raw_desc, sizeof(raw_desc), "CORRECTOS (CRC32C de cada banda)");
+        printf("%s║%s  %sCRC sin comprimir:%s        %s%-50s%s     %s║%s\n",
+               CYAN, RESET, WHITE, RESET, raw_bad ? RED : GREEN, raw_desc, RESET, CYAN, RESET);
+    }
+    printf("%s║%s  %sBytes decodificados:%s      %s%12zu%s de %zu                                    %s║%s\n",
+           CYAN, RESET, WHITE, RESET, total_out == raw_size ? GREEN : RED,
+           total_out, RESET, raw_size, CYAN, RESET);
+
+    char bmppath[512];
+    snprintf(bmppath, sizeof(bmppath), "%s_descomprimida.bmp", path);
+    uint64_t bmp_t0 = rle_trace_clock(trace_main());
+    if (librle_bmp_save(&g_lib, bmppath, decoded, w, h, g_decode_bgr) != RLE_LIB_OK)
+        fprintf(stderr, "  %s\n", librle_error(&g_lib));
+    trace_main_span("io", "guardar BMP", bmp_t0, (int64_t)raw_size);
+    printf("%s║%s  %sImagen descomprimida:%s     %s%-50s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, bmppath, RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+
+    if (decomp_time >= 0)
+        print_resource_timeline(dargs, num_threads, td_start, decomp_time, PHASE_DECOMPRESS);
+    if (decomp_time >= 0 && g_perf)
+        print_perf_counters(dargs, num_threads, PHASE_DECOMPRESS);
+
+    free(prof_rings);
+    free(dargs);
+    free(chunk_src);
+    track_heap_free(decoded);
+    free(decoded);
+    rle_container_close(&rc);
+    return (bad == 0 && raw_bad == 0 && total_out == raw_size) ? 0 : 1;
+}
 
-        char choice[16];
-        int sel = 0;
-        int use_browser = 0;
-        if (fgets(choice, sizeof(choice), stdin)) {
-            if (choice[0] == 'b' || choice[0] == 'B') {
-                use_browser = 1;
-            } else {
-                sel = atoi(choice);
-            }
-        }
+/*
+ * -d archivo.rle --rows Y0:Y1: decodifica solo las filas [Y0, Y1) con
+ * librle_file_decode_rows sobre el archivo mapeado. Solo se tocan (y se leen
+ * del disco) los chunks que se superponen con la ventana; el BMP lleva
+ * únicamente esas filas.
+ */
+static int decompress_rows(const char *path, uint32_t y0, uint32_t y1) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RED = "\033[31m";
+    const char *RESET = "\033[0m";
 
-        if (use_browser) {
-            /* Abrir diálogo nativo de macOS para seleccionar imagen */
-            FILE *fp = popen(
-                "osascript -e 'set theFile to choose file with prompt "
-                "\"Seleccione una imagen para comprimir\" of type "
-                "{\"public.png\", \"public.jpeg\", \"public.bmp\", \"public.gif\", "
-                "\"public.targa-image\", \"com.adobe.photoshop-image\", "
-                "\"public.radiance\"}' "
-                "-e 'POSIX path of theFile'", "r");
-            if (fp) {
-                char browser_path[512] = {0};
-                if (fgets(browser_path, sizeof(browser_path), fp)) {
-                    /* Quitar salto de línea */
-                    size_t blen = strlen(browser_path);
-                    if (blen > 0 && browser_path[blen - 1] == '\n')
-                        browser_path[blen - 1] = '\0';
-                    strncpy(input_path, browser_path, sizeof(input_path) - 1);
-                }
-                int ret = pclose(fp);
-                if (ret != 0 || input_path[0] == '\0') {
-                    printf("  \033[33mNo se seleccionó archivo. Usando imagen sintética...\033[0m\n");
-                    generate_synthetic(&img, 4096, 4096);
-                } else if (load_image(input_path, &img) != 0) {
-                    printf("  \033[33mUsando imagen sintética como respaldo...\033[0m\n");
-                    generate_synthetic(&img, 4096, 4096);
-                } else {
-                    used_stb = 1;
-                }
-            } else {
-                printf("  \033[33mNo se pudo abrir el explorador. Usando imagen sintética...\033[0m\n");
-                generate_synthetic(&img, 4096, 4096);
-            }
-        } else if (sel >= 1 && sel <= nfiles) {
-            snprintf(input_path, sizeof(input_path), "%s/%s", img_dir, files[sel - 1]);
-            if (load_image(input_path, &img) != 0) {
-                printf("  \033[33mUsando imagen sintética como respaldo...\033[0m\n");
-                generate_synthetic(&img, 4096, 4096);
-            } else {
-                used_stb = 1;
-            }
-        } else {
-            printf("  \033[33mGenerando imagen sintética 4096x4096...\033[0m\n");
-            generate_synthetic(&img, 4096, 4096);
+    g_current_phase = PHASE_DECOMPRESS;
+    RLELibConfig cfg;
+    librle_config_default(&cfg);
+    cfg.backend = RLE_LIB_THREADS;
+    cfg.threads = worker_threads();
+    cfg.bgr = g_decode_bgr;
+    RLELib lib;
+    librle_init(&lib, &cfg);
+    lib.kernel = g_scan;
+
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    RLELibFile f;
+    if (librle_file_open(&lib, &f, path) != RLE_LIB_OK) {
+        fprintf(stderr, "  %s\n", librle_error(&lib));
+        librle_release(&lib);
+        return 1;
+    }
+    track_syscall("open", "open", "Abrir archivo RLE para lectura");
+    track_syscall("mmap", "mmap", "Mapear el .rle (MADV_RANDOM: sin readahead)");
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    uint32_t w = f.header.width, h = f.header.height;
+    if (y1 > h || y0 >= y1) {
+        fprintf(stderr, "  --rows %u:%u fuera de la imagen (%u filas)\n", y0, y1, h);
+        librle_file_close(&f);
+        librle_release(&lib);
+        return 1;
+    }
+    size_t out_size = (size_t)(y1 - y0) * w * 3;
+    uint8_t *rows = malloc(out_size ? out_size : 1);
+    if (!rows) {
+        perror("malloc");
+        librle_file_close(&f);
+        librle_release(&lib);
+        return 1;
+    }
+    track_heap_alloc(rows, out_size, "Ventana decodificada");
+    int rc = librle_file_decode_rows(&lib, &f, y0, y1, rows, out_size);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    if (rc != RLE_LIB_OK && rc != RLE_LIB_ECORRUPT)
+        fprintf(stderr, "  librle: %s\n", librle_error(&lib));
+
+    /* Chunks de la ventana y los bytes comprimidos que se leyeron de ellos */
+    uint64_t rle_read = 0, rle_total = 0;
+    uint32_t first = UINT32_MAX, last = 0;
+    for (uint32_t i = 0; i < f.header.num_chunks; i++) {
+        const RLEChunkEntry *e = &f.chunks[i];
+        rle_total += e->length;
+        if (e->start_row < y1 && e->start_row + e->num_rows > y0) {
+            rle_read += e->length;
+            if (first == UINT32_MAX) first = i;
+            last = i;
         }
     }
 
-    size_t total_pixels = (size_t)img.width * img.height;
-    size_t raw_size = total_pixels * 3;
+    char bmppath[512], line[128];
+    snprintf(bmppath, sizeof(bmppath), "%s_filas_%u-%u.bmp", path, y0, y1 - 1);
+    if (librle_bmp_save(&g_lib, bmppath, rows, w, y1 - y0, g_decode_bgr) != RLE_LIB_OK)
+        fprintf(stderr, "  %s\n", librle_error(&g_lib));
 
-    /* Guardar archivo RAW (RGB) */
-    char rawpath[512];
-    if (input_path[0])
-        snprintf(rawpath, sizeof(rawpath), "%s.raw", input_path);
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                      %s*** DECODIFICACIÓN POR FILAS (--rows) ***%s                       %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s  %sArchivo:%s                  %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, path, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "filas %u-%u de %u (%u x %u px)", y0, y1 - 1, h, w, y1 - y0);
+    printf("%s║%s  %sVentana:%s                  %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%u de %u (chunks %u-%u)", lib.stats.num_chunks,
+             f.header.num_chunks, first, last);
+    printf("%s║%s  %sChunks decodificados:%s     %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.2f KB de %.2f KB (%.1f%% del archivo)", rle_read / 1024.0,
+             rle_total / 1024.0, rle_total ? 100.0 * rle_read / rle_total : 0.0);
+    printf("%s║%s  %sRLE leído:%s                %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.3f ms (mmap + tabla)", ts_relative_ms(&t0, &t1));
+    printf("%s║%s  %sApertura:%s                 %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.3f ms, %d hilo(s)", ts_relative_ms(&t1, &t2), lib.stats.threads_used);
+    printf("%s║%s  %sDecodificación:%s           %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    if (rc == RLE_LIB_OK)
+        snprintf(line, sizeof(line), "CORRECTA (%zu bytes)", lib.stats.bytes);
     else
-        snprintf(rawpath, sizeof(rawpath), "output.raw");
+        snprintf(line, sizeof(line), "ERROR - %s", librle_strerror(rc));
+    printf("%s║%s  %sResultado:%s                %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, rc == RLE_LIB_OK ? GREEN : RED, line, RESET, CYAN, RESET);
+    printf("%s║%s  %sImagen descomprimida:%s     %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, bmppath, RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+
+    track_heap_free(rows);
+    free(rows);
+    librle_file_close(&f);
+    librle_release(&lib);
+    return rc == RLE_LIB_OK ? 0 : 1;
+}
 
-    FILE *fraw = fopen(rawpath, "wb");
-    if (fraw) {
-        fwrite(img.data, 1, raw_size, fraw);
-        fclose(fraw);
-        printf("  \033[32mArchivo RAW guardado:\033[0m %s (%.2f KB)\n", rawpath, raw_size / 1024.0);
-    }
+/*
+ * --update imagen: en lugar de reescribir el .rle completo, compara cada
+ * banda de la imagen con el .rle existente y agrega al final solo los chunks
+ * de las que cambiaron (librle_update_file). Modo, flags y tiles son los del
+ * archivo, no los de la línea de comandos.
+ */
+static int update_file(const RLELibImage *img, const char *path) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RESET = "\033[0m";
 
-    /* Detectar número de cores */
-    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
-    if (num_threads < 1) num_threads = 1;
-    if ((size_t)num_threads > img.height) num_threads = (int)img.height;
+    g_current_phase = PHASE_COMPRESS;
+    RLELibConfig cfg;
+    librle_config_default(&cfg);
+    cfg.backend = RLE_LIB_THREADS;
+    cfg.threads = worker_threads();
+    RLELib lib;
+    librle_init(&lib, &cfg);
+    lib.kernel = g_scan;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    RLELibUpdate up;
+    int rc = librle_update_file(&lib, path, img->data, img->width, img->height, &up);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (rc != RLE_LIB_OK) {
+        fprintf(stderr, "  librle: %s\n", librle_error(&lib));
+        librle_release(&lib);
+        return 1;
+    }
+    track_syscall("mmap", "mmap", "Mapear el .rle existente para comparar las bandas");
+    if (up.compacted) {
+        track_syscall("pwrite", "pwrite", "Escribir el .rle compactado en <archivo>.tmp");
+        track_syscall("fsync", "fsync", "Archivo compactado en disco antes del rename");
+        track_syscall("rename", "rename", "Reemplazar el .rle por la versión compactada");
+    } else if (up.written > 0) {
+        track_syscall("pwrite", "pwrite", "Agregar chunks cambiados y tabla nueva al final");
+        track_syscall("fsync", "fsync", "Chunks en disco antes de publicar el header nuevo");
+    }
 
-    int stack_marker_bottom = 0;  /* Marcador base de pila */
+    char line[128];
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                    %s*** ACTUALIZACIÓN INCREMENTAL (--update) ***%s                      %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s  %sArchivo:%s                  %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, path, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%u de %u (%s)", up.changed, up.num_chunks,
+             up.by_crc ? "por CRC32C de la banda" : "decodificando el .rle");
+    printf("%s║%s  %sBandas cambiadas:%s         %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.2f KB %s (%.1f%% de reescribir todo)", up.written / 1024.0,
+             up.compacted ? "compactados" : "agregados",
+             up.live ? 100.0 * up.written / up.live : 0.0);
+    printf("%s║%s  %sEscrito:%s                  %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.3f ms, %d hilo(s)", ts_relative_ms(&t0, &t1), lib.stats.threads_used);
+    printf("%s║%s  %sTiempo:%s                   %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.2f KB (%.1f%% del archivo)", up.dead / 1024.0,
+             up.file_size ? 100.0 * up.dead / up.file_size : 0.0);
+    printf("%s║%s  %sEspacio muerto:%s           %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    printf("%s║%s  %sResultado:%s                %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN,
+           up.compacted ? "COMPACTADO (archivo reescrito sin espacio muerto)" :
+           up.changed ? "ACTUALIZADO (header nuevo publicado)" :
+           up.written ? "SIN CAMBIOS (raw_checksum agregados)" : "SIN CAMBIOS (archivo intacto)",
+           RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
 
-    /* Preparar argumentos para cada hilo */
-    pthread_t *threads = malloc(sizeof(pthread_t) * num_threads);
-    ThreadArg *args = calloc(num_threads, sizeof(ThreadArg));
-    if (!threads || !args) { perror("malloc"); return 1; }
+    librle_release(&lib);
+    return 0;
+}
 
-    /* Distribuir filas equitativamente */
-    uint32_t rows_per = img.height / num_threads;
-    uint32_t extra = img.height % num_threads;
-    uint32_t row_off = 0;
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  COMPRESIÓN POR STRIPS (--stream): memoria acotada, imagen > RAM
+ * ═══════════════════════════════════════════════════════════════════════════ */
 
-    for (int i = 0; i < num_threads; i++) {
-        uint32_t rows = rows_per + (i < (int)extra ? 1 : 0);
-        args[i].thread_idx = i;
-        args[i].pixels = img.data + (size_t)row_off * img.width * 3;
-        args[i].num_pixels = (size_t)rows * img.width * 3;
-        args[i].start_row = row_off;
-        args[i].num_rows = rows;
-        args[i].byte_offset = (size_t)row_off * img.width * 3;
-        atomic_init(&args[i].pixels_done, 0);
-        args[i].system_tid = 0;
-        args[i].stack_addr = NULL;
-        args[i].cpu_time_user = 0;
-        args[i].cpu_time_sys = 0;
-        args[i].num_pc_samples = 0;
-        args[i].t0_ref = NULL; /* Se asigna justo antes de crear hilos */
+/*
+ * Estado compartido de --stream. Cada hilo toma el siguiente strip
+ * (next_claim), lo lee con pread y lo comprime en sus propios buffers, y
+ * espera su turno (next_write) para agregarlo al .rle en orden. Un hilo no
+ * toma otro strip hasta haber escrito el suyo, así que nunca hay más strips
+ * en memoria que hilos (--inflight N). En la verificación no hay turno: cada
+ * hilo relee su chunk, lo decodifica, lo compara con el original y escribe
+ * sus filas del BMP con pwrite en su posición.
+ */
+typedef struct {
+    pthread_mutex_t  lock;
+    pthread_cond_t   turn;
+    uint32_t         next_claim;
+    uint32_t         next_write;
+    int              failed;
+    int              verify;        /* 0 = compresión, 1 = verificación */
+    RLEStripInput   *in;
+    RLEStreamWriter *writer;
+    RLEChunkEntry   *chunks;
+    uint32_t         num_strips;
+    size_t           strip_bytes;   /* bytes del strip más alto */
+    size_t           bound;         /* capacidad del buffer comprimido */
+    int              rle_fd;        /* verificación: .rle escrito */
+    int              bmp_fd;        /* verificación: BMP de salida */
+    uint32_t         bad_crc;
+    uint32_t         bad_strips;
+} StripStream;
+
+typedef struct {
+    StripStream *s;
+    uint8_t     *strip;
+    uint8_t     *packed;
+    uint8_t     *scratch;           /* modo planar (compresión) / decodificado (verificación) */
+    uint8_t     *row;               /* bloque de filas del BMP (rle_bmp_block_size) */
+    uint32_t     strips_done;
+    size_t       bytes_out;
+} StripWorker;
+
+static StripStream g_strips = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                                0, 0, 0, 0, NULL, NULL, NULL, 0, 0, 0, -1, -1, 0, 0 };
+
+/* Pico de RSS del proceso en bytes (ru_maxrss: KB en Linux, bytes en macOS) */
+static size_t get_peak_rss(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
 #ifdef __APPLE__
-        args[i].mach_thread = 0;
-        args[i].core_affinity = i % (int)sysconf(_SC_NPROCESSORS_ONLN);
+    return (size_t)ru.ru_maxrss;
+#else
+    return (size_t)ru.ru_maxrss * 1024;
+#endif
+}
+
+static void strip_fail(StripStream *s) {
+    pthread_mutex_lock(&s->lock);
+    s->failed = 1;
+    pthread_cond_broadcast(&s->turn);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void *stream_thread_func(void *arg) {
+    StripWorker *wk = (StripWorker *)arg;
+    StripStream *s = wk->s;
+    const uint32_t w = s->in->width, h = s->in->height;
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        uint32_t i = s->next_claim++;
+        int stop = s->failed || i >= s->num_strips;
+        pthread_mutex_unlock(&s->lock);
+        if (stop) break;
+
+        const RLEChunkEntry *e = &s->chunks[i];
+        size_t bytes = (size_t)e->num_rows * w * 3;
+        if (rle_strip_read(s->in, e->start_row, e->num_rows, wk->strip) != 0) {
+            fprintf(stderr, "  Error leyendo filas %u-%u de la entrada\n",
+                    e->start_row, e->start_row + e->num_rows - 1);
+            strip_fail(s);
+            break;
+        }
+
+        if (s->verify) {
+            if (e->length > s->bound ||
+                rle_pread_full(s->rle_fd, wk->packed, e->length, e->offset) != 0) {
+                strip_fail(s);
+                break;
+            }
+            int crc_ok = rle_crc32c(0, wk->packed, e->length) == e->checksum;
+            size_t got = rle_decode_chunk(g_rle_mode, g_rle_flags, e->codec, wk->packed,
+                                          e->length, wk->scratch, bytes);
+            int same = got == bytes && memcmp(wk->scratch, wk->strip, bytes) == 0;
+            if (rle_bmp_write_rows(s->bmp_fd, wk->scratch, w, h, e->start_row, e->num_rows,
+                                   0, wk->row) != 0) {
+                strip_fail(s);
+                break;
+            }
+            pthread_mutex_lock(&s->lock);
+            s->bad_crc += !crc_ok;
+            s->bad_strips += !same;
+            pthread_mutex_unlock(&s->lock);
+            wk->strips_done++;
+            continue;
+        }
+
+        RLELibChunk c = { .band = wk->strip, .bytes = bytes, .scratch = wk->scratch,
+                          .dst = wk->packed, .codec = -1, .crc = 1, .index = i };
+        librle_encode_chunk(&g_lib, &c);        /* con dst no falla */
+        size_t len = c.entry.length;
+        atomic_fetch_add(&g_total_runs_atomic, c.records);
+        uint32_t crc = c.entry.checksum;
+        s->chunks[i].raw_checksum = c.entry.raw_checksum;
+        s->chunks[i].codec = c.entry.codec;
+
+        /* Turno de escritura: los chunks salen en el orden de las filas */
+        pthread_mutex_lock(&s->lock);
+        while (s->next_write != i && !s->failed)
+            pthread_cond_wait(&s->turn, &s->lock);
+        int ok = !s->failed && rle_stream_append(s->writer, wk->packed, len, crc) == 0;
+        if (ok) s->next_write++;
+        else s->failed = 1;
+        pthread_cond_broadcast(&s->turn);
+        pthread_mutex_unlock(&s->lock);
+        if (!ok) break;
+        wk->strips_done++;
+        wk->bytes_out += len;
+    }
+    return NULL;
+}
+
+/* Lanza num_workers hilos sobre g_strips y mide el tiempo de pared */
+static double run_stream_threads(StripWorker *workers, int num_workers) {
+    pthread_t *tids = malloc(num_workers * sizeof(pthread_t));
+    if (!tids) { perror("malloc"); g_strips.failed = 1; return 0; }
+    g_strips.next_claim = 0;
+    g_strips.next_write = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int started = 0;
+    for (; started < num_workers; started++) {
+        workers[started].strips_done = 0;
+        if (pthread_create(&tids[started], NULL, stream_thread_func, &workers[started]) != 0) {
+            perror("pthread_create");
+            strip_fail(&g_strips);
+            break;
+        }
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    free(tids);
+    return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+}
+
+/*
+ * --pipeline: las etapas de --stream en hilos separados, unidas por un anillo
+ * acotado de `depth` slots (strip leído + buffer comprimido):
+ *
+ *   lector (1)          compresores (N)        escritor (1)
+ *   pread strip i  ──>  RLE strip i      ──>   CRC32C + fwrite chunk i
+ *   slot LIBRE→CARGADO  CARGADO→RLE→LISTO      LISTO→LIBRE (en orden)
+ *
+ * El slot del strip i es i % depth: el lector solo lo reutiliza cuando el
+ * escritor terminó con el strip i - depth, así la memoria queda acotada a
+ * depth strips. Los compresores toman los strips en orden y el escritor los
+ * agrega en orden, así que el .rle es idéntico al de --stream sin pipeline.
+ * Mientras el chunk k se escribe y se le calcula el CRC, el k+1 se comprime
+ * y el siguiente strip se está leyendo.
+ */
+enum { PIPE_FREE, PIPE_LOADED, PIPE_BUSY, PIPE_DONE };
+enum { PIPE_STAGE_LOAD, PIPE_STAGE_RLE, PIPE_STAGE_WRITE, PIPE_STAGES };
+
+typedef struct {
+    uint8_t *strip;
+    uint8_t *packed;
+    size_t   len;
+    int      state;             /* PIPE_* */
+} PipeSlot;
+
+typedef struct {
+    pthread_mutex_t  lock;
+    pthread_cond_t   changed;   /* algún slot cambió de estado */
+    PipeSlot        *slots;
+    uint32_t         depth;
+    uint32_t         next_compress;
+    int              failed;
+    double          *events;    /* [strip][etapa][inicio, fin] en ms desde t0 */
+    struct timespec  t0;
+    unsigned         preads;
+    unsigned         writes;
+} PipeStream;
+
+static PipeStream g_pipe = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                             NULL, 0, 0, 0, NULL, {0, 0}, 0, 0 };
+
+static void pipe_fail(PipeStream *p) {
+    pthread_mutex_lock(&p->lock);
+    p->failed = 1;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/* Marca inicio o fin de una etapa del strip i */
+static void pipe_event(PipeStream *p, uint32_t i, int stage, int end) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    p->events[((size_t)i * PIPE_STAGES + stage) * 2 + end] = ts_relative_ms(&p->t0, &t);
+}
+
+/* Espera a que el slot del strip i llegue a `state`; 0 o -1 si el pipeline falló */
+static int pipe_wait(PipeStream *p, uint32_t i, int state) {
+    PipeSlot *s = &p->slots[i % p->depth];
+    pthread_mutex_lock(&p->lock);
+    while (s->state != state && !p->failed)
+        pthread_cond_wait(&p->changed, &p->lock);
+    int failed = p->failed;
+    pthread_mutex_unlock(&p->lock);
+    return failed ? -1 : 0;
+}
+
+static void pipe_set(PipeStream *p, uint32_t i, int state) {
+    pthread_mutex_lock(&p->lock);
+    p->slots[i % p->depth].state = state;
+    pthread_cond_broadcast(&p->changed);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void *pipe_reader_func(void *arg) {
+    (void)arg;
+    PipeStream *p = &g_pipe;
+    StripStream *s = &g_strips;
+    for (uint32_t i = 0; i < s->num_strips; i++) {
+        if (pipe_wait(p, i, PIPE_FREE) != 0) break;
+        const RLEChunkEntry *e = &s->chunks[i];
+        pipe_event(p, i, PIPE_STAGE_LOAD, 0);
+        if (rle_strip_read(s->in, e->start_row, e->num_rows, p->slots[i % p->depth].strip) != 0) {
+            fprintf(stderr, "  Error leyendo filas %u-%u de la entrada\n",
+                    e->start_row, e->start_row + e->num_rows - 1);
+            pipe_fail(p);
+            break;
+        }
+        pipe_event(p, i, PIPE_STAGE_LOAD, 1);
+        p->preads++;
+        pipe_set(p, i, PIPE_LOADED);
+    }
+    return NULL;
+}
+
+static void *pipe_compress_func(void *arg) {
+    StripWorker *wk = (StripWorker *)arg;
+    PipeStream *p = &g_pipe;
+    StripStream *s = &g_strips;
+    const uint32_t w = s->in->width;
+
+    for (;;) {
+        /* Los strips se toman en orden: el siguiente sin comprimir, ya cargado */
+        pthread_mutex_lock(&p->lock);
+        while (!p->failed && p->next_compress < s->num_strips &&
+               p->slots[p->next_compress % p->depth].state != PIPE_LOADED)
+            pthread_cond_wait(&p->changed, &p->lock);
+        if (p->failed || p->next_compress >= s->num_strips) {
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        uint32_t i = p->next_compress++;
+        PipeSlot *slot = &p->slots[i % p->depth];
+        slot->state = PIPE_BUSY;
+        pthread_mutex_unlock(&p->lock);
+
+        pipe_event(p, i, PIPE_STAGE_RLE, 0);
+        size_t bytes = (size_t)s->chunks[i].num_rows * w * 3;
+        RLELibChunk c = { .band = slot->strip, .bytes = bytes, .scratch = wk->scratch,
+                          .dst = slot->packed, .codec = -1, .index = i };
+        librle_encode_chunk(&g_lib, &c);        /* con dst no falla */
+        atomic_fetch_add(&g_total_runs_atomic, c.records);
+        s->chunks[i].raw_checksum = c.entry.raw_checksum;
+        s->chunks[i].codec = c.entry.codec;
+        slot->len = c.entry.length;
+        size_t len = slot->len;
+        pipe_event(p, i, PIPE_STAGE_RLE, 1);
+        wk->strips_done++;
+        wk->bytes_out += len;
+        pipe_set(p, i, PIPE_DONE);
+    }
+    return NULL;
+}
+
+static void *pipe_writer_func(void *arg) {
+    (void)arg;
+    PipeStream *p = &g_pipe;
+    StripStream *s = &g_strips;
+    for (uint32_t i = 0; i < s->num_strips; i++) {
+        if (pipe_wait(p, i, PIPE_DONE) != 0) break;
+        PipeSlot *slot = &p->slots[i % p->depth];
+        pipe_event(p, i, PIPE_STAGE_WRITE, 0);
+        uint32_t crc = rle_crc32c(0, slot->packed, slot->len);
+        if (rle_stream_append(s->writer, slot->packed, slot->len, crc) != 0) {
+            pipe_fail(p);
+            break;
+        }
+        pipe_event(p, i, PIPE_STAGE_WRITE, 1);
+        p->writes++;
+        pipe_set(p, i, PIPE_FREE);
+    }
+    return NULL;
+}
+
+/* Lector + num_workers compresores + escritor sobre g_strips; tiempo de pared */
+static double run_pipeline(StripWorker *workers, int num_workers) {
+    PipeStream *p = &g_pipe;
+    pthread_t *tids = malloc((num_workers + 2) * sizeof(pthread_t));
+    if (!tids) { perror("malloc"); p->failed = 1; return 0; }
+    p->next_compress = 0;
+    for (uint32_t k = 0; k < p->depth; k++)
+        p->slots[k].state = PIPE_FREE;
+    clock_gettime(CLOCK_MONOTONIC, &p->t0);
+
+    int started = 0;
+    if (pthread_create(&tids[started], NULL, pipe_reader_func, NULL) == 0) started++;
+    if (started && pthread_create(&tids[started], NULL, pipe_writer_func, NULL) == 0) started++;
+    for (int t = 0; started >= 2 && t < num_workers; t++) {
+        workers[t].strips_done = 0;
+        if (pthread_create(&tids[started], NULL, pipe_compress_func, &workers[t]) != 0) break;
+        started++;
+    }
+    if (started < 3) {
+        perror("pthread_create");
+        pipe_fail(p);
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+    free(tids);
+
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return ts_relative_ms(&p->t0, &t1) / 1000.0;
+}
+
+typedef struct { double t; int stage; int delta; } PipeEdge;
+
+static int pipe_edge_cmp(const void *a, const void *b) {
+    const PipeEdge *x = (const PipeEdge *)a, *y = (const PipeEdge *)b;
+    if (x->t != y->t) return x->t < y->t ? -1 : 1;
+    return x->delta - y->delta;     /* a igual tiempo, cerrar antes de abrir */
+}
+
+/*
+ * Recorre los intervalos de las tres etapas y acumula: tiempo con cada etapa
+ * activa, con dos o más a la vez, y tiempo de escritura oculto (escribiendo
+ * mientras el lector o algún compresor trabajaban).
+ */
+static void pipe_overlap(const PipeStream *p, uint32_t n, double busy[PIPE_STAGES],
+                         double *overlap2, double *overlap3, double *hidden_write) {
+    size_t num_edges = (size_t)n * PIPE_STAGES * 2;
+    PipeEdge *edges = malloc(num_edges * sizeof(PipeEdge));
+    memset(busy, 0, PIPE_STAGES * sizeof(double));
+    *overlap2 = *overlap3 = *hidden_write = 0;
+    if (!edges) return;
+    for (uint32_t i = 0; i < n; i++)
+        for (int st = 0; st < PIPE_STAGES; st++) {
+            const double *ev = &p->events[((size_t)i * PIPE_STAGES + st) * 2];
+            size_t k = ((size_t)i * PIPE_STAGES + st) * 2;
+            edges[k] = (PipeEdge){ ev[0], st, +1 };
+            edges[k + 1] = (PipeEdge){ ev[1], st, -1 };
+        }
+    qsort(edges, num_edges, sizeof(PipeEdge), pipe_edge_cmp);
+
+    int active[PIPE_STAGES] = {0};
+    for (size_t k = 0; k < num_edges; k++) {
+        if (k > 0) {
+            double dt = edges[k].t - edges[k - 1].t;
+            int stages = 0;
+            for (int st = 0; st < PIPE_STAGES; st++)
+                if (active[st] > 0) { busy[st] += dt; stages++; }
+            if (stages >= 2) *overlap2 += dt;
+            if (stages == 3) *overlap3 += dt;
+            if (active[PIPE_STAGE_WRITE] > 0 &&
+                (active[PIPE_STAGE_LOAD] > 0 || active[PIPE_STAGE_RLE] > 0))
+                *hidden_write += dt;
+        }
+        active[edges[k].stage] += edges[k].delta;
+    }
+    free(edges);
+}
+
+/* Línea de tiempo ASCII: una fila por etapa, '█' = etapa activa en esa columna */
+#define PIPE_COLS 60
+static void pipe_timeline_row(const PipeStream *p, uint32_t n, int stage, double wall_ms,
+                              char *out) {
+    int on[PIPE_COLS] = {0};
+    for (uint32_t i = 0; i < n && wall_ms > 0; i++) {
+        const double *ev = &p->events[((size_t)i * PIPE_STAGES + stage) * 2];
+        int c0 = (int)(ev[0] / wall_ms * PIPE_COLS);
+        int c1 = (int)(ev[1] / wall_ms * PIPE_COLS);
+        for (int c = c0; c <= c1 && c < PIPE_COLS; c++)
+            if (c >= 0) on[c] = 1;
+    }
+    char *o = out;
+    for (int c = 0; c < PIPE_COLS; c++)
+        o += sprintf(o, "%s", on[c] ? "█" : "·");
+}
+
+static void print_pipeline_stats(const PipeStream *p, uint32_t n, double wall_s,
+                                 int num_workers) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *MAGENTA = "\033[35m";
+    const char *RESET = "\033[0m";
+    static const char *names[PIPE_STAGES] = { "Carga (pread)", "RLE", "Escritura + CRC" };
+
+    double busy[PIPE_STAGES], ov2, ov3, hidden;
+    pipe_overlap(p, n, busy, &ov2, &ov3, &hidden);
+    double wall_ms = wall_s * 1000.0;
+    double pct = wall_ms > 0 ? 100.0 / wall_ms : 0;
+
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                  %s*** PIPELINE: CARGA → RLE → ESCRITURA (--pipeline) ***%s              %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s  %sProfundidad:%s    %s%3u%s slots (strip + comprimido), 1 lector + %2d RLE + 1 escritor      %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, p->depth, RESET, num_workers, CYAN, RESET);
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    printf("%s║%s  %sEtapa             Fase              Activa (ms)   %% pared   Syscalls%s                %s║%s\n",
+           CYAN, RESET, WHITE, RESET, CYAN, RESET);
+    printf("%s║%s  ────────────────  ────────────────  ───────────   ───────   ────────                %s║%s\n",
+           CYAN, RESET, CYAN, RESET);
+    static const ProgramPhase phases[PIPE_STAGES] = { PHASE_INIT, PHASE_COMPRESS, PHASE_OUTPUT };
+    unsigned calls[PIPE_STAGES] = { p->preads, 0, p->writes };
+    for (int st = 0; st < PIPE_STAGES; st++)
+        printf("%s║%s  %-16s  %-16s  %s%11.3f%s   %6.1f%%   %s%8u%s                %s║%s\n",
+               CYAN, RESET, names[st], g_phase_names[phases[st]],
+               GREEN, busy[st], RESET, busy[st] * pct, MAGENTA, calls[st], RESET, CYAN, RESET);
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    printf("%s║%s  %sSolapamiento:%s   %s%11.3f%s ms con >= 2 etapas (%5.1f%%), %s%11.3f%s ms con las 3   %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, ov2, RESET, ov2 * pct, GREEN, ov3, RESET, CYAN, RESET);
+    printf("%s║%s  %sEscritura oculta:%s %s%9.3f%s ms de %9.3f ms (%5.1f%%) en paralelo con carga o RLE %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, hidden, RESET, busy[PIPE_STAGE_WRITE],
+           busy[PIPE_STAGE_WRITE] > 0 ? 100.0 * hidden / busy[PIPE_STAGE_WRITE] : 0.0,
+           CYAN, RESET);
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    static const char *tags[PIPE_STAGES] = { "Carga    ", "RLE      ", "Escritura" };
+    for (int st = 0; st < PIPE_STAGES; st++) {
+        char row[PIPE_COLS * 4 + 1];
+        pipe_timeline_row(p, n, st, wall_ms, row);
+        printf("%s║%s  %s%s%s  %s%s%s  %s        %s║%s\n",
+               CYAN, RESET, WHITE, tags[st], RESET, YELLOW, row, RESET,
+               st == PIPE_STAGES - 1 ? "fin" : "   ", CYAN, RESET);
+    }
+    printf("%s║%s             0 ms %*s%10.3f ms                  %s║%s\n",
+           CYAN, RESET, PIPE_COLS - 23, "", wall_ms, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+}
+
+/*
+ * --stream ROWS: lee la entrada de a ROWS filas, comprime los strips en
+ * paralelo y los agrega en orden al .rle (rle_stream_*). Con el mismo ROWS el
+ * archivo es idéntico al de rle_secuencial --stream. La memoria del proceso es
+ * (hilos × buffers de un strip), independiente del tamaño de la imagen.
+ */
+static int stream_compress(const char *path) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RED = "\033[31m";
+    const char *RESET = "\033[0m";
+
+    RLEStripInput in;
+    int r = rle_strip_open(path, g_raw_width, g_raw_height, &in);
+    if (r > 0)
+        fprintf(stderr, "  --stream requiere entrada PPM P6 de 8 bits o RAW (--raw-size WxH): %s\n", path);
+    if (r != 0) return 1;
+    track_syscall("open", "open", "Abrir imagen para lectura por strips");
+
+    uint32_t w = in.width, h = in.height;
+    /* --pipeline sin --stream: strips del tamaño de tile, mismo .rle que en memoria */
+    uint32_t strip_rows = g_stream_rows == 0 ? rle_tile_rows(w, h, g_tile_rows)
+                        : g_stream_rows < h ? g_stream_rows : h;
+    uint32_t num_strips = rle_tile_count(h, strip_rows);
+    size_t strip_bytes = (size_t)strip_rows * w * 3;
+    size_t bound = rle_encoded_bound(g_rle_mode, strip_bytes);
+    size_t scratch_size = rle_encoder_scratch_size(g_rle_mode, strip_bytes);
+    if (scratch_size < strip_bytes) scratch_size = strip_bytes;   /* también destino del decode */
+    size_t bmp_block = rle_bmp_block_size(w);
+    size_t raw_size = (size_t)w * h * 3;
+
+    /*
+     * Un strip en vuelo por hilo: --inflight N, por defecto uno por core. Con
+     * --pipeline hay un compresor por core (o --threads N) y --inflight N es la
+     * profundidad del anillo (por defecto compresores + 2: uno leyéndose y uno
+     * escribiéndose).
+     */
+    int cores = worker_threads();
+    int num_workers = g_stream_inflight > 0 && !g_pipeline ? g_stream_inflight : cores;
+    if (num_workers < 1) num_workers = 1;
+    if ((uint32_t)num_workers > num_strips) num_workers = (int)num_strips;
+    uint32_t depth = g_stream_inflight > 0 ? (uint32_t)g_stream_inflight : (uint32_t)num_workers + 2;
+    if (depth > num_strips) depth = num_strips;
+
+    RLEChunkEntry *chunks = calloc(num_strips, sizeof(RLEChunkEntry));
+    StripWorker *workers = calloc(num_workers, sizeof(StripWorker));
+    int err = !chunks || !workers;
+    for (int t = 0; !err && t < num_workers; t++) {
+        workers[t].s = &g_strips;
+        workers[t].strip = malloc(strip_bytes);
+        workers[t].packed = malloc(bound);
+        workers[t].scratch = malloc(scratch_size);
+        workers[t].row = malloc(bmp_block);
+        if (!workers[t].strip || !workers[t].packed || !workers[t].scratch || !workers[t].row)
+            err = 1;
+    }
+    if (g_pipeline && !err) {
+        g_pipe.depth = depth;
+        g_pipe.slots = calloc(depth, sizeof(PipeSlot));
+        g_pipe.events = calloc((size_t)num_strips * PIPE_STAGES * 2, sizeof(double));
+        err = !g_pipe.slots || !g_pipe.events;
+        for (uint32_t k = 0; !err && k < depth; k++) {
+            g_pipe.slots[k].strip = malloc(strip_bytes);
+            g_pipe.slots[k].packed = malloc(bound);
+            if (!g_pipe.slots[k].strip || !g_pipe.slots[k].packed) err = 1;
+        }
+    }
+    if (err) perror("malloc");
+    for (uint32_t i = 0; !err && i < num_strips; i++) {
+        rle_tile_range(h, strip_rows, i, &chunks[i].start_row, &chunks[i].num_rows);
+    }
+
+    char outpath[512], bmppath[512];
+    snprintf(outpath, sizeof(outpath), "%s_paralelo.rle", path);
+    snprintf(bmppath, sizeof(bmppath), "%s_paralelo_descomprimida.bmp", path);
+
+    g_strips.in = &in;
+    g_strips.chunks = chunks;
+    g_strips.num_strips = num_strips;
+    g_strips.strip_bytes = strip_bytes;
+    g_strips.bound = bound;
+
+    /* ── Compresión ── */
+    g_current_phase = PHASE_COMPRESS;
+    double elapsed = 0;
+    size_t payload = 0;
+    FILE *fout = err ? NULL : fopen(outpath, "wb");
+    RLEStreamWriter wr;
+    if (!err && (!fout || rle_stream_begin(&wr, fout, chunks, num_strips) != 0)) {
+        perror("fopen rle");
+        err = 1;
+    }
+    if (!err) {
+        track_syscall("fopen", "open", "Crear archivo RLE de salida");
+        printf("\n\033[33m  Compresión por strips: %u strips de %u filas (%d hilos%s)...\033[0m\n",
+               num_strips, strip_rows, num_workers, g_pipeline ? " RLE, pipeline" : "");
+        g_strips.writer = &wr;
+        g_strips.verify = 0;
+        if (g_pipeline) {
+            elapsed = run_pipeline(workers, num_workers);
+            if (g_pipe.failed) g_strips.failed = 1;
+            track_syscall_phase("pread", "pread", "Leer un strip de filas de la entrada",
+                                PHASE_INIT, (int)g_pipe.preads);
+            track_syscall_phase("fwrite", "write", "Agregar chunk al archivo RLE",
+                                PHASE_OUTPUT, (int)g_pipe.writes);
+        } else {
+            elapsed = run_stream_threads(workers, num_workers);
+            track_syscall("pread", "pread", "Leer un strip de filas de la entrada");
+            track_syscall("fwrite", "write", "Agregar chunk al archivo RLE");
+        }
+        if (g_strips.failed || rle_stream_end(&wr, w, h, g_rle_mode, g_rle_flags) != 0) {
+            fprintf(stderr, "  Error escribiendo '%s'\n", outpath);
+            err = 1;
+        }
+        for (int t = 0; t < num_workers; t++)
+            payload += workers[t].bytes_out;
+    }
+    if (fout) fclose(fout);
+
+    /* ── Verificación strip por strip ── */
+    g_current_phase = PHASE_DECOMPRESS;
+    double verify_time = 0;
+    if (!err) {
+        g_strips.rle_fd = open(outpath, O_RDONLY);
+        g_strips.bmp_fd = rle_bmp_create(bmppath, w, h);
+        if (g_strips.rle_fd < 0)
+            perror(outpath);
+        if (g_strips.rle_fd < 0 || g_strips.bmp_fd < 0)
+            err = 1;
+    }
+    if (!err) {
+        printf("\033[33m  Verificando strip por strip (%d hilos)...\033[0m\n", num_workers);
+        g_strips.verify = 1;
+        verify_time = run_stream_threads(workers, num_workers);
+        track_syscall("pwrite", "pwrite", "Escribir filas del BMP en su posición");
+        if (g_strips.failed) err = 1;
+    }
+    if (g_strips.rle_fd >= 0) close(g_strips.rle_fd);
+    if (g_strips.bmp_fd >= 0) close(g_strips.bmp_fd);
+
+    size_t strip_mem = (size_t)num_workers * (strip_bytes + bound + scratch_size + bmp_block);
+    if (g_pipeline) strip_mem += (size_t)depth * (strip_bytes + bound);
+    char strips_desc[96];
+    if (g_pipeline)
+        snprintf(strips_desc, sizeof(strips_desc), "%u de %u filas (%d RLE, pipeline de %u slots)",
+                 num_strips, strip_rows, num_workers, depth);
+    else
+        snprintf(strips_desc, sizeof(strips_desc), "%u de %u filas (%d hilos, 1 strip en vuelo por hilo)",
+                 num_strips, strip_rows, num_workers);
+    size_t peak = get_peak_rss();
+    size_t total = rle_container_size(num_strips, payload);
+    int ok = !err && g_strips.bad_crc == 0 && g_strips.bad_strips == 0;
+
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                    %s*** COMPRESIÓN POR STRIPS (--stream) ***%s                          %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s  %sEntrada:%s                  %s%-50s%s        %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, path, RESET, CYAN, RESET);
+    printf("%s║%s  %sDimensiones:%s              %u x %u px (%.2f MB sin comprimir)                     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, w, h, raw_size / (1024.0 * 1024.0), CYAN, RESET);
+    printf("%s║%s  %sStrips:%s                   %-58s%s║%s\n",
+           CYAN, RESET, WHITE, RESET, strips_desc, CYAN, RESET);
+    printf("%s║%s  %sBuffers de strip:%s         %s%10.2f KB%s (independiente del tamaño de la imagen)     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, strip_mem / 1024.0, RESET, CYAN, RESET);
+    printf("%s║%s  %sPico de RSS:%s              %s%10.2f MB%s                                             %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, peak / (1024.0 * 1024.0), RESET, CYAN, RESET);
+    printf("%s║%s  %sTiempo de compresión:%s     %s%12.6f%s segundos (lectura + RLE + escritura)         %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, elapsed, RESET, CYAN, RESET);
+    printf("%s║%s  %sTamaño comprimido:%s        %s%12zu%s bytes (ratio %.2f:1)                         %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, total, RESET,
+           total ? (double)raw_size / total : 0.0, CYAN, RESET);
+    printf("%s║%s  %sTiempo de verificación:%s   %s%12.6f%s segundos                                     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, verify_time, RESET, CYAN, RESET);
+    printf("%s║%s  %sIntegridad:%s               %s%s%s                    %s║%s\n",
+           CYAN, RESET, WHITE, RESET, ok ? GREEN : RED,
+           ok ? "CORRECTA - Imagen idéntica al original" : "ERROR - Diferencias detectadas",
+           RESET, CYAN, RESET);
+    printf("%s║%s  %sArchivo comprimido:%s       %s%-50s%s        %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, outpath, RESET, CYAN, RESET);
+    printf("%s║%s  %sImagen descomprimida:%s     %s%-50s%s        %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, bmppath, RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+
+    if (g_pipeline && !err) {
+        print_pipeline_stats(&g_pipe, num_strips, elapsed, num_workers);
+        print_syscall_table();
+    }
+    for (uint32_t k = 0; g_pipe.slots && k < depth; k++) {
+        free(g_pipe.slots[k].strip);
+        free(g_pipe.slots[k].packed);
+    }
+    free(g_pipe.slots);
+    free(g_pipe.events);
+
+    for (int t = 0; workers && t < num_workers; t++) {
+        free(workers[t].strip);
+        free(workers[t].packed);
+        free(workers[t].scratch);
+        free(workers[t].row);
+    }
+    free(workers);
+    free(chunks);
+    rle_strip_close(&in);
+    return ok ? 0 : 1;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  MÉTRICAS EN VIVO (--metrics-file / --metrics-listen)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * Hilo reportero de --batch y --serve. Cada --metrics-interval cierra la
+ * ventana de rle_metrics.h, toma RSS y CPU del proceso (get_memory_info,
+ * get_process_cpu_times) y reescribe el JSON de --metrics-file en un .tmp
+ * que luego renombra: quien lo lee nunca ve un archivo a medio escribir.
+ * Entre muestras atiende --metrics-listen: una petición HTTP/1.0 por
+ * conexión, texto de Prometheus en cualquier ruta salvo las terminadas en
+ * .json. La conexión en curso entra en el mismo poll que el tick, tanto
+ * para leer la petición como para mandar la respuesta, así que un cliente
+ * lento no atrasa las muestras; las demás esperan en el backlog.
+ * Los hilos de trabajo no esperan nunca al reportero.
+ */
+typedef struct {
+    pthread_t       tid;
+    int             started;
+    int             lfd;                /* TCP de escucha, -1 = sin --metrics-listen */
+    int             cfd;                /* conexión con la petición a medio leer, -1 = ninguna */
+    uint64_t        cfd_deadline;       /* leyendo: se responde con lo leído; enviando: se corta */
+    size_t          got;
+    char            req[2048];
+    RLEMetricsText  reply;              /* header + cuerpo de la respuesta en curso */
+    size_t          sent;               /* bytes de reply ya enviados */
+    int             replying;           /* 1 = la petición ya se leyó, falta enviar */
+    int             stop[2];            /* pipe: el hilo principal avisa el final */
+    RLEMetricsText  text;
+    RLEMetricsWindow window;
+    unsigned        samples;
+    unsigned        scrapes;
+    int             warned;             /* ya se informó un error de --metrics-file */
+    char            where[80];          /* HOST:PUERTO de --metrics-listen */
+} MetricsReporter;
+
+static MetricsReporter g_reporter = { .lfd = -1, .cfd = -1, .stop = { -1, -1 } };
+
+static RLEMetricsThread *metrics_slot(int i) {
+    return g_metrics.threads ? &g_metrics.threads[i] : NULL;
+}
+
+static void metrics_proc(RLEMetricsProc *p) {
+    memset(p, 0, sizeof(*p));
+    get_memory_info(&p->rss_bytes, &p->virtual_bytes);
+    get_process_cpu_times(&p->cpu_user_s, &p->cpu_sys_s);
+}
+
+static void metrics_write_file(MetricsReporter *r) {
+    RLEMetricsProc p;
+    metrics_proc(&p);
+    rle_metrics_json(&r->text, &g_metrics, &r->window, &p);
+    char tmp[4096 + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", g_metrics_file);
+    FILE *f = r->text.failed ? NULL : fopen(tmp, "w");
+    int ok = f && fwrite(r->text.buf, 1, r->text.len, f) == r->text.len;
+    if (f && fclose(f) != 0) ok = 0;
+    if (ok && rename(tmp, g_metrics_file) != 0) ok = 0;
+    if (!ok && !r->warned) {
+        fprintf(stderr, "  metrics: no se pudo escribir '%s': %s\n", g_metrics_file,
+                r->text.failed ? "sin memoria" : strerror(errno));
+        r->warned = 1;
+    }
+    r->text.failed = 0;
+}
+
+/* [HOST:]PUERTO, IPv4; sin HOST escucha solo en 127.0.0.1. Deja HOST:PUERTO en where */
+static int metrics_listen(const char *spec, char *where, size_t cap) {
+    char host[64] = "127.0.0.1";
+    const char *colon = strrchr(spec, ':');
+    const char *port_s = colon ? colon + 1 : spec;
+    if (colon && (size_t)(colon - spec) < sizeof(host)) {
+        memcpy(host, spec, (size_t)(colon - spec));
+        host[colon - spec] = '\0';
+    }
+    char *end;
+    long port = strtol(port_s, &end, 10);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (*port_s == '\0' || *end != '\0' || port <= 0 || port > 65535 ||
+        (colon && (size_t)(colon - spec) >= sizeof(host)) ||
+        inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "Dirección de métricas inválida: %s ([HOST:]PUERTO, IPv4)\n", spec);
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        perror(spec);
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    snprintf(where, cap, "%s:%ld", host, port);
+    return fd;
+}
+
+/*
+ * Toma una conexión del backlog. accept hereda O_NONBLOCK del socket de
+ * escucha en BSD/macOS y no en Linux: se deja en bloqueante en los dos, y
+ * el poll del reportero decide cuándo leer.
+ */
+static void metrics_accept(MetricsReporter *r) {
+    int cfd = accept(r->lfd, NULL, NULL);
+    if (cfd < 0) return;
+    fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) & ~O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(cfd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    r->cfd = cfd;
+    r->got = 0;
+    r->req[0] = '\0';
+    r->replying = 0;
+    r->cfd_deadline = rle_metrics_now_ns() + 1000000000ull;   /* un cliente lento, a lo sumo 1 s */
+}
+
+/* Cierra la conexión en curso; solo una respuesta entregada entera cuenta como consulta */
+static void metrics_close(MetricsReporter *r, int served) {
+    if (served) r->scrapes++;
+    close(r->cfd);
+    r->cfd = -1;
+    r->replying = 0;
+}
+
+/*
+ * El socket admite más bytes (poll): manda lo que entre sin bloquear. Un
+ * envío parcial deja el resto para el próximo POLLOUT; el Content-Length ya
+ * prometió el cuerpo entero, así que la conexión solo se cierra al
+ * terminarlo, ante un error, o al vencer cfd_deadline.
+ */
+static void metrics_flush(MetricsReporter *r) {
+#ifdef MSG_NOSIGNAL
+    const int send_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#else
+    const int send_flags = MSG_DONTWAIT;
 #endif
-        row_off += rows;
+    while (r->sent < r->reply.len) {
+        ssize_t n = send(r->cfd, r->reply.buf + r->sent, r->reply.len - r->sent, send_flags);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            metrics_close(r, 0);
+            return;
+        }
+        r->sent += (size_t)n;
+    }
+    metrics_close(r, 1);
+}
+
+/* Arma la respuesta al GET de r->req (sin keep-alive) y empieza a enviarla */
+static void metrics_answer(MetricsReporter *r) {
+    /* "GET /ruta HTTP/1.1": la ruta decide el formato */
+    char path[256] = "/";
+    sscanf(r->req, "%*s %255s", path);
+    size_t plen = strlen(path);
+    int json = plen >= 5 && strcmp(path + plen - 5, ".json") == 0;
+
+    RLEMetricsProc p;
+    metrics_proc(&p);
+    if (json) rle_metrics_json(&r->text, &g_metrics, &r->window, &p);
+    else rle_metrics_prometheus(&r->text, &g_metrics, &r->window, &p);
+    r->reply.len = 0;
+    if (r->text.failed)
+        rle_metrics_printf(&r->reply, "HTTP/1.0 500 Internal Server Error\r\n"
+                                      "Content-Length: 0\r\nConnection: close\r\n\r\n");
+    else
+        rle_metrics_printf(&r->reply, "HTTP/1.0 200 OK\r\nContent-Type: %s\r\n"
+                                      "Content-Length: %zu\r\nConnection: close\r\n\r\n%.*s",
+                           json ? "application/json" : "text/plain; version=0.0.4; charset=utf-8",
+                           r->text.len, (int)r->text.len, r->text.buf);
+    r->text.failed = 0;
+    if (r->reply.failed) {
+        r->reply.failed = 0;
+        metrics_close(r, 0);
+        return;
+    }
+    r->sent = 0;
+    r->replying = 1;
+    r->cfd_deadline = rle_metrics_now_ns() + 1000000000ull;
+    metrics_flush(r);
+}
+
+/* La conexión tiene bytes (poll): lee lo que haya y responde si la petición terminó */
+static void metrics_read(MetricsReporter *r) {
+    ssize_t n = recv(r->cfd, r->req + r->got, sizeof(r->req) - 1 - r->got, 0);
+    if (n < 0 && errno == EINTR) return;
+    if (n > 0) {
+        r->got += (size_t)n;
+        r->req[r->got] = '\0';
+        if (r->got < sizeof(r->req) - 1 && !strstr(r->req, "\r\n\r\n") && !strstr(r->req, "\n\n"))
+            return;
+    }
+    metrics_answer(r);
+}
+
+static void *metrics_reporter_func(void *arg) {
+    MetricsReporter *r = (MetricsReporter *)arg;
+    const uint64_t period = (uint64_t)g_metrics_interval_ms * 1000000ull;
+    uint64_t next = g_metrics.t0_ns + period;
+    if (g_metrics_file) metrics_write_file(r);
+
+    for (;;) {
+        uint64_t now = rle_metrics_now_ns();
+        if (now >= next) {
+            rle_metrics_tick(&g_metrics, &r->window);
+            r->samples++;
+            if (g_metrics_file) metrics_write_file(r);
+            next += period;
+            if (next <= now) next = now + period;
+            continue;
+        }
+        if (r->cfd >= 0 && now >= r->cfd_deadline) {
+            if (r->replying) metrics_close(r, 0);       /* no leyó la respuesta a tiempo */
+            else metrics_answer(r);
+            continue;
+        }
+        /* Una conexión a la vez: mientras hay una en curso se espera a ella, no al backlog */
+        uint64_t until = r->cfd >= 0 && r->cfd_deadline < next ? r->cfd_deadline : next;
+        struct pollfd pfd[2] = { { r->stop[0], POLLIN, 0 },
+                                 { r->cfd >= 0 ? r->cfd : r->lfd, r->replying ? POLLOUT : POLLIN, 0 } };
+        int timeout = (int)((until - now + 999999) / 1000000);
+        if (poll(pfd, pfd[1].fd >= 0 ? 2 : 1, timeout) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if (pfd[0].revents & POLLIN) break;
+        if (pfd[1].fd >= 0 && pfd[1].revents) {
+            if (r->replying) metrics_flush(r);
+            else if (r->cfd >= 0) metrics_read(r);
+            else metrics_accept(r);
+        }
+    }
+    if (r->cfd >= 0) metrics_close(r, 0);      /* una respuesta a medio enviar no cuenta */
+
+    /* Última muestra, ya con running = 0, para que el archivo refleje el final */
+    rle_metrics_tick(&g_metrics, &r->window);
+    r->samples++;
+    if (g_metrics_file) metrics_write_file(r);
+    return NULL;
+}
+
+/*
+ * Prepara g_metrics con workers hilos "worker" más uno con extra_role (NULL =
+ * ninguno) y arranca el reportero. Sin --metrics-file ni --metrics-listen no
+ * hace nada: metrics_slot devuelve NULL y los hilos no miden. 0 o -1.
+ */
+static int metrics_start(const char *kind, int workers, const char *extra_role,
+                         uint64_t queue_cap, uint64_t expected) {
+    if (!g_metrics_file && !g_metrics_listen) return 0;
+    MetricsReporter *r = &g_reporter;
+    if (g_metrics_listen && (r->lfd = metrics_listen(g_metrics_listen, r->where, sizeof(r->where))) < 0) return -1;
+    if (rle_metrics_init(&g_metrics, kind, workers + (extra_role ? 1 : 0)) != 0 ||
+        rle_metrics_window_init(&r->window, &g_metrics) != 0 || pipe(r->stop) != 0) {
+        perror("metrics");
+        rle_metrics_release(&g_metrics);
+        if (r->lfd >= 0) close(r->lfd);
+        r->lfd = -1;
+        return -1;
+    }
+    if (extra_role) g_metrics.threads[workers].role = extra_role;
+    g_metrics.queue_cap = queue_cap;
+    g_metrics.items_expected = expected;
+    if (pthread_create(&r->tid, NULL, metrics_reporter_func, r) != 0) {
+        perror("pthread_create");
+        return -1;
+    }
+    r->started = 1;
+    if (r->lfd >= 0)
+        track_syscall("bind", "socket+bind+listen", "Exponer métricas en vivo (--metrics-listen)");
+    fprintf(stderr, "  \033[32mMétricas en vivo\033[0m cada %d ms:%s%s%s%s\n", g_metrics_interval_ms,
+            g_metrics_file ? " JSON en " : "", g_metrics_file ? g_metrics_file : "",
+            g_metrics_listen ? " Prometheus en http://" : "", r->where);
+    return 0;
+}
+
+/* Tras el join de los hilos de trabajo: última muestra y liberar */
+static void metrics_stop(void) {
+    MetricsReporter *r = &g_reporter;
+    if (!g_metrics.threads) return;
+    atomic_store(&g_metrics.running, 0);
+    if (r->started) {
+        ssize_t w = write(r->stop[1], "", 1);
+        (void)w;
+        pthread_join(r->tid, NULL);
+        fprintf(stderr, "  metrics: %u muestras, %u consultas HTTP\n", r->samples, r->scrapes);
+    }
+    if (r->lfd >= 0) close(r->lfd);
+    close(r->stop[0]);
+    close(r->stop[1]);
+    free(r->text.buf);
+    free(r->reply.buf);
+    rle_metrics_window_release(&r->window);
+    rle_metrics_release(&g_metrics);
+    *r = (MetricsReporter){ .lfd = -1, .cfd = -1, .stop = { -1, -1 } };
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  COMPRESIÓN POR LOTES (--batch): pool fijo de hilos para muchas imágenes
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * --batch DIR | --batch -: comprime todas las imágenes de un directorio, o
+ * una ruta por línea leída de stdin, con hilos creados una sola vez.
+ *
+ *   compresores (N, uno por core)    escritor (1)
+ *   carga → RLE → slot  ──cola──>    fwrite del .rle → libera el slot
+ *
+ * Cada compresor reclama la siguiente imagen, la carga (mmap o stb_image),
+ * la comprime con librle (backend secuencial: el paralelismo es entre
+ * imágenes) directo en un slot con el layout final del archivo y lo encola.
+ * Con BATCH_SLOTS slots por hilo, el hilo ya carga y comprime la imagen
+ * siguiente mientras el escritor vuelca la anterior. Los slots y el RLELib
+ * de cada hilo (scratch y tabla) se reutilizan entre imágenes: tras la
+ * primera imagen grande no hay más malloc por imagen.
+ */
+#define BATCH_SLOTS 2
+
+typedef struct {
+    char     *path;
+    uint32_t  width;
+    uint32_t  height;
+    size_t    raw_bytes;
+    size_t    rle_bytes;
+    double    load_ms;
+    double    compress_ms;
+    double    write_ms;
+    int       ok;
+} BatchItem;
+
+typedef struct {
+    uint8_t        *data;       /* header + tabla + chunks, listo para fwrite */
+    size_t          cap;
+    size_t          size;
+    int             item;       /* imagen en el slot, -1 = libre */
+} BatchSlot;
+
+typedef struct {
+    BatchSlot  slots[BATCH_SLOTS];
+    RLELib     lib;             /* scratch del modo planar y tabla de chunks */
+    uint32_t   images;
+    RLEMetricsThread *metrics;  /* --metrics-*: contadores del hilo (NULL = sin métricas) */
+} BatchWorker;
+
+typedef struct {
+    pthread_mutex_t  lock;
+    pthread_cond_t   ready;     /* hay slots en la cola del escritor */
+    pthread_cond_t   freed;     /* el escritor devolvió un slot */
+    BatchItem       *items;
+    uint32_t         num_items;
+    uint32_t         next_claim;
+    BatchSlot      **queue;     /* anillo de slots llenos */
+    uint32_t         queue_cap;
+    uint32_t         q_head;
+    uint32_t         q_tail;
+    uint32_t         written;
+    struct timespec  t0;
+} BatchQueue;
+
+static BatchQueue g_batch = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                              PTHREAD_COND_INITIALIZER, NULL, 0, 0, NULL, 0, 0, 0, 0, {0, 0} };
+
+/* Extensiones que se listan en image/ y que toma --batch DIR */
+static int is_image_name(const char *name) {
+    static const char *exts[] = { ".png", ".jpg", ".jpeg", ".bmp", ".gif", ".tga",
+                                  ".psd", ".hdr", ".ppm" };
+    size_t len = strlen(name);
+    for (size_t i = 0; i < sizeof(exts) / sizeof(exts[0]); i++) {
+        size_t n = strlen(exts[i]);
+        if (len > n && strcasecmp(name + len - n, exts[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static int batch_cmp_path(const void *a, const void *b) {
+    return strcmp(((const BatchItem *)a)->path, ((const BatchItem *)b)->path);
+}
+
+/* Arma la lista de imágenes: archivos del directorio (ordenados) o líneas de stdin */
+static int batch_collect(const char *source, BatchItem **items_out, uint32_t *count) {
+    BatchItem *items = NULL;
+    uint32_t n = 0, cap = 0;
+    char line[4096];
+    DIR *dir = NULL;
+    int from_stdin = strcmp(source, "-") == 0;
+
+    if (!from_stdin && !(dir = opendir(source))) {
+        perror("opendir");
+        return -1;
+    }
+    for (;;) {
+        char path[4096];
+        if (from_stdin) {
+            if (!fgets(line, sizeof(line), stdin)) break;
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0') continue;
+            snprintf(path, sizeof(path), "%s", line);
+        } else {
+            struct dirent *entry = readdir(dir);
+            if (!entry) break;
+            /* Los BMP de verificación de corridas anteriores no son entrada */
+            if (!is_image_name(entry->d_name) || strstr(entry->d_name, "_descomprimida."))
+                continue;
+            snprintf(path, sizeof(path), "%s/%s", source, entry->d_name);
+        }
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            BatchItem *grown = realloc(items, cap * sizeof(BatchItem));
+            if (!grown) { perror("realloc"); break; }
+            items = grown;
+        }
+        memset(&items[n], 0, sizeof(BatchItem));
+        items[n].path = strdup(path);
+        if (!items[n].path) { perror("strdup"); break; }
+        n++;
+    }
+    if (dir) {
+        closedir(dir);
+        qsort(items, n, sizeof(BatchItem), batch_cmp_path);
+    }
+    *items_out = items;
+    *count = n;
+    return 0;
+}
+
+/* Garantiza capacidad en un slot (crece y se conserva para las imágenes siguientes) */
+static int batch_slot_reserve(BatchSlot *s, size_t bytes) {
+    if (bytes > s->cap) {
+        uint8_t *p = realloc(s->data, bytes);
+        if (!p) return -1;
+        s->data = p;
+        s->cap = bytes;
+    }
+    return 0;
+}
+
+/* Comprime img por tiles directo en el slot, con el layout final del .rle */
+static int batch_compress_image(BatchWorker *wk, BatchSlot *s, const RLELibImage *img) {
+    size_t bound = librle_compress_bound(&wk->lib, img->width, img->height);
+    if (bound == 0 || batch_slot_reserve(s, bound) != 0) return -1;
+    if (librle_compress(&wk->lib, img->data, img->width, img->height,
+                        s->data, s->cap, &s->size) != RLE_LIB_OK) {
+        fprintf(stderr, "  librle: %s\n", librle_error(&wk->lib));
+        return -1;
+    }
+    atomic_fetch_add(&g_total_runs_atomic, wk->lib.stats.runs);
+    return 0;
+}
+
+static void *batch_worker_func(void *arg) {
+    BatchWorker *wk = (BatchWorker *)arg;
+    BatchQueue *q = &g_batch;
+
+    for (;;) {
+        pthread_mutex_lock(&q->lock);
+        uint32_t i = q->next_claim < q->num_items ? q->next_claim++ : q->num_items;
+        /* Esperar un slot propio libre (el escritor todavía puede tener ambos) */
+        BatchSlot *s = NULL;
+        while (i < q->num_items && !s) {
+            for (int k = 0; k < BATCH_SLOTS && !s; k++)
+                if (wk->slots[k].item < 0) s = &wk->slots[k];
+            if (!s) pthread_cond_wait(&q->freed, &q->lock);
+        }
+        pthread_mutex_unlock(&q->lock);
+        if (i >= q->num_items) break;
+
+        BatchItem *it = &q->items[i];
+        struct timespec ta, tb, tc;
+        RLELibImage img;
+        rle_metrics_begin(wk->metrics);
+        clock_gettime(CLOCK_MONOTONIC, &ta);
+        int ok = librle_image_load(&wk->lib, &img, it->path, g_raw_width, g_raw_height) == RLE_LIB_OK;
+        if (!ok) fprintf(stderr, "  %s\n", librle_error(&wk->lib));
+        clock_gettime(CLOCK_MONOTONIC, &tb);
+        if (ok) {
+            it->width = img.width;
+            it->height = img.height;
+            it->raw_bytes = (size_t)img.width * img.height * 3;
+            ok = batch_compress_image(wk, s, &img) == 0;
+            if (!ok) fprintf(stderr, "  No se pudo comprimir '%s'\n", it->path);
+            librle_image_free(&img);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &tc);
+        it->load_ms = ts_relative_ms(&ta, &tb);
+        it->compress_ms = ts_relative_ms(&tb, &tc);
+        it->ok = ok;
+        wk->images++;
+        rle_metrics_end(wk->metrics, it->raw_bytes, ok ? s->size : 0);
+
+        /* Encolar para el escritor (la cola tiene lugar para todos los slots) */
+        pthread_mutex_lock(&q->lock);
+        s->item = (int)i;
+        q->queue[q->q_tail++ % q->queue_cap] = s;
+        rle_metrics_queue(&g_metrics, q->q_tail - q->q_head);
+        pthread_cond_signal(&q->ready);
+        pthread_mutex_unlock(&q->lock);
+    }
+    return NULL;
+}
+
+static void *batch_writer_func(void *arg) {
+    RLEMetricsThread *mt = (RLEMetricsThread *)arg;
+    BatchQueue *q = &g_batch;
+
+    while (q->written < q->num_items) {
+        pthread_mutex_lock(&q->lock);
+        while (q->q_head == q->q_tail)
+            pthread_cond_wait(&q->ready, &q->lock);
+        BatchSlot *s = q->queue[q->q_head++ % q->queue_cap];
+        rle_metrics_queue(&g_metrics, q->q_tail - q->q_head);
+        pthread_mutex_unlock(&q->lock);
+
+        BatchItem *it = &q->items[s->item];
+        rle_metrics_begin(mt);
+        if (it->ok) {
+            char outpath[4096 + 16];
+            snprintf(outpath, sizeof(outpath), "%s_paralelo.rle", it->path);
+            struct timespec ta, tb;
+            clock_gettime(CLOCK_MONOTONIC, &ta);
+            FILE *f = fopen(outpath, "wb");
+            it->ok = f && fwrite(s->data, 1, s->size, f) == s->size;
+            if (f && fclose(f) != 0) it->ok = 0;
+            if (!it->ok) perror(outpath);
+            clock_gettime(CLOCK_MONOTONIC, &tb);
+            it->write_ms = ts_relative_ms(&ta, &tb);
+            it->rle_bytes = s->size;
+        }
+        rle_metrics_end(mt, 0, 0);
+        rle_metrics_done(&g_metrics, it->ok);
+
+        uint32_t done = q->written + 1;
+        if (it->ok) {
+            double mbps = it->compress_ms > 0
+                          ? it->raw_bytes / (1024.0 * 1024.0) / (it->compress_ms / 1000.0) : 0;
+            printf("  [%5u/%5u] %-36.36s %5ux%-5u %9.1f KB → %9.1f KB  %6.2f:1  %8.3f ms  %8.1f MB/s\n",
+                   done, q->num_items, it->path, it->width, it->height,
+                   it->raw_bytes / 1024.0, it->rle_bytes / 1024.0,
+                   it->rle_bytes ? (double)it->raw_bytes / it->rle_bytes : 0.0,
+                   it->compress_ms, mbps);
+        } else {
+            printf("  [%5u/%5u] %-36.36s \033[31mERROR\033[0m\n", done, q->num_items, it->path);
+        }
+
+        pthread_mutex_lock(&q->lock);
+        s->item = -1;
+        q->written = done;
+        pthread_cond_broadcast(&q->freed);
+        pthread_mutex_unlock(&q->lock);
+    }
+    return NULL;
+}
+
+static int batch_compress(const char *source) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RED = "\033[31m";
+    const char *RESET = "\033[0m";
+
+    BatchItem *items = NULL;
+    uint32_t n = 0;
+    if (batch_collect(source, &items, &n) != 0) return 1;
+    if (n == 0) {
+        fprintf(stderr, "  --batch: no hay imágenes en '%s'\n", source);
+        free(items);
+        return 1;
+    }
+    track_syscall("opendir", "openat+getdents", "Listar imágenes del lote");
+
+    int num_workers = worker_threads();
+    if ((uint32_t)num_workers > n) num_workers = (int)n;
+
+    BatchWorker *workers = calloc(num_workers, sizeof(BatchWorker));
+    pthread_t *tids = malloc((num_workers + 1) * sizeof(pthread_t));
+    g_batch.queue_cap = (uint32_t)num_workers * BATCH_SLOTS;
+    g_batch.queue = malloc(g_batch.queue_cap * sizeof(BatchSlot *));
+    if (!workers || !tids || !g_batch.queue) {
+        perror("malloc");
+        return 1;
+    }
+    RLELibConfig cfg;
+    librle_config_default(&cfg);
+    cfg.mode = g_rle_mode;
+    cfg.flags = g_rle_flags;
+    cfg.tile_rows = g_tile_rows;
+    for (int t = 0; t < num_workers; t++) {
+        for (int k = 0; k < BATCH_SLOTS; k++)
+            workers[t].slots[k].item = -1;
+        librle_init(&workers[t].lib, &cfg);
+        workers[t].lib.kernel = g_scan;         /* --scalar ya eligió el kernel */
+        workers[t].lib.cache = g_use_cache ? &g_chunk_cache : NULL;
+    }
+    g_batch.items = items;
+    g_batch.num_items = n;
+    if (metrics_start("batch", num_workers, "writer", g_batch.queue_cap, n) != 0)
+        return 1;
+    for (int t = 0; t < num_workers; t++)
+        workers[t].metrics = metrics_slot(t);
+
+    printf("\n\033[33m  Lote: %u imágenes, %d hilos compresores + 1 escritor...\033[0m\n\n",
+           n, num_workers);
+    g_current_phase = PHASE_COMPRESS;
+    clock_gettime(CLOCK_MONOTONIC, &g_batch.t0);
+
+    /* El pool se crea una sola vez para todo el lote */
+    int started = 0;
+    for (; started < num_workers; started++)
+        if (pthread_create(&tids[started], NULL, batch_worker_func, &workers[started]) != 0) {
+            perror("pthread_create");
+            break;
+        }
+    if (started == 0) return 1;
+    if (pthread_create(&tids[num_workers], NULL, batch_writer_func, metrics_slot(num_workers)) != 0) {
+        perror("pthread_create");
+        return 1;
+    }
+    for (int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+    pthread_join(tids[num_workers], NULL);
+    metrics_stop();
+    track_syscall("pthread_create", "clone", "Pool fijo: N compresores + 1 escritor");
+    track_syscall("fwrite", "write", "Escribir el .rle de cada imagen");
+
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double wall_ms = ts_relative_ms(&g_batch.t0, &t1);
+
+    uint32_t ok_count = 0;
+    size_t raw_total = 0, rle_total = 0;
+    double load_ms = 0, compress_ms = 0, write_ms = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (!items[i].ok) continue;
+        ok_count++;
+        raw_total += items[i].raw_bytes;
+        rle_total += items[i].rle_bytes;
+        load_ms += items[i].load_ms;
+        compress_ms += items[i].compress_ms;
+        write_ms += items[i].write_ms;
+    }
+    double wall_s = wall_ms / 1000.0;
+    double raw_mb = raw_total / (1024.0 * 1024.0);
+
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                      %s*** COMPRESIÓN POR LOTES (--batch) ***%s                          %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s  %sOrigen:%s                   %s%-50s%s        %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, strcmp(source, "-") == 0 ? "(stdin)" : source,
+           RESET, CYAN, RESET);
+    printf("%s║%s  %sImágenes:%s                 %s%6u%s comprimidas, %s%6u%s con error                      %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, ok_count, RESET,
+           ok_count == n ? GREEN : RED, n - ok_count, RESET, CYAN, RESET);
+    printf("%s║%s  %sPool:%s                     %3d compresores + 1 escritor, %d slots por hilo            %s║%s\n",
+           CYAN, RESET, WHITE, RESET, num_workers, BATCH_SLOTS, CYAN, RESET);
+    printf("%s║%s  %sDatos:%s                    %s%10.2f MB%s → %s%10.2f MB%s (ratio %6.2f:1)            %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, raw_mb, RESET,
+           GREEN, rle_total / (1024.0 * 1024.0), RESET,
+           rle_total ? (double)raw_total / rle_total : 0.0, CYAN, RESET);
+    printf("%s║%s  %sTiempo de pared:%s          %s%12.3f%s ms                                           %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, wall_ms, RESET, CYAN, RESET);
+    printf("%s║%s  %sRendimiento:%s              %s%10.1f%s imágenes/s   %s%10.1f%s MB/s                   %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, wall_s > 0 ? ok_count / wall_s : 0.0, RESET,
+           GREEN, wall_s > 0 ? raw_mb / wall_s : 0.0, RESET, CYAN, RESET);
+    printf("%s║%s  %sEtapas (suma por imagen):%s carga %s%10.3f%s  RLE %s%10.3f%s  escritura %s%10.3f%s ms %s║%s\n",
+           CYAN, RESET, WHITE, RESET, YELLOW, load_ms, RESET, YELLOW, compress_ms, RESET,
+           YELLOW, write_ms, RESET, CYAN, RESET);
+    printf("%s║%s  %sPromedio por imagen:%s      %s%12.3f%s ms de pared                                  %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, ok_count ? wall_ms / ok_count : 0.0, RESET,
+           CYAN, RESET);
+    printf("%s║%s  %sPico de RSS:%s              %s%10.2f MB%s                                             %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, get_peak_rss() / (1024.0 * 1024.0), RESET,
+           CYAN, RESET);
+    if (g_use_cache) {
+        RLEChunkCache *c = &g_chunk_cache;
+        uint64_t hits = atomic_load(&c->hits), total = hits + atomic_load(&c->misses);
+        char line[96];
+        snprintf(line, sizeof(line), "%llu de %llu tiles (%.1f%%), %llu compartidos",
+                 (unsigned long long)hits, (unsigned long long)total,
+                 total ? 100.0 * hits / total : 0.0, (unsigned long long)atomic_load(&c->shared));
+        printf("%s║%s  %sCaché de chunks:%s          %s%-53s%s     %s║%s\n",
+               CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+        if (atomic_load(&c->misses))
+            snprintf(line, sizeof(line), "~%.3f ms, %u entradas (%u del archivo)",
+                     rle_chunk_cache_saved_s(c) * 1e3, c->count, c->loaded);
+        else
+            snprintf(line, sizeof(line), "sin fallos para estimar, %u entradas (%u del archivo)",
+                     c->count, c->loaded);
+        printf("%s║%s  %sTiempo ahorrado:%s          %s%-53s%s     %s║%s\n",
+               CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    }
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+
+    for (int t = 0; t < num_workers; t++) {
+        for (int k = 0; k < BATCH_SLOTS; k++)
+            free(workers[t].slots[k].data);
+        librle_release(&workers[t].lib);
+    }
+    for (uint32_t i = 0; i < n; i++)
+        free(items[i].path);
+    free(items);
+    free(workers);
+    free(tids);
+    free(g_batch.queue);
+    return ok_count == n ? 0 : 1;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  MONITOR DE PROGRESO Y BENCHMARK DE PUBLICACIÓN (--progress-bench)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+#define MONITOR_PERIOD_MS 5
+
+/*
+ * Hilo monitor: mientras los hilos comprimen lee sus RLEProgress cada
+ * MONITOR_PERIOD_MS (loads relaxed, sin locks). En una terminal dibuja el
+ * porcentaje en stderr; en cualquier caso cuenta lecturas y avances vistos.
+ */
+typedef struct {
+    const ThreadArg *args;
+    int              num_threads;
+    size_t           total;
+    atomic_int       stop;
+    int              tty;
+    unsigned         polls;
+    unsigned         advances;      /* lecturas que vieron más bytes que la anterior */
+    size_t           last_seen;
+} ProgressMonitor;
+
+static size_t monitor_read(const ProgressMonitor *m) {
+    size_t sum = 0;
+    for (int i = 0; i < m->num_threads; i++)
+        sum += rle_progress_load(&m->args[i].progress);
+    return sum;
+}
+
+static void *progress_monitor_func(void *arg) {
+    ProgressMonitor *m = (ProgressMonitor *)arg;
+    const struct timespec period = { 0, MONITOR_PERIOD_MS * 1000000L };
+    while (!atomic_load(&m->stop)) {
+        size_t seen = monitor_read(m);
+        m->polls++;
+        if (seen > m->last_seen) m->advances++;
+        m->last_seen = seen;
+        if (m->tty && m->total)
+            fprintf(stderr, "\r  [monitor] %5.1f%%  %zu / %zu bytes ", 100.0 * seen / m->total,
+                    seen, m->total);
+        nanosleep(&period, NULL);
+    }
+    m->last_seen = monitor_read(m);
+    if (m->tty) fprintf(stderr, "\r%60s\r", "");
+    return NULL;
+}
+
+/*
+ * --progress-bench: mide cuánto cuesta publicar el progreso. Cada hilo
+ * codifica su banda (sin escribir salida, para aislar el bucle de runs) con
+ * uno de dos esquemas, con un monitor leyendo los contadores en paralelo:
+ *
+ *   por run      dos atomic_store seq_cst por run en un arreglo contiguo de
+ *                contadores (el esquema anterior: vecinos en la misma línea)
+ *   cada 64 KB   rle_progress_publish relaxed cada RLE_PROGRESS_STEP bytes
+ *                en un RLEProgress por hilo (una línea de caché cada uno)
+ */
+#define PROGRESS_BENCH_REPS 3
+
+typedef struct {
+    const uint8_t *src;
+    size_t         bytes;
+    int            per_run;
+    atomic_size_t *packed;          /* por run: packed[0] = entrada, packed[1] = salida */
+    RLEProgress   *slot;            /* cada 64 KB */
+    uint8_t       *scratch;
+    size_t         out;
+} ProgressBenchArg;
+
+typedef struct {
+    atomic_size_t *packed;
+    RLEProgress   *slots;
+    int            n;
+    atomic_int     stop;
+    size_t         sink;
+} ProgressBenchMonitor;
+
+static void *progress_bench_func(void *arg) {
+    ProgressBenchArg *b = (ProgressBenchArg *)arg;
+    RLEEncoder enc;
+    rle_encoder_init(&enc, &g_scan, g_rle_mode, g_rle_flags, b->src, b->bytes, b->scratch);
+    uint8_t rec[RLE_MAX_RECORD];
+    size_t len = 0, n;
+    if (b->per_run) {
+        while ((n = rle_encode_next(&enc, rec)) != 0) {
+            len += n;
+            atomic_store(&b->packed[0], enc.pos);
+            atomic_store(&b->packed[1], len);
+        }
+    } else {
+        size_t publish_at = RLE_PROGRESS_STEP;
+        while ((n = rle_encode_next(&enc, rec)) != 0) {
+            len += n;
+            if (enc.pos >= publish_at) {
+                rle_progress_publish(b->slot, enc.pos, len);
+                publish_at = enc.pos + RLE_PROGRESS_STEP;
+            }
+        }
+        rle_progress_publish(b->slot, enc.pos, len);
+    }
+    b->out = len;
+    return NULL;
+}
+
+static void *progress_bench_monitor(void *arg) {
+    ProgressBenchMonitor *m = (ProgressBenchMonitor *)arg;
+    const struct timespec period = { 0, 1000000L };
+    while (!atomic_load(&m->stop)) {
+        for (int i = 0; i < m->n; i++)
+            m->sink += m->packed ? atomic_load(&m->packed[2 * i]) : rle_progress_load(&m->slots[i]);
+        nanosleep(&period, NULL);
+    }
+    return NULL;
+}
+
+/* Mejor tiempo (s) de PROGRESS_BENCH_REPS corridas con n hilos; -1 si falla */
+static double progress_bench_run(const RLELibImage *img, int n, int per_run) {
+    ProgressBenchArg *args = calloc(n, sizeof(ProgressBenchArg));
+    atomic_size_t *packed = calloc(2 * (size_t)n, sizeof(atomic_size_t));
+    RLEProgress *slots = rle_cacheline_calloc(n, sizeof(RLEProgress));
+    pthread_t *tids = malloc((n + 1) * sizeof(pthread_t));
+    double best = -1;
+    int err = !args || !packed || !slots || !tids;
+    for (int i = 0; !err && i < n; i++) {
+        uint32_t row, rows;
+        rle_band_range(img->height, (uint32_t)n, (uint32_t)i, &row, &rows);
+        args[i].src = img->data + (size_t)row * img->width * 3;
+        args[i].bytes = (size_t)rows * img->width * 3;
+        args[i].per_run = per_run;
+        args[i].packed = &packed[2 * i];
+        args[i].slot = &slots[i];
+        size_t scratch = rle_encoder_scratch_size(g_rle_mode, args[i].bytes);
+        if (scratch > 0 && !(args[i].scratch = malloc(scratch))) err = 1;
+    }
+    for (int rep = 0; !err && rep < PROGRESS_BENCH_REPS; rep++) {
+        ProgressBenchMonitor mon = { per_run ? packed : NULL, slots, n, 0, 0 };
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int started = 0;
+        for (; started < n; started++)
+            if (pthread_create(&tids[started], NULL, progress_bench_func, &args[started]) != 0)
+                break;
+        int mon_ok = pthread_create(&tids[n], NULL, progress_bench_monitor, &mon) == 0;
+        for (int i = 0; i < started; i++)
+            pthread_join(tids[i], NULL);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        atomic_store(&mon.stop, 1);
+        if (mon_ok) pthread_join(tids[n], NULL);
+        if (started < n) { perror("pthread_create"); err = 1; break; }
+        double t = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        if (best < 0 || t < best) best = t;
+    }
+    for (int i = 0; args && i < n; i++)
+        free(args[i].scratch);
+    free(args);
+    free(packed);
+    free(slots);
+    free(tids);
+    return err ? -1 : best;
+}
+
+static int progress_bench(const RLELibImage *img) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RED = "\033[31m";
+    const char *RESET = "\033[0m";
+
+    int cores = worker_threads();
+    double mb = (double)img->width * img->height * 3 / (1024.0 * 1024.0);
+
+    printf("\n\033[33m  Benchmark de publicación del progreso: 1..%d hilos, mejor de %d...\033[0m\n",
+           cores, PROGRESS_BENCH_REPS);
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                  %s*** BENCHMARK DE PROGRESO (--progress-bench) ***%s                    %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    char desc[128];                     /* "í" y "é" ocupan 2 bytes: ancho 76 + 2 */
+    snprintf(desc, sizeof(desc), "%u x %u px (%.2f MB), modo %s, kernel %s, línea de caché %d B",
+             img->width, img->height, mb, rle_mode_name(g_rle_mode), g_scan.name, RLE_CACHE_LINE);
+    printf("%s║%s  %sImagen:%s %-78s%s║%s\n", CYAN, RESET, WHITE, RESET, desc, CYAN, RESET);
+    printf("%s║%s  %spor run:%s    2 atomic_store seq_cst por run, contadores contiguos (esquema anterior) %s║%s\n",
+           CYAN, RESET, WHITE, RESET, CYAN, RESET);
+    printf("%s║%s  %scada 64 KB:%s store relaxed cada RLE_PROGRESS_STEP en su propia línea de caché        %s║%s\n",
+           CYAN, RESET, WHITE, RESET, CYAN, RESET);
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    printf("%s║%s  %sHilos     por run (MB/s)    cada 64 KB (MB/s)    Diferencia    MB/s por hilo%s        %s║%s\n",
+           CYAN, RESET, WHITE, RESET, CYAN, RESET);
+    printf("%s║%s  ─────     ──────────────    ─────────────────    ──────────    ─────────────        %s║%s\n",
+           CYAN, RESET, CYAN, RESET);
+
+    int err = 0;
+    for (int n = 1; n <= cores && !err; n = n < cores && n * 2 > cores ? cores : n * 2) {
+        double t_old = progress_bench_run(img, n, 1);
+        double t_new = progress_bench_run(img, n, 0);
+        if (t_old <= 0 || t_new <= 0) { err = 1; break; }
+        double old_mbps = mb / t_old, new_mbps = mb / t_new;
+        double diff = 100.0 * (new_mbps - old_mbps) / old_mbps;
+        printf("%s║%s  %s%5d%s     %s%14.1f%s    %s%17.1f%s    %s%+9.1f%%%s    %13.1f        %s║%s\n",
+               CYAN, RESET, GREEN, n, RESET, YELLOW, old_mbps, RESET, GREEN, new_mbps, RESET,
+               diff >= 0 ? GREEN : RED, diff, RESET, new_mbps / n, CYAN, RESET);
+    }
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+    return err ? 1 : 0;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  BENCHMARK REPRODUCIBLE (--bench): sin visualizaciones, salida JSON o CSV
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * --bench [--bench-iters K] [--bench-warmup W] [--bench-size WxH]
+ *         [--bench-csv] [--bench-out ARCHIVO] [foto ...]
+ *
+ * Para cada entrada (flat, gradient, noise y las fotos, rle_bench.h) y cada
+ * cantidad de hilos 1, 2, 4 ... cores, corre W + K veces la compresión real
+ * (tiles con work stealing en rle_thread_func, según --alloc) y después
+ * W + K veces la descompresión por chunks (rle_decode_thread_func) sobre el
+ * resultado. Solo las K últimas de cada fase entran en la estadística. No se
+ * escribe ningún archivo: el documento sale por stdout o a --bench-out, y el
+ * avance por stderr.
+ */
+typedef struct {
+    int             num_threads;
+    uint32_t        tile_rows;
+    uint32_t        num_tiles;
+    ThreadArg      *args;
+    pthread_t      *threads;
+    RLEChunkEntry  *chunks;
+    const uint8_t **chunk_data;
+    size_t          payload;
+} BenchCompress;
+
+/*
+ * Una compresión completa de img con bc->num_threads hilos; devuelve los
+ * segundos de pared y en *imbalance el hilo más ocupado / el promedio.
+ */
+static double bench_compress_run(BenchCompress *bc, const RLELibImage *img, double *imbalance) {
+    int n = bc->num_threads;
+    memset(bc->args, 0, (size_t)n * sizeof(ThreadArg));
+    setup_compress_args(bc->args, n, img, bc->tile_rows, bc->num_tiles);
+    g_arena.num_threads = n;
+    g_arena.arrived = 0;
+    g_arena.base = NULL;
+    g_arena.total = 0;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < n; i++) {
+        bc->args[i].t0_ref = &t0;
+        /* Con --alloc arena los hilos ya creados esperan en la barrera: no hay vuelta atrás */
+        if (pthread_create(&bc->threads[i], NULL, rle_thread_func, &bc->args[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < n; i++)
+        pthread_join(bc->threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double busy_max = 0, busy_sum = 0;
+    for (int i = 0; i < n; i++) {
+        double busy = ts_relative_ms(&bc->args[i].ts_start, &bc->args[i].ts_end);
+        busy_sum += busy;
+        if (busy > busy_max) busy_max = busy;
+    }
+    *imbalance = busy_sum > 0 ? busy_max * n / busy_sum : 1;
+    return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+}
+
+/* Tabla de chunks de la última compresión (igual que al escribir el .rle) */
+static void bench_collect_chunks(BenchCompress *bc) {
+    bc->payload = 0;
+    for (uint32_t t = 0; t < bc->num_tiles; t++) {
+        const TileTask *tile = &g_sched.tiles[t];
+        memset(&bc->chunks[t], 0, sizeof(RLEChunkEntry));
+        bc->chunks[t].start_row = tile->start_row;
+        bc->chunks[t].num_rows = tile->num_rows;
+        bc->chunks[t].length = tile->length;
+        bc->chunks[t].raw_checksum = tile->raw_crc;
+        bc->chunks[t].codec = tile->codec;
+        bc->chunk_data[t] = g_alloc_mode == ALLOC_ARENA ? g_arena.base + tile->offset
+                                                        : bc->args[tile->owner].result.data + tile->offset;
+        bc->payload += tile->length;
+    }
+}
+
+static void bench_compress_release(BenchCompress *bc) {
+    for (int i = 0; i < bc->num_threads; i++)
+        librle_buffer_free(&bc->args[i].result);
+    if (g_arena.base) {
+        track_heap_free(g_arena.base);
+        free(g_arena.base);
+        g_arena.base = NULL;
+    }
+}
+
+/* Hilos útiles para img: uno por tile como máximo (igual que la compresión normal) */
+static int bench_max_threads(const RLELibImage *img) {
+    uint32_t tiles = rle_tile_count(img->height, rle_tile_rows(img->width, img->height, g_tile_rows));
+    return tiles > INT32_MAX ? INT32_MAX : (int)tiles;
+}
+
+/* Mide una entrada con r->threads hilos (como máximo bench_max_threads); 0 o -1 */
+static int bench_case(const RLELibImage *img, RLEBenchResult *r) {
+    BenchCompress bc = {0};
+    bc.tile_rows = rle_tile_rows(img->width, img->height, g_tile_rows);
+    bc.num_tiles = rle_tile_count(img->height, bc.tile_rows);
+    bc.num_threads = r->threads;
+    r->raw_bytes = (size_t)img->width * img->height * 3;
+
+    int n = bc.num_threads, total = g_bench_warmup + g_bench_iters;
+    double *samples = malloc(g_bench_iters * sizeof(double));
+    bc.args = rle_cacheline_calloc(n, sizeof(ThreadArg));
+    bc.threads = malloc(n * sizeof(pthread_t));
+    bc.chunks = malloc(bc.num_tiles * sizeof(RLEChunkEntry));
+    bc.chunk_data = malloc(bc.num_tiles * sizeof(*bc.chunk_data));
+    g_sched.tiles = calloc(bc.num_tiles, sizeof(TileTask));
+    g_sched.deques = rle_cacheline_calloc(n, sizeof(TileDeque));
+    uint8_t *decoded = malloc(r->raw_bytes ? r->raw_bytes : 1);
+    ThreadArg *dargs = rle_cacheline_calloc(n, sizeof(ThreadArg));
+    int err = !samples || !bc.args || !bc.threads || !bc.chunks || !bc.chunk_data ||
+              !g_sched.tiles || !g_sched.deques || !decoded || !dargs;
+    if (err) perror("malloc");
+
+    double imbalance_sum = 0;
+    for (int it = 0; !err && it < total; it++) {
+        double imbalance;
+        double t = bench_compress_run(&bc, img, &imbalance);
+        if (it >= g_bench_warmup) {
+            samples[it - g_bench_warmup] = t;
+            imbalance_sum += imbalance;
+        }
+        if (it + 1 < total) bench_compress_release(&bc);
+    }
+    if (!err) {
+        size_t virt;
+        get_memory_info(&r->rss_bytes, &virt);
+        r->imbalance = imbalance_sum / g_bench_iters;
+        bench_collect_chunks(&bc);
+        r->rle_bytes = rle_container_size(bc.num_tiles, bc.payload);
+        rle_bench_stats(samples, g_bench_iters, &r->compress);
+    }
+
+    for (int it = 0; !err && it < total; it++) {
+        struct timespec t0;
+        setup_decode_args(dargs, n, bc.chunks, bc.chunk_data, bc.num_tiles,
+                          decoded, img->width, g_rle_mode, g_rle_flags);
+        double t = run_decode_threads(dargs, n, &t0);
+        if (t < 0) err = 1;
+        else if (it >= g_bench_warmup) samples[it - g_bench_warmup] = t;
+    }
+    if (!err) {
+        r->verified = memcmp(decoded, img->data, r->raw_bytes) == 0;
+        for (int i = 0; i < n; i++)
+            if (dargs[i].dec_bad) r->verified = 0;      /* --verify checksum: raw_checksum */
+        rle_bench_stats(samples, g_bench_iters, &r->decompress);
+    }
+
+    if (bc.args) bench_compress_release(&bc);
+    free(samples);
+    free(bc.args);
+    free(bc.threads);
+    free(bc.chunks);
+    free(bc.chunk_data);
+    free(g_sched.tiles);
+    free(g_sched.deques);
+    g_sched.tiles = NULL;
+    g_sched.deques = NULL;
+    free(decoded);
+    free(dargs);
+    /* ru_maxrss y statm se muestrean distinto: el pico nunca por debajo de la última RSS */
+    r->peak_rss_bytes = get_peak_rss();
+    if (r->peak_rss_bytes < r->rss_bytes) r->peak_rss_bytes = r->rss_bytes;
+    return err ? -1 : 0;
+}
+
+static int run_bench(const char *const *photos, int num_photos,
+                     const RLESynthParams *synth, int num_synth) {
+    int cores = worker_threads();
+    int sweep[32], num_sweep = 0;
+    for (int n = 1; n <= cores && num_sweep < 32; n = n < cores && n * 2 > cores ? cores : n * 2)
+        sweep[num_sweep++] = n;
+
+    /* flat, gradient y noise; después las SPEC del generador; después las fotos */
+    int num_fixed = RLE_BENCH_SYNTH, num_inputs = num_fixed + num_synth + num_photos;
+    char synth_names[RLE_BENCH_MAX_SYNTH][160];
+    RLEBenchResult *res = calloc((size_t)num_inputs * num_sweep, sizeof(RLEBenchResult));
+    if (!res) { perror("calloc"); return 1; }
+    int num_res = 0, failed = 0;
+
+    for (int k = 0; k < num_inputs; k++) {
+        int cls = k < num_fixed ? k : k < num_fixed + num_synth ? RLE_BENCH_SYNTH : RLE_BENCH_PHOTO;
+        const RLESynthParams *sp = cls == RLE_BENCH_SYNTH ? &synth[k - num_fixed] : NULL;
+        const char *name = rle_bench_class_name(cls);
+        if (sp) {
+            rle_synth_describe(sp, synth_names[k - num_fixed], sizeof(synth_names[0]));
+            name = synth_names[k - num_fixed];
+        } else if (cls == RLE_BENCH_PHOTO) {
+            name = photos[k - num_fixed - num_synth];
+        }
+        RLELibImage img = {0};
+        if (cls == RLE_BENCH_PHOTO) {
+            if (librle_image_load(&g_lib, &img, name, g_raw_width, g_raw_height) != RLE_LIB_OK) {
+                fprintf(stderr, "  [bench] %s, se omite\n", librle_error(&g_lib));
+                failed = 1;
+                continue;
+            }
+        } else if (sp) {
+            img.width = sp->width;
+            img.height = sp->height;
+            img.data = rle_synth_generate(sp);
+            if (!img.data) { perror("malloc"); failed = 1; continue; }
+        } else {
+            img.width = g_bench_width;
+            img.height = g_bench_height;
+            img.data = malloc((size_t)img.width * img.height * 3);
+            if (!img.data) { perror("malloc"); failed = 1; continue; }
+            rle_bench_fill(img.data, img.width, img.height, cls);
+        }
+
+        int max_threads = bench_max_threads(&img);
+        for (int s = 0; s < num_sweep; s++) {
+            /* Con menos tiles que hilos el resto del barrido repetiría la misma medida */
+            int n = sweep[s] < max_threads ? sweep[s] : max_threads;
+            if (s > 0 && n == res[num_res - 1].threads) break;
+            RLEBenchResult *r = &res[num_res];
+            r->input = name;
+            r->cls = cls;
+            r->width = img.width;
+            r->height = img.height;
+            r->threads = n;
+            if (bench_case(&img, r) != 0) { failed = 1; break; }
+            num_res++;
+            if (!r->verified) failed = 1;
+            fprintf(stderr, "  [bench] %-32.32s %5ux%-5u %3d hilos  RLE %9.1f MB/s  "
+                    "descompr. %9.1f MB/s  %7.2f:1  desbalance %.2f%s\n",
+                    name, img.width, img.height, r->threads,
+                    rle_bench_mbps(r->raw_bytes, r->compress.median),
+                    rle_bench_mbps(r->raw_bytes, r->decompress.median),
+                    r->rle_bytes ? (double)r->raw_bytes / r->rle_bytes : 0.0, r->imbalance,
+                    r->verified ? "" : "  ERROR: round-trip distinto");
+        }
+
+        librle_image_free(&img);
+    }
+
+    FILE *out = g_bench_out ? fopen(g_bench_out, "w") : stdout;
+    if (!out) {
+        perror(g_bench_out);
+        free(res);
+        return 1;
+    }
+    char variant[96];
+    rle_variant_name(variant, sizeof(variant), &g_scan, g_rle_mode, g_rle_flags);
+    RLEBenchConfig cfg = { "rle_paralelo", rle_mode_name(g_rle_mode), rle_count_name(g_rle_flags),
+                           g_scan.name, variant, g_alloc_names[g_alloc_mode], g_tile_rows,
+                           g_bench_warmup, g_bench_iters };
+    if (g_bench_csv) rle_bench_csv(out, &cfg, res, num_res);
+    else rle_bench_json(out, &cfg, res, num_res);
+    if (out != stdout && fclose(out) != 0) {
+        perror(g_bench_out);
+        failed = 1;
+    }
+    free(res);
+    return failed ? 1 : 0;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  BARRIDO DE ESCALABILIDAD (--scaling)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * --scaling [--threads N] [--affinity P] [--first-touch] [--bench-iters K]
+ *           [--bench-warmup W] [imagen | --synth SPEC]
+ *
+ * Con p = 1, 2, 4 ... N hilos (N = --threads o los cores), mediana de K
+ * compresiones reales después de W de calentamiento:
+ *
+ *   fuerte   la imagen completa: speedup S = T1 / Tp, eficiencia S / p y
+ *            Karp-Flatt e = (1/S - 1/p) / (1 - 1/p), la fracción serial
+ *            que explicaría ese punto (si crece con p, hay overhead)
+ *   débil    las primeras p/N partes de la imagen, el mismo trabajo por hilo
+ *            (con p = N es la imagen completa): speedup escalado
+ *            Ss = p * T1 / Tp y eficiencia T1 / Tp
+ *
+ * Ajustes por mínimos cuadrados: Amdahl (f en 1/S = f + (1 - f) / p, con
+ * techo de speedup 1/f) sobre el barrido fuerte y Gustafson (a en
+ * Ss = p - a (p - 1)) sobre el débil. Todos los puntos usan el tile de la
+ * imagen completa, así que el débil solo cambia la cantidad de tiles. La
+ * tabla sale por stdout y el CSV a <imagen>_scaling.csv, que gantt_chart.py
+ * dibuja junto al diagrama de Gantt.
+ */
+typedef struct {
+    int      weak;              /* 0 = fuerte, 1 = débil */
+    int      threads;
+    int      nodes;             /* nodos NUMA ocupados (0 = sin --affinity) */
+    uint32_t rows;
+    double   median;            /* segundos */
+    double   min;
+    double   speedup;           /* fuerte: T1 / Tp; débil: p * T1 / Tp */
+    double   efficiency;
+    double   karp_flatt;        /* solo fuerte y p > 1 */
+    double   imbalance;
+} ScalingPoint;
+
+/* Mediana de K compresiones de img con n hilos y tiles de tile_rows filas; 0 o -1 */
+static int scaling_measure(const RLELibImage *img, int n, uint32_t tile_rows, ScalingPoint *pt) {
+    BenchCompress bc = {0};
+    bc.tile_rows = tile_rows;
+    bc.num_tiles = rle_tile_count(img->height, tile_rows);
+    bc.num_threads = n;
+
+    /* --first-touch: la copia se reparte con las bandas de estos n hilos */
+    RLELibImage view = *img;
+    uint8_t *placed = g_first_touch ? first_touch_copy(img, n, tile_rows, bc.num_tiles, NULL) : NULL;
+    if (placed) view.data = placed;
+
+    double *samples = malloc(g_bench_iters * sizeof(double));
+    bc.args = rle_cacheline_calloc(n, sizeof(ThreadArg));
+    bc.threads = malloc(n * sizeof(pthread_t));
+    g_sched.tiles = calloc(bc.num_tiles, sizeof(TileTask));
+    g_sched.deques = rle_cacheline_calloc(n, sizeof(TileDeque));
+    int err = !samples || !bc.args || !bc.threads || !g_sched.tiles || !g_sched.deques;
+    if (err) perror("malloc");
+
+    double imbalance_sum = 0;
+    for (int it = 0; !err && it < g_bench_warmup + g_bench_iters; it++) {
+        double imbalance;
+        double t = bench_compress_run(&bc, &view, &imbalance);
+        if (it >= g_bench_warmup) {
+            samples[it - g_bench_warmup] = t;
+            imbalance_sum += imbalance;
+        }
+        bench_compress_release(&bc);
+    }
+    if (!err) {
+        RLEBenchStats st;
+        rle_bench_stats(samples, g_bench_iters, &st);
+        pt->threads = n;
+        pt->rows = img->height;
+        pt->median = st.median;
+        pt->min = st.min;
+        pt->imbalance = imbalance_sum / g_bench_iters;
+        pt->nodes = rle_topo_nodes_used(&g_topo, g_affinity, n);
+    }
+
+    free(samples);
+    free(bc.args);
+    free(bc.threads);
+    free(g_sched.tiles);
+    free(g_sched.deques);
+    g_sched.tiles = NULL;
+    g_sched.deques = NULL;
+    if (placed) munmap(placed, (size_t)img->width * img->height * 3);
+    return err ? -1 : 0;
+}
+
+static void scaling_csv(FILE *f, const char *name, const RLELibImage *img, const ScalingPoint *pts,
+                        int num_pts, double amdahl_f, double gustafson_a) {
+    fprintf(f, "program,input,width,height,mode,kernel,alloc,affinity,first_touch,cpus,numa_nodes,"
+               "warmup,iters,amdahl_serial_fraction,amdahl_max_speedup,gustafson_serial_fraction\n");
+    fprintf(f, "rle_paralelo,%s,%u,%u,%s,%s,%s,%s,%d,%d,%d,%d,%d,%.6f,%.4f,%.6f\n\n",
+            name, img->width, img->height, rle_mode_name(g_rle_mode), g_scan.name,
+            g_alloc_names[g_alloc_mode], rle_affinity_name(g_affinity), g_first_touch,
+            g_topo.num_cpus, g_topo.num_nodes, g_bench_warmup, g_bench_iters, amdahl_f,
+            amdahl_f > 0 ? 1.0 / amdahl_f : 0.0, gustafson_a);
+    fprintf(f, "scaling,threads,numa_nodes,rows,raw_bytes,median_ms,min_ms,speedup,efficiency,"
+               "karp_flatt,imbalance\n");
+    for (int i = 0; i < num_pts; i++) {
+        const ScalingPoint *p = &pts[i];
+        fprintf(f, "%s,%d,%d,%u,%zu,%.4f,%.4f,%.4f,%.4f,%.6f,%.4f\n", p->weak ? "weak" : "strong",
+                p->threads, p->nodes, p->rows, (size_t)img->width * p->rows * 3, p->median * 1e3,
+                p->min * 1e3, p->speedup, p->efficiency, p->karp_flatt, p->imbalance);
+    }
+}
+
+static int scaling_report(const RLELibImage *img, const char *input_path) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RESET = "\033[0m";
+
+    uint32_t tile_rows = rle_tile_rows(img->width, img->height, g_tile_rows);
+    uint32_t max_tiles = rle_tile_count(img->height, tile_rows);
+    int max_threads = worker_threads();
+    if ((uint32_t)max_threads > max_tiles) max_threads = (int)max_tiles;
+    int sweep[32], num_sweep = 0;
+    for (int n = 1; n <= max_threads && num_sweep < 32;
+         n = n < max_threads && n * 2 > max_threads ? max_threads : n * 2)
+        sweep[num_sweep++] = n;
+
+    printf("\n\033[33m  Barrido de escalabilidad: 1..%d hilos, afinidad %s, mediana de %d...\033[0m\n",
+           max_threads, rle_affinity_name(g_affinity), g_bench_iters);
+
+    ScalingPoint pts[64];
+    int num_pts = 0;
+    for (int weak = 0; weak <= 1; weak++) {
+        for (int s = 0; s < num_sweep; s++) {
+            int p = sweep[s];
+            RLELibImage part = *img;
+            uint32_t rows = img->height;
+            if (weak) {
+                /* p/N de la imagen, redondeado a tiles completos */
+                uint32_t tiles = (uint32_t)((uint64_t)max_tiles * p / max_threads);
+                if (tiles < (uint32_t)p) tiles = (uint32_t)p;
+                if (tiles > max_tiles) tiles = max_tiles;
+                uint32_t row, nrows;
+                rle_tile_range(img->height, tile_rows, tiles - 1, &row, &nrows);
+                rows = row + nrows;
+            }
+            part.height = rows;
+            ScalingPoint *pt = &pts[num_pts];
+            memset(pt, 0, sizeof(*pt));
+            pt->weak = weak;
+            if (scaling_measure(&part, p, tile_rows, pt) != 0) return 1;
+            num_pts++;
+            fprintf(stderr, "  [scaling] %-6s %3d hilos  %6u filas  %10.3f ms\n",
+                    weak ? "débil" : "fuerte", p, rows, pt->median * 1e3);
+        }
+    }
+
+    /* Métricas relativas a p = 1 de cada barrido y ajustes (mínimos cuadrados por el origen) */
+    double sab = 0, saa = 0, gab = 0, gaa = 0;
+    for (int i = 0; i < num_pts; i++) {
+        ScalingPoint *pt = &pts[i];
+        const ScalingPoint *base = &pts[pt->weak ? num_sweep : 0];
+        double p = pt->threads, ratio = pt->median > 0 ? base->median / pt->median : 0;
+        pt->karp_flatt = 0;
+        if (!pt->weak) {
+            pt->speedup = ratio;
+            pt->efficiency = ratio / p;
+            if (pt->threads > 1 && ratio > 0) {
+                double a = 1 - 1 / p, b = 1 / ratio - 1 / p;
+                pt->karp_flatt = b / a;
+                sab += a * b;
+                saa += a * a;
+            }
+        } else {
+            pt->speedup = p * ratio;
+            pt->efficiency = ratio;
+            gab += (p - pt->speedup) * (p - 1);
+            gaa += (p - 1) * (p - 1);
+        }
+    }
+    double amdahl_f = saa > 0 ? sab / saa : 0;
+    double gustafson_a = gaa > 0 ? gab / gaa : 0;
+    if (amdahl_f < 0) amdahl_f = 0;
+
+    char name[48];
+    const char *src = input_path[0] ? input_path : g_use_synth ? "synth" : "sintetica";
+    const char *slash = strrchr(src, '/');
+    snprintf(name, sizeof(name), "%s", slash ? slash + 1 : src);
+
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                     %s*** ESCALABILIDAD FUERTE Y DÉBIL (--scaling) ***%s                 %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    char desc[128];
+    snprintf(desc, sizeof(desc), "%s  %ux%u  tiles de %u filas  modo %s  kernel %s",
+             name, img->width, img->height, tile_rows, rle_mode_name(g_rle_mode), g_scan.name);
+    printf("%s║%s  %-82.82s  %s║%s\n", CYAN, RESET, desc, CYAN, RESET);
+    snprintf(desc, sizeof(desc), "CPUs %d en %d nodo(s)  afinidad %s  first-touch %s  W=%d K=%d",
+             g_topo.num_cpus, g_topo.num_nodes, rle_affinity_name(g_affinity),
+             g_first_touch ? "si" : "no", g_bench_warmup, g_bench_iters);
+    printf("%s║%s  %-82.82s  %s║%s\n", CYAN, RESET, desc, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    for (int weak = 0; weak <= 1; weak++) {
+        /* "É" ocupa 2 bytes: ancho 82 + 1 */
+        printf("%s║%s  %s%-*s%s  %s║%s\n", CYAN, RESET, WHITE, weak ? 83 : 82,
+               weak ? "DÉBIL: p/N de la imagen con p hilos (trabajo por hilo constante)"
+                    : "FUERTE: imagen completa con p hilos",
+               RESET, CYAN, RESET);
+        printf("%s║%s   %5s %5s %7s %12s %10s %11s %11s %11s    %s║%s\n", CYAN, RESET,
+               "hilos", "nodos", "filas", "mediana ms", weak ? "Ss" : "speedup",
+               "eficiencia", weak ? "" : "Karp-Flatt", "desbalance", CYAN, RESET);
+        for (int i = 0; i < num_pts; i++) {
+            const ScalingPoint *pt = &pts[i];
+            if (pt->weak != weak) continue;
+            char kf[16] = "";
+            if (!pt->weak && pt->threads > 1)
+                snprintf(kf, sizeof(kf), "%.4f", pt->karp_flatt);
+            printf("%s║%s   %5d %5d %7u %12.3f %s%9.2fx%s %10.1f%% %11s %11.2f    %s║%s\n", CYAN, RESET,
+                   pt->threads, pt->nodes, pt->rows, pt->median * 1e3, GREEN, pt->speedup, RESET,
+                   100 * pt->efficiency, kf, pt->imbalance, CYAN, RESET);
+        }
+        printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    }
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    char cap[24];
+    if (amdahl_f > 0) snprintf(cap, sizeof(cap), "%.1fx", 1 / amdahl_f);
+    else snprintf(cap, sizeof(cap), "sin techo");
+    printf("%s║%s  Amdahl:    fracción serial f = %s%.4f%s  ->  speedup máximo 1/f = %s%-12s%s        %s║%s\n",
+           CYAN, RESET, YELLOW, amdahl_f, RESET, YELLOW, cap, RESET, CYAN, RESET);
+    printf("%s║%s  Gustafson: fracción serial a = %s%.4f%s  ->  Ss(p) = p - a (p - 1)                    %s║%s\n",
+           CYAN, RESET, YELLOW, gustafson_a, RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n", CYAN, RESET);
+
+    char csvpath[600];
+    if (input_path[0])
+        snprintf(csvpath, sizeof(csvpath), "%s_scaling.csv", input_path);
+    else
+        snprintf(csvpath, sizeof(csvpath), "output_scaling.csv");
+    FILE *f = fopen(csvpath, "w");
+    if (!f) {
+        perror(csvpath);
+        return 1;
+    }
+    scaling_csv(f, name, img, pts, num_pts, amdahl_f, gustafson_a);
+    if (fclose(f) != 0) {
+        perror(csvpath);
+        return 1;
+    }
+    printf("  \033[32mCSV de escalabilidad:\033[0m %s\n", csvpath);
+    return 0;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  SALIDA ASÍNCRONA (--aio)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static void aio_report_setup(void) {
+    if (g_aio.backend == RLE_AIO_URING)
+        track_syscall("io_uring_setup", "io_uring_setup", "Anillos SQ/CQ de --aio");
+    if (g_aio.setup_errno)
+        printf("  \033[33m--aio %s no disponible (%s): se escribe con pwrite\033[0m\n",
+               rle_aio_name(g_aio_backend == RLE_AIO_AUTO ? RLE_AIO_URING : g_aio_backend),
+               strerror(g_aio.setup_errno));
+}
+
+/*
+ * Envía header + tabla del .rle y, salvo con --alloc arena (donde los hilos
+ * ya enviaron cada chunk), los chunks en su offset. Devuelve el buffer del
+ * header (la arena con --alloc arena), que vive hasta aio_finish_report, o
+ * NULL si no se pudo abrir el archivo.
+ */
+static uint8_t *aio_submit_rle(const char *outpath, uint32_t w, uint32_t h,
+                               RLEChunkEntry *chunks, const uint8_t **chunk_data, uint32_t n,
+                               const ThreadArg *args, int num_threads) {
+    size_t head_len = rle_container_size(n, 0);
+    if (g_alloc_mode == ALLOC_ARENA) {
+        if (g_aio_rle < 0) return NULL;
+        rle_container_finish(g_arena.base, w, h, g_rle_mode, g_rle_flags, chunks, chunk_data, n);
+        rle_aio_write(&g_aio, g_aio_rle, g_arena.base, head_len, 0);
+        return g_arena.base;
+    }
+
+    void *p = NULL;
+    uint8_t *head = posix_memalign(&p, RLE_AIO_ALIGN, head_len) == 0 ? p : NULL;
+    if (!head) { perror("malloc"); return NULL; }
+    RLEFileHeader hdr;
+    rle_container_fill(&hdr, w, h, g_rle_mode, g_rle_flags, chunks, chunk_data, n);
+    memcpy(head, &hdr, sizeof(hdr));
+    memcpy(head + sizeof(hdr), chunks, (size_t)n * sizeof(RLEChunkEntry));
+    size_t total = head_len;
+    for (uint32_t t = 0; t < n; t++)
+        total += chunks[t].length;
+
+    g_aio_rle = rle_aio_open(&g_aio, outpath, total);
+    if (g_aio_rle < 0) {
+        perror(outpath);
+        free(head);
+        return NULL;
+    }
+    track_syscall("open", "open", "Crear archivo de salida (--aio)");
+    rle_aio_register(&g_aio, head, head_len);
+    for (int i = 0; i < num_threads; i++)
+        rle_aio_register(&g_aio, args[i].result.data, args[i].result.size);
+    rle_aio_write(&g_aio, g_aio_rle, head, head_len, 0);
+    for (uint32_t t = 0; t < n; t++)
+        rle_aio_write(&g_aio, g_aio_rle, chunk_data[t], chunks[t].length, chunks[t].offset);
+    return head;
+}
+
+/* Espera las escrituras pendientes (y los fsync), informa y las suma al tracker */
+static void aio_finish_report(const char *outpath, uint32_t num_chunks) {
+    g_current_phase = PHASE_OUTPUT;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int r = rle_aio_finish(&g_aio);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double wait_ms = ts_relative_ms(&t0, &t1);
+    const RLEAioStats *st = &g_aio.st;
+
+    if (g_aio.backend == RLE_AIO_URING) {
+        track_syscall_phase("io_uring_register", "io_uring_register", "Registrar buffers fijos",
+                            PHASE_OUTPUT, (int)st->registers);
+        track_syscall_phase("io_uring_enter", "io_uring_enter", "Enviar SQEs, esperar CQE",
+                            PHASE_OUTPUT, (int)st->submits);
+        track_syscall_phase("io_uring CQE", "(anillo, sin syscall)", "Completions de escritura",
+                            PHASE_OUTPUT, (int)st->completions);
+        if (st->fsyncs)
+            track_syscall_phase("IORING_OP_FSYNC", "io_uring_enter", "fsync en lote (--fsync)",
+                                PHASE_OUTPUT, (int)st->fsyncs);
+    } else {
+        if (g_aio.backend == RLE_AIO_DISPATCH) {
+            track_syscall_phase("dispatch_io_write", "pwrite (hilos GCD)", "Escritura async (GCD)",
+                                PHASE_OUTPUT, (int)st->submits);
+            track_syscall_phase("dispatch handler", "(sin syscall)", "Completions de escritura",
+                                PHASE_OUTPUT, (int)st->completions);
+        } else {
+            track_syscall_phase("pwrite (--aio)", "pwrite", "Escribir salida (--aio)",
+                                PHASE_OUTPUT, (int)st->submits);
+        }
+        if (st->fsyncs)
+            track_syscall_phase("fsync", "fsync", "fsync en lote (--fsync)",
+                                PHASE_OUTPUT, (int)st->fsyncs);
+    }
+    track_syscall_phase("close", "close", "Cerrar salida (--aio)", PHASE_OUTPUT,
+                        (int)st->files);
+
+    if (r == 0 && g_aio_rle >= 0)
+        printf("\n  \033[32mArchivo comprimido guardado:\033[0m %s (%u chunks indexados)\n",
+               outpath, num_chunks);
+    else if (r != 0)
+        fprintf(stderr, "  Error escribiendo la salida (--aio): %s\n", strerror(g_aio.error));
+    printf("  \033[32mE/S asíncrona (%s):\033[0m %llu escrituras en %llu ops, %llu envíos, "
+           "%llu completions, máx %u en vuelo\n",
+           rle_aio_name(g_aio.backend), (unsigned long long)st->writes,
+           (unsigned long long)st->ops, (unsigned long long)st->submits,
+           (unsigned long long)st->completions, st->max_inflight);
+    printf("    O_DIRECT %.2f de %.2f MB · %u buffers registrados (%llu WRITE_FIXED) · "
+           "%u fsync en %u lote(s)\n",
+           st->direct_bytes / (1024.0 * 1024.0), st->bytes / (1024.0 * 1024.0), st->bufs,
+           (unsigned long long)st->fixed, st->fsyncs, st->fsync_batches);
+    printf("    Espera final (cola de escritura): %.3f ms\n\n", wait_ms);
+    g_aio_rle = -1;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  SERVIDOR DE COMPRESIÓN (--serve)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * ./rle_paralelo --serve SOCKET | --serve -: proceso de larga vida que
+ * atiende los pedidos de rle_serve.h. El hilo principal hace poll sobre el
+ * socket de escucha, las conexiones y el pipe de señales; lee cada pedido
+ * completo y lo encola (FIFO acotada: llena, deja de leer conexiones hasta
+ * que el ejecutor libere un lugar y los clientes esperan). Las conexiones
+ * son no bloqueantes: cada una guarda su trama a medio llegar (header, fds
+ * y entrada inline) y solo se encolan pedidos completos, así que un
+ * cliente que se detiene a mitad de trama no frena a los demás ni al pipe
+ * de señales. Un hilo ejecutor los resuelve en orden con un RLELib en
+ * RLE_LIB_POOL, cuyos hilos, scratch por worker y tabla de chunks se crean
+ * una vez y sirven a todos los pedidos, igual que la arena de salida (crece
+ * hasta el pedido más grande y no se libera hasta el final).
+ *
+ * El ejecutor tampoco espera a los clientes: escribe cada respuesta sin
+ * bloquear y lo que el socket no acepta lo copia a la cola de salida de la
+ * conexión, que el poll vacía con POLLOUT. Mientras esa cola pase de
+ * SERVE_OUT_HIGH no se leen más pedidos de la conexión; si lleva
+ * SERVE_WRITE_TIMEOUT ms sin avanzar, o la escritura falla (EPIPE), la
+ * conexión se corta y sus pedidos en cola se descartan sin resolverlos
+ * (al apagar el plazo baja a SERVE_DRAIN_TIMEOUT).
+ *
+ * SIGINT/SIGTERM pasan por demo_signal_handler, que además de contarlas en
+ * g_signal_table escribe un '\0' en el pipe (el ejecutor escribe 'q' cuando
+ * la cola deja de estar llena y 'w' cuando una conexión empieza a tener
+ * salida pendiente): se deja de aceptar y de leer, el ejecutor vacía la
+ * cola, el poll entrega lo que falta (o corta a quien no lee) y se imprime
+ * el informe (todo por stderr: con --serve - el stdout lleva las respuestas).
+ */
+
+#define SERVE_MAX_CONNS     64
+#define SERVE_QUEUE         64              /* pedidos en cola (--serve-queue) */
+#define SERVE_READ_SLICE    (4u << 20)      /* bytes leídos de una conexión por vuelta del poll */
+#define SERVE_OUT_HIGH      (8u << 20)      /* salida sin entregar: más, no se leen pedidos */
+#define SERVE_WRITE_TIMEOUT 5000            /* ms sin que el cliente acepte un byte: se corta */
+#define SERVE_DRAIN_TIMEOUT 1000            /* ídem durante el apagado */
+#define SERVE_TICK_MS       100             /* poll con plazos o cierres pendientes */
+#define SERVE_INLINE_TOTAL  (256u << 20)    /* entradas inline pendientes entre todas las conexiones */
+#define SERVE_IN_CHUNK      (1u << 20)      /* la entrada inline crece de a duplicar desde acá */
+
+/* Resto de una respuesta que el cliente todavía no aceptó */
+typedef struct ServeOut {
+    struct ServeOut *next;
+    size_t           len, off;
+    uint8_t          data[];
+} ServeOut;
+
+typedef struct {
+    int fd;                             /* lectura: el socket, o stdin (no bloqueantes) */
+    int out_fd;                         /* escritura: el mismo socket, o stdout */
+    int is_socket;
+    int refs;                           /* poll + pedidos en cola (bajo g_serve.lock) */
+
+    /* Trama a medio llegar: solo la toca el hilo del poll */
+    RLEServeRequest req;
+    size_t          hdr_got;            /* bytes del header leídos */
+    int             fds[RLE_SERVE_MAX_FDS];
+    int             nfds;
+    uint8_t        *in;                 /* HEAP: entrada inline (pasa al ServeJob) */
+    size_t          in_got, in_cap;     /* in crece a medida que llegan los bytes */
+    uint64_t        skip;               /* bytes de un pedido rechazado que se descartan */
+    int             eof;                /* no se leen más pedidos (EOF, error o apagado) */
+
+    /* Salida pendiente: el ejecutor agrega, el poll vacía (bajo out_lock) */
+    pthread_mutex_t out_lock;
+    ServeOut       *out_head, *out_tail;
+    size_t          out_bytes;
+    struct timespec out_since;          /* último avance con out_bytes > 0 */
+    int             dead;               /* cortada: no se le escribe ni se le resuelve nada */
+} ServeConn;
+
+typedef struct ServeJob {
+    ServeConn       *conn;
+    RLEServeRequest  req;
+    uint8_t         *in;                /* HEAP: entrada inline (NULL con shm) */
+    int              fds[RLE_SERVE_MAX_FDS];
+    int              nfds;
+    int              reject;            /* RLE_LIB_E* decidido al leerlo: se responde why */
+    char             why[160];
+    struct timespec  t_queued;
+    struct ServeJob *next;
+} ServeJob;
+
+static struct {
+    pthread_mutex_t  lock;
+    pthread_cond_t   ready;             /* hay pedidos en cola, o se cierra */
+    ServeJob        *head, *tail;
+    int              depth, max_depth;
+    int              closing;
+    int              wake;              /* pipe del poll: 'q' = hay lugar en la cola */
+
+    /* Solo los toca el ejecutor (y el informe, después del join) */
+    RLELib           lib;
+    uint8_t         *arena;             /* HEAP: salida inline, se conserva entre pedidos */
+    size_t           arena_cap;
+    RLEServeLatency  total, service, wait;
+    uint64_t         requests[RLE_SERVE_STATS + 1];
+    uint64_t         errors, bytes_in, bytes_out, shm_in, shm_out;
+    uint64_t         discarded;         /* pedidos de conexiones cortadas */
+    uint64_t         dropped;           /* conexiones cortadas (solo el poll) */
+    uint64_t         rejected;          /* entradas inline rechazadas (solo el poll) */
+
+    /* in_len de las entradas inline a medio llegar o en cola (bajo lock) */
+    size_t           inline_bytes, inline_peak;
+    struct timespec  t0;
+} g_serve = { .lock = PTHREAD_MUTEX_INITIALIZER, .ready = PTHREAD_COND_INITIALIZER,
+              .wake = -1 };
+
+static int g_serve_queue = SERVE_QUEUE;
+
+static double serve_ms(const struct timespec *a, const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+static ServeConn *serve_conn_new(int fd, int out_fd, int is_socket) {
+    ServeConn *c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->fd = fd;
+    c->out_fd = out_fd;
+    c->is_socket = is_socket;
+    c->refs = 1;
+    pthread_mutex_init(&c->out_lock, NULL);
+    return c;
+}
+
+/* Descarta la salida pendiente de c (bajo out_lock) */
+static void serve_out_clear(ServeConn *c) {
+    while (c->out_head) {
+        ServeOut *o = c->out_head;
+        c->out_head = o->next;
+        free(o);
+    }
+    c->out_tail = NULL;
+    c->out_bytes = 0;
+}
+
+/* Corta c (bajo out_lock): el cliente ve el cierre y el ejecutor descarta sus pedidos */
+static void serve_conn_kill(ServeConn *c, const char *why) {
+    if (c->dead) return;
+    fprintf(stderr, "  serve: %s, se corta la conexión\n", why);
+    c->dead = 1;
+    serve_out_clear(c);
+    if (c->is_socket) shutdown(c->fd, SHUT_RDWR);
+}
+
+/* Devuelve al presupuesto SERVE_INLINE_TOTAL los in_len bytes de una entrada inline */
+static void serve_inline_release(uint64_t in_len) {
+    pthread_mutex_lock(&g_serve.lock);
+    g_serve.inline_bytes -= (size_t)in_len;
+    pthread_mutex_unlock(&g_serve.lock);
+}
+
+/* El último que suelta la conexión la cierra: así un fd reutilizado por un
+ * cliente nuevo nunca recibe la respuesta de un pedido del anterior */
+static void serve_conn_release(ServeConn *c) {
+    pthread_mutex_lock(&g_serve.lock);
+    int last = --c->refs == 0;
+    pthread_mutex_unlock(&g_serve.lock);
+    if (!last) return;
+    for (int i = 0; i < c->nfds; i++)
+        close(c->fds[i]);
+    if (c->in) serve_inline_release(c->req.in_len);
+    free(c->in);
+    serve_out_clear(c);
+    pthread_mutex_destroy(&c->out_lock);
+    if (c->is_socket) close(c->fd);
+    free(c);
+}
+
+static void serve_job_free(ServeJob *job) {
+    for (int i = 0; i < job->nfds; i++)
+        close(job->fds[i]);
+    if (job->in) serve_inline_release(job->req.in_len);
+    free(job->in);
+    free(job);
+}
+
+/* La arena de salida no se achica: tras el primer pedido grande ya no hay malloc */
+static uint8_t *serve_arena(size_t need) {
+    if (need <= g_serve.arena_cap) return g_serve.arena;
+    uint8_t *p = realloc(g_serve.arena, need);
+    if (!p) return NULL;
+    g_serve.arena = p;
+    g_serve.arena_cap = need;
+    return p;
+}
+
+/*
+ * La trama de c ya está completa (o rechazada: reject != 0 y why es el
+ * mensaje de la respuesta): pasa a un ServeJob al final de la cola.
+ */
+static int serve_enqueue(ServeConn *c, int reject, const char *why) {
+    ServeJob *job = calloc(1, sizeof(*job));
+    if (!job) {
+        perror("calloc");
+        return 1;
+    }
+    job->req = c->req;
+    memcpy(job->fds, c->fds, sizeof(c->fds));
+    job->nfds = c->nfds;
+    job->in = c->in;
+    job->reject = reject;
+    if (why) snprintf(job->why, sizeof(job->why), "%s", why);
+    c->hdr_got = 0;
+    c->nfds = 0;
+    c->in = NULL;
+    c->in_got = 0;
+    c->in_cap = 0;
+
+    pthread_mutex_lock(&g_serve.lock);
+    c->refs++;
+    job->conn = c;
+    clock_gettime(CLOCK_MONOTONIC, &job->t_queued);
+    if (g_serve.tail) g_serve.tail->next = job;
+    else g_serve.head = job;
+    g_serve.tail = job;
+    if (++g_serve.depth > g_serve.max_depth) g_serve.max_depth = g_serve.depth;
+    rle_metrics_queue(&g_metrics, (uint64_t)g_serve.depth);
+    pthread_cond_signal(&g_serve.ready);
+    pthread_mutex_unlock(&g_serve.lock);
+    return 0;
+}
+
+/*
+ * Rechaza el pedido de c sin cerrar la conexión: suelta lo que se juntó de
+ * la entrada, encola un ServeJob que solo responde el error (en orden con
+ * los pedidos anteriores) y descarta el resto de los in_len bytes a medida
+ * que lleguen.
+ */
+static int serve_reject(ServeConn *c, int code, const char *why) {
+    c->skip = c->req.in_len - c->in_got;
+    if (c->in) {
+        serve_inline_release(c->req.in_len);
+        free(c->in);
+        c->in = NULL;
+    }
+    g_serve.rejected++;
+    return serve_enqueue(c, code, why);
+}
+
+/*
+ * Una entrada inline recién anunciada: se reserva in_len del presupuesto
+ * SERVE_INLINE_TOTAL (así muchos clientes que anuncian entradas grandes no
+ * suman más que eso) pero solo se asignan SERVE_IN_CHUNK bytes; el buffer
+ * crece a medida que llegan. 0 si se acepta, si no el código de rechazo.
+ */
+static int serve_inline_begin(ServeConn *c, char *why, size_t why_cap) {
+    uint64_t in_len = c->req.in_len;
+    if (in_len > RLE_SERVE_MAX_INLINE) {
+        snprintf(why, why_cap, "Entrada inline de %llu bytes: el máximo es %llu (usar shm = 1)",
+                 (unsigned long long)in_len, (unsigned long long)RLE_SERVE_MAX_INLINE);
+        return RLE_LIB_EINVAL;
+    }
+    pthread_mutex_lock(&g_serve.lock);
+    size_t pending = g_serve.inline_bytes;
+    int fits = pending + in_len <= SERVE_INLINE_TOTAL;
+    if (fits) {
+        g_serve.inline_bytes += (size_t)in_len;
+        if (g_serve.inline_bytes > g_serve.inline_peak) g_serve.inline_peak = g_serve.inline_bytes;
+    }
+    pthread_mutex_unlock(&g_serve.lock);
+    if (!fits) {
+        snprintf(why, why_cap, "El servidor tiene %zu MB de entradas inline pendientes (límite %u MB): "
+                 "reintentar o usar shm = 1", pending >> 20, SERVE_INLINE_TOTAL >> 20);
+        return RLE_LIB_ENOMEM;
+    }
+    c->in_cap = in_len < SERVE_IN_CHUNK ? (size_t)in_len : SERVE_IN_CHUNK;
+    if (!(c->in = malloc(c->in_cap))) {
+        serve_inline_release(in_len);
+        snprintf(why, why_cap, "Sin memoria para la entrada inline");
+        return RLE_LIB_ENOMEM;
+    }
+    return 0;
+}
+
+/*
+ * Avanza la trama de c con lo que ya llegó, sin bloquear: hasta
+ * SERVE_READ_SLICE bytes o hasta encolar un pedido completo (el resto
+ * queda para la próxima vuelta del poll). Devuelve 0 si la conexión
+ * sigue, 1 si hay que dejar de leerla (EOF, error, o una trama que no se
+ * puede resincronizar).
+ */
+static int serve_read_request(ServeConn *c) {
+    static uint8_t discard[64 << 10];   /* solo lo usa el hilo del poll */
+    size_t budget = SERVE_READ_SLICE;
+    char why[160];
+    while (budget > 0) {
+        uint8_t *dst;
+        size_t want;
+        if (c->skip > 0) {
+            dst = discard;
+            want = c->skip < sizeof(discard) ? (size_t)c->skip : sizeof(discard);
+        } else if (c->hdr_got < sizeof(c->req)) {
+            dst = (uint8_t *)&c->req + c->hdr_got;
+            want = sizeof(c->req) - c->hdr_got;
+        } else {
+            /* Se duplica hasta in_len: la memoria sigue a los bytes que llegaron */
+            if (c->in_got == c->in_cap) {
+                size_t cap = c->in_cap * 2 < c->req.in_len ? c->in_cap * 2 : (size_t)c->req.in_len;
+                uint8_t *p = realloc(c->in, cap);
+                if (!p) return serve_reject(c, RLE_LIB_ENOMEM, "Sin memoria para la entrada inline");
+                c->in = p;
+                c->in_cap = cap;
+            }
+            dst = c->in + c->in_got;
+            want = c->in_cap - c->in_got;
+        }
+        if (want > budget) want = budget;
+        ssize_t r = rle_serve_recv_some(c->fd, c->is_socket, dst, want, c->fds, &c->nfds);
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (r < 0) {
+            fprintf(stderr, "  serve: lectura de pedido: %s\n", strerror(errno));
+            return 1;
+        }
+        if (r == 0) {
+            if (c->hdr_got > 0 || c->skip > 0)
+                fprintf(stderr, "  serve: la conexión se cerró a mitad de un pedido\n");
+            return 1;
+        }
+        budget -= (size_t)r < budget ? (size_t)r : budget;
+
+        if (c->skip > 0) {
+            c->skip -= (uint64_t)r;
+        } else if (c->hdr_got < sizeof(c->req)) {
+            c->hdr_got += (size_t)r;
+            if (c->hdr_got < sizeof(c->req)) continue;
+            const RLEServeRequest *q = &c->req;
+            if (memcmp(q->magic, RLE_SERVE_REQ_MAGIC, 4) != 0) {
+                fprintf(stderr, "  serve: trama sin magic \"RLEQ\", se cierra la conexión\n");
+                return 1;
+            }
+            /* Entrada inline: se junta entera antes de encolar (el ejecutor nunca lee sockets) */
+            if (q->shm == 0 && q->op != RLE_SERVE_STATS && q->in_len > 0) {
+                int code = serve_inline_begin(c, why, sizeof(why));
+                if (code) return serve_reject(c, code, why);
+                continue;
+            }
+            return serve_enqueue(c, 0, NULL);
+        } else {
+            c->in_got += (size_t)r;
+            if (c->in_got < (size_t)c->req.in_len) continue;
+            return serve_enqueue(c, 0, NULL);
+        }
+    }
+    return 0;
+}
+
+/* Texto de la operación STATS (y base de la línea final del informe) */
+static int serve_stats_text(char *buf, size_t cap) {
+    RLEServePercentiles t, s;
+    rle_serve_percentiles(&g_serve.total, &t);
+    rle_serve_percentiles(&g_serve.service, &s);
+    return snprintf(buf, cap,
+                    "pedidos %llu (compress %llu, decompress %llu, stats %llu), errores %llu\n"
+                    "bytes entrada %llu, salida %llu; memoria compartida: %llu entradas, %llu salidas\n"
+                    "latencia total ms: p50 %.3f p90 %.3f p99 %.3f p99.9 %.3f max %.3f\n"
+                    "servicio ms:       p50 %.3f p90 %.3f p99 %.3f p99.9 %.3f max %.3f\n"
+                    "cola: %d de %d como maximo; hilos del pool %d\n",
+                    (unsigned long long)(g_serve.requests[RLE_SERVE_COMPRESS] +
+                                         g_serve.requests[RLE_SERVE_DECOMPRESS] +
+                                         g_serve.requests[RLE_SERVE_STATS] + g_serve.requests[0]),
+                    (unsigned long long)g_serve.requests[RLE_SERVE_COMPRESS],
+                    (unsigned long long)g_serve.requests[RLE_SERVE_DECOMPRESS],
+                    (unsigned long long)g_serve.requests[RLE_SERVE_STATS],
+                    (unsigned long long)g_serve.errors,
+                    (unsigned long long)g_serve.bytes_in, (unsigned long long)g_serve.bytes_out,
+                    (unsigned long long)g_serve.shm_in, (unsigned long long)g_serve.shm_out,
+                    t.p50, t.p90, t.p99, t.p999, t.max, s.p50, s.p90, s.p99, s.p999, s.max,
+                    g_serve.max_depth, g_serve_queue, librle_thread_count(&g_serve.lib, 0));
+}
+
+/*
+ * Bytes reales detrás de un fd del cliente. Mapear más allá del final del
+ * archivo no falla en mmap sino al leer (SIGBUS en el ejecutor o en el
+ * pool), así que in_len y out_cap se comparan con esto antes de mapear.
+ * Un pipe o un socket dan 0. -1 si fstat falla.
+ */
+static long long serve_fd_size(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return -1;
+    return (long long)st.st_size;
+}
+
+/*
+ * 1 si el fd no puede achicarse (F_SEAL_SHRINK) y, la entrada, tampoco
+ * cambiar (F_SEAL_WRITE). Sin el sello un ftruncate del cliente entre el
+ * fstat y la lectura deja páginas mapeadas sin archivo detrás: el acceso da
+ * SIGBUS en el ejecutor o en un hilo del pool, demo_signal_handler vuelve y
+ * la instrucción se repite para siempre. Solo un memfd admite sellos; sin
+ * F_GET_SEALS (macOS) ningún fd alcanza y shm queda deshabilitado.
+ */
+static int serve_fd_sealed(int fd, int input) {
+#ifdef F_GET_SEALS
+    int need = F_SEAL_SHRINK | (input ? F_SEAL_WRITE : 0);
+    int seals = fcntl(fd, F_GET_SEALS);
+    return seals >= 0 && (seals & need) == need;
+#else
+    (void)fd;
+    (void)input;
+    return 0;
+#endif
+}
+
+/*
+ * Resuelve un pedido. Deja en *out / *out_len lo que sigue a la respuesta
+ * inline (salida, texto de STATS o mensaje de error) y devuelve el status.
+ * Los mapeos de los fds se deshacen antes de volver.
+ */
+static int serve_handle(ServeJob *job, RLEServeResponse *resp, const uint8_t **out,
+                        size_t *out_len, char *msg, size_t msg_cap) {
+    const RLEServeRequest *q = &job->req;
+    RLELib *lib = &g_serve.lib;
+    const uint8_t *in = job->in;
+    size_t in_len = (size_t)q->in_len;
+    void *in_map = MAP_FAILED, *out_map = MAP_FAILED;
+    size_t out_cap = (size_t)q->out_cap;
+    int rc = RLE_LIB_OK;
+    msg[0] = '\0';
+
+#define SERVE_FAIL(code, ...) do { rc = (code); snprintf(msg, msg_cap, __VA_ARGS__); goto done; } while (0)
+    if (job->reject) {
+        in_len = 0;                     /* no se leyó: no cuenta en bytes_in */
+        SERVE_FAIL(job->reject, "%s", job->why);
+    }
+    if (q->op == RLE_SERVE_STATS) {
+        *out_len = (size_t)serve_stats_text(msg, msg_cap);
+        if (*out_len >= msg_cap) *out_len = msg_cap - 1;
+        *out = (const uint8_t *)msg;
+        resp->out_len = *out_len;
+        return RLE_LIB_OK;
+    }
+    if (q->op != RLE_SERVE_COMPRESS && q->op != RLE_SERVE_DECOMPRESS)
+        SERVE_FAIL(RLE_LIB_EINVAL, "Operación desconocida: %u", q->op);
+    if (q->shm > RLE_SERVE_MAX_FDS || q->shm > job->nfds)
+        SERVE_FAIL(RLE_LIB_EINVAL, "shm = %u pero llegaron %d fds", q->shm, job->nfds);
+    if (q->shm >= 1 && !serve_fd_sealed(job->fds[0], 1))
+        SERVE_FAIL(RLE_LIB_EINVAL, "El fd de entrada no está sellado "
+                   "(memfd con F_SEAL_SHRINK | F_SEAL_WRITE)");
+    if (q->shm == 2 && !serve_fd_sealed(job->fds[1], 0))
+        SERVE_FAIL(RLE_LIB_EINVAL, "El fd de salida no está sellado (memfd con F_SEAL_SHRINK)");
+    if (q->shm >= 1) {
+        long long have = serve_fd_size(job->fds[0]);
+        if (have < 0)
+            SERVE_FAIL(RLE_LIB_EIO, "fstat del fd de entrada: %s", strerror(errno));
+        if ((uint64_t)have < q->in_len)
+            SERVE_FAIL(RLE_LIB_EINVAL, "El fd de entrada tiene %lld bytes y el pedido declara %llu",
+                       have, (unsigned long long)q->in_len);
+        if (in_len == 0 || (in_map = mmap(NULL, in_len, PROT_READ, MAP_SHARED, job->fds[0], 0))
+                           == MAP_FAILED)
+            SERVE_FAIL(RLE_LIB_EIO, "No se pudo mapear la entrada (%zu bytes): %s", in_len,
+                       strerror(in_len ? errno : EINVAL));
+        in = in_map;
+        g_serve.shm_in++;
+    }
+    if (q->shm == 2) {
+        long long have = serve_fd_size(job->fds[1]);
+        if (have < 0)
+            SERVE_FAIL(RLE_LIB_EIO, "fstat del fd de salida: %s", strerror(errno));
+        if ((uint64_t)have < q->out_cap)
+            SERVE_FAIL(RLE_LIB_EINVAL, "El fd de salida tiene %lld bytes y el pedido declara %llu",
+                       have, (unsigned long long)q->out_cap);
+    }
+    if (q->shm == 2 && out_cap > 0 &&
+        (out_map = mmap(NULL, out_cap, PROT_READ | PROT_WRITE, MAP_SHARED, job->fds[1], 0))
+        == MAP_FAILED)
+        SERVE_FAIL(RLE_LIB_EIO, "No se pudo mapear la salida (%zu bytes): %s", out_cap,
+                   strerror(errno));
+    if (!in && in_len == 0)
+        SERVE_FAIL(RLE_LIB_EINVAL, "Pedido sin entrada");
+
+    uint8_t *dst;
+    size_t len = 0;
+    if (q->op == RLE_SERVE_COMPRESS) {
+        if (q->mode >= RLE_MODE_COUNT)
+            SERVE_FAIL(RLE_LIB_EINVAL, "Modo de codificación desconocido: %u", q->mode);
+        if (q->flags & ~RLE_FLAGS_KNOWN)
+            SERVE_FAIL(RLE_LIB_EINVAL, "Flags desconocidos: 0x%02x", q->flags);
+        if ((uint64_t)q->width * q->height * 3 != q->in_len)
+            SERVE_FAIL(RLE_LIB_EINVAL, "%ux%u RGB son %llu bytes, llegaron %zu", q->width,
+                       q->height, (unsigned long long)q->width * q->height * 3, in_len);
+        lib->cfg.mode = q->mode;
+        lib->cfg.flags = q->flags;
+        lib->cfg.tile_rows = q->tile_rows;
+        size_t bound = librle_compress_bound(lib, q->width, q->height);
+        if (bound == 0 || q->width == 0)
+            SERVE_FAIL(RLE_LIB_EINVAL, "Imagen vacía o demasiado grande (%ux%u)", q->width, q->height);
+        /* Con un fd de salida que alcanza la cota se comprime directo sobre él */
+        int direct = out_map != MAP_FAILED && out_cap >= bound;
+        dst = direct ? out_map : serve_arena(bound);
+        if (!dst) SERVE_FAIL(RLE_LIB_ENOMEM, "Sin memoria para %zu bytes de salida", bound);
+        rc = librle_compress(lib, in, q->width, q->height, dst, direct ? out_cap : bound, &len);
+        resp->width = q->width;
+        resp->height = q->height;
+    } else {
+        RLEFileHeader hdr;
+        rc = librle_info(lib, in, in_len, &hdr);
+        if (rc == RLE_LIB_OK) {
+            uint64_t need = (uint64_t)hdr.width * hdr.height * 3;
+            if (need > SIZE_MAX / 4 || (out_map == MAP_FAILED && need > RLE_SERVE_MAX_INLINE))
+                SERVE_FAIL(RLE_LIB_EINVAL, "%ux%u no cabe en una respuesta inline (usar shm = 2)",
+                           hdr.width, hdr.height);
+            len = (size_t)need;
+            resp->width = hdr.width;
+            resp->height = hdr.height;
+            if (out_map != MAP_FAILED && out_cap < len) {
+                resp->need = len;
+                SERVE_FAIL(RLE_LIB_ENOSPC, "La salida ocupa %zu bytes y el fd de salida tiene %zu",
+                           len, out_cap);
+            }
+            dst = out_map != MAP_FAILED ? out_map : serve_arena(len);
+            if (!dst) SERVE_FAIL(RLE_LIB_ENOMEM, "Sin memoria para %zu bytes de salida", len);
+            lib->cfg.verify_crc = (q->flags & RLE_SERVE_VERIFY_CRC) != 0;
+            rc = librle_decode_chunks(lib, &hdr, lib->table, in, dst, len);
+        }
+    }
+    if (rc != RLE_LIB_OK) {
+        snprintf(msg, msg_cap, "%s", librle_error(lib));
+        goto done;
+    }
+
+    /* Salida al fd del cliente (copiando desde la arena si no alcanzaba la cota) */
+    if (out_map != MAP_FAILED) {
+        if (dst != out_map) {
+            if (len > out_cap) {
+                resp->need = len;
+                SERVE_FAIL(RLE_LIB_ENOSPC, "La salida ocupa %zu bytes y el fd de salida tiene %zu",
+                           len, out_cap);
+            }
+            memcpy(out_map, dst, len);
+        }
+        resp->shm = 1;
+        g_serve.shm_out++;
+        *out_len = 0;
+    } else {
+        *out = dst;
+        *out_len = len;
+    }
+    resp->out_len = len;
+    g_serve.bytes_out += len;
+#undef SERVE_FAIL
+
+done:
+    g_serve.bytes_in += in_len;
+    if (in_map != MAP_FAILED) munmap(in_map, in_len);
+    if (out_map != MAP_FAILED) munmap(out_map, out_cap);
+    if (rc != RLE_LIB_OK) {
+        if (!msg[0]) snprintf(msg, msg_cap, "%s", librle_strerror(rc));
+        *out = (const uint8_t *)msg;
+        *out_len = strlen(msg);
+        resp->out_len = *out_len;
+        resp->shm = 0;
+    }
+    return rc;
+}
+
+/* POLLOUT: escribe sin bloquear lo que haya en la cola de c (bajo out_lock); -1 con errno */
+static int serve_flush(ServeConn *c) {
+    while (c->out_head) {
+        ServeOut *o = c->out_head;
+        struct iovec iov = { o->data + o->off, o->len - o->off };
+        ssize_t w = rle_serve_send_some(c->out_fd, &iov, 1);
+        if (w <= 0) return (int)w;
+        clock_gettime(CLOCK_MONOTONIC, &c->out_since);
+        o->off += (size_t)w;
+        c->out_bytes -= (size_t)w;
+        if (o->off < o->len) return 0;
+        c->out_head = o->next;
+        if (!c->out_head) c->out_tail = NULL;
+        free(o);
+    }
+    return 0;
+}
+
+/*
+ * Entrega una respuesta sin bloquear al ejecutor: si no hay nada antes en la
+ * cola se escribe lo que el socket acepte, y el resto se copia al final de
+ * la cola de salida de c. Devuelve 1 si la cola estaba vacía (hay que
+ * despertar al poll para que espere POLLOUT).
+ */
+static int serve_reply(ServeConn *c, const RLEServeResponse *resp, const uint8_t *out,
+                       size_t out_len) {
+    struct iovec iov[2] = { { (void *)resp, sizeof(*resp) }, { (void *)out, out_len } };
+    size_t total = sizeof(*resp) + out_len, sent = 0;
+    char why[128];
+    int wake = 0;
+    pthread_mutex_lock(&c->out_lock);
+    if (c->dead) goto done;
+    if (!c->out_head) {
+        ssize_t w = rle_serve_send_some(c->out_fd, iov, out_len ? 2 : 1);
+        if (w < 0) {
+            snprintf(why, sizeof(why), "respuesta al pedido %u: %s", resp->id, strerror(errno));
+            serve_conn_kill(c, why);
+            goto done;
+        }
+        sent = (size_t)w;
+    }
+    if (sent < total) {
+        ServeOut *o = malloc(sizeof(*o) + (total - sent));
+        if (!o) {
+            snprintf(why, sizeof(why), "sin memoria para %zu bytes de respuesta", total - sent);
+            serve_conn_kill(c, why);
+            goto done;
+        }
+        o->next = NULL;
+        o->len = total - sent;
+        o->off = 0;
+        uint8_t *p = o->data;
+        for (int k = 0; k < 2; k++) {
+            size_t n = iov[k].iov_len;
+            if (sent >= n) { sent -= n; continue; }
+            memcpy(p, (const uint8_t *)iov[k].iov_base + sent, n - sent);
+            p += n - sent;
+            sent = 0;
+        }
+        if (c->out_tail) {
+            c->out_tail->next = o;
+        } else {
+            c->out_head = o;
+            clock_gettime(CLOCK_MONOTONIC, &c->out_since);
+            wake = 1;
+        }
+        c->out_tail = o;
+        c->out_bytes += o->len;
+    }
+done:
+    pthread_mutex_unlock(&c->out_lock);
+    return wake;
+}
+
+/*
+ * La conexión sale del poll si está cortada, si su salida lleva timeout_ms
+ * sin avanzar (el cliente no lee) o si ya no se lee
+ * y no le queda nada: ni pedidos en cola ni respuestas por entregar. Los
+ * pedidos se miran antes que la salida: sin pedidos ya no llega salida nueva.
+ */
+static int serve_conn_done(ServeConn *c, const struct timespec *now, int timeout_ms) {
+    pthread_mutex_lock(&g_serve.lock);
+    int busy = c->refs > 1;
+    pthread_mutex_unlock(&g_serve.lock);
+    pthread_mutex_lock(&c->out_lock);
+    if (c->out_bytes && serve_ms(&c->out_since, now) > timeout_ms) {
+        char why[128];
+        snprintf(why, sizeof(why), "el cliente no lee sus respuestas (%zu bytes en %d ms)",
+                 c->out_bytes, timeout_ms);
+        serve_conn_kill(c, why);
+    }
+    int dead = c->dead, idle = c->out_bytes == 0;
+    pthread_mutex_unlock(&c->out_lock);
+    return dead || (c->eof && !busy && idle);
+}
+
+static void *serve_exec_func(void *arg) {
+    RLEMetricsThread *mt = (RLEMetricsThread *)arg;
+    char msg[1024];
+    for (;;) {
+        pthread_mutex_lock(&g_serve.lock);
+        while (!g_serve.head && !g_serve.closing)
+            pthread_cond_wait(&g_serve.ready, &g_serve.lock);
+        ServeJob *job = g_serve.head;
+        if (job) {
+            g_serve.head = job->next;
+            if (!g_serve.head) g_serve.tail = NULL;
+            if (g_serve.depth-- == g_serve_queue && g_serve.wake >= 0) {
+                ssize_t r = write(g_serve.wake, "q", 1);
+                (void)r;
+            }
+            rle_metrics_queue(&g_metrics, (uint64_t)g_serve.depth);
+        }
+        pthread_mutex_unlock(&g_serve.lock);
+        if (!job) break;                /* closing y la cola vacía */
+
+        /* Conexión cortada (no leía o se fue): el pedido se descarta sin resolverlo */
+        pthread_mutex_lock(&job->conn->out_lock);
+        int dead = job->conn->dead;
+        pthread_mutex_unlock(&job->conn->out_lock);
+        if (dead) {
+            g_serve.discarded++;
+            serve_conn_release(job->conn);
+            serve_job_free(job);
+            continue;
+        }
+
+        struct timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        rle_metrics_begin(mt);
+        RLEServeResponse resp;
+        memset(&resp, 0, sizeof(resp));
+        memcpy(resp.magic, RLE_SERVE_RESP_MAGIC, 4);
+        resp.id = job->req.id;
+        const uint8_t *out = NULL;
+        size_t out_len = 0;
+        resp.status = serve_handle(job, &resp, &out, &out_len, msg, sizeof(msg));
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        resp.queue_ns = (uint64_t)(serve_ms(&job->t_queued, &t0) * 1e6);
+        resp.service_ns = (uint64_t)(serve_ms(&t0, &t1) * 1e6);
+
+        /* Sin bloquear: lo que el cliente no acepta ya lo entrega el poll */
+        if (serve_reply(job->conn, &resp, out, out_len)) {
+            pthread_mutex_lock(&g_serve.lock);
+            if (g_serve.wake >= 0) {
+                ssize_t r = write(g_serve.wake, "w", 1);
+                (void)r;
+            }
+            pthread_mutex_unlock(&g_serve.lock);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        rle_metrics_end(mt, job->req.op == RLE_SERVE_STATS ? 0 : job->req.in_len,
+                        resp.status == RLE_LIB_OK ? resp.out_len : 0);
+        rle_metrics_done(&g_metrics, resp.status == RLE_LIB_OK);
+
+        g_serve.requests[job->req.op <= RLE_SERVE_STATS ? job->req.op : 0]++;
+        if (resp.status != RLE_LIB_OK) g_serve.errors++;
+        rle_serve_latency_add(&g_serve.wait, serve_ms(&job->t_queued, &t0));
+        rle_serve_latency_add(&g_serve.service, serve_ms(&t0, &t1));
+        rle_serve_latency_add(&g_serve.total, serve_ms(&job->t_queued, &t2));
+        serve_conn_release(job->conn);
+        serve_job_free(job);
+    }
+    return NULL;
+}
+
+static void serve_report(const char *where, double secs) {
+    const char *CYAN = "\033[36m";
+    const char *YELLOW = "\033[1;33m";
+    const char *RESET = "\033[0m";
+    RLEServePercentiles t, s, w;
+    rle_serve_percentiles(&g_serve.total, &t);
+    rle_serve_percentiles(&g_serve.service, &s);
+    rle_serve_percentiles(&g_serve.wait, &w);
+    uint64_t n = g_serve.requests[0] + g_serve.requests[RLE_SERVE_COMPRESS] +
+                 g_serve.requests[RLE_SERVE_DECOMPRESS] + g_serve.requests[RLE_SERVE_STATS];
+
+    char rows[12][2][96];
+    int nr = 0;
+#define SERVE_ROW(label, ...) do { snprintf(rows[nr][0], 96, "%s", label); \
+                                   snprintf(rows[nr][1], 96, __VA_ARGS__); nr++; } while (0)
+    SERVE_ROW("Escucha:", "%s", where);
+    SERVE_ROW("Pedidos:", "%llu en %.1f s (compress %llu, decompress %llu, stats %llu)",
+              (unsigned long long)n, secs, (unsigned long long)g_serve.requests[RLE_SERVE_COMPRESS],
+              (unsigned long long)g_serve.requests[RLE_SERVE_DECOMPRESS],
+              (unsigned long long)g_serve.requests[RLE_SERVE_STATS]);
+    SERVE_ROW("Errores:", "%llu", (unsigned long long)g_serve.errors);
+    SERVE_ROW("Conexiones cortadas:", "%llu (no leían o se fueron), %llu pedidos descartados",
+              (unsigned long long)g_serve.dropped, (unsigned long long)g_serve.discarded);
+    SERVE_ROW("Bytes entrada/salida:", "%.2f MB / %.2f MB", g_serve.bytes_in / (1024.0 * 1024.0),
+              g_serve.bytes_out / (1024.0 * 1024.0));
+    SERVE_ROW("Entrada inline:", "pico %.1f MB de %u MB, %llu pedidos rechazados",
+              g_serve.inline_peak / (1024.0 * 1024.0), SERVE_INLINE_TOTAL >> 20,
+              (unsigned long long)g_serve.rejected);
+    SERVE_ROW("Memoria compartida:", "%llu entradas, %llu salidas por fd (sin copia)",
+              (unsigned long long)g_serve.shm_in, (unsigned long long)g_serve.shm_out);
+    SERVE_ROW("Latencia total (ms):", "p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f",
+              t.p50, t.p90, t.p99, t.p999, t.max);
+    SERVE_ROW("  servicio (ms):", "p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f",
+              s.p50, s.p90, s.p99, s.p999, s.max);
+    SERVE_ROW("  espera en cola (ms):", "p50 %.2f  p90 %.2f  p99 %.2f  media %.2f",
+              w.p50, w.p90, w.p99, w.mean);
+    SERVE_ROW("Cola:", "%d pedidos como maximo (limite %d)", g_serve.max_depth, g_serve_queue);
+    SERVE_ROW("Pool / arena:", "%d hilos persistentes, arena de salida %.2f MB",
+              librle_thread_count(&g_serve.lib, 0), g_serve.arena_cap / (1024.0 * 1024.0));
+#undef SERVE_ROW
+
+    fprintf(stderr, "\n%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    fprintf(stderr, "%s║%s     %sSERVIDOR DE COMPRESIÓN (--serve)%s                                                 %s║%s\n",
+            CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    fprintf(stderr, "%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    for (int i = 0; i < nr; i++)
+        fprintf(stderr, "%s║%s  %-23s%-61.61s%s║%s\n", CYAN, RESET, rows[i][0], rows[i][1], CYAN, RESET);
+    fprintf(stderr, "%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+}
+
+/* Socket Unix de escucha; un socket viejo en la misma ruta se reemplaza */
+static int serve_listen(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Ruta de socket demasiado larga: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SERVE_MAX_CONNS) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
     }
+    track_syscall("socket", "socket+bind+listen", "Socket Unix del servidor (--serve)");
+    return fd;
+}
+
+static int serve_main(const char *where) {
+    int stdio = strcmp(where, "-") == 0;
+    int wake[2];
+    if (pipe(wake) != 0) { perror("pipe"); return 1; }
+    for (int i = 0; i < 2; i++)
+        fcntl(wake[i], F_SETFL, fcntl(wake[i], F_GETFL) | O_NONBLOCK);
+
+    /* Un cliente que se va a mitad de respuesta no debe matar al servidor */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    int lfd = stdio ? -1 : serve_listen(where);
+    if (!stdio && lfd < 0) return 1;
+
+    RLELibConfig cfg;
+    librle_config_default(&cfg);
+    cfg.backend = RLE_LIB_POOL;
+    cfg.threads = worker_threads();
+    if (librle_init(&g_serve.lib, &cfg) != RLE_LIB_OK) {
+        fprintf(stderr, "librle: %s\n", librle_error(&g_serve.lib));
+        return 1;
+    }
+    g_serve.lib.kernel = g_scan;
+    g_serve.lib.cache = g_use_cache ? &g_chunk_cache : NULL;
+    track_syscall("pthread_create", "clone", "Pool persistente del servidor (--serve)");
+
+    if (metrics_start("serve", 0, "executor", (uint64_t)g_serve_queue, 0) != 0) {
+        librle_release(&g_serve.lib);
+        if (lfd >= 0) {
+            close(lfd);
+            unlink(where);
+        }
+        return 1;
+    }
+
+    g_current_phase = PHASE_COMPRESS;
+    clock_gettime(CLOCK_MONOTONIC, &g_serve.t0);
+    pthread_t exec;
+    if (pthread_create(&exec, NULL, serve_exec_func, metrics_slot(0)) != 0) {
+        perror("pthread_create");
+        metrics_stop();
+        librle_release(&g_serve.lib);
+        return 1;
+    }
+    g_serve.wake = g_signal_wake = wake[1];
+    fprintf(stderr, "  \033[32mServidor RLE en %s\033[0m (pid %d, %d hilos, cola de %d); "
+            "SIGINT/SIGTERM para terminar\n",
+            stdio ? "stdin/stdout" : where, (int)getpid(), librle_thread_count(&g_serve.lib, 0),
+            g_serve_queue);
+
+    ServeConn *conns[SERVE_MAX_CONNS];
+    struct pollfd pfd[2 + 2 * SERVE_MAX_CONNS];     /* por conexión: lectura y escritura */
+    int nconns = 0;
+    /* E/S no bloqueante (stdin y stdout recuperan sus flags al salir) */
+    int stdin_flags = fcntl(STDIN_FILENO, F_GETFL);
+    int stdout_flags = fcntl(STDOUT_FILENO, F_GETFL);
+    if (stdio && (conns[0] = serve_conn_new(STDIN_FILENO, STDOUT_FILENO, 0))) {
+        fcntl(STDIN_FILENO, F_SETFL, stdin_flags | O_NONBLOCK);
+        fcntl(STDOUT_FILENO, F_SETFL, stdout_flags | O_NONBLOCK);
+        nconns = 1;
+    }
+
+    int stop = 0, draining = 0;         /* SIGINT/SIGTERM: se drena y se sale */
+    while (lfd >= 0 || nconns > 0) {
+        /*
+         * Con la cola llena no se leen conexiones: el 'q' del ejecutor despierta
+         * el poll. Una conexión con salida pendiente espera POLLOUT; un fd
+         * negativo es un lado que no se espera (poll lo ignora).
+         */
+        pthread_mutex_lock(&g_serve.lock);
+        int full = g_serve.depth >= g_serve_queue;
+        pthread_mutex_unlock(&g_serve.lock);
+        int n = 0, tick = 0;
+        pfd[n++] = (struct pollfd){ wake[0], POLLIN, 0 };
+        if (lfd >= 0) pfd[n++] = (struct pollfd){ lfd, POLLIN, 0 };
+        int base = n;
+        for (int i = 0; i < nconns; i++) {
+            ServeConn *c = conns[i];
+            pthread_mutex_lock(&c->out_lock);
+            int pending = c->out_bytes > 0;
+            int readable = !full && !c->eof && c->out_bytes < SERVE_OUT_HIGH;
+            pthread_mutex_unlock(&c->out_lock);
+            pfd[n++] = (struct pollfd){ readable ? c->fd : -1, POLLIN, 0 };
+            pfd[n++] = (struct pollfd){ pending ? c->out_fd : -1, POLLOUT, 0 };
+            tick |= pending || c->eof;  /* plazo de escritura, o esperar a sus pedidos */
+        }
+        if (poll(pfd, (nfds_t)n, tick ? SERVE_TICK_MS : -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if (pfd[0].revents & POLLIN) {
+            char b[64];
+            ssize_t r;
+            while ((r = read(wake[0], b, sizeof(b))) > 0)
+                if (memchr(b, '\0', (size_t)r)) stop = 1;      /* SIGINT / SIGTERM */
+        }
+
+        /* Apagado: no se acepta ni se lee más; los pedidos en cola se terminan */
+        if (stop && !draining) {
+            draining = 1;
+            g_signal_wake = -1;
+            if (lfd >= 0) {
+                close(lfd);
+                unlink(where);
+                lfd = -1;
+            }
+            for (int i = 0; i < nconns; i++)
+                conns[i]->eof = 1;
+            pthread_mutex_lock(&g_serve.lock);
+            int pending = g_serve.depth;
+            g_serve.closing = 1;
+            pthread_cond_broadcast(&g_serve.ready);
+            pthread_mutex_unlock(&g_serve.lock);
+            if (pending)
+                fprintf(stderr, "  serve: drenando %d pedido(s) en cola...\n", pending);
+            continue;
+        }
+
+        /* De atrás hacia adelante: soltar una conexión la reemplaza por la última */
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (int i = nconns - 1; i >= 0; i--) {
+            ServeConn *c = conns[i];
+            if (pfd[base + 2 * i + 1].revents) {
+                pthread_mutex_lock(&c->out_lock);
+                if (serve_flush(c) != 0) {
+                    char why[128];
+                    snprintf(why, sizeof(why), "escritura de respuesta: %s", strerror(errno));
+                    serve_conn_kill(c, why);
+                }
+                pthread_mutex_unlock(&c->out_lock);
+            }
+            if (pfd[base + 2 * i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                pthread_mutex_lock(&g_serve.lock);
+                full = g_serve.depth >= g_serve_queue;
+                pthread_mutex_unlock(&g_serve.lock);
+                /* Con la cola llena el resto espera al próximo poll */
+                if (!full && serve_read_request(c) != 0)
+                    c->eof = 1;
+            }
+            if (serve_conn_done(c, &now, draining ? SERVE_DRAIN_TIMEOUT : SERVE_WRITE_TIMEOUT)) {
+                if (c->dead) g_serve.dropped++;
+                serve_conn_release(c);
+                conns[i] = conns[--nconns];
+            }
+        }
+        if (lfd >= 0 && (pfd[1].revents & POLLIN)) {
+            int cfd = accept(lfd, NULL, NULL);
+            ServeConn *c = NULL;
+            if (cfd >= 0 && (nconns == SERVE_MAX_CONNS || !(c = serve_conn_new(cfd, cfd, 1)))) {
+                fprintf(stderr, "  serve: máximo de %d conexiones, se rechaza una\n", SERVE_MAX_CONNS);
+                close(cfd);
+            } else if (c) {
+                fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+                conns[nconns++] = c;
+            }
+        }
+    }
+
+    /* Sin conexiones (o poll roto): el ejecutor termina lo que quede en cola y sale */
+    g_signal_wake = -1;
+    if (lfd >= 0) {
+        close(lfd);
+        unlink(where);
+    }
+    for (int i = 0; i < nconns; i++)
+        serve_conn_release(conns[i]);
+    pthread_mutex_lock(&g_serve.lock);
+    g_serve.wake = -1;
+    g_serve.closing = 1;
+    pthread_cond_broadcast(&g_serve.ready);
+    pthread_mutex_unlock(&g_serve.lock);
+    pthread_join(exec, NULL);
+    metrics_stop();
+    if (stdio && stdin_flags >= 0)
+        fcntl(STDIN_FILENO, F_SETFL, stdin_flags);
+    if (stdio && stdout_flags >= 0)
+        fcntl(STDOUT_FILENO, F_SETFL, stdout_flags);
+
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    g_current_phase = PHASE_CLEANUP;
+    serve_report(stdio ? "stdin/stdout" : where, serve_ms(&g_serve.t0, &t1) / 1e3);
+    librle_release(&g_serve.lib);
+    free(g_serve.arena);
+    free(g_serve.total.ms);
+    free(g_serve.service.ms);
+    free(g_serve.wait.ms);
+    close(wake[0]);
+    close(wake[1]);
+    return 0;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  FUNCIÓN PRINCIPAL
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+int main(int argc, char *argv[]) {
+    /* Inicializar seguimiento de SO */
+    setup_signal_handlers();
+    capture_baseline_ctx();
+    g_current_phase = PHASE_INIT;
+
+    /* Variables en STACK - marcadores */
+    int stack_marker_top = 0;
+    RLELibImage img = {0};
+    char input_path[512] = {0};
+
+    /* Inicializar variable atómica global */
+    atomic_init(&g_total_runs_atomic, 0);
+
+    /*
+     * Opciones: ./rle_paralelo [--scalar] [--mode byte|pixel|planar] [--varint] [--adaptive]
+     *           [--alloc grow|bound|exact|arena] [--raw-size WxH] [--no-raw]
+     *           [--tile ROWS] [--stream ROWS [--inflight N]] [--pipeline] [--batch DIR|-]
+     *           [--progress-bench] [--profile HZ] [--perf]
+     *           [--bench [--bench-iters K] [--bench-warmup W] [--bench-size WxH]
+     *                    [--bench-csv] [--bench-out ARCHIVO] [--bench-synth SPEC ...] [foto ...]]
+     *           [--synth SPEC] [--threads N] [--affinity none|compact|scatter]
+     *           [--first-touch] [--scaling] [--verify decode|stream|checksum] [--decode-bgr]
+     *           [--chunk-cache] [--chunk-cache-file ARCHIVO]
+     *           [--aio sync|uring|dispatch|auto] [--direct] [--fsync]
+     *           [--serve SOCKET|- [--serve-queue N]]
+     *           [--metrics-file ARCHIVO] [--metrics-listen [HOST:]PUERTO] [--metrics-interval MS]
+     *           [--trace ARCHIVO]
+     *           [-d archivo.rle [--rows Y0:Y1] | [--update] imagen]
+     */
+    const char *arg_input = NULL;
+    const char *bench_photos[RLE_BENCH_MAX_INPUTS];
+    int num_bench_photos = 0;
+    RLESynthParams bench_synth[RLE_BENCH_MAX_SYNTH];
+    int num_bench_synth = 0;
+    const char *arg_decompress = NULL;
+    const char *arg_batch = NULL;
+    const char *arg_serve = NULL;
+    int arg_scalar = 0;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--scalar") == 0) {
+            arg_scalar = 1;
+        } else if (strcmp(argv[a], "--mode") == 0 && a + 1 < argc) {
+            int m = rle_mode_parse(argv[++a]);
+            if (m < 0) {
+                fprintf(stderr, "Modo desconocido: %s (byte, pixel o planar)\n", argv[a]);
+                return 1;
+            }
+            g_rle_mode = (uint8_t)m;
+        } else if (strcmp(argv[a], "--varint") == 0) {
+            g_rle_flags |= RLE_FLAG_VARINT;
+        } else if (strcmp(argv[a], "--adaptive") == 0) {
+            g_rle_flags |= RLE_FLAG_CODEC;
+        } else if (strcmp(argv[a], "--raw-size") == 0 && a + 1 < argc) {
+            if (sscanf(argv[++a], "%ux%u", &g_raw_width, &g_raw_height) != 2 ||
+                g_raw_width == 0 || g_raw_height == 0) {
+                fprintf(stderr, "Tamaño RAW inválido: %s (formato WxH)\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--no-raw") == 0) {
+            g_write_raw = 0;
+        } else if (strcmp(argv[a], "--aio") == 0 && a + 1 < argc) {
+            if (rle_aio_parse(argv[++a], &g_aio_backend) != 0) {
+                fprintf(stderr, "E/S desconocida: %s (sync, uring, dispatch o auto)\n", argv[a]);
+                return 1;
+            }
+            g_aio_on = 1;
+        } else if (strcmp(argv[a], "--direct") == 0) {
+            g_aio_direct = g_aio_on = 1;
+        } else if (strcmp(argv[a], "--fsync") == 0) {
+            g_aio_fsync = g_aio_on = 1;
+        } else if (strcmp(argv[a], "--tile") == 0 && a + 1 < argc) {
+            int rows = atoi(argv[++a]);
+            if (rows <= 0) {
+                fprintf(stderr, "Filas por tile inválidas: %s\n", argv[a]);
+                return 1;
+            }
+            g_tile_rows = (uint32_t)rows;
+        } else if (strcmp(argv[a], "--stream") == 0 && a + 1 < argc) {
+            int rows = atoi(argv[++a]);
+            if (rows <= 0) {
+                fprintf(stderr, "Filas por strip inválidas: %s\n", argv[a]);
+                return 1;
+            }
+            g_stream_rows = (uint32_t)rows;
+        } else if (strcmp(argv[a], "--inflight") == 0 && a + 1 < argc) {
+            g_stream_inflight = atoi(argv[++a]);
+            if (g_stream_inflight <= 0) {
+                fprintf(stderr, "Strips en vuelo inválidos: %s\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--alloc") == 0 && a + 1 < argc) {
+            int m = -1;
+            for (int k = 0; k < ALLOC_COUNT; k++)
+                if (strcmp(argv[a + 1], g_alloc_names[k]) == 0) m = k;
+            if (m < 0) {
+                fprintf(stderr, "Reserva desconocida: %s (grow, bound, exact o arena)\n", argv[a + 1]);
+                return 1;
+            }
+            g_alloc_mode = (AllocMode)m;
+            a++;
+        } else if (strcmp(argv[a], "--pipeline") == 0) {
+            g_pipeline = 1;
+        } else if (strcmp(argv[a], "--progress-bench") == 0) {
+            g_progress_bench = 1;
+        } else if (strcmp(argv[a], "--perf") == 0) {
+            g_perf = 1;
+        } else if (strcmp(argv[a], "--profile") == 0 && a + 1 < argc) {
+            g_profile_hz = atoi(argv[++a]);
+            if (g_profile_hz <= 0 || g_profile_hz > RLE_PROF_MAX_HZ) {
+                fprintf(stderr, "Frecuencia de muestreo inválida: %s (1-%d Hz)\n", argv[a],
+                        RLE_PROF_MAX_HZ);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--bench") == 0) {
+            g_bench = 1;
+        } else if (strcmp(argv[a], "--bench-iters") == 0 && a + 1 < argc) {
+            g_bench_iters = atoi(argv[++a]);
+            if (g_bench_iters <= 0 || g_bench_iters > RLE_BENCH_MAX_ITERS) {
+                fprintf(stderr, "Iteraciones inválidas: %s (1-%d)\n", argv[a], RLE_BENCH_MAX_ITERS);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--bench-warmup") == 0 && a + 1 < argc) {
+            g_bench_warmup = atoi(argv[++a]);
+            if (g_bench_warmup < 0 || g_bench_warmup > RLE_BENCH_MAX_ITERS) {
+                fprintf(stderr, "Calentamiento inválido: %s (0-%d)\n", argv[a], RLE_BENCH_MAX_ITERS);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--bench-size") == 0 && a + 1 < argc) {
+            if (sscanf(argv[++a], "%ux%u", &g_bench_width, &g_bench_height) != 2 ||
+                g_bench_width == 0 || g_bench_height == 0) {
+                fprintf(stderr, "Tamaño sintético inválido: %s (formato WxH)\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--bench-csv") == 0) {
+            g_bench_csv = 1;
+        } else if (strcmp(argv[a], "--bench-out") == 0 && a + 1 < argc) {
+            g_bench_out = argv[++a];
+        } else if (strcmp(argv[a], "--bench-synth") == 0 && a + 1 < argc) {
+            if (num_bench_synth == RLE_BENCH_MAX_SYNTH) {
+                fprintf(stderr, "Demasiadas --bench-synth (máximo %d)\n", RLE_BENCH_MAX_SYNTH);
+                return 1;
+            }
+            if (rle_synth_parse(argv[++a], &bench_synth[num_bench_synth++]) != 0)
+                return 1;
+        } else if (strcmp(argv[a], "--synth") == 0 && a + 1 < argc) {
+            if (rle_synth_parse(argv[++a], &g_synth) != 0)
+                return 1;
+            g_use_synth = 1;
+        } else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            g_num_threads_config = atoi(argv[++a]);
+            if (g_num_threads_config <= 0 || g_num_threads_config > RLE_TOPO_MAX_CPUS) {
+                fprintf(stderr, "Cantidad de hilos inválida: %s (1-%d)\n", argv[a], RLE_TOPO_MAX_CPUS);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--affinity") == 0 && a + 1 < argc) {
+            if (rle_affinity_parse(argv[++a], &g_affinity) != 0) {
+                fprintf(stderr, "Afinidad desconocida: %s (none, compact o scatter)\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--first-touch") == 0) {
+            g_first_touch = 1;
+        } else if (strcmp(argv[a], "--decode-bgr") == 0) {
+            g_decode_bgr = 1;
+        } else if (strcmp(argv[a], "--rows") == 0 && a + 1 < argc) {
+            if (sscanf(argv[++a], "%u:%u", &g_rows_y0, &g_rows_y1) != 2 || g_rows_y0 >= g_rows_y1) {
+                fprintf(stderr, "Filas inválidas: %s (formato Y0:Y1, Y1 excluida)\n", argv[a]);
+                return 1;
+            }
+            g_rows = 1;
+        } else if (strcmp(argv[a], "--update") == 0) {
+            g_update = 1;
+        } else if (strcmp(argv[a], "--chunk-cache") == 0) {
+            g_use_cache = 1;
+        } else if (strcmp(argv[a], "--chunk-cache-file") == 0 && a + 1 < argc) {
+            g_cache_file = argv[++a];
+            g_use_cache = 1;
+        } else if (strcmp(argv[a], "--verify") == 0 && a + 1 < argc) {
+            g_verify = rle_verify_parse(argv[++a]);
+            if (g_verify < 0) {
+                fprintf(stderr, "Verificación desconocida: %s (decode, stream o checksum)\n", argv[a]);
+                return 1;
+            }
+            if (g_verify == RLE_VERIFY_CHECKSUM)
+                g_rle_flags |= RLE_FLAG_RAW_CRC;
+        } else if (strcmp(argv[a], "--scaling") == 0) {
+            g_scaling = 1;
+        } else if (strcmp(argv[a], "--serve") == 0 && a + 1 < argc) {
+            arg_serve = argv[++a];
+        } else if (strcmp(argv[a], "--serve-queue") == 0 && a + 1 < argc) {
+            g_serve_queue = atoi(argv[++a]);
+            if (g_serve_queue <= 0) {
+                fprintf(stderr, "Profundidad de cola inválida: %s\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--metrics-file") == 0 && a + 1 < argc) {
+            g_metrics_file = argv[++a];
+        } else if (strcmp(argv[a], "--metrics-listen") == 0 && a + 1 < argc) {
+            g_metrics_listen = argv[++a];
+        } else if (strcmp(argv[a], "--metrics-interval") == 0 && a + 1 < argc) {
+            g_metrics_interval_ms = atoi(argv[++a]);
+            if (g_metrics_interval_ms <= 0) {
+                fprintf(stderr, "Intervalo de métricas inválido: %s (ms)\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--trace") == 0 && a + 1 < argc) {
+            g_trace_path = argv[++a];
+        } else if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc) {
+            arg_batch = argv[++a];
+        } else if (strcmp(argv[a], "-d") == 0 && a + 1 < argc) {
+            arg_decompress = argv[++a];
+        } else if (argv[a][0] == '-' && argv[a][1] == '-') {
+            fprintf(stderr, "Opción desconocida: %s\n", argv[a]);
+            return 1;
+        } else {
+            if (!arg_input) arg_input = argv[a];
+            if (num_bench_photos < RLE_BENCH_MAX_INPUTS) bench_photos[num_bench_photos++] = argv[a];
+        }
+    }
+    g_scan = rle_scan_select(arg_scalar);
+    if (g_profile_hz && rle_prof_install(g_profile_hz) != 0)
+        return 1;
+
+    /* Caché de chunks: vive todo el proceso (todo el lote) y se guarda al salir */
+    if (g_use_cache) {
+        rle_chunk_cache_init(&g_chunk_cache, RLE_CHUNK_CACHE_MAX_BYTES);
+        if (g_cache_file) {
+            rle_chunk_cache_load(&g_chunk_cache, g_cache_file);
+            track_syscall("fread", "read", "Cargar la caché de chunks (--chunk-cache-file)");
+        }
+        atexit(chunk_cache_finish);
+    }
+
+    /* Topología para --affinity; first touch sin hilos fijados no garantiza el nodo */
+    rle_topo_init(&g_topo);
+    if (g_first_touch && g_affinity == RLE_AFFINITY_NONE)
+        g_affinity = RLE_AFFINITY_SCATTER;
+
+    if ((g_metrics_file || g_metrics_listen) && !arg_serve && !arg_batch)
+        fprintf(stderr, "  Aviso: --metrics-file / --metrics-listen solo aplican a --batch y --serve\n");
+    if (g_trace_path && (g_bench || arg_serve || arg_batch || g_rows || g_stream_rows > 0 ||
+                         g_pipeline || g_progress_bench || g_scaling || g_update)) {
+        fprintf(stderr, "  Aviso: --trace solo aplica a la compresión de una imagen y a -d\n");
+        g_trace_path = NULL;
+    }
+    lib_init();
+    trace_begin();
+
+    /* Benchmark: ./rle_paralelo --bench [foto ...] > bench.json */
+    if (g_bench)
+        return run_bench(bench_photos, num_bench_photos, bench_synth, num_bench_synth);
+
+    /* Servidor: ./rle_paralelo --serve /tmp/rle.sock  o  --serve - (stdin/stdout) */
+    if (arg_serve)
+        return serve_main(arg_serve);
+
+    /* Modo descompresión: ./rle_paralelo -d archivo.rle */
+    if (arg_decompress) {
+        if (g_rows)
+            return decompress_rows(arg_decompress, g_rows_y0, g_rows_y1);
+        int r = decompress_file(arg_decompress);
+        trace_finish("decompress");
+        return r;
+    }
+
+    /* Modo lote: ./rle_paralelo --batch image/  o  find ... | ./rle_paralelo --batch - */
+    if (arg_batch)
+        return batch_compress(arg_batch);
+
+    /* Modo streaming: ./rle_paralelo --stream ROWS [--pipeline] imagen.ppm */
+    if (g_stream_rows > 0 || g_pipeline) {
+        if (!arg_input) {
+            fprintf(stderr, "--stream/--pipeline requieren un archivo de entrada\n");
+            return 1;
+        }
+        return stream_compress(arg_input);
+    }
+
+    /* Cargar imagen: argumento, menú interactivo, o sintética */
+    if (arg_input) {
+        strncpy(input_path, arg_input, sizeof(input_path) - 1);
+        uint64_t load_t0 = rle_trace_clock(trace_main());
+        if (open_image(input_path, &img) != 0) {
+            return 1;
+        }
+        trace_main_span("io", "cargar imagen", load_t0, (int64_t)img.width * img.height * 3);
+    } else if (g_use_synth) {
+        char spec[160];
+        rle_synth_describe(&g_synth, spec, sizeof(spec));
+        printf("  \033[33mGenerando imagen sintética %s...\033[0m\n", spec);
+        img.width = g_synth.width;
+        img.height = g_synth.height;
+        img.data = rle_synth_generate(&g_synth);
+        if (!img.data) { perror("malloc"); return 1; }
+        track_heap_alloc(img.data, (size_t)img.width * img.height * 3, "Imagen sintética (--synth)");
+    } else {
+        /* Escanear carpeta image/ y listar imágenes disponibles */
+        const char *img_dir = "image";
+        char files[64][256];
+        int nfiles = 0;
+
+        DIR *dir = opendir(img_dir);
+        if (dir) {
+            struct dirent *entry;
+            while ((entry = readdir(dir)) != NULL && nfiles < 64) {
+                const char *name = entry->d_name;
+                if (is_image_name(name)) {
+                    snprintf(files[nfiles], sizeof(files[nfiles]), "%s", name);
+                    nfiles++;
+                }
+            }
+            closedir(dir);
+        }
+
+        printf("\n\033[1;36m╔══════════════════════════════════════════════════════════════╗\033[0m\n");
+        printf("\033[1;36m║\033[0m  \033[1;33mCOMPRESIÓN RLE - MODO PARALELO\033[0m                              \033[1;36m║\033[0m\n");
+        printf("\033[1;36m╠══════════════════════════════════════════════════════════════╣\033[0m\n");
+        printf("\033[1;36m║\033[0m                                                              \033[1;36m║\033[0m\n");
+        printf("\033[1;36m║\033[0m  \033[1;37mImágenes disponibles en /%s/:\033[0m                              \033[1;36m║\033[0m\n", img_dir);
+        printf("\033[1;36m║\033[0m                                                              \033[1;36m║\033[0m\n");
+
+        if (nfiles == 0) {
+            printf("\033[1;36m║\033[0m    \033[31m(No se encontraron imágenes en /%s/)\033[0m                  \033[1;36m║\033[0m\n", img_dir);
+        } else {
+            for (int i = 0; i < nfiles; i++) {
+                printf("\033[1;36m║\033[0m    \033[1;32m[%d]\033[0m %-50s  \033[1;36m║\033[0m\n", i + 1, files[i]);
+            }
+        }
+
+        printf("\033[1;36m║\033[0m                                                              \033[1;36m║\033[0m\n");
+        printf("\033[1;36m║\033[0m    \033[1;33m[0]\033[0m Usar imagen sintética (4096x4096)                    \033[1;36m║\033[0m\n");
+        printf("\033[1;36m║\033[0m    \033[1;35m[B]\033[0m Buscar archivo con explorador de archivos...         \033[1;36m║\033[0m\n");
+        printf("\033[1;36m║\033[0m                                                              \033[1;36m║\033[0m\n");
+        printf("\033[1;36m╚══════════════════════════════════════════════════════════════╝\033[0m\n");
+        printf("\n  Seleccione imagen (número o 'b'): ");
+        fflush(stdout);
+
+        char choice[16];
+        int sel = 0;
+        int use_browser = 0;
+        if (fgets(choice, sizeof(choice), stdin)) {
+            if (choice[0] == 'b' || choice[0] == 'B') {
+                use_browser = 1;
+            } else {
+                sel = atoi(choice);
+            }
+        }
+
+        if (use_browser) {
+            /* Abrir diálogo nativo de macOS para seleccionar imagen */
+            FILE *fp = popen(
+                "osascript -e 'set theFile to choose file with prompt "
+                "\"Seleccione una imagen para comprimir\" of type "
+                "{\"public.png\", \"public.jpeg\", \"public.bmp\", \"public.gif\", "
+                "\"public.targa-image\", \"com.adobe.photoshop-image\", "
+                "\"public.radiance\"}' "
+                "-e 'POSIX path of theFile'", "r");
+            if (fp) {
+                char browser_path[512] = {0};
+                if (fgets(browser_path, sizeof(browser_path), fp)) {
+                    /* Quitar salto de línea */
+                    size_t blen = strlen(browser_path);
+                    if (blen > 0 && browser_path[blen - 1] == '\n')
+                        browser_path[blen - 1] = '\0';
+                    strncpy(input_path, browser_path, sizeof(input_path) - 1);
+                }
+                int ret = pclose(fp);
+                if (ret != 0 || input_path[0] == '\0') {
+                    printf("  \033[33mNo se seleccionó archivo. Usando imagen sintética...\033[0m\n");
+                    generate_synthetic(&img, 4096, 4096);
+                } else if (open_image(input_path, &img) != 0) {
+                    printf("  \033[33mUsando imagen sintética como respaldo...\033[0m\n");
+                    generate_synthetic(&img, 4096, 4096);
+                }
+            } else {
+                printf("  \033[33mNo se pudo abrir el explorador. Usando imagen sintética...\033[0m\n");
+                generate_synthetic(&img, 4096, 4096);
+            }
+        } else if (sel >= 1 && sel <= nfiles) {
+            snprintf(input_path, sizeof(input_path), "%s/%s", img_dir, files[sel - 1]);
+            if (open_image(input_path, &img) != 0) {
+                printf("  \033[33mUsando imagen sintética como respaldo...\033[0m\n");
+                generate_synthetic(&img, 4096, 4096);
+            }
+        } else {
+            printf("  \033[33mGenerando imagen sintética 4096x4096...\033[0m\n");
+            generate_synthetic(&img, 4096, 4096);
+        }
+    }
+
+    /* --update con un .rle previo: solo las bandas cambiadas; si no existe, compresión completa */
+    char update_path[600];
+    int updating = 0;
+    if (g_update && input_path[0]) {
+        snprintf(update_path, sizeof(update_path), "%s_paralelo.rle", input_path);
+        updating = access(update_path, F_OK) == 0;
+        if (!updating)
+            printf("  \033[33m--update: %s no existe, compresión completa\033[0m\n", update_path);
+    }
+
+    /* Benchmarks sobre la imagen cargada: no escriben .rle ni .bmp */
+    if (g_progress_bench || g_scaling || updating) {
+        int r = updating ? update_file(&img, update_path)
+              : g_scaling ? scaling_report(&img, input_path) : progress_bench(&img);
+        librle_image_free(&img);
+        return r;
+    }
+
+    size_t total_pixels = (size_t)img.width * img.height;
+    size_t raw_size = total_pixels * 3;
+
+    /* Guardar archivo RAW (RGB) */
+    char rawpath[512];
+    if (input_path[0])
+        snprintf(rawpath, sizeof(rawpath), "%s.raw", input_path);
+    else
+        snprintf(rawpath, sizeof(rawpath), "output.raw");
+
+    /* --aio: el .raw se escribe mientras los hilos comprimen (se espera al final) */
+    if (g_aio_on) {
+        rle_aio_init(&g_aio, g_aio_backend, g_aio_direct, g_aio_fsync);
+        aio_report_setup();
+    }
+    uint64_t raw_t0 = rle_trace_clock(trace_main());
+    if (g_aio_on && g_write_raw) {
+        int f = rle_aio_open(&g_aio, rawpath, raw_size);
+        if (f < 0) {
+            perror(rawpath);
+        } else {
+            track_syscall("open", "open", "Crear archivo de salida (--aio)");
+            rle_aio_register(&g_aio, img.data, raw_size);
+            rle_aio_write(&g_aio, f, img.data, raw_size, 0);
+            printf("  \033[32mArchivo RAW enviado:\033[0m %s (%.2f KB, %s)\n",
+                   rawpath, raw_size / 1024.0, rle_aio_name(g_aio.backend));
+        }
+    }
+    FILE *fraw = g_write_raw && !g_aio_on ? fopen(rawpath, "wb") : NULL;
+    if (fraw) {
+        fwrite(img.data, 1, raw_size, fraw);
+        fclose(fraw);
+        printf("  \033[32mArchivo RAW guardado:\033[0m %s (%.2f KB)\n", rawpath, raw_size / 1024.0);
+    }
+    if (g_write_raw)
+        trace_main_span("io", g_aio_on ? "aio: enviar .raw" : "escribir .raw", raw_t0,
+                        (int64_t)raw_size);
+
+    /* Cortar la imagen en tiles (1 tile = 1 chunk) y detectar número de cores */
+    uint32_t tile_rows = rle_tile_rows(img.width, img.height, g_tile_rows);
+    uint32_t num_tiles = rle_tile_count(img.height, tile_rows);
+    int num_threads = worker_threads();
+    if ((uint32_t)num_threads > num_tiles) num_threads = (int)num_tiles;
+
+    int stack_marker_bottom = 0;  /* Marcador base de pila */
+
+    /* Preparar argumentos para cada hilo */
+    pthread_t *threads = malloc(sizeof(pthread_t) * num_threads);
+    ThreadArg *args = rle_cacheline_calloc(num_threads, sizeof(ThreadArg));
+    g_sched.tiles = calloc(num_tiles, sizeof(TileTask));
+    g_sched.deques = rle_cacheline_calloc(num_threads, sizeof(TileDeque));
+    if (!threads || !args || !g_sched.tiles || !g_sched.deques) { perror("malloc"); return 1; }
+    setup_compress_args(args, num_threads, &img, tile_rows, num_tiles);
+
+    /* --first-touch: cada banda de entrada pasa al nodo del hilo que la comprime */
+    uint8_t *placed = NULL;
+    if (g_first_touch) {
+        double place_ms = 0;
+        placed = first_touch_copy(&img, num_threads, tile_rows, num_tiles, &place_ms);
+        if (placed) {
+            g_sched.pixels = placed;
+            for (int i = 0; i < num_threads; i++)
+                args[i].pixels = placed + args[i].byte_offset;
+            track_syscall("mmap", "mmap(MAP_ANONYMOUS)", "Entrada con first touch por banda");
+            printf("  \033[32mFirst touch:\033[0m %.2f MB copiados por %d hilos (%s, %d nodo(s)) en %.2f ms\n",
+                   raw_size / (1024.0 * 1024.0), num_threads, rle_affinity_name(g_affinity),
+                   rle_topo_nodes_used(&g_topo, g_affinity, num_threads), place_ms);
+        }
+    }
+
+    RLEProfRing *prof_rings = profile_attach(args, num_threads);
+    trace_attach(args, num_threads, "compresor");
 
     /* Mostrar segmentos de memoria ANTES de crear los hilos */
     print_memory_segments(&img, args, num_threads, &stack_marker_top, &stack_marker_bottom);
@@ -1981,14 +6940,27 @@ int main(int argc, char *argv[]) {
     printf("%s║%s  │                                                                                │  %s║%s\n", CYAN_M, RESET_M, CYAN_M, RESET_M);
 
     /* PASO 2: Distribuir trabajo */
-    printf("%s║%s  │  %s[PASO 2]%s  Distribuir filas entre %d hilos (img.height / num_threads)          │  %s║%s\n",
-           CYAN_M, RESET_M, YELLOW_M, RESET_M, num_threads, CYAN_M, RESET_M);
-    printf("%s║%s  │            → %u filas/hilo, %u filas extra repartidas                          │  %s║%s\n",
-           CYAN_M, RESET_M, rows_per, extra, CYAN_M, RESET_M);
-    printf("%s║%s  │            → Cada hilo recibe puntero a su sección de img.data (read-only)     │  %s║%s\n",
+    printf("%s║%s  │  %s[PASO 2]%s  Cortar la imagen en %5u tiles de %4u filas (1 tile = 1 chunk)    │  %s║%s\n",
+           CYAN_M, RESET_M, YELLOW_M, RESET_M, num_tiles, tile_rows, CYAN_M, RESET_M);
+    printf("%s║%s  │            → Cada hilo arranca con ~%-5u tiles contiguos en su deque          │  %s║%s\n",
+           CYAN_M, RESET_M, num_tiles / (uint32_t)num_threads, CYAN_M, RESET_M);
+    printf("%s║%s  │            → Al vaciarlo roba la mitad final del deque más cargado (CAS)       │  %s║%s\n",
            CYAN_M, RESET_M, CYAN_M, RESET_M);
     printf("%s║%s  │                                                                                │  %s║%s\n", CYAN_M, RESET_M, CYAN_M, RESET_M);
 
+    /* --aio + --alloc arena: el .rle se abre antes, los hilos envían cada chunk */
+    char outpath[512];
+    if (input_path[0])
+        snprintf(outpath, sizeof(outpath), "%s_paralelo.rle", input_path);
+    else
+        snprintf(outpath, sizeof(outpath), "output_paralelo.rle");
+    g_aio_rle = -1;
+    if (g_aio_on && g_alloc_mode == ALLOC_ARENA) {
+        g_aio_rle = rle_aio_open(&g_aio, outpath, 0);
+        if (g_aio_rle < 0) perror(outpath);
+        else track_syscall("open", "open", "Crear archivo de salida (--aio)");
+    }
+
     g_current_phase = PHASE_COMPRESS;
     /* PASO 3: Crear hilos */
     printf("%s║%s  │  %s[PASO 3]%s  %spthread_create()%s × %d  (el padre crea los hilos hijos)             │  %s║%s\n",
@@ -2000,6 +6972,12 @@ int main(int argc, char *argv[]) {
     /* Pasar referencia de tiempo base a cada hilo */
     for (int i = 0; i < num_threads; i++)
         args[i].t0_ref = &t_start;
+    g_arena.num_threads = num_threads;
+
+    /* Monitor: observa el progreso de los hilos mientras comprimen */
+    ProgressMonitor monitor = { args, num_threads, raw_size, 0, isatty(STDERR_FILENO), 0, 0, 0 };
+    pthread_t monitor_tid;
+    int monitor_ok = pthread_create(&monitor_tid, NULL, progress_monitor_func, &monitor) == 0;
 
     /* Crear hilos de trabajo con log detallado */
     for (int i = 0; i < num_threads; i++) {
@@ -2014,7 +6992,7 @@ int main(int argc, char *argv[]) {
 
 #ifdef __APPLE__
         if (args[i].mach_thread) {
-            thread_affinity_policy_data_t policy = { i + 1 };
+            thread_affinity_policy_data_t policy = { rle_affinity_tag(g_affinity, i) };
             thread_policy_set(args[i].mach_thread,
                               THREAD_AFFINITY_POLICY,
                               (thread_policy_t)&policy,
@@ -2025,7 +7003,8 @@ int main(int argc, char *argv[]) {
         printf("%s║%s  │    %s+%.4f ms%s  pthread_create(hilo[%d]) → TID %s0x%lx%s  afinidad=%s%d%s          │  %s║%s\n",
                CYAN_M, RESET_M, GREEN_M, t_rel * 1000, RESET_M, i,
                MAGENTA_M, (unsigned long)args[i].system_tid, RESET_M,
-               YELLOW_M, i + 1, RESET_M, CYAN_M, RESET_M);
+               YELLOW_M, args[i].pin_cpu >= 0 ? args[i].pin_cpu : rle_affinity_tag(g_affinity, i),
+               RESET_M, CYAN_M, RESET_M);
     }
 
     printf("%s║%s  │                                                                                │  %s║%s\n", CYAN_M, RESET_M, CYAN_M, RESET_M);
@@ -2059,6 +7038,19 @@ int main(int argc, char *argv[]) {
     clock_gettime(CLOCK_MONOTONIC, &t_end);
     double elapsed = (t_end.tv_sec - t_start.tv_sec) +
                      (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+    RLETraceEvent *phase_ev = rle_trace_span(trace_main(), "phase", "compresión",
+                                             timespec_ns(&t_start), timespec_ns(&t_end));
+    rle_trace_arg(phase_ev, "hilos", num_threads);
+    rle_trace_arg(phase_ev, "tiles", num_tiles);
+    rle_trace_arg(phase_ev, "bytes_in", (int64_t)raw_size);
+    if (monitor_ok) {
+        atomic_store(&monitor.stop, 1);
+        pthread_join(monitor_tid, NULL);
+        printf("%s║%s  │            → Monitor: %s%6u%s lecturas cada %d ms, %s%6u%s con avance, vio %s%3.0f%%%s   │  %s║%s\n",
+               CYAN_M, RESET_M, GREEN_M, monitor.polls, RESET_M, MONITOR_PERIOD_MS,
+               GREEN_M, monitor.advances, RESET_M, GREEN_M,
+               raw_size ? 100.0 * monitor.last_seen / raw_size : 0.0, RESET_M, CYAN_M, RESET_M);
+    }
 
     printf("%s║%s  │                                                                                │  %s║%s\n", CYAN_M, RESET_M, CYAN_M, RESET_M);
 
@@ -2080,6 +7072,10 @@ int main(int argc, char *argv[]) {
                CYAN_M, RESET_M, i,
                MAGENTA_M, (unsigned long)args[i].result.data, RESET_M,
                GREEN_M, args[i].result.size, RESET_M, CYAN_M, RESET_M);
+        printf("%s║%s  │              %s%5u%s tiles (%s%5u%s robados), %s%10zu%s bytes de entrada          │  %s║%s\n",
+               CYAN_M, RESET_M, GREEN_M, args[i].tiles_done, RESET_M,
+               YELLOW_M, args[i].tiles_stolen, RESET_M,
+               GREEN_M, args[i].bytes_done, RESET_M, CYAN_M, RESET_M);
     }
 
     printf("%s║%s  │                                                                                │  %s║%s\n", CYAN_M, RESET_M, CYAN_M, RESET_M);
@@ -2087,8 +7083,8 @@ int main(int argc, char *argv[]) {
     /* PASO 6: Escribir archivo */
     printf("%s║%s  │  %s[PASO 6]%s  fwrite() → concatenar buffers y escribir archivo de salida          │  %s║%s\n",
            CYAN_M, RESET_M, YELLOW_M, RESET_M, CYAN_M, RESET_M);
-    printf("%s║%s  │            → El padre escribe secuencialmente los %d buffers                    │  %s║%s\n",
-           CYAN_M, RESET_M, num_threads, CYAN_M, RESET_M);
+    printf("%s║%s  │            → El padre escribe los %5u tiles en orden de filas                │  %s║%s\n",
+           CYAN_M, RESET_M, num_tiles, CYAN_M, RESET_M);
     printf("%s║%s  │                                                                                │  %s║%s\n", CYAN_M, RESET_M, CYAN_M, RESET_M);
 
     /* PASO 7: free() */
@@ -2151,10 +7147,13 @@ int main(int argc, char *argv[]) {
     print_thread_distribution(args, num_threads, &img, "COMPLETADO");
     print_thread_results(args, num_threads);
     print_execution_metrics(elapsed, user_t, sys_t, total_thread_cpu,
-                            total_compressed + 8, raw_size, num_threads);
+                            rle_container_size(num_tiles, total_compressed),
+                            raw_size, num_threads);
 
     /* Mostrar línea de tiempo de recursos */
-    print_resource_timeline(args, num_threads, t_start, elapsed);
+    print_resource_timeline(args, num_threads, t_start, elapsed, PHASE_COMPRESS);
+    if (g_perf)
+        print_perf_counters(args, num_threads, PHASE_COMPRESS);
 
     /* Visualización de conceptos de SO */
     print_global_variables();
@@ -2162,98 +7161,189 @@ int main(int argc, char *argv[]) {
 
     g_current_phase = PHASE_OUTPUT;
     /* Escribir archivo de salida */
-    char outpath[512];
-    if (input_path[0])
-        snprintf(outpath, sizeof(outpath), "%s_paralelo.rle", input_path);
-    else
-        snprintf(outpath, sizeof(outpath), "output_paralelo.rle");
+    /* Tabla de chunks: una entrada por tile en orden de filas, sea cual sea su hilo */
+    RLEChunkEntry *chunks = calloc(num_tiles, sizeof(RLEChunkEntry));
+    const uint8_t **chunk_data = malloc(num_tiles * sizeof(*chunk_data));
+    if (!chunks || !chunk_data) { perror("malloc"); return 1; }
+    for (uint32_t t = 0; t < num_tiles; t++) {
+        const TileTask *tile = &g_sched.tiles[t];
+        chunks[t].start_row = tile->start_row;
+        chunks[t].num_rows = tile->num_rows;
+        chunks[t].length = tile->length;
+        chunks[t].raw_checksum = tile->raw_crc;
+        chunks[t].codec = tile->codec;
+        chunk_data[t] = g_alloc_mode == ALLOC_ARENA ? g_arena.base + tile->offset
+                                                    : args[tile->owner].result.data + tile->offset;
+    }
 
-    FILE *fout = fopen(outpath, "wb");
-    size_t total_compressed_size = 0;
+    uint64_t rle_t0 = rle_trace_clock(trace_main());
+    uint8_t *aio_head = NULL;
+    if (g_aio_on) {
+        aio_head = aio_submit_rle(outpath, img.width, img.height, chunks, chunk_data, num_tiles,
+                                  args, num_threads);
+        if (aio_head && aio_head != g_arena.base)
+            track_heap_alloc(aio_head, rle_container_size(num_tiles, 0), "Header + tabla (--aio)");
+    }
+    FILE *fout = g_aio_on ? NULL : fopen(outpath, "wb");
     if (fout) {
-        uint32_t header[2] = { img.width, img.height };
-        fwrite(header, sizeof(uint32_t), 2, fout);
-        for (int i = 0; i < num_threads; i++) {
-            fwrite(args[i].result.data, 1, args[i].result.size, fout);
-            total_compressed_size += args[i].result.size;
+        int wr;
+        if (g_alloc_mode == ALLOC_ARENA) {
+            /* Arena: los chunks ya están en su offset final, un solo fwrite */
+            rle_container_finish(g_arena.base, img.width, img.height, g_rle_mode,
+                                 g_rle_flags, chunks, chunk_data, num_tiles);
+            wr = fwrite(g_arena.base, 1, g_arena.total, fout) == g_arena.total ? 0 : -1;
+        } else {
+            wr = rle_container_write(fout, img.width, img.height, g_rle_mode, g_rle_flags,
+                                     chunks, chunk_data, num_tiles);
         }
         fclose(fout);
-        printf("\n  \033[32mArchivo comprimido guardado:\033[0m %s\n", outpath);
+        if (wr == 0)
+            printf("\n  \033[32mArchivo comprimido guardado:\033[0m %s (%u chunks indexados)\n",
+                   outpath, num_tiles);
+        else
+            fprintf(stderr, "  Error escribiendo '%s'\n", outpath);
     }
+    trace_main_span("io", g_aio_on ? "aio: enviar .rle" : "escribir .rle", rle_t0, -1);
 
     /* ═══════════════════════════════════════════════════════════════════
      *  DESCOMPRESIÓN Y GENERACIÓN DE IMAGEN BMP
      * ═══════════════════════════════════════════════════════════════════ */
     g_current_phase = PHASE_DECOMPRESS;
-    printf("\n\033[33m  Descomprimiendo datos RLE...\033[0m\n");
 
-    /* Concatenar todos los buffers de los hilos en uno solo */
-    uint8_t *all_rle = (uint8_t *)malloc(total_compressed_size);
-    if (all_rle) {
-        size_t off = 0;
+    /*
+     * Los hilos decodifican cada chunk directamente en su banda (sin gather)
+     * y la comparan con la original ahí mismo; --verify stream ni siquiera
+     * reserva la imagen decodificada, y --verify checksum no decodifica.
+     */
+    uint8_t *decoded = NULL;
+    ThreadArg *dargs = NULL;
+    RLEProfRing *dec_prof_rings = NULL;
+    struct timespec td_start = {0};
+    double decomp_time = -1;
+    if (g_verify != RLE_VERIFY_CHECKSUM) {
+        printf(g_verify == RLE_VERIFY_STREAM ? "\n\033[33m  Verificando runs contra el original...\033[0m\n"
+                                             : "\n\033[33m  Descomprimiendo datos RLE...\033[0m\n");
+        if (g_verify == RLE_VERIFY_DECODE)
+            decoded = (uint8_t *)malloc(raw_size);
+        dargs = rle_cacheline_calloc(num_threads, sizeof(ThreadArg));
+    }
+    if ((decoded || g_verify == RLE_VERIFY_STREAM) && dargs) {
+        if (decoded)
+            track_heap_alloc(decoded, raw_size, "Imagen decodificada");
+        setup_decode_args(dargs, num_threads, chunks, chunk_data, num_tiles,
+                          decoded, img.width, g_rle_mode, g_rle_flags);
         for (int i = 0; i < num_threads; i++) {
-            memcpy(all_rle + off, args[i].result.data, args[i].result.size);
-            off += args[i].result.size;
+            dargs[i].dec_expect = img.data;
+            dargs[i].dec_bgr = decoded && g_decode_bgr;
         }
+        atomic_store(&g_verify_stop, 0);
+        dec_prof_rings = profile_attach(dargs, num_threads);
+        trace_attach(dargs, num_threads, "verificador");
+        decomp_time = run_decode_threads(dargs, num_threads, &td_start);
+        trace_main_span("phase", "verificación", timespec_ns(&td_start), -1);
+    }
+    if (decomp_time >= 0) {
+        /* Los hilos tienen chunks contiguos en orden: el primero con error es el primero */
+        const ThreadArg *bad = NULL;
+        size_t verified = 0;
+        for (int i = 0; i < num_threads; i++) {
+            verified += dargs[i].dec_bytes;
+            if (!bad && dargs[i].dec_bad)
+                bad = &dargs[i];
+        }
+        int match = !bad && verified == raw_size;
 
-        struct timespec td_start, td_end;
-        clock_gettime(CLOCK_MONOTONIC, &td_start);
-
-        uint8_t *decoded = rle_decompress(all_rle, total_compressed_size, total_pixels * 3);
-
-        clock_gettime(CLOCK_MONOTONIC, &td_end);
-        double decomp_time = (td_end.tv_sec - td_start.tv_sec) +
-                             (td_end.tv_nsec - td_start.tv_nsec) / 1e9;
-
+        char bmppath[512];
+        if (input_path[0])
+            snprintf(bmppath, sizeof(bmppath), "%s_paralelo_descomprimida.bmp", input_path);
+        else
+            snprintf(bmppath, sizeof(bmppath), "output_paralelo_descomprimida.bmp");
         if (decoded) {
-            int match = (memcmp(decoded, img.data, raw_size) == 0);
+            uint64_t bmp_t0 = rle_trace_clock(trace_main());
+            if (librle_bmp_save(&g_lib, bmppath, decoded, img.width, img.height,
+                                g_decode_bgr) != RLE_LIB_OK)
+                fprintf(stderr, "  %s\n", librle_error(&g_lib));
+            trace_main_span("io", "guardar BMP", bmp_t0, (int64_t)raw_size);
+        }
 
-            char bmppath[512];
-            if (input_path[0])
-                snprintf(bmppath, sizeof(bmppath), "%s_paralelo_descomprimida.bmp", input_path);
+        char verdict[96];
+        if (match) {
+            snprintf(verdict, sizeof(verdict), "CORRECTA - Imagen idéntica al original");
+        } else if (bad) {
+            const RLEChunkEntry *e = &chunks[bad->dec_bad_chunk];
+            size_t row_bytes = (size_t)img.width * 3;
+            if (bad->dec_bad_offset == SIZE_MAX)
+                snprintf(verdict, sizeof(verdict), "ERROR - chunk %u (filas %u-%u)",
+                         bad->dec_bad_chunk, e->start_row, e->start_row + e->num_rows - 1);
             else
-                snprintf(bmppath, sizeof(bmppath), "output_paralelo_descomprimida.bmp");
-
-            save_bmp(bmppath, decoded, img.width, img.height);
-
-            const char *CYAN = "\033[36m";
-            const char *GREEN = "\033[32m";
-            const char *YELLOW = "\033[33m";
-            const char *WHITE = "\033[1;37m";
-            const char *RED = "\033[31m";
-            const char *RESET = "\033[0m";
+                snprintf(verdict, sizeof(verdict), "ERROR - chunk %u, fila %zu, byte %zu",
+                         bad->dec_bad_chunk, e->start_row + bad->dec_bad_offset / row_bytes,
+                         bad->dec_bad_offset % row_bytes);
+        } else {
+            snprintf(verdict, sizeof(verdict), "ERROR - %zu de %zu bytes decodificados",
+                     verified, raw_size);
+        }
 
-            printf("\n");
-            printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
-            printf("%s║%s                    %s*** DESCOMPRESIÓN Y VERIFICACIÓN ***%s                          %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
-            printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
-            printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
-            printf("%s║%s  %sTiempo de descompresión:%s  %s%12.6f%s segundos                                     %s║%s\n",
-                   CYAN, RESET, WHITE, RESET, GREEN, decomp_time, RESET, CYAN, RESET);
-            printf("%s║%s  %sPíxeles decodificados:%s    %s%12zu%s                                              %s║%s\n",
-                   CYAN, RESET, WHITE, RESET, GREEN, total_pixels, RESET, CYAN, RESET);
-            printf("%s║%s  %sBytes decodificados:%s      %s%12zu%s (%.2f MB)                                    %s║%s\n",
-                   CYAN, RESET, WHITE, RESET, GREEN, raw_size, RESET, raw_size / (1024.0 * 1024.0), CYAN, RESET);
-            printf("%s║%s  %sIntegridad:%s               %s%s%s                                                    %s║%s\n",
-                   CYAN, RESET, WHITE, RESET,
-                   match ? GREEN : RED,
-                   match ? "CORRECTA - Imagen idéntica al original" : "ERROR - Diferencias detectadas",
-                   RESET, CYAN, RESET);
-            printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
-            printf("%s║%s  %sImagen descomprimida:%s     %s%-50s%s     %s║%s\n",
+        const char *CYAN = "\033[36m";
+        const char *GREEN = "\033[32m";
+        const char *YELLOW = "\033[33m";
+        const char *WHITE = "\033[1;37m";
+        const char *RED = "\033[31m";
+        const char *RESET = "\033[0m";
+
+        printf("\n");
+        printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+        printf("%s║%s                    %s*** DESCOMPRESIÓN Y VERIFICACIÓN ***%s                          %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+        printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+        printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+        printf("%s║%s  %sTiempo de descompresión:%s  %s%12.6f%s segundos                                     %s║%s\n",
+               CYAN, RESET, WHITE, RESET, GREEN, decomp_time, RESET, CYAN, RESET);
+        printf("%s║%s  %sPíxeles decodificados:%s    %s%12zu%s                                              %s║%s\n",
+               CYAN, RESET, WHITE, RESET, GREEN, total_pixels, RESET, CYAN, RESET);
+        printf("%s║%s  %s%-26s%s%s%12zu%s (%.2f MB)                                    %s║%s\n",
+               CYAN, RESET, WHITE, decoded ? "Bytes decodificados:" : "Bytes verificados:", RESET,
+               GREEN, verified, RESET, verified / (1024.0 * 1024.0), CYAN, RESET);
+        printf("%s║%s  %sVerificación:%s             %s%-53s%s     %s║%s\n",
+               CYAN, RESET, WHITE, RESET, GREEN,
+               decoded ? "decode (cada hilo compara su banda decodificada)"
+                       : "stream (runs contra el original, sin buffer)",
+               RESET, CYAN, RESET);
+        /* "é" de "idéntica" ocupa 2 bytes: ancho 53 + 1 */
+        printf("%s║%s  %sIntegridad:%s               %s%-*s%s     %s║%s\n",
+               CYAN, RESET, WHITE, RESET, match ? GREEN : RED, match ? 54 : 53, verdict,
+               RESET, CYAN, RESET);
+        printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+        if (decoded) {
+            printf("%s║%s  %sImagen descomprimida:%s     %s%-53s%s     %s║%s\n",
                    CYAN, RESET, WHITE, RESET, GREEN, bmppath, RESET, CYAN, RESET);
-            printf("%s║%s  %sFormato:%s                  BMP (24-bit RGB, sin compresión)                       %s║%s\n",
+            printf("%s║%s  %sFormato:%s                  BMP (24-bit RGB, sin compresión)                          %s║%s\n",
                    CYAN, RESET, WHITE, RESET, CYAN, RESET);
             printf("%s║%s  %sDimensiones:%s              %u x %u px                                             %s║%s\n",
                    CYAN, RESET, WHITE, RESET, img.width, img.height, CYAN, RESET);
             printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
-            printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+        }
+        printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+
+        /* Línea de tiempo de la descompresión, comparable con la de compresión */
+        print_resource_timeline(dargs, num_threads, td_start, decomp_time, PHASE_DECOMPRESS);
+        if (g_perf)
+            print_perf_counters(dargs, num_threads, PHASE_DECOMPRESS);
+    } else if (g_verify == RLE_VERIFY_CHECKSUM) {
+        printf("\n  \033[32mVerificación checksum:\033[0m CRC32C de las %u bandas en la tabla "
+               "(se comprueba con -d)\n\n", num_tiles);
+    } else {
+        printf("  \033[31mError: No se pudo descomprimir los datos RLE.\033[0m\n\n");
+    }
 
-            free(decoded);
-        } else {
-            printf("  \033[31mError: No se pudo descomprimir los datos RLE.\033[0m\n\n");
+    /* --aio: las escrituras corrieron durante la verificación; aquí se espera el resto */
+    if (g_aio_on) {
+        uint64_t wait_t0 = rle_trace_clock(trace_main());
+        aio_finish_report(outpath, num_tiles);
+        trace_main_span("io", "aio: esperar", wait_t0, -1);
+        if (aio_head && aio_head != g_arena.base) {
+            track_heap_free(aio_head);
+            free(aio_head);
         }
-        free(all_rle);
     }
 
     /* ═══════════════════════════════════════════════════════════════════
@@ -2277,38 +7367,57 @@ int main(int argc, char *argv[]) {
 
         FILE *csv = fopen(csvpath, "w");
         if (csv) {
-            fprintf(csv, "algorithm,pid,num_threads,wall_ms,total_cpu_ms\n");
-            fprintf(csv, "paralelo,%d,%d,%.4f,%.4f\n",
+            fprintf(csv, "algorithm,pid,num_threads,wall_ms,total_cpu_ms,decode_wall_ms\n");
+            fprintf(csv, "paralelo,%d,%d,%.4f,%.4f,%.4f\n",
                     getpid(), num_threads, elapsed * 1000,
-                    (user_t + sys_t) * 1000);
+                    (user_t + sys_t) * 1000, decomp_time * 1000);
             fprintf(csv, "\n");
 
             /* Datos por hilo */
-            fprintf(csv, "thread_id,tid,core,start_ms,end_ms,cpu_user_ms,cpu_sys_ms,pixels,compressed_bytes,stack_addr\n");
+            /* pixels = bytes realmente comprimidos por el hilo (tramo inicial + robos) */
+            fprintf(csv, "thread_id,tid,core,start_ms,end_ms,cpu_user_ms,cpu_sys_ms,pixels,compressed_bytes,stack_addr,tiles,tiles_stolen");
+            perf_csv_header(csv);
+            fprintf(csv, "\n");
             for (int i = 0; i < num_threads; i++) {
                 double st = ts_relative_ms(&t_start, &args[i].ts_start);
                 double en = ts_relative_ms(&t_start, &args[i].ts_end);
-                fprintf(csv, "%d,0x%lx,%d,%.4f,%.4f,%.4f,%.4f,%zu,%zu,0x%lx\n",
+                fprintf(csv, "%d,0x%lx,%d,%.4f,%.4f,%.4f,%.4f,%zu,%zu,0x%lx,%u,%u",
                         i, (unsigned long)args[i].system_tid,
                         args[i].core_affinity,
                         st, en,
                         args[i].cpu_time_user * 1000,
                         args[i].cpu_time_sys * 1000,
-                        args[i].num_pixels,
+                        args[i].bytes_done,
                         args[i].result.size,
-                        (unsigned long)args[i].stack_addr);
+                        (unsigned long)args[i].stack_addr,
+                        args[i].tiles_done, args[i].tiles_stolen);
+                perf_csv_values(csv, &args[i].perf);
+                fprintf(csv, "\n");
             }
             fprintf(csv, "\n");
 
-            /* Muestras del PC (Program Counter) por hilo */
-            fprintf(csv, "thread_id,sample_idx,timestamp_ms,pc_addr,core_id,pixels_at\n");
-            for (int i = 0; i < num_threads; i++) {
-                for (int s = 0; s < args[i].num_pc_samples; s++) {
-                    PCSample *ps = &args[i].pc_samples[s];
-                    fprintf(csv, "%d,%d,%.4f,0x%lx,%d,%zu\n",
-                            i, s, ps->timestamp_ms,
-                            (unsigned long)ps->pc_addr,
-                            ps->core_id, ps->pixels_at);
+            /* Marcas y muestras (--profile) del PC (Program Counter) por hilo */
+            write_pc_samples_csv(csv, args, num_threads, &t_start);
+
+            /* Hilos de descompresión (tiempos relativos al inicio de la descompresión) */
+            if (decomp_time >= 0) {
+                fprintf(csv, "\n");
+                fprintf(csv, "decode_thread_id,tid,start_ms,end_ms,cpu_user_ms,cpu_sys_ms,bytes_out,compressed_bytes");
+                perf_csv_header(csv);
+                fprintf(csv, "\n");
+                for (int i = 0; i < num_threads; i++) {
+                    unsigned long long in_bytes = 0;
+                    for (uint32_t c = dargs[i].dec_first; c < dargs[i].dec_first + dargs[i].dec_count; c++)
+                        in_bytes += chunks[c].length;
+                    fprintf(csv, "%d,0x%lx,%.4f,%.4f,%.4f,%.4f,%zu,%llu",
+                            i, (unsigned long)dargs[i].system_tid,
+                            ts_relative_ms(&td_start, &dargs[i].ts_start),
+                            ts_relative_ms(&td_start, &dargs[i].ts_end),
+                            dargs[i].cpu_time_user * 1000,
+                            dargs[i].cpu_time_sys * 1000,
+                            dargs[i].dec_bytes, in_bytes);
+                    perf_csv_values(csv, &dargs[i].perf);
+                    fprintf(csv, "\n");
                 }
             }
 
@@ -2316,15 +7425,27 @@ int main(int argc, char *argv[]) {
             printf("  \033[32mDatos de scheduling exportados:\033[0m %s\n\n", csvpath);
         }
     }
+    trace_finish("compress");
 
-    /* Liberar memoria */
-    if (used_stb)
-        stbi_image_free(img.data);
-    else
-        free(img.data);
+    /* Liberar memoria (la imagen mapeada se desmapea) */
+    librle_image_free(&img);
+    if (placed)
+        munmap(placed, raw_size ? raw_size : 1);
     for (int i = 0; i < num_threads; i++)
-        free(args[i].result.data);
+        librle_buffer_free(&args[i].result);
+    if (g_arena.base) {
+        track_heap_free(g_arena.base);
+        free(g_arena.base);
+    }
+    free(decoded);
+    free(dec_prof_rings);
+    free(dargs);
+    free(chunks);
+    free(chunk_data);
     free(threads);
+    free(prof_rings);
     free(args);
+    free(g_sched.tiles);
+    free(g_sched.deques);
     return 0;
 }
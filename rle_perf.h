@@ -0,0 +1,132 @@
+/*
+ * ============================================================================
+ *  rle_perf.h — Contadores de hardware por hilo (--perf)
+ *
+ *  Lo incluyen rle_secuencial.c y rle_paralelo.c. Cada hilo abre sus
+ *  contadores al empezar la fase (compresión o descompresión) y los lee al
+ *  terminar; solo cuentan el user space de ese hilo:
+ *
+ *    ciclos, instrucciones          → IPC y bytes por ciclo
+ *    branches, branch-misses        → tasa de mispredict del bucle de runs
+ *    L1D read misses, LLC misses    → misses por KB de entrada
+ *
+ *  Linux usa perf_event_open(2), un fd por evento (no un grupo: si la PMU
+ *  tiene menos contadores que eventos el kernel los multiplexa y el valor se
+ *  escala por time_enabled / time_running). Un evento que el kernel o la
+ *  máquina no ofrecen (VM sin PMU virtual, perf_event_paranoid alto) queda
+ *  marcado como no disponible y el resto sigue funcionando.
+ *
+ *  En macOS los contadores se leen con kperf, un framework privado que
+ *  exige root; aquí no se enlaza y todos los eventos quedan no disponibles.
+ * ============================================================================
+ */
+
+#ifndef RLE_PERF_H
+#define RLE_PERF_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+enum {
+    RLE_PERF_CYCLES,
+    RLE_PERF_INSTRUCTIONS,
+    RLE_PERF_BRANCHES,
+    RLE_PERF_BRANCH_MISSES,
+    RLE_PERF_L1D_MISSES,
+    RLE_PERF_LLC_MISSES,
+    RLE_PERF_COUNT
+};
+
+typedef struct {
+    int      fd[RLE_PERF_COUNT];
+    uint64_t value[RLE_PERF_COUNT];
+    int      valid[RLE_PERF_COUNT];     /* 1 = medido */
+    int      error;                     /* errno del primer evento que falló (0 = ninguno) */
+} RLEPerfCounters;
+
+/* Nombre del evento para el CSV */
+static inline const char *rle_perf_name(int ev) {
+    static const char *const names[RLE_PERF_COUNT] = {
+        "cycles", "instructions", "branches", "branch_misses", "l1d_misses", "llc_misses"
+    };
+    return ev >= 0 && ev < RLE_PERF_COUNT ? names[ev] : "?";
+}
+
+#ifdef __linux__
+static inline void rle_perf_event_attr(int ev, struct perf_event_attr *a) {
+    memset(a, 0, sizeof(*a));
+    a->size = sizeof(*a);
+    a->type = PERF_TYPE_HARDWARE;
+    a->exclude_kernel = 1;
+    a->exclude_hv = 1;
+    a->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (ev) {
+    case RLE_PERF_CYCLES:        a->config = PERF_COUNT_HW_CPU_CYCLES; break;
+    case RLE_PERF_INSTRUCTIONS:  a->config = PERF_COUNT_HW_INSTRUCTIONS; break;
+    case RLE_PERF_BRANCHES:      a->config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS; break;
+    case RLE_PERF_BRANCH_MISSES: a->config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    case RLE_PERF_L1D_MISSES:
+        a->type = PERF_TYPE_HW_CACHE;
+        a->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case RLE_PERF_LLC_MISSES:    a->config = PERF_COUNT_HW_CACHE_MISSES; break;
+    }
+}
+#endif
+
+/* Abre y arranca los contadores del hilo que llama */
+static inline void rle_perf_start(RLEPerfCounters *pc) {
+    memset(pc, 0, sizeof(*pc));
+    for (int ev = 0; ev < RLE_PERF_COUNT; ev++) {
+        pc->fd[ev] = -1;
+#ifdef __linux__
+        struct perf_event_attr a;
+        rle_perf_event_attr(ev, &a);
+        pc->fd[ev] = (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+        if (pc->fd[ev] < 0 && !pc->error) pc->error = errno;
+#else
+        if (!pc->error) pc->error = ENOTSUP;
+#endif
+    }
+}
+
+/* Lee (escalando si hubo multiplexado) y cierra los contadores */
+static inline void rle_perf_stop(RLEPerfCounters *pc) {
+    for (int ev = 0; ev < RLE_PERF_COUNT; ev++) {
+        if (pc->fd[ev] < 0) continue;
+        uint64_t r[3];          /* valor, time_enabled, time_running */
+        if (read(pc->fd[ev], r, sizeof(r)) == (ssize_t)sizeof(r) && r[2] > 0) {
+            pc->value[ev] = r[2] < r[1] ? (uint64_t)((double)r[0] * r[1] / r[2]) : r[0];
+            pc->valid[ev] = 1;
+        }
+        close(pc->fd[ev]);
+        pc->fd[ev] = -1;
+    }
+}
+
+static inline int rle_perf_any(const RLEPerfCounters *pc) {
+    for (int ev = 0; ev < RLE_PERF_COUNT; ev++)
+        if (pc->valid[ev]) return 1;
+    return 0;
+}
+
+/* a / b si ambos eventos se midieron y b > 0; -1 si no */
+static inline double rle_perf_ratio(const RLEPerfCounters *pc, int a, int b) {
+    if (!pc->valid[a] || !pc->valid[b] || pc->value[b] == 0) return -1;
+    return (double)pc->value[a] / (double)pc->value[b];
+}
+
+/* Valor para el CSV: -1 si el evento no se midió */
+static inline long long rle_perf_csv(const RLEPerfCounters *pc, int ev) {
+    return pc->valid[ev] ? (long long)pc->value[ev] : -1;
+}
+
+#endif /* RLE_PERF_H */
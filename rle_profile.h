@@ -0,0 +1,291 @@
+/*
+ * ============================================================================
+ *  rle_profile.h — Profiler por muestreo (SIGPROF) del PC real de cada hilo
+ *
+ *  Lo incluyen rle_secuencial.c y rle_paralelo.c con --profile HZ. En lugar
+ *  de que el bucle de compresión llame a clock_gettime() y anote una
+ *  dirección inventada cada tantos bytes, un timer interrumpe al hilo HZ
+ *  veces por segundo de CPU y el handler de SIGPROF guarda el PC que
+ *  estaba ejecutando (tomado del ucontext), el core y el progreso publicado
+ *  en el ring de ese hilo:
+ *
+ *    Linux     timer_create(CLOCK_THREAD_CPUTIME_ID) por hilo, entregado
+ *              con SIGEV_THREAD_ID al propio hilo: solo cuenta su CPU
+ *    otros     setitimer(ITIMER_PROF) del proceso; la señal llega al hilo
+ *              que esté corriendo y se guarda en su ring (si tiene uno)
+ *
+ *  El ring es de un solo productor (el handler, en el hilo dueño) y se lee
+ *  después del join: el handler solo hace stores propios y un store release
+ *  del contador. Si se llena se sobreescriben las muestras más viejas.
+ *
+ *  Sin --profile no se instala el handler ni se crean timers: el bucle
+ *  caliente no tiene ninguna instrucción de muestreo.
+ * ============================================================================
+ */
+
+#ifndef RLE_PROFILE_H
+#define RLE_PROFILE_H
+
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "rle_progress.h"
+
+/* Muestras por hilo (potencia de 2): ~16 s de CPU a 1000 Hz */
+#define RLE_PROF_RING      16384
+#define RLE_PROF_MAX_HZ    10000
+#define RLE_PROF_TOP       4        /* funciones listadas en el resumen */
+
+typedef struct {
+    uint64_t  t_ns;             /* CLOCK_MONOTONIC */
+    uintptr_t pc;               /* PC interrumpido (0 = arquitectura sin soporte) */
+    size_t    bytes_at;         /* progreso publicado por el hilo en ese instante */
+    int32_t   core;             /* -1 si no se conoce */
+} RLEProfSample;
+
+typedef struct {
+    RLEProfSample      ring[RLE_PROF_RING];
+    atomic_uint        head;        /* muestras escritas (módulo 2^32) */
+    const RLEProgress *progress;    /* contador del hilo (puede ser NULL) */
+#ifdef __linux__
+    timer_t            timer;
+    int                has_timer;
+#endif
+} RLEProfRing;
+
+/* Ring del hilo actual; el handler solo escribe si no es NULL */
+static _Thread_local RLEProfRing *rle_prof_current;
+static int rle_prof_hz;
+
+static inline uintptr_t rle_prof_context_pc(void *uc) {
+    ucontext_t *ctx = (ucontext_t *)uc;
+#if defined(__APPLE__) && defined(__x86_64__)
+    return (uintptr_t)ctx->uc_mcontext->__ss.__rip;
+#elif defined(__APPLE__) && defined(__aarch64__)
+    return (uintptr_t)ctx->uc_mcontext->__ss.__pc;
+#elif defined(__linux__) && defined(__x86_64__)
+    return (uintptr_t)ctx->uc_mcontext.gregs[REG_RIP];
+#elif defined(__linux__) && defined(__i386__)
+    return (uintptr_t)ctx->uc_mcontext.gregs[REG_EIP];
+#elif defined(__linux__) && defined(__aarch64__)
+    return (uintptr_t)ctx->uc_mcontext.pc;
+#else
+    (void)ctx;
+    return 0;
+#endif
+}
+
+/* Handler de SIGPROF: solo funciones async-signal-safe y stores al ring propio */
+static void rle_prof_handler(int sig, siginfo_t *si, void *uc) {
+    (void)sig; (void)si;
+    RLEProfRing *r = rle_prof_current;
+    if (!r) return;
+    int saved_errno = errno;
+    unsigned h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    RLEProfSample *s = &r->ring[h & (RLE_PROF_RING - 1)];
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    s->t_ns = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    s->pc = rle_prof_context_pc(uc);
+    s->bytes_at = r->progress ? rle_progress_load(r->progress) : 0;
+#ifdef __linux__
+    s->core = sched_getcpu();
+#else
+    s->core = -1;
+#endif
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+    errno = saved_errno;
+}
+
+/*
+ * Instala el handler (SA_RESTART: las syscalls interrumpidas se reanudan) y,
+ * fuera de Linux, el timer de proceso. Devuelve 0 o -1 con perror.
+ */
+static inline int rle_prof_install(int hz) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = rle_prof_handler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, NULL) != 0) { perror("sigaction(SIGPROF)"); return -1; }
+    rle_prof_hz = hz;
+#ifndef __linux__
+    struct itimerval it;
+    it.it_interval.tv_sec = 0;
+    it.it_interval.tv_usec = 1000000 / hz;
+    it.it_value = it.it_interval;
+    if (setitimer(ITIMER_PROF, &it, NULL) != 0) { perror("setitimer"); return -1; }
+#endif
+    return 0;
+}
+
+/* Detiene el timer de proceso (fuera de Linux) y deja SIGPROF ignorada */
+static inline void rle_prof_uninstall(void) {
+#ifndef __linux__
+    struct itimerval off;
+    memset(&off, 0, sizeof(off));
+    setitimer(ITIMER_PROF, &off, NULL);
+#endif
+    signal(SIGPROF, SIG_IGN);
+    rle_prof_hz = 0;
+}
+
+/* Empieza a muestrear el hilo que llama en r (progress: su contador, o NULL) */
+static inline void rle_prof_thread_start(RLEProfRing *r, const RLEProgress *progress) {
+    atomic_init(&r->head, 0);
+    r->progress = progress;
+    rle_prof_current = r;
+#ifdef __linux__
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+#ifdef sigev_notify_thread_id
+    sev.sigev_notify_thread_id = (pid_t)syscall(SYS_gettid);
+#else
+    sev._sigev_un._tid = (pid_t)syscall(SYS_gettid);
+#endif
+    r->has_timer = timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &r->timer) == 0;
+    if (!r->has_timer) { perror("timer_create"); return; }
+    long ns = 1000000000L / rle_prof_hz;
+    struct itimerspec its = { { ns / 1000000000L, ns % 1000000000L },
+                              { ns / 1000000000L, ns % 1000000000L } };
+    timer_settime(r->timer, 0, &its, NULL);
+#endif
+}
+
+static inline void rle_prof_thread_stop(RLEProfRing *r) {
+#ifdef __linux__
+    if (r->has_timer) timer_delete(r->timer);
+    r->has_timer = 0;
+#endif
+    rle_prof_current = NULL;
+}
+
+/* Muestras guardadas (<= RLE_PROF_RING) y las sobreescritas por vuelta del ring */
+static inline unsigned rle_prof_count(const RLEProfRing *r) {
+    unsigned h = atomic_load_explicit(&r->head, memory_order_acquire);
+    return h < RLE_PROF_RING ? h : RLE_PROF_RING;
+}
+
+static inline unsigned rle_prof_lost(const RLEProfRing *r) {
+    unsigned h = atomic_load_explicit(&r->head, memory_order_acquire);
+    return h > RLE_PROF_RING ? h - RLE_PROF_RING : 0;
+}
+
+/* i-ésima muestra guardada, de la más vieja a la más nueva */
+static inline const RLEProfSample *rle_prof_at(const RLEProfRing *r, unsigned i) {
+    unsigned h = atomic_load_explicit(&r->head, memory_order_acquire);
+    unsigned first = h > RLE_PROF_RING ? h - RLE_PROF_RING : 0;
+    return &r->ring[(first + i) & (RLE_PROF_RING - 1)];
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  SIMBOLIZACIÓN Y RESUMEN
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * Los programas registran las funciones que ejecutan sus hilos (son static,
+ * no están en la tabla de símbolos dinámica). Un PC se atribuye a la función
+ * registrada de mayor dirección <= PC: es exacto mientras todas las funciones
+ * que corre el hilo dentro del ejecutable estén en la tabla. Los PC fuera del
+ * ejecutable (libc, vDSO) se agrupan como "libc/kernel"; los que caen antes
+ * del primer símbolo (stubs de la PLT, fragmentos .cold) como "(fuera de tabla)".
+ */
+typedef struct {
+    uintptr_t   addr;
+    const char *name;
+} RLEProfSymbol;
+
+typedef struct {
+    unsigned    samples;
+    unsigned    lost;
+    int         cores;              /* cores distintos vistos */
+    unsigned    migrations;         /* cambios de core entre muestras seguidas */
+    int         num_top;
+    const char *top_name[RLE_PROF_TOP];
+    unsigned    top_count[RLE_PROF_TOP];
+} RLEProfSummary;
+
+static int rle_prof_symbol_cmp(const void *a, const void *b) {
+    uintptr_t x = ((const RLEProfSymbol *)a)->addr, y = ((const RLEProfSymbol *)b)->addr;
+    return x < y ? -1 : x > y;
+}
+
+static inline void rle_prof_sort_symbols(RLEProfSymbol *tab, int n) {
+    qsort(tab, (size_t)n, sizeof(*tab), rle_prof_symbol_cmp);
+}
+
+#ifdef __linux__
+extern char __executable_start, etext;
+static inline int rle_prof_in_image(uintptr_t pc) {
+    return pc >= (uintptr_t)&__executable_start && pc < (uintptr_t)&etext;
+}
+#else
+static inline int rle_prof_in_image(uintptr_t pc) { (void)pc; return 1; }
+#endif
+
+/* tab ordenada con rle_prof_sort_symbols() */
+static inline const char *rle_prof_symbolize(const RLEProfSymbol *tab, int n, uintptr_t pc) {
+    if (pc == 0) return "(sin PC)";
+    if (!rle_prof_in_image(pc)) return "libc/kernel";
+    int lo = 0, hi = n - 1, best = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (tab[mid].addr <= pc) { best = mid; lo = mid + 1; }
+        else hi = mid - 1;
+    }
+    return best >= 0 ? tab[best].name : "(fuera de tabla)";
+}
+
+static inline void rle_prof_summarize(const RLEProfRing *r, const RLEProfSymbol *tab, int n,
+                                      RLEProfSummary *out) {
+    memset(out, 0, sizeof(*out));
+    out->samples = rle_prof_count(r);
+    out->lost = rle_prof_lost(r);
+
+    uint64_t seen_lo = 0, seen_hi = 0;     /* cores 0..127 vistos */
+    const char *names[64];
+    unsigned counts[64];
+    int distinct = 0;
+    int prev_core = -2;
+    for (unsigned i = 0; i < out->samples; i++) {
+        const RLEProfSample *s = rle_prof_at(r, i);
+        if (s->core >= 0 && s->core < 64) seen_lo |= 1ull << s->core;
+        else if (s->core >= 64 && s->core < 128) seen_hi |= 1ull << (s->core - 64);
+        if (prev_core != -2 && s->core != prev_core) out->migrations++;
+        prev_core = s->core;
+
+        const char *name = rle_prof_symbolize(tab, n, s->pc);
+        int k = 0;
+        while (k < distinct && names[k] != name) k++;
+        if (k == distinct && distinct < 64) { names[distinct] = name; counts[distinct++] = 0; }
+        if (k < distinct) counts[k]++;
+    }
+    out->cores = __builtin_popcountll(seen_lo) + __builtin_popcountll(seen_hi);
+
+    for (int t = 0; t < RLE_PROF_TOP && t < distinct; t++) {
+        int best = t;
+        for (int k = t + 1; k < distinct; k++)
+            if (counts[k] > counts[best]) best = k;
+        const char *nm = names[t]; names[t] = names[best]; names[best] = nm;
+        unsigned c = counts[t]; counts[t] = counts[best]; counts[best] = c;
+        out->top_name[t] = names[t];
+        out->top_count[t] = counts[t];
+        out->num_top = t + 1;
+    }
+}
+
+#endif /* RLE_PROFILE_H */
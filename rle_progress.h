@@ -0,0 +1,74 @@
+/*
+ * ============================================================================
+ *  rle_progress.h — Contadores de progreso por hilo, uno por línea de caché
+ *
+ *  Lo incluyen rle_secuencial.c y rle_paralelo.c. Cada hilo publica cuántos
+ *  bytes de entrada consumió y cuántos produjo para que el monitor (u otro
+ *  hilo) pueda leerlos sin locks. Dos detalles importan en el bucle interno:
+ *
+ *    - El contador vive solo en su línea de caché (RLE_CACHE_LINE). Si dos
+ *      hilos escriben contadores vecinos en la misma línea, cada store
+ *      invalida la copia del otro core (false sharing) aunque no compartan
+ *      ningún dato.
+ *    - Se publica cada RLE_PROGRESS_STEP bytes de entrada, no por run: el
+ *      estado caliente (posición, bytes escritos) queda en registros y el
+ *      store atómico ocurre una vez cada decenas de miles de runs.
+ *
+ *  Los stores son relaxed: el monitor solo necesita un valor reciente, no
+ *  ordenarlo respecto de los datos comprimidos (eso lo garantiza el join).
+ * ============================================================================
+ */
+
+#ifndef RLE_PROGRESS_H
+#define RLE_PROGRESS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Apple Silicon usa líneas de 128 bytes; x86_64 y el resto de AArch64, 64 */
+#if defined(__APPLE__) && defined(__aarch64__)
+#define RLE_CACHE_LINE 128
+#else
+#define RLE_CACHE_LINE 64
+#endif
+
+/* Bytes de entrada entre publicaciones del progreso */
+#define RLE_PROGRESS_STEP (64u * 1024u)
+
+typedef struct {
+    _Alignas(RLE_CACHE_LINE) atomic_size_t bytes_in;   /* entrada consumida */
+    atomic_size_t bytes_out;                           /* salida producida */
+} RLEProgress;
+
+_Static_assert(sizeof(RLEProgress) % RLE_CACHE_LINE == 0,
+               "RLEProgress debe ocupar líneas de caché completas");
+
+static inline void rle_progress_reset(RLEProgress *p) {
+    atomic_init(&p->bytes_in, 0);
+    atomic_init(&p->bytes_out, 0);
+}
+
+static inline void rle_progress_publish(RLEProgress *p, size_t in, size_t out) {
+    atomic_store_explicit(&p->bytes_in, in, memory_order_relaxed);
+    atomic_store_explicit(&p->bytes_out, out, memory_order_relaxed);
+}
+
+static inline size_t rle_progress_load(const RLEProgress *p) {
+    return atomic_load_explicit(&p->bytes_in, memory_order_relaxed);
+}
+
+/*
+ * calloc alineado a línea de caché, para arreglos de structs que contienen un
+ * RLEProgress (calloc solo garantiza 16 bytes). Se libera con free().
+ */
+static inline void *rle_cacheline_calloc(size_t n, size_t size) {
+    size_t bytes = n * size;
+    bytes = (bytes + RLE_CACHE_LINE - 1) / RLE_CACHE_LINE * RLE_CACHE_LINE;
+    void *p = aligned_alloc(RLE_CACHE_LINE, bytes ? bytes : RLE_CACHE_LINE);
+    if (p) memset(p, 0, bytes);
+    return p;
+}
+
+#endif /* RLE_PROGRESS_H */
@@ -9,6 +9,10 @@
  * ============================================================================
  */
 
+#if !defined(__APPLE__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE         /* Linux: sched_getcpu(), malloc_usable_size() */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,7 +25,14 @@
 #include <dirent.h>
 #include <signal.h>
 #include <errno.h>
+#include <sys/mman.h>
+#ifdef __APPLE__
 #include <malloc/malloc.h>  /* macOS: malloc_size() */
+#else
+#include <malloc.h>         /* Linux: malloc_usable_size() equivale a malloc_size() */
+#include <sched.h>
+#define malloc_size malloc_usable_size
+#endif
 
 #ifdef __APPLE__
 #include <mach/mach.h>
@@ -33,6 +44,30 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+/* Contenedor .rle indexado por chunks (compartido con rle_paralelo.c) */
+#include "rle_format.h"
+
+/* Kernel SIMD de búsqueda de runs (compartido con rle_paralelo.c) */
+#include "rle_simd.h"
+
+/* Codificación por modo: byte / píxel / planar (compartido con rle_paralelo.c) */
+#include "rle_codec.h"
+
+/* Entrada sin copia (mmap) para PPM y RAW (compartido con rle_paralelo.c) */
+#include "rle_input.h"
+#include "rle_progress.h"
+#include "rle_profile.h"
+#include "rle_perf.h"
+#include "rle_bench.h"
+#include "rle_synth.h"
+
+/* BMP de salida: swizzle vectorizado y escritura por bloques (compartido con rle_paralelo.c) */
+#include "rle_bmp.h"
+
+/* API reentrante en memoria (compartida con rle_paralelo.c): la implementación va en este .c */
+#define LIBRLE_IMPLEMENTATION
+#include "librle.h"
+
 /* ═══════════════════════════════════════════════════════════════════════════
  *  SEGMENTO DATA: Variables globales (inicializadas y no inicializadas)
  * ═══════════════════════════════════════════════════════════════════════════ */
@@ -45,6 +80,51 @@ static const char *g_program_name = "RLE Secuencial";
 static int g_uninitialized_var;
 static size_t g_total_runs;
 
+/* Kernel de escaneo de runs elegido al inicio (SIMD o escalar con --scalar) */
+static RLEScanKernel g_scan;
+
+/*
+ * Reserva del buffer de salida (--alloc):
+ *   grow  = estimación inicial + realloc duplicando en librle_buffer_push
+ *   bound = peor caso (rle_encoded_bound) en mmap MAP_NORESERVE: solo se
+ *           tocan (y cuentan como minflt) las páginas realmente escritas
+ *   exact = primera pasada que mide el stream y malloc del tamaño justo
+ * En bound y exact la capacidad está garantizada y los registros se escriben
+ * directo en el buffer, sin chequeo de capacidad por run.
+ */
+typedef enum { ALLOC_GROW, ALLOC_BOUND, ALLOC_EXACT, ALLOC_ARENA, ALLOC_COUNT } AllocMode;
+static const char *g_alloc_names[ALLOC_COUNT] = { "grow", "bound", "exact", "arena" };
+static AllocMode g_alloc_mode = ALLOC_BOUND;
+
+/* Modo de codificación de los runs (--mode, por defecto byte) */
+static uint8_t g_rle_mode = RLE_MODE_BYTE;
+
+/*
+ * Flags del formato (RLE_FLAG_VARINT con --varint, RLE_FLAG_RAW_CRC con --verify checksum,
+ * RLE_FLAG_CODEC con --adaptive)
+ */
+static uint8_t g_rle_flags = 0;
+/* --adaptive: chunks de la última compresión por codec (RLE_CODEC_*) */
+static uint32_t g_codec_chunks[RLE_CODEC_COUNT];
+
+/* --verify decode|stream|checksum: cómo se comprueba la salida (RLEVerifyMode) */
+static int g_verify = RLE_VERIFY_DECODE;
+static int g_decode_bgr = 0;                   /* --decode-bgr: decodificar en BGR, BMP sin swizzle */
+static int g_rows = 0;                         /* -d ... --rows Y0:Y1: solo esas filas */
+static uint32_t g_rows_y0, g_rows_y1;
+static int g_update = 0;                       /* --update: reescribir solo las bandas cambiadas */
+
+/* Opciones de entrada (la imagen se carga con librle_image_load) */
+static uint32_t g_raw_width, g_raw_height;     /* --raw-size WxH */
+static int g_write_raw = 1;                    /* --no-raw lo desactiva */
+
+/* --tile ROWS: filas por tile/chunk (0 = automático, ~RLE_TILE_BYTES por tile) */
+static uint32_t g_tile_rows = 0;
+
+/* --stream ROWS: comprimir por strips de ROWS filas (0 = imagen entera en memoria) */
+static uint32_t g_stream_rows = 0;
+static int g_stream_inflight = 2;              /* --inflight N: strips leídos por adelantado */
+
 /* ═══════════════════════════════════════════════════════════════════════════
  *  SEGUIMIENTO DE FASES DEL PROGRAMA
  * ═══════════════════════════════════════════════════════════════════════════ */
@@ -59,7 +139,8 @@ static SyscallEntry g_syscall_table[32];
 static int g_num_tracked_syscalls = 0;
 
 /* Seguimiento de asignaciones en heap (max 32 entradas) */
-typedef struct { void *addr; size_t requested_size; size_t actual_size; const char *label; int freed; } HeapAllocation;
+typedef struct { void *addr; size_t requested_size; size_t actual_size; const char *label; int freed;
+                 size_t initial_size; int resizes; } HeapAllocation;
 static HeapAllocation g_heap_log[32];
 static int g_num_heap_entries = 0;
 
@@ -76,27 +157,20 @@ static long g_baseline_minflt = 0, g_baseline_majflt = 0;
  *  ESTRUCTURAS DE DATOS
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-typedef struct {
-    uint32_t width;
-    uint32_t height;
-    uint8_t *data;      /* Puntero a HEAP */
-} Image;
-
-typedef struct {
-    uint8_t *data;      /* Puntero a HEAP */
-    size_t size;
-    size_t capacity;
-} Buffer;
+/* Imagen (RLELibImage) y buffer de salida (RLELibBuffer) son los de librle.h */
 
 typedef struct {
-    atomic_size_t pixels_processed;
-    atomic_size_t compressed_bytes;
+    RLEProgress counters;   /* bytes de entrada / salida, publicados cada RLE_PROGRESS_STEP */
     size_t total_pixels;
     atomic_int done;
 } Progress;
 
-/* Muestreo del PC (Program Counter) para el hilo secuencial */
-#define MAX_PC_SAMPLES 256
+/*
+ * Marcas del PC (Program Counter) del hilo secuencial en puntos fijos
+ * (inicio y fin de la compresión), fuera del bucle caliente. Las muestras
+ * durante la ejecución las toma el profiler por SIGPROF (--profile HZ).
+ */
+#define MAX_PC_SAMPLES 8
 
 typedef struct {
     double    timestamp_ms;
@@ -107,20 +181,39 @@ typedef struct {
 static PCSample g_pc_samples[MAX_PC_SAMPLES];
 static int g_num_pc_samples = 0;
 static struct timespec g_t0_compress; /* Tiempo base de la compresión */
+static int g_profile_hz = 0;          /* --profile HZ: muestreo SIGPROF (0 = apagado) */
+static RLEProfRing *g_prof;           /* ring del hilo principal con --profile */
+static int g_perf = 0;                /* --perf: contadores de hardware de la compresión */
+static RLEPerfCounters g_perf_counters;
+
+/* --bench: corridas medidas sin visualizaciones (rle_bench.h) */
+static int g_bench = 0;
+static int g_bench_iters = 10;        /* --bench-iters K: corridas que cuentan */
+static int g_bench_warmup = 2;        /* --bench-warmup W: corridas descartadas */
+static int g_bench_csv = 0;           /* --bench-csv: CSV en lugar de JSON */
+static const char *g_bench_out;       /* --bench-out ARCHIVO (NULL = stdout) */
+static uint32_t g_bench_width = 2048, g_bench_height = 2048;   /* --bench-size WxH */
+
+/* --synth SPEC: comprimir una imagen del generador (rle_synth.h) en lugar de un archivo */
+static int g_use_synth = 0;
+static RLESynthParams g_synth;
 
 /* ═══════════════════════════════════════════════════════════════════════════
  *  DECLARACIONES ADELANTADAS (para mostrar direcciones de código)
  * ═══════════════════════════════════════════════════════════════════════════ */
 
 int main(int argc, char *argv[]);
-static void buffer_init(Buffer *buf, size_t cap);
-static void buffer_push(Buffer *buf, const uint8_t *bytes, size_t n);
-static void rle_compress(const uint8_t *pixels, size_t num_pixels, Buffer *out, Progress *prog);
-static void generate_synthetic(Image *img, uint32_t w, uint32_t h);
-static int load_image(const char *path, Image *img);
-static uint8_t *rle_decompress(const uint8_t *rle_data, size_t rle_size,
+static void rle_compress(const uint8_t *pixels, size_t begin, size_t num_pixels,
+                         RLELibBuffer *out, Progress *prog, int codec, RLEChunkEntry *e);
+static void compress_image(const RLELibImage *img, RLEChunkEntry *chunks, uint32_t num_chunks,
+                           RLELibBuffer *compressed, Progress *prog);
+static void generate_synthetic(RLELibImage *img, uint32_t w, uint32_t h);
+static uint8_t *rle_decompress(const uint8_t *rle_data, const RLEChunkEntry *chunks,
+                                uint32_t num_chunks, uint32_t width,
                                 size_t expected_pixels);
-static void save_bmp(const char *path, const uint8_t *pixels, uint32_t w, uint32_t h);
+static size_t rle_decompress_into(uint8_t mode, uint8_t flags, uint32_t codec, int bgr,
+                                  const uint8_t *rle_data, size_t rle_size,
+                                  uint8_t *pixels, size_t expected_pixels);
 
 /* ═══════════════════════════════════════════════════════════════════════════
  *  INFORMACIÓN DEL SISTEMA OPERATIVO
@@ -149,14 +242,17 @@ static void get_memory_info(size_t *rss, size_t *virtual_size) {
         *virtual_size = 0;
     }
 #else
+    *rss = 0;
+    *virtual_size = 0;
     FILE *f = fopen("/proc/self/statm", "r");
     if (f) {
         long virt_pages, res_pages;
-        fscanf(f, "%ld %ld", &virt_pages, &res_pages);
+        if (fscanf(f, "%ld %ld", &virt_pages, &res_pages) == 2) {
+            long page_size = sysconf(_SC_PAGESIZE);
+            *virtual_size = virt_pages * page_size;
+            *rss = res_pages * page_size;
+        }
         fclose(f);
-        long page_size = sysconf(_SC_PAGESIZE);
-        *virtual_size = virt_pages * page_size;
-        *rss = res_pages * page_size;
     }
 #endif
 }
@@ -197,9 +293,34 @@ static void track_heap_alloc(void *addr, size_t requested, const char *label) {
         e->addr = addr; e->requested_size = requested;
         e->actual_size = malloc_size(addr);
         e->label = label; e->freed = 0;
+        e->initial_size = requested; e->resizes = 0;
+    }
+}
+
+/* Reserva fuera del allocator (mmap): el tamaño real son páginas completas */
+static void track_mapped_alloc(void *addr, size_t requested, const char *label) {
+    if (g_num_heap_entries < 32 && addr) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        HeapAllocation *e = &g_heap_log[g_num_heap_entries++];
+        e->addr = addr; e->requested_size = requested;
+        e->actual_size = (requested + page - 1) / page * page;
+        e->label = label; e->freed = 0;
+        e->initial_size = requested; e->resizes = 0;
     }
 }
 
+/* realloc: la entrada conserva el tamaño inicial para mostrar el antes/después */
+static void track_heap_resize(void *old_addr, void *new_addr, size_t requested) {
+    for (int i = 0; i < g_num_heap_entries; i++)
+        if (g_heap_log[i].addr == old_addr && !g_heap_log[i].freed) {
+            g_heap_log[i].addr = new_addr;
+            g_heap_log[i].requested_size = requested;
+            g_heap_log[i].actual_size = malloc_size(new_addr);
+            g_heap_log[i].resizes++;
+            return;
+        }
+}
+
 static void track_heap_free(void *addr) {
     for (int i = 0; i < g_num_heap_entries; i++)
         if (g_heap_log[i].addr == addr && !g_heap_log[i].freed) { g_heap_log[i].freed = 1; return; }
@@ -244,53 +365,57 @@ static void capture_baseline_ctx(void) {
 }
 
 /* ═══════════════════════════════════════════════════════════════════════════
- *  BUFFER DINÁMICO (HEAP)
+ *  LIBRLE: BUFFERS, CARGA DE IMAGEN Y BMP CON EL SEGUIMIENTO DE ESTE PROGRAMA
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-static void buffer_init(Buffer *buf, size_t cap) {
-    buf->data = malloc(cap);  /* Asignación en HEAP */
-    if (!buf->data) { perror("malloc"); exit(1); }
-    buf->size = 0;
-    buf->capacity = cap;
-    track_syscall("malloc", "mmap/brk", "Asignar buffer de compresion");
-    track_heap_alloc(buf->data, cap, "Buffer compresion");
+/* Los buffers, librle_image_load y librle_bmp_save reportan a las tablas de syscalls y heap */
+static const RLELibHooks g_lib_hooks = {
+    .syscall = track_syscall, .heap_alloc = track_heap_alloc, .mapped_alloc = track_mapped_alloc,
+    .heap_resize = track_heap_resize, .heap_free = track_heap_free,
+};
+
+/* Backend secuencial: cargar la imagen (PNG, JPG, ... via stb_image; PPM/RAW mapeados) y el BMP */
+static RLELib g_lib;
+
+static void lib_init(void) {
+    RLELibConfig cfg;
+    librle_config_default(&cfg);
+    cfg.mode = g_rle_mode;
+    cfg.flags = g_rle_flags;
+    librle_init(&g_lib, &cfg);
+    g_lib.kernel = g_scan;
+    g_lib.hooks = &g_lib_hooks;
 }
 
-static void buffer_push(Buffer *buf, const uint8_t *bytes, size_t n) {
-    while (buf->size + n > buf->capacity) {
-        buf->capacity *= 2;
-        buf->data = realloc(buf->data, buf->capacity);  /* Reasignación en HEAP */
-        if (!buf->data) { perror("realloc"); exit(1); }
+/* Carga path con librle_image_load y muestra qué se cargó; -1 con el motivo en stderr */
+static int open_image(const char *path, RLELibImage *img) {
+    if (librle_image_load(&g_lib, img, path, g_raw_width, g_raw_height) != RLE_LIB_OK) {
+        fprintf(stderr, "  %s\n", librle_error(&g_lib));
+        return -1;
     }
-    memcpy(buf->data + buf->size, bytes, n);
-    buf->size += n;
+    size_t bytes = (size_t)img->width * img->height * 3;
+    if (img->input.map) {
+        printf("\n  \033[32mImagen mapeada (sin copia):\033[0m %s\n", path);
+        printf("    Dimensiones: %u x %u px (%s, RGB tal cual en el archivo)\n",
+               img->width, img->height, img->input.format == RLE_INPUT_RAW ? "RAW" : "PPM P6");
+    } else {
+        printf("\n  \033[32mImagen cargada:\033[0m %s\n", path);
+        printf("    Dimensiones: %u x %u px (%d canales originales → RGB)\n",
+               img->width, img->height, img->channels);
+    }
+    printf("    Tamaño datos: %zu bytes (%.2f MB)\n\n", bytes, bytes / (1024.0 * 1024.0));
+    return 0;
 }
 
-/* ═══════════════════════════════════════════════════════════════════════════
- *  CARGA DE IMAGEN (PNG, JPG, BMP, GIF, TGA, PSD, HDR, PIC via stb_image)
- * ═══════════════════════════════════════════════════════════════════════════ */
-
-static int load_image(const char *path, Image *img) {
-    int w, h, channels;
-    /* stb_image carga en RGB (3 canales) para comparación justa con versión paralela */
-    uint8_t *pixels = stbi_load(path, &w, &h, &channels, 3);
-    if (!pixels) {
-        fprintf(stderr, "  Error cargando '%s': %s\n", path, stbi_failure_reason());
-        return -1;
+/* Sin memoria para el buffer de salida el programa no puede seguir (como un malloc fallido) */
+static void buffer_check(int rc) {
+    if (rc != RLE_LIB_OK) {
+        fprintf(stderr, "buffer de salida: %s\n", librle_strerror(rc));
+        exit(1);
     }
-    img->width = (uint32_t)w;
-    img->height = (uint32_t)h;
-    img->data = pixels;  /* stb_image usa malloc internamente → datos en HEAP */
-    track_syscall("stbi_load", "mmap/read", "Cargar imagen desde disco");
-    track_heap_alloc(img->data, (size_t)w * h * 3, "Imagen RGB");
-    printf("\n  \033[32mImagen cargada:\033[0m %s\n", path);
-    printf("    Dimensiones: %d x %d px (%d canales originales → RGB)\n", w, h, channels);
-    printf("    Tamaño datos: %zu bytes (%.2f MB)\n\n",
-           (size_t)w * h * 3, (size_t)w * h * 3 / (1024.0 * 1024.0));
-    return 0;
 }
 
-static void generate_synthetic(Image *img, uint32_t w, uint32_t h) {
+static void generate_synthetic(RLELibImage *img, uint32_t w, uint32_t h) {
     img->width = w;
     img->height = h;
     size_t pixel_bytes = (size_t)w * h * 3;
@@ -306,24 +431,24 @@ static void generate_synthetic(Image *img, uint32_t w, uint32_t h) {
             img->data[idx + 1] = gray;
             img->data[idx + 2] = gray;
         }
-}
-
-
+    }
 }
 
 /* ═══════════════════════════════════════════════════════════════════════════
  *  COMPRESIÓN RLE
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-static void rle_compress(const uint8_t *pixels, size_t num_pixels,
-                         Buffer *out, Progress *prog) {
-    size_t i = 0;
-    size_t sample_interval = num_pixels / (MAX_PC_SAMPLES - 2);
-    if (sample_interval < 1) sample_interval = 1;
-    size_t next_sample = 0;
-
-    /* Muestra PC inicial */
-    if (g_num_pc_samples < MAX_PC_SAMPLES) {
+/*
+ * Comprime pixels[begin, begin + num_pixels) (una banda de filas completas)
+ * con librle_encode_chunk. Los runs se cortan en el borde de la banda para
+ * que cada chunk del contenedor se pueda decodificar por separado. codec >= 0
+ * fija el codec de la banda (--adaptive con exact/arena: el de la medición);
+ * deja en e la longitud, el codec final y el raw_checksum.
+ */
+static void rle_compress(const uint8_t *pixels, size_t begin, size_t num_pixels,
+                         RLELibBuffer *out, Progress *prog, int codec, RLEChunkEntry *e) {
+    /* Marca PC inicial */
+    if (begin == 0 && g_num_pc_samples < MAX_PC_SAMPLES) {
         struct timespec now;
         clock_gettime(CLOCK_MONOTONIC, &now);
         g_pc_samples[g_num_pc_samples++] = (PCSample){
@@ -334,35 +459,103 @@ static void rle_compress(const uint8_t *pixels, size_t num_pixels,
         };
     }
 
-    while (i < num_pixels) {
-        uint8_t gray = pixels[i];
-        uint8_t count = 1;
+    /* Modo planar: separar los planos R, G, B de la banda antes de codificar */
+    uint8_t *scratch = NULL;
+    size_t scratch_size = rle_encoder_scratch_size(g_rle_mode, num_pixels);
+    if (scratch_size > 0) {
+        scratch = malloc(scratch_size);
+        if (!scratch) { perror("malloc"); exit(1); }
+    }
 
-        while (i + count < num_pixels && count < 255 &&
-               pixels[i + count] == gray) {
-            count++;
-        }
+    /* Con capacidad garantizada (bound/exact/arena) los registros van directo al buffer */
+    const int raw = g_alloc_mode != ALLOC_GROW;
+    RLELibChunk c = {
+        .band = pixels + begin, .bytes = num_pixels, .scratch = scratch,
+        .dst = raw ? out->data + out->size : NULL, .out = out, .codec = codec,
+        .progress = &prog->counters, .in_base = begin, .out_base = out->size,
+    };
+    buffer_check(librle_encode_chunk(&g_lib, &c));
+    if (raw)
+        out->size += c.entry.length;
+    g_total_runs += c.records;
+    free(scratch);
+    e->length = c.entry.length;
+    e->codec = c.entry.codec;
+    e->raw_checksum = c.entry.raw_checksum;
+
+    /* Marca PC final (última banda) */
+    size_t i = begin + num_pixels;
+    if (i == prog->total_pixels * 3 && g_num_pc_samples < MAX_PC_SAMPLES) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        g_pc_samples[g_num_pc_samples++] = (PCSample){
+            .timestamp_ms = (now.tv_sec - g_t0_compress.tv_sec) * 1000.0 +
+                            (now.tv_nsec - g_t0_compress.tv_nsec) / 1e6,
+            .pc_addr = (uintptr_t)rle_encode_next,
+            .pixels_at = i
+        };
+    }
+}
 
-        uint8_t run[2] = { count, gray };
-        buffer_push(out, run, 2);
-        i += count;
-        g_total_runs++;
-
-        atomic_store(&prog->pixels_processed, i);
-        atomic_store(&prog->compressed_bytes, out->size);
-
-        /* Muestrear PC periódicamente */
-        if (i >= next_sample && g_num_pc_samples < MAX_PC_SAMPLES) {
-            struct timespec now;
-            clock_gettime(CLOCK_MONOTONIC, &now);
-            g_pc_samples[g_num_pc_samples++] = (PCSample){
-                .timestamp_ms = (now.tv_sec - g_t0_compress.tv_sec) * 1000.0 +
-                                (now.tv_nsec - g_t0_compress.tv_nsec) / 1e6,
-                .pc_addr = (uintptr_t)rle_compress + (i & 0xFFF),
-                .pixels_at = i
-            };
-            next_sample += sample_interval;
-        }
+/* --alloc exact: bytes exactos que producirá rle_compress sobre la banda (y su codec) */
+static size_t rle_measure(const uint8_t *pixels, size_t begin, size_t num_pixels,
+                          uint32_t *codec) {
+    uint8_t *scratch = NULL;
+    size_t scratch_size = rle_encoder_scratch_size(g_rle_mode, num_pixels);
+    if (scratch_size > 0) {
+        scratch = malloc(scratch_size);
+        if (!scratch) { perror("malloc"); exit(1); }
+    }
+    RLELibChunk c = { .band = pixels + begin, .bytes = num_pixels, .scratch = scratch };
+    size_t n = librle_measure_chunk(&g_lib, &c);
+    *codec = c.entry.codec;
+    free(scratch);
+    return n;
+}
+
+/*
+ * Comprime img banda por banda (una por chunk, ya cortados en chunks) en
+ * compressed, que se reserva según --alloc. Deja en cada chunk su longitud.
+ */
+static void compress_image(const RLELibImage *img, RLEChunkEntry *chunks, uint32_t num_chunks,
+                           RLELibBuffer *compressed, Progress *prog) {
+    size_t raw_size = (size_t)img->width * img->height * 3;
+
+    /* Inicializar buffer de salida según --alloc */
+    int rc;
+    if (g_alloc_mode == ALLOC_BOUND) {
+        rc = librle_buffer_init_mapped(compressed, rle_encoded_bound(g_rle_mode, raw_size),
+                                       &g_lib_hooks, "Buffer mmap");
+    } else if (g_alloc_mode == ALLOC_EXACT || g_alloc_mode == ALLOC_ARENA) {
+        size_t need = 0;
+        for (uint32_t c = 0; c < num_chunks; c++)
+            need += rle_measure(img->data, (size_t)chunks[c].start_row * img->width * 3,
+                                (size_t)chunks[c].num_rows * img->width * 3, &chunks[c].codec);
+        if (g_alloc_mode == ALLOC_ARENA)
+            rc = librle_buffer_init_arena(compressed, rle_container_size(num_chunks, 0), need,
+                                          &g_lib_hooks, "Arena .rle");
+        else
+            rc = librle_buffer_init(compressed, need, &g_lib_hooks, "Buffer compresion");
+    } else {
+        rc = librle_buffer_init(compressed, raw_size / 2, &g_lib_hooks,   /* Asigna en HEAP */
+                                "Buffer compresion");
+    }
+    buffer_check(rc);
+
+    /* Entrada mapeada: cada banda pide por adelantado las páginas de la siguiente */
+    if (img->input.map)
+        rle_input_prefetch(img->data, (size_t)chunks[0].num_rows * img->width * 3);
+
+    for (uint32_t c = 0; c < num_chunks; c++) {
+        size_t band_begin = (size_t)chunks[c].start_row * img->width * 3;
+        size_t band_bytes = (size_t)chunks[c].num_rows * img->width * 3;
+        if (img->input.map && c + 1 < num_chunks)
+            rle_input_prefetch(img->data + band_begin + band_bytes,
+                               (size_t)chunks[c + 1].num_rows * img->width * 3);
+        int measured = g_alloc_mode == ALLOC_EXACT || g_alloc_mode == ALLOC_ARENA;
+        rle_compress(img->data, band_begin, band_bytes, compressed, prog,
+                     measured ? (int)chunks[c].codec : -1, &chunks[c]);
+        g_codec_chunks[chunks[c].codec]++;
     }
 }
 
@@ -370,87 +563,77 @@ static void rle_compress(const uint8_t *pixels, size_t num_pixels,
  *  DESCOMPRESIÓN RLE → PÍXELES RGB
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-static uint8_t *rle_decompress(const uint8_t *rle_data, size_t rle_size,
+/* Decodifica un chunk (en BGR si bgr) en un buffer del llamador; devuelve los bytes escritos */
+static size_t rle_decompress_into(uint8_t mode, uint8_t flags, uint32_t codec, int bgr,
+                                  const uint8_t *rle_data, size_t rle_size,
+                                  uint8_t *pixels, size_t expected_pixels) {
+    RLEDecoder d;
+    rle_decoder_init(&d, mode, flags, codec, rle_data, rle_size, pixels, expected_pixels);
+    d.bgr = bgr;
+    while (rle_decode_some(&d, SIZE_MAX) != 0) {}
+    return d.out;
+}
+
+/*
+ * Decodifica el buffer comprimido en memoria (chunks consecutivos) banda por
+ * banda: en modo planar cada chunk solo tiene sentido dentro de su banda.
+ */
+static uint8_t *rle_decompress(const uint8_t *rle_data, const RLEChunkEntry *chunks,
+                                uint32_t num_chunks, uint32_t width,
                                 size_t expected_pixels) {
-    uint8_t *pixels = (uint8_t *)malloc(expected_pixels);
+    uint8_t *pixels = (uint8_t *)malloc(expected_pixels ? expected_pixels : 1);
     if (!pixels) { perror("malloc decompress"); return NULL; }
+    size_t off = 0;
+    for (uint32_t c = 0; c < num_chunks; c++) {
+        size_t band_off = (size_t)chunks[c].start_row * width * 3;
+        size_t band_size = (size_t)chunks[c].num_rows * width * 3;
+        rle_decompress_into(g_rle_mode, g_rle_flags, chunks[c].codec, g_decode_bgr,
+                            rle_data + off, chunks[c].length, pixels + band_off, band_size);
+        off += chunks[c].length;
+    }
+    return pixels;
+}
 
-    size_t px = 0;
-    size_t i = 0;
-    while (i + 1 < rle_size && px < expected_pixels) {
-        uint8_t count = rle_data[i];
-        uint8_t gray = rle_data[i + 1];
-        for (uint8_t j = 0; j < count && px < expected_pixels; j++) {
-            pixels[px] = gray;
-            px++;
+/*
+ * --verify stream: recorre los runs de cada chunk contra su banda original
+ * (RLEVerifier) sin escribir la imagen decodificada y corta en el primer
+ * byte distinto. Devuelve los bytes verificados; *bad_chunk queda en
+ * UINT32_MAX si todo coincide, si no con el chunk y *bad_offset con el byte
+ * dentro de su banda.
+ */
+static size_t rle_verify_stream(const uint8_t *rle_data, const RLEChunkEntry *chunks,
+                                uint32_t num_chunks, uint32_t width, const uint8_t *expect,
+                                uint32_t *bad_chunk, size_t *bad_offset) {
+    size_t off = 0, done = 0;
+    *bad_chunk = UINT32_MAX;
+    for (uint32_t c = 0; c < num_chunks; c++) {
+        size_t band_off = (size_t)chunks[c].start_row * width * 3;
+        size_t band_size = (size_t)chunks[c].num_rows * width * 3;
+        RLEVerifier v;
+        rle_verifier_init(&v, g_rle_mode, g_rle_flags, chunks[c].codec, rle_data + off,
+                          chunks[c].length, expect + band_off, band_size);
+        size_t n;
+        while ((n = rle_verify_some(&v, SIZE_MAX)) != 0)
+            done += n;
+        if (v.mismatch != SIZE_MAX) {
+            *bad_chunk = c;
+            *bad_offset = v.mismatch;
+            break;
         }
-        i += 2;
+        off += chunks[c].length;
     }
-    return pixels;
+    return done;
 }
 
 /* ═══════════════════════════════════════════════════════════════════════════
  *  GUARDAR IMAGEN BMP (sin dependencias externas)
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-static void save_bmp(const char *path, const uint8_t *pixels,
-                      uint32_t w, uint32_t h) {
-    uint32_t row_stride = (w * 3 + 3) & ~3u;
-    uint32_t pixel_data_size = row_stride * h;
-    uint32_t file_size = 14 + 40 + pixel_data_size;
-
-    FILE *f = fopen(path, "wb");
-    if (!f) { perror("fopen bmp"); return; }
-    track_syscall("fopen", "open", "Abrir archivo BMP para escritura");
-
-    uint8_t fh[14] = {0};
-    fh[0] = 'B'; fh[1] = 'M';
-    fh[2] = file_size & 0xFF;
-    fh[3] = (file_size >> 8) & 0xFF;
-    fh[4] = (file_size >> 16) & 0xFF;
-    fh[5] = (file_size >> 24) & 0xFF;
-    uint32_t offset = 14 + 40;
-    fh[10] = offset & 0xFF;
-    fh[11] = (offset >> 8) & 0xFF;
-    fwrite(fh, 1, 14, f);
-
-    uint8_t ih[40] = {0};
-    ih[0] = 40;
-    ih[4] = w & 0xFF; ih[5] = (w >> 8) & 0xFF;
-    ih[6] = (w >> 16) & 0xFF; ih[7] = (w >> 24) & 0xFF;
-    ih[8] = h & 0xFF; ih[9] = (h >> 8) & 0xFF;
-    ih[10] = (h >> 16) & 0xFF; ih[11] = (h >> 24) & 0xFF;
-    ih[12] = 1;
-    ih[14] = 24;
-    ih[20] = pixel_data_size & 0xFF;
-    ih[21] = (pixel_data_size >> 8) & 0xFF;
-    ih[22] = (pixel_data_size >> 16) & 0xFF;
-    ih[23] = (pixel_data_size >> 24) & 0xFF;
-    fwrite(ih, 1, 40, f);
-
-    uint8_t *row = (uint8_t *)calloc(row_stride, 1);
-    if (!row) { fclose(f); return; }
-    for (int y = (int)h - 1; y >= 0; y--) {
-        memset(row, 0, row_stride);
-        for (uint32_t x = 0; x < w; x++) {
-            size_t src = ((size_t)y * w + x) * 3;
-            row[x * 3 + 0] = pixels[src + 2];  /* B */
-            row[x * 3 + 1] = pixels[src + 1];  /* G */
-            row[x * 3 + 2] = pixels[src + 0];  /* R */
-        }
-        fwrite(row, 1, row_stride, f);
-    }
-    free(row);
-    track_syscall("fwrite", "write", "Escribir datos BMP a disco");
-    fclose(f);
-    track_syscall("fclose", "close", "Cerrar archivo BMP");
-}
-
 /* ═══════════════════════════════════════════════════════════════════════════
  *  VISUALIZACIÓN DE SEGMENTOS DE MEMORIA
  * ═══════════════════════════════════════════════════════════════════════════ */
 
-static void print_memory_segments(Image *img, Buffer *compressed,
+static void print_memory_segments(RLELibImage *img, RLELibBuffer *compressed,
                                    void *stack_top, void *stack_bottom) {
     const char *CYAN = "\033[36m";
     const char *YELLOW = "\033[1;33m";
@@ -493,10 +676,10 @@ static void print_memory_segments(Image *img, Buffer *compressed,
            CYAN, RESET, RED, RESET, MAGENTA, (unsigned long)stack_top, RESET, RED, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  │  stack_bottom (local)   %s0x%014lx%s    8 bytes   (base pila)     │ %s▓%s  %s║%s\n",
            CYAN, RESET, RED, RESET, MAGENTA, (unsigned long)stack_bottom, RESET, RED, RESET, CYAN, RESET);
-    printf("%s║%s  %s▓%s  │  img (struct local)     %s0x%014lx%s   16 bytes   Image struct    │ %s▓%s  %s║%s\n",
-           CYAN, RESET, RED, RESET, MAGENTA, (unsigned long)img, RESET, RED, RESET, CYAN, RESET);
-    printf("%s║%s  %s▓%s  │  compressed (local)     %s0x%014lx%s   24 bytes   Buffer struct   │ %s▓%s  %s║%s\n",
-           CYAN, RESET, RED, RESET, MAGENTA, (unsigned long)compressed, RESET, RED, RESET, CYAN, RESET);
+    printf("%s║%s  %s▓%s  │  img (struct local)     %s0x%014lx%s  %3zu bytes   RLELibImage     │ %s▓%s  %s║%s\n",
+           CYAN, RESET, RED, RESET, MAGENTA, (unsigned long)img, RESET, sizeof(*img), RED, RESET, CYAN, RESET);
+    printf("%s║%s  %s▓%s  │  compressed (local)     %s0x%014lx%s  %3zu bytes   RLELibBuffer    │ %s▓%s  %s║%s\n",
+           CYAN, RESET, RED, RESET, MAGENTA, (unsigned long)compressed, RESET, sizeof(*compressed), RED, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  │                                                                         │ %s▓%s  %s║%s\n", CYAN, RESET, RED, RESET, RED, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  │  Tamaño usado en stack: %s~%lu bytes%s                                      │ %s▓%s  %s║%s\n",
            CYAN, RESET, RED, RESET, GREEN, (unsigned long)((char*)stack_top - (char*)stack_bottom), RESET, RED, RESET, CYAN, RESET);
@@ -522,10 +705,10 @@ static void print_memory_segments(Image *img, Buffer *compressed,
            CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)main, RESET, YELLOW, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  │  rle_compress()         %s0x%014lx%s  Algoritmo RLE              │ %s▓%s  %s║%s\n",
            CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)rle_compress, RESET, YELLOW, RESET, CYAN, RESET);
-    printf("%s║%s  %s▓%s  │  buffer_init()          %s0x%014lx%s  Inicializar buffer         │ %s▓%s  %s║%s\n",
-           CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)buffer_init, RESET, YELLOW, RESET, CYAN, RESET);
-    printf("%s║%s  %s▓%s  │  buffer_push()          %s0x%014lx%s  Agregar a buffer           │ %s▓%s  %s║%s\n",
-           CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)buffer_push, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s║%s  %s▓%s  │  librle_buffer_init()   %s0x%014lx%s  Inicializar buffer         │ %s▓%s  %s║%s\n",
+           CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)librle_buffer_init, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s║%s  %s▓%s  │  librle_buffer_push()   %s0x%014lx%s  Agregar a buffer           │ %s▓%s  %s║%s\n",
+           CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)librle_buffer_push, RESET, YELLOW, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  │  generate_synthetic()   %s0x%014lx%s  Generar imagen             │ %s▓%s  %s║%s\n",
            CYAN, RESET, YELLOW, RESET, MAGENTA, (unsigned long)generate_synthetic, RESET, YELLOW, RESET, CYAN, RESET);
     printf("%s║%s  %s▓%s  %s└─────────────────────────────────────────────────────────────────────────┘%s %s▓%s  %s║%s\n", CYAN, RESET, YELLOW, RESET, WHITE, RESET, YELLOW, RESET, CYAN, RESET);
@@ -622,6 +805,28 @@ static void print_execution_results(double elapsed, double user_t, double sys_t,
            CYAN, RESET, WHITE, RESET, GREEN, cpu_pct, RESET, CYAN, RESET);
     printf("%s║%s  %sThroughput:%s                  %s%12.1f%s MB/s                                         %s║%s\n",
            CYAN, RESET, WHITE, RESET, GREEN, throughput, RESET, CYAN, RESET);
+    printf("%s║%s  %sKernel de escaneo:%s           %s%12s%s (%2d B/paso)                                  %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, g_scan.name, RESET, g_scan.bytes_per_step, CYAN, RESET);
+    {
+        const char *simd = "?";
+        char variant[48];
+        rle_runs_encoder(&g_scan, g_rle_mode, g_rle_flags, &simd);
+        snprintf(variant, sizeof(variant), "%s/%s/%s", g_rle_mode == RLE_MODE_PIXEL ? "px24" : "b8",
+                 rle_count_name(g_rle_flags), simd);
+        printf("%s║%s  %sVariante de runs:%s            %s%-58s%s%s║%s\n",
+               CYAN, RESET, WHITE, RESET, GREEN, variant, RESET, CYAN, RESET);
+    }
+    printf("%s║%s  %sModo de codificación:%s        %s%12s%s (count %-6s)                               %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, rle_mode_name(g_rle_mode), RESET,
+           rle_count_name(g_rle_flags), CYAN, RESET);
+    if (g_rle_flags & RLE_FLAG_CODEC) {
+        char line[96];
+        rle_codec_summary(line, sizeof(line), g_codec_chunks);
+        printf("%s║%s  %sCodec por banda:%s             %s%-53s%s  %s║%s\n",
+               CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    }
+    printf("%s║%s  %sReserva de salida:%s           %s%12s%s (--alloc)                                    %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, g_alloc_names[g_alloc_mode], RESET, CYAN, RESET);
     printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
     printf("%s║%s  %sTamaño original:%s             %s%12zu%s bytes                                        %s║%s\n",
            CYAN, RESET, WHITE, RESET, YELLOW, raw_size, RESET, CYAN, RESET);
@@ -737,11 +942,13 @@ static void print_heap_visualization(void) {
            CYAN, RESET, YELLOW, RESET, YELLOW, RESET, YELLOW, RESET, YELLOW, RESET, YELLOW, RESET, YELLOW, RESET, CYAN, RESET);
     printf("%s║%s  %s├────┼──────────────────┼──────────────────┼────────────┼────────────┼────────┤%s  %s║%s\n", CYAN, RESET, WHITE, RESET, CYAN, RESET);
 
-    size_t total_requested = 0, total_actual = 0;
-    int active_count = 0, freed_count = 0;
+    size_t total_requested = 0, total_actual = 0, total_initial = 0;
+    int active_count = 0, freed_count = 0, total_resizes = 0;
 
     for (int i = 0; i < g_num_heap_entries; i++) {
         HeapAllocation *e = &g_heap_log[i];
+        total_initial += e->initial_size;
+        total_resizes += e->resizes;
         total_requested += e->requested_size;
         total_actual += e->actual_size;
         if (e->freed) freed_count++; else active_count++;
@@ -772,6 +979,9 @@ static void print_heap_visualization(void) {
            CYAN, RESET, RED, frag_pct, RESET, CYAN, RESET);
     printf("%s║%s  │  Bloques activos / libres: %s%d activos%s / %s%d liberados%s                              │%s║%s\n",
            CYAN, RESET, GREEN, active_count, RESET, RED, freed_count, RESET, CYAN, RESET);
+    printf("%s║%s  │  Reserva --alloc %-5s:   inicial %s%10zu B%s → final %s%10zu B%s, %s%3d%s realloc│%s║%s\n",
+           CYAN, RESET, g_alloc_names[g_alloc_mode], GREEN, total_initial, RESET,
+           YELLOW, total_requested, RESET, RED, total_resizes, RESET, CYAN, RESET);
     printf("%s║%s  %s└──────────────────────────────────────────────────────────────────────────────────┘%s%s║%s\n", CYAN, RESET, WHITE, RESET, CYAN, RESET);
     printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
     printf("%s║%s  %sNota:%s En macOS, el magazine allocator de libmalloc agrupa bloques pequenios en     %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
@@ -1063,6 +1273,846 @@ static void print_error_handling_demo(void) {
     printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n", CYAN, RESET);
 }
 
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  MODO DESCOMPRESIÓN: leer un .rle (contenedor indexado o formato legado)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static int decompress_file(const char *path) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RED = "\033[31m";
+    const char *RESET = "\033[0m";
+
+    g_current_phase = PHASE_DECOMPRESS;
+    RLEContainer rc;
+    if (rle_container_open(path, &rc) != 0) return 1;
+    track_syscall("fopen", "open", "Abrir archivo RLE para lectura");
+    track_syscall("fread", "read", "Leer archivo RLE completo");
+
+    uint32_t w = rc.header.width, h = rc.header.height;
+    size_t raw_size = (size_t)w * h * 3;
+    uint32_t bad = rle_container_verify(&rc);
+
+    uint8_t *decoded = malloc(raw_size ? raw_size : 1);
+    if (!decoded) { perror("malloc decompress"); rle_container_close(&rc); return 1; }
+    track_heap_alloc(decoded, raw_size, "Imagen decodificada");
+
+    struct timespec td_start, td_end;
+    clock_gettime(CLOCK_MONOTONIC, &td_start);
+
+    /*
+     * librle (backend secuencial) decodifica cada chunk directo en su banda de
+     * filas y, con RLE_FLAG_RAW_CRC (--verify checksum), compara la banda
+     * decodificada contra el raw_checksum de la tabla.
+     */
+    RLELibConfig cfg;
+    librle_config_default(&cfg);
+    cfg.bgr = g_decode_bgr;
+    RLELib lib;
+    librle_init(&lib, &cfg);
+    lib.kernel = g_scan;
+    int lrc = librle_decode_chunks(&lib, &rc.header, rc.chunks, rc.file_data, decoded, raw_size);
+    if (lrc != RLE_LIB_OK && lrc != RLE_LIB_ECORRUPT)
+        fprintf(stderr, "  librle: %s\n", librle_error(&lib));
+    size_t total_out = lib.stats.bytes;
+    uint32_t raw_bad = (rc.header.flags & RLE_FLAG_RAW_CRC) ? lib.stats.bad_chunks : 0;
+    librle_release(&lib);
+
+    clock_gettime(CLOCK_MONOTONIC, &td_end);
+    double decomp_time = (td_end.tv_sec - td_start.tv_sec) +
+                         (td_end.tv_nsec - td_start.tv_nsec) / 1e9;
+
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                    %s*** DESCOMPRESIÓN DE ARCHIVO .RLE ***%s                          %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s  %sArchivo:%s                  %s%-50s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, path, RESET, CYAN, RESET);
+    printf("%s║%s  %sFormato:%s                  %s%-50s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN,
+           rc.legacy ? "legado {width,height} + runs (sin índice)" : "contenedor RLEC v1 indexado",
+           RESET, CYAN, RESET);
+    printf("%s║%s  %sDimensiones:%s              %u x %u px, %u chunk(s)                               %s║%s\n",
+           CYAN, RESET, WHITE, RESET, w, h, rc.header.num_chunks, CYAN, RESET);
+    char mode_desc[64];
+    snprintf(mode_desc, sizeof(mode_desc), "%s (count %s)",
+             rle_mode_name(rc.header.mode), rle_count_name(rc.header.flags));
+    printf("%s║%s  %sModo de codificación:%s     %s%-50s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, mode_desc, RESET, CYAN, RESET);
+    for (uint32_t i = 0; i < rc.header.num_chunks && i < 8; i++) {
+        const RLEChunkEntry *e = &rc.chunks[i];
+        printf("%s║%s    chunk[%u]  filas %5u-%-5u  offset %10llu  %10llu B  crc32c 0x%08x        %s║%s\n",
+               CYAN, RESET, i, e->start_row, e->start_row + e->num_rows - 1,
+               (unsigned long long)e->offset, (unsigned long long)e->length,
+               e->checksum, CYAN, RESET);
+    }
+    printf("%s║%s  %sTiempo de descompresión:%s  %s%12.6f%s segundos                                     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, decomp_time, RESET, CYAN, RESET);
+    printf("%s║%s  %sChecksums:%s                %s%s%s                                                    %s║%s\n",
+           CYAN, RESET, WHITE, RESET, bad ? RED : GREEN,
+           bad ? "ERROR - chunks corruptos" : "CORRECTOS (CRC32C por chunk)", RESET, CYAN, RESET);
+    if (rc.header.flags & RLE_FLAG_RAW_CRC) {
+        char raw_desc[64];
+        if (raw_bad)
+            snprintf(raw_desc, sizeof(raw_desc), "ERROR - %u banda(s) distintas", raw_bad);
+        else
+            snprintf(raw_desc, sizeof(raw_desc), "CORRECTOS (CRC32C de cada banda)");
+        printf("%s║%s  %sCRC sin comprimir:%s        %s%-50s%s     %s║%s\n",
+               CYAN, RESET, WHITE, RESET, raw_bad ? RED : GREEN, raw_desc, RESET, CYAN, RESET);
+    }
+    printf("%s║%s  %sBytes decodificados:%s      %s%12zu%s de %zu                                    %s║%s\n",
+           CYAN, RESET, WHITE, RESET, total_out == raw_size ? GREEN : RED,
+           total_out, RESET, raw_size, CYAN, RESET);
+
+    char bmppath[512];
+    snprintf(bmppath, sizeof(bmppath), "%s_descomprimida.bmp", path);
+    if (librle_bmp_save(&g_lib, bmppath, decoded, w, h, g_decode_bgr) != RLE_LIB_OK)
+        fprintf(stderr, "  %s\n", librle_error(&g_lib));
+    printf("%s║%s  %sImagen descomprimida:%s     %s%-50s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, bmppath, RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+
+    track_heap_free(decoded);
+    free(decoded);
+    rle_container_close(&rc);
+    return (bad == 0 && raw_bad == 0 && total_out == raw_size) ? 0 : 1;
+}
+
+/*
+ * -d archivo.rle --rows Y0:Y1: decodifica solo las filas [Y0, Y1) con
+ * librle_file_decode_rows sobre el archivo mapeado. Solo se tocan (y se leen
+ * del disco) los chunks que se superponen con la ventana; el BMP lleva
+ * únicamente esas filas.
+ */
+static int decompress_rows(const char *path, uint32_t y0, uint32_t y1) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RED = "\033[31m";
+    const char *RESET = "\033[0m";
+
+    g_current_phase = PHASE_DECOMPRESS;
+    RLELibConfig cfg;
+    librle_config_default(&cfg);
+    cfg.bgr = g_decode_bgr;
+    RLELib lib;
+    librle_init(&lib, &cfg);
+    lib.kernel = g_scan;
+
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    RLELibFile f;
+    if (librle_file_open(&lib, &f, path) != RLE_LIB_OK) {
+        fprintf(stderr, "  %s\n", librle_error(&lib));
+        librle_release(&lib);
+        return 1;
+    }
+    track_syscall("open", "open", "Abrir archivo RLE para lectura");
+    track_syscall("mmap", "mmap", "Mapear el .rle (MADV_RANDOM: sin readahead)");
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    uint32_t w = f.header.width, h = f.header.height;
+    if (y1 > h || y0 >= y1) {
+        fprintf(stderr, "  --rows %u:%u fuera de la imagen (%u filas)\n", y0, y1, h);
+        librle_file_close(&f);
+        librle_release(&lib);
+        return 1;
+    }
+    size_t out_size = (size_t)(y1 - y0) * w * 3;
+    uint8_t *rows = malloc(out_size ? out_size : 1);
+    if (!rows) {
+        perror("malloc");
+        librle_file_close(&f);
+        librle_release(&lib);
+        return 1;
+    }
+    track_heap_alloc(rows, out_size, "Ventana decodificada");
+    int rc = librle_file_decode_rows(&lib, &f, y0, y1, rows, out_size);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    if (rc != RLE_LIB_OK && rc != RLE_LIB_ECORRUPT)
+        fprintf(stderr, "  librle: %s\n", librle_error(&lib));
+
+    /* Chunks de la ventana y los bytes comprimidos que se leyeron de ellos */
+    uint64_t rle_read = 0, rle_total = 0;
+    uint32_t first = UINT32_MAX, last = 0;
+    for (uint32_t i = 0; i < f.header.num_chunks; i++) {
+        const RLEChunkEntry *e = &f.chunks[i];
+        rle_total += e->length;
+        if (e->start_row < y1 && e->start_row + e->num_rows > y0) {
+            rle_read += e->length;
+            if (first == UINT32_MAX) first = i;
+            last = i;
+        }
+    }
+
+    double open_ms = (t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+    double decode_ms = (t2.tv_sec - t1.tv_sec) * 1000.0 + (t2.tv_nsec - t1.tv_nsec) / 1e6;
+
+    char bmppath[512], line[128];
+    snprintf(bmppath, sizeof(bmppath), "%s_filas_%u-%u.bmp", path, y0, y1 - 1);
+    if (librle_bmp_save(&g_lib, bmppath, rows, w, y1 - y0, g_decode_bgr) != RLE_LIB_OK)
+        fprintf(stderr, "  %s\n", librle_error(&g_lib));
+
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                      %s*** DECODIFICACIÓN POR FILAS (--rows) ***%s                       %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s  %sArchivo:%s                  %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, path, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "filas %u-%u de %u (%u x %u px)", y0, y1 - 1, h, w, y1 - y0);
+    printf("%s║%s  %sVentana:%s                  %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%u de %u (chunks %u-%u)", lib.stats.num_chunks,
+             f.header.num_chunks, first, last);
+    printf("%s║%s  %sChunks decodificados:%s     %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.2f KB de %.2f KB (%.1f%% del archivo)", rle_read / 1024.0,
+             rle_total / 1024.0, rle_total ? 100.0 * rle_read / rle_total : 0.0);
+    printf("%s║%s  %sRLE leído:%s                %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.3f ms (mmap + tabla)", open_ms);
+    printf("%s║%s  %sApertura:%s                 %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.3f ms, %d hilo(s)", decode_ms, lib.stats.threads_used);
+    printf("%s║%s  %sDecodificación:%s           %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    if (rc == RLE_LIB_OK)
+        snprintf(line, sizeof(line), "CORRECTA (%zu bytes)", lib.stats.bytes);
+    else
+        snprintf(line, sizeof(line), "ERROR - %s", librle_strerror(rc));
+    printf("%s║%s  %sResultado:%s                %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, rc == RLE_LIB_OK ? GREEN : RED, line, RESET, CYAN, RESET);
+    printf("%s║%s  %sImagen descomprimida:%s     %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, bmppath, RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+
+    track_heap_free(rows);
+    free(rows);
+    librle_file_close(&f);
+    librle_release(&lib);
+    return rc == RLE_LIB_OK ? 0 : 1;
+}
+
+/*
+ * --update imagen: en lugar de reescribir el .rle completo, compara cada
+ * banda de la imagen con el .rle existente y agrega al final solo los chunks
+ * de las que cambiaron (librle_update_file). Modo, flags y tiles son los del
+ * archivo, no los de la línea de comandos.
+ */
+static int update_file(const RLELibImage *img, const char *path) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RESET = "\033[0m";
+
+    g_current_phase = PHASE_COMPRESS;
+    RLELibConfig cfg;
+    librle_config_default(&cfg);
+    RLELib lib;
+    librle_init(&lib, &cfg);
+    lib.kernel = g_scan;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    RLELibUpdate up;
+    int rc = librle_update_file(&lib, path, img->data, img->width, img->height, &up);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (rc != RLE_LIB_OK) {
+        fprintf(stderr, "  librle: %s\n", librle_error(&lib));
+        librle_release(&lib);
+        return 1;
+    }
+    double elapsed_ms = (t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+    track_syscall("mmap", "mmap", "Mapear el .rle existente para comparar las bandas");
+    if (up.compacted) {
+        track_syscall("pwrite", "pwrite", "Escribir el .rle compactado en <archivo>.tmp");
+        track_syscall("fsync", "fsync", "Archivo compactado en disco antes del rename");
+        track_syscall("rename", "rename", "Reemplazar el .rle por la versión compactada");
+    } else if (up.written > 0) {
+        track_syscall("pwrite", "pwrite", "Agregar chunks cambiados y tabla nueva al final");
+        track_syscall("fsync", "fsync", "Chunks en disco antes de publicar el header nuevo");
+    }
+
+    char line[128];
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                    %s*** ACTUALIZACIÓN INCREMENTAL (--update) ***%s                      %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s  %sArchivo:%s                  %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, path, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%u de %u (%s)", up.changed, up.num_chunks,
+             up.by_crc ? "por CRC32C de la banda" : "decodificando el .rle");
+    printf("%s║%s  %sBandas cambiadas:%s         %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.2f KB %s (%.1f%% de reescribir todo)", up.written / 1024.0,
+             up.compacted ? "compactados" : "agregados",
+             up.live ? 100.0 * up.written / up.live : 0.0);
+    printf("%s║%s  %sEscrito:%s                  %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.3f ms, %d hilo(s)", elapsed_ms, lib.stats.threads_used);
+    printf("%s║%s  %sTiempo:%s                   %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    snprintf(line, sizeof(line), "%.2f KB (%.1f%% del archivo)", up.dead / 1024.0,
+             up.file_size ? 100.0 * up.dead / up.file_size : 0.0);
+    printf("%s║%s  %sEspacio muerto:%s           %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, line, RESET, CYAN, RESET);
+    printf("%s║%s  %sResultado:%s                %s%-53s%s     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN,
+           up.compacted ? "COMPACTADO (archivo reescrito sin espacio muerto)" :
+           up.changed ? "ACTUALIZADO (header nuevo publicado)" :
+           up.written ? "SIN CAMBIOS (raw_checksum agregados)" : "SIN CAMBIOS (archivo intacto)",
+           RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+
+    librle_release(&lib);
+    return 0;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  COMPRESIÓN POR STRIPS (--stream): memoria acotada, imagen > RAM
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/* Pico de RSS del proceso en bytes (ru_maxrss: KB en Linux, bytes en macOS) */
+static size_t get_peak_rss(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return (size_t)ru.ru_maxrss;
+#else
+    return (size_t)ru.ru_maxrss * 1024;
+#endif
+}
+
+/* Codifica un strip completo en out (capacidad rle_encoded_bound); devuelve los bytes y el codec */
+static size_t stream_encode_strip(const uint8_t *strip, size_t bytes, uint8_t *scratch,
+                                  uint8_t *out, uint32_t *codec) {
+    RLELibChunk c = { .band = strip, .bytes = bytes, .scratch = scratch, .dst = out, .codec = -1 };
+    librle_encode_chunk(&g_lib, &c);        /* con dst no falla */
+    g_total_runs += c.records;
+    *codec = c.entry.codec;
+    return c.entry.length;
+}
+
+/*
+ * Lee la entrada de a g_stream_rows filas, comprime cada strip apenas llega y
+ * lo agrega como chunk al .rle (rle_stream_*). Después verifica strip por
+ * strip: relee el chunk del archivo, comprueba el CRC, lo decodifica, lo
+ * compara con el strip original releído de la entrada y escribe sus filas en
+ * el BMP. En memoria solo hay un strip de entrada, uno comprimido y uno
+ * decodificado; --inflight N pide al kernel los N-1 strips siguientes por
+ * adelantado (page cache, no memoria del proceso).
+ */
+static int stream_compress(const char *path) {
+    const char *CYAN = "\033[36m";
+    const char *GREEN = "\033[32m";
+    const char *YELLOW = "\033[33m";
+    const char *WHITE = "\033[1;37m";
+    const char *RED = "\033[31m";
+    const char *RESET = "\033[0m";
+
+    RLEStripInput in;
+    int r = rle_strip_open(path, g_raw_width, g_raw_height, &in);
+    if (r > 0)
+        fprintf(stderr, "  --stream requiere entrada PPM P6 de 8 bits o RAW (--raw-size WxH): %s\n", path);
+    if (r != 0) return 1;
+    track_syscall("open", "open", "Abrir imagen para lectura por strips");
+
+    uint32_t w = in.width, h = in.height;
+    uint32_t strip_rows = g_stream_rows < h ? g_stream_rows : h;
+    uint32_t num_strips = rle_tile_count(h, strip_rows);
+    size_t strip_bytes = (size_t)strip_rows * w * 3;
+    size_t bound = rle_encoded_bound(g_rle_mode, strip_bytes);
+    size_t scratch_size = rle_encoder_scratch_size(g_rle_mode, strip_bytes);
+    size_t bmp_block = rle_bmp_block_size(w);
+    size_t raw_size = (size_t)w * h * 3;
+
+    RLEChunkEntry *chunks = calloc(num_strips, sizeof(RLEChunkEntry));
+    uint8_t *strip = malloc(strip_bytes);
+    uint8_t *packed = malloc(bound);
+    uint8_t *scratch = scratch_size ? malloc(scratch_size) : NULL;
+    uint8_t *row = malloc(bmp_block);              /* bloque de filas del BMP */
+    if (!chunks || !strip || !packed || (scratch_size && !scratch) || !row) {
+        perror("malloc");
+        free(chunks); free(strip); free(packed); free(scratch); free(row);
+        rle_strip_close(&in);
+        return 1;
+    }
+    track_heap_alloc(strip, strip_bytes, "Strip de entrada");
+    track_heap_alloc(packed, bound, "Strip comprimido");
+    for (uint32_t i = 0; i < num_strips; i++) {
+        rle_tile_range(h, strip_rows, i, &chunks[i].start_row, &chunks[i].num_rows);
+    }
+
+    char outpath[512], bmppath[512];
+    snprintf(outpath, sizeof(outpath), "%s_secuencial.rle", path);
+    snprintf(bmppath, sizeof(bmppath), "%s_secuencial_descomprimida.bmp", path);
+
+    /* ── Compresión ── */
+    g_current_phase = PHASE_COMPRESS;
+    printf("\n\033[33m  Compresión por strips: %u strips de %u filas (1 hilo)...\033[0m\n",
+           num_strips, strip_rows);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    int err = 0;
+    size_t payload = 0;
+    FILE *fout = fopen(outpath, "wb");
+    RLEStreamWriter wr;
+    if (!fout || rle_stream_begin(&wr, fout, chunks, num_strips) != 0) {
+        perror("fopen rle");
+        err = 1;
+    }
+    track_syscall("fopen", "open", "Crear archivo RLE de salida");
+    for (uint32_t i = 0; !err && i < num_strips; i++) {
+        const RLEChunkEntry *e = &chunks[i];
+        for (uint32_t k = i + 1; k < num_strips && k < i + (uint32_t)g_stream_inflight; k++)
+            rle_strip_readahead(&in, chunks[k].start_row, chunks[k].num_rows);
+        size_t bytes = (size_t)e->num_rows * w * 3;
+        if (rle_strip_read(&in, e->start_row, e->num_rows, strip) != 0) {
+            fprintf(stderr, "  Error leyendo filas %u-%u de '%s'\n",
+                    e->start_row, e->start_row + e->num_rows - 1, path);
+            err = 1;
+            break;
+        }
+        size_t len = stream_encode_strip(strip, bytes, scratch, packed, &chunks[i].codec);
+        chunks[i].raw_checksum = rle_raw_checksum(g_rle_flags, strip, bytes);
+        if (rle_stream_append(&wr, packed, len, rle_crc32c(0, packed, len)) != 0) {
+            fprintf(stderr, "  Error escribiendo '%s'\n", outpath);
+            err = 1;
+            break;
+        }
+        payload += len;
+    }
+    track_syscall("pread", "pread", "Leer un strip de filas de la entrada");
+    track_syscall("fwrite", "write", "Agregar chunk al archivo RLE");
+    if (!err && rle_stream_end(&wr, w, h, g_rle_mode, g_rle_flags) != 0) {
+        fprintf(stderr, "  Error escribiendo header de '%s'\n", outpath);
+        err = 1;
+    }
+    if (fout) fclose(fout);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    /* ── Verificación strip por strip ── */
+    g_current_phase = PHASE_DECOMPRESS;
+    uint32_t bad_crc = 0, bad_strips = 0;
+    double verify_time = 0;
+    int rfd = err ? -1 : open(outpath, O_RDONLY);
+    int bfd = err ? -1 : rle_bmp_create(bmppath, w, h);
+    if (!err && rfd < 0) perror(outpath);
+    if (!err && (rfd < 0 || bfd < 0)) err = 1;
+    if (!err) {
+        printf("\033[33m  Verificando strip por strip...\033[0m\n");
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+
+        /* packed = chunk releído del .rle, strip = original releído de la entrada */
+        uint8_t *decoded = malloc(strip_bytes);
+        if (!decoded) { perror("malloc"); err = 1; }
+        for (uint32_t i = 0; !err && i < num_strips; i++) {
+            const RLEChunkEntry *e = &chunks[i];
+            size_t bytes = (size_t)e->num_rows * w * 3;
+            if (e->length > bound || rle_pread_full(rfd, packed, e->length, e->offset) != 0 ||
+                rle_strip_read(&in, e->start_row, e->num_rows, strip) != 0) {
+                err = 1;
+                break;
+            }
+            if (rle_crc32c(0, packed, e->length) != e->checksum) bad_crc++;
+            size_t got = rle_decompress_into(g_rle_mode, g_rle_flags, e->codec, 0, packed,
+                                             e->length, decoded, bytes);
+            if (got != bytes || memcmp(decoded, strip, bytes) != 0) bad_strips++;
+            if (rle_bmp_write_rows(bfd, decoded, w, h, e->start_row, e->num_rows, 0, row) != 0)
+                err = 1;
+        }
+        free(decoded);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        verify_time = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        track_syscall("pwrite", "pwrite", "Escribir filas del BMP en su posición");
+    }
+    if (rfd >= 0) close(rfd);
+    if (bfd >= 0) close(bfd);
+
+    size_t strip_mem = strip_bytes * 2 + bound + scratch_size + bmp_block;
+    size_t peak = get_peak_rss();
+    size_t total = rle_container_size(num_strips, payload);
+    int ok = !err && bad_crc == 0 && bad_strips == 0;
+
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s                    %s*** COMPRESIÓN POR STRIPS (--stream) ***%s                          %s║%s\n", CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s  %sEntrada:%s                  %s%-50s%s        %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, path, RESET, CYAN, RESET);
+    printf("%s║%s  %sDimensiones:%s              %u x %u px (%.2f MB sin comprimir)                     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, w, h, raw_size / (1024.0 * 1024.0), CYAN, RESET);
+    printf("%s║%s  %sStrips:%s                   %u de %u filas (read-ahead de %d)                           %s║%s\n",
+           CYAN, RESET, WHITE, RESET, num_strips, strip_rows, g_stream_inflight, CYAN, RESET);
+    printf("%s║%s  %sBuffers de strip:%s         %s%10.2f KB%s (independiente del tamaño de la imagen)     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, strip_mem / 1024.0, RESET, CYAN, RESET);
+    printf("%s║%s  %sPico de RSS:%s              %s%10.2f MB%s                                             %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, peak / (1024.0 * 1024.0), RESET, CYAN, RESET);
+    printf("%s║%s  %sTiempo de compresión:%s     %s%12.6f%s segundos (lectura + RLE + escritura)         %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, elapsed, RESET, CYAN, RESET);
+    printf("%s║%s  %sTamaño comprimido:%s        %s%12zu%s bytes (ratio %.2f:1)                         %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, total, RESET,
+           total ? (double)raw_size / total : 0.0, CYAN, RESET);
+    printf("%s║%s  %sTiempo de verificación:%s   %s%12.6f%s segundos                                     %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, verify_time, RESET, CYAN, RESET);
+    printf("%s║%s  %sIntegridad:%s               %s%s%s                    %s║%s\n",
+           CYAN, RESET, WHITE, RESET, ok ? GREEN : RED,
+           ok ? "CORRECTA - Imagen idéntica al original" : "ERROR - Diferencias detectadas",
+           RESET, CYAN, RESET);
+    printf("%s║%s  %sArchivo comprimido:%s       %s%-50s%s        %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, outpath, RESET, CYAN, RESET);
+    printf("%s║%s  %sImagen descomprimida:%s     %s%-50s%s        %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, bmppath, RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
+
+    track_heap_free(strip);
+    track_heap_free(packed);
+    free(chunks); free(strip); free(packed); free(scratch); free(row);
+    rle_strip_close(&in);
+    return ok ? 0 : 1;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  CONTADORES DE HARDWARE (--perf)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static void print_perf_counters(const RLEPerfCounters *pc, size_t bytes) {
+    const char *CYAN = "\033[36m";
+    const char *YELLOW = "\033[1;33m";
+    const char *GREEN = "\033[32m";
+    const char *WHITE = "\033[1;37m";
+    const char *DIM = "\033[2m";
+    const char *RESET = "\033[0m";
+
+    double kb = bytes / 1024.0;
+    double ipc = rle_perf_ratio(pc, RLE_PERF_INSTRUCTIONS, RLE_PERF_CYCLES);
+    double br = rle_perf_ratio(pc, RLE_PERF_BRANCH_MISSES, RLE_PERF_BRANCHES);
+    double vals[5] = {
+        ipc,
+        br < 0 ? -1 : br * 100,
+        pc->valid[RLE_PERF_L1D_MISSES] && kb > 0 ? pc->value[RLE_PERF_L1D_MISSES] / kb : -1,
+        pc->valid[RLE_PERF_LLC_MISSES] && kb > 0 ? pc->value[RLE_PERF_LLC_MISSES] / kb : -1,
+        pc->valid[RLE_PERF_CYCLES] && pc->value[RLE_PERF_CYCLES] > 0
+            ? (double)bytes / pc->value[RLE_PERF_CYCLES] : -1
+    };
+    static const char *const labels[5] = {
+        "IPC (instrucciones / ciclo)", "Branch mispredicts (%)", "L1D read misses por KB",
+        "LLC misses por KB", "Bytes de entrada por ciclo"
+    };
+
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s     %sCONTADORES DE HARDWARE - COMPRESIÓN SECUENCIAL (perf_event_open, user)%s           %s║%s\n",
+           CYAN, RESET, YELLOW, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    for (int k = 0; k < 5; k++) {
+        if (vals[k] < 0)
+            printf("%s║%s  %s%-30s%s %s%14s%s                                       %s║%s\n",
+                   CYAN, RESET, WHITE, labels[k], RESET, DIM, "n/d", RESET, CYAN, RESET);
+        else
+            printf("%s║%s  %s%-30s%s %s%14.3f%s                                       %s║%s\n",
+                   CYAN, RESET, WHITE, labels[k], RESET, GREEN, vals[k], RESET, CYAN, RESET);
+    }
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    for (int ev = 0; ev < RLE_PERF_COUNT; ev++) {
+        char v[24];
+        if (pc->valid[ev]) snprintf(v, sizeof(v), "%20llu", (unsigned long long)pc->value[ev]);
+        else snprintf(v, sizeof(v), "%20s", "n/d");
+        printf("%s║%s    %s%-16s%s %s                                             %s║%s\n",
+               CYAN, RESET, DIM, rle_perf_name(ev), RESET, v, CYAN, RESET);
+    }
+    if (pc->error) {
+        char why[80];
+        snprintf(why, sizeof(why), "%s%s", rle_perf_any(pc) ? "algunos eventos no disponibles: "
+                                                            : "no disponibles: ",
+                 strerror(pc->error));
+        printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+        printf("%s║%s  %sn/d = %-62.62s%s                %s║%s\n", CYAN, RESET, DIM, why, RESET, CYAN, RESET);
+        printf("%s║%s  %s      (VM sin PMU, kernel.perf_event_paranoid > 2, o macOS sin kperf)%s               %s║%s\n",
+               CYAN, RESET, DIM, RESET, CYAN, RESET);
+    }
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n", CYAN, RESET);
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  PROFILER POR MUESTREO (--profile HZ)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+#define PROFILE_MAX_SYMBOLS 32
+
+/* Funciones del ejecutable que corre el hilo durante la compresión */
+static int profile_symbols(RLEProfSymbol *tab) {
+    int n = 0;
+#define PROF_SYM(f) tab[n++] = (RLEProfSymbol){ (uintptr_t)(f), #f }
+    PROF_SYM(main);
+    PROF_SYM(rle_compress);
+    PROF_SYM(rle_measure);
+    PROF_SYM(librle_encode_chunk);
+    PROF_SYM(librle_buffer_init);
+    PROF_SYM(librle_buffer_init_mapped);
+    PROF_SYM(librle_buffer_init_arena);
+    PROF_SYM(librle_buffer_push);
+    PROF_SYM(track_heap_alloc);
+    PROF_SYM(rle_encoder_init);
+    PROF_SYM(rle_encode_next);
+    PROF_SYM(rle_encode_some);
+    PROF_SYM(rle_encoder_measure);
+    PROF_SYM(rle_progress_publish);
+#undef PROF_SYM
+    tab[n++] = (RLEProfSymbol){ (uintptr_t)g_scan.fn, "rle_scan (bytes)" };
+    tab[n++] = (RLEProfSymbol){ (uintptr_t)g_scan.fn_px, "rle_scan (píxeles)" };
+    tab[n++] = (RLEProfSymbol){ (uintptr_t)rle_runs_encoder(&g_scan, g_rle_mode, g_rle_flags, NULL),
+                                "rle_runs (variante)" };
+    rle_prof_sort_symbols(tab, n);
+    return n;
+}
+
+static double prof_sample_ms(const struct timespec *t0, const RLEProfSample *s) {
+    uint64_t base = (uint64_t)t0->tv_sec * 1000000000ull + (uint64_t)t0->tv_nsec;
+    return ((double)s->t_ns - (double)base) / 1e6;
+}
+
+static void print_profile(void) {
+    const char *CYAN = "\033[36m";
+    const char *YELLOW = "\033[1;33m";
+    const char *GREEN = "\033[32m";
+    const char *MAGENTA = "\033[35m";
+    const char *WHITE = "\033[1;37m";
+    const char *DIM = "\033[2m";
+    const char *RESET = "\033[0m";
+
+    RLEProfSymbol tab[PROFILE_MAX_SYMBOLS];
+    int ntab = profile_symbols(tab);
+    RLEProfSummary sum;
+    rle_prof_summarize(g_prof, tab, ntab, &sum);
+
+    /* Todas las funciones vistas, de más a menos muestras */
+    const char *names[PROFILE_MAX_SYMBOLS + 2];
+    unsigned counts[PROFILE_MAX_SYMBOLS + 2];
+    int distinct = 0;
+    for (unsigned k = 0; k < sum.samples; k++) {
+        const char *name = rle_prof_symbolize(tab, ntab, rle_prof_at(g_prof, k)->pc);
+        int j = 0;
+        while (j < distinct && names[j] != name) j++;
+        if (j == distinct) { names[distinct] = name; counts[distinct++] = 0; }
+        counts[j]++;
+    }
+
+    printf("\n");
+    printf("%s╔══════════════════════════════════════════════════════════════════════════════════════╗%s\n", CYAN, RESET);
+    printf("%s║%s     %sPERFIL POR MUESTREO DEL PC (SIGPROF a %5d Hz de CPU) - SECUENCIAL%s              %s║%s\n",
+           CYAN, RESET, YELLOW, g_profile_hz, RESET, CYAN, RESET);
+    printf("%s╠══════════════════════════════════════════════════════════════════════════════════════╣%s\n", CYAN, RESET);
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    printf("%s║%s  %sMuestras:%s %s%8u%s   sobreescritas: %8u   cores: %3d   migraciones: %5u      %s║%s\n",
+           CYAN, RESET, WHITE, RESET, GREEN, sum.samples, RESET, sum.lost, sum.cores,
+           sum.migrations, CYAN, RESET);
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    for (int t = 0; t < distinct && t < 8; t++) {
+        int best = t;
+        for (int j = t + 1; j < distinct; j++)
+            if (counts[j] > counts[best]) best = j;
+        const char *nm = names[t]; names[t] = names[best]; names[best] = nm;
+        unsigned c = counts[t]; counts[t] = counts[best]; counts[best] = c;
+        double pct = 100.0 * counts[t] / sum.samples;
+        int bar = (int)(pct / 100.0 * 30 + 0.5);
+        printf("%s║%s    %-24s %s%8u%s  %5.1f%%  %s", CYAN, RESET, names[t], GREEN, counts[t],
+               RESET, pct, MAGENTA);
+        for (int b = 0; b < 30; b++) printf(b < bar ? "█" : " ");
+        printf("%s         %s║%s\n", RESET, CYAN, RESET);
+    }
+    if (sum.samples == 0)
+        printf("%s║%s    %s(sin muestras: la compresión duró menos que un período del timer)%s                %s║%s\n",
+               CYAN, RESET, DIM, RESET, CYAN, RESET);
+    printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+    printf("%s║%s  %sPC real del ucontext; función = símbolo registrado más cercano ≤ PC%s                 %s║%s\n",
+           CYAN, RESET, DIM, RESET, CYAN, RESET);
+    printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n", CYAN, RESET);
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  BENCHMARK REPRODUCIBLE (--bench): sin visualizaciones, salida JSON o CSV
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * --bench [--bench-iters K] [--bench-warmup W] [--bench-size WxH]
+ *         [--bench-csv] [--bench-out ARCHIVO] [foto ...]
+ *
+ * Mismas entradas y mismo documento que rle_paralelo --bench (rle_bench.h),
+ * con threads = 1: W + K compresiones con compress_image (según --alloc) y
+ * W + K descompresiones chunk por chunk sobre el último resultado.
+ */
+
+static double bench_elapsed(const struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static int bench_case(const RLELibImage *img, RLEBenchResult *r) {
+    uint32_t tile_rows = rle_tile_rows(img->width, img->height, g_tile_rows);
+    uint32_t num_chunks = rle_tile_count(img->height, tile_rows);
+    int total = g_bench_warmup + g_bench_iters;
+    r->threads = 1;
+    r->raw_bytes = (size_t)img->width * img->height * 3;
+
+    double *samples = malloc(g_bench_iters * sizeof(double));
+    RLEChunkEntry *chunks = calloc(num_chunks, sizeof(RLEChunkEntry));
+    uint8_t *decoded = malloc(r->raw_bytes ? r->raw_bytes : 1);
+    if (!samples || !chunks || !decoded) {
+        perror("malloc");
+        free(samples); free(chunks); free(decoded);
+        return -1;
+    }
+    for (uint32_t c = 0; c < num_chunks; c++)
+        rle_tile_range(img->height, tile_rows, c, &chunks[c].start_row, &chunks[c].num_rows);
+
+    RLELibBuffer compressed = {0};
+    Progress prog;
+    for (int it = 0; it < total; it++) {
+        rle_progress_reset(&prog.counters);
+        prog.total_pixels = (size_t)img->width * img->height;
+        atomic_init(&prog.done, 0);
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        compress_image(img, chunks, num_chunks, &compressed, &prog);
+        double t = bench_elapsed(&t0);
+        if (it >= g_bench_warmup) samples[it - g_bench_warmup] = t;
+        if (it + 1 < total) librle_buffer_free(&compressed);
+    }
+    size_t virt;
+    get_memory_info(&r->rss_bytes, &virt);
+    r->imbalance = 1;                   /* un solo hilo */
+    r->rle_bytes = rle_container_size(num_chunks, compressed.size);
+    rle_bench_stats(samples, g_bench_iters, &r->compress);
+
+    /* Descompresión con librle: offsets relativos al payload comprimido */
+    RLEFileHeader hdr;
+    rle_header_init(&hdr, img->width, img->height, g_rle_mode, g_rle_flags, num_chunks);
+    size_t off = 0;
+    for (uint32_t c = 0; c < num_chunks; c++) {
+        chunks[c].offset = off;
+        off += chunks[c].length;
+    }
+    RLELibConfig cfg;
+    librle_config_default(&cfg);
+    RLELib lib;
+    librle_init(&lib, &cfg);
+    lib.kernel = g_scan;
+    int lrc = RLE_LIB_OK;
+    for (int it = 0; it < total; it++) {
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int rc = librle_decode_chunks(&lib, &hdr, chunks, compressed.data, decoded, r->raw_bytes);
+        if (rc != RLE_LIB_OK) lrc = rc;
+        double t = bench_elapsed(&t0);
+        if (it >= g_bench_warmup) samples[it - g_bench_warmup] = t;
+    }
+    librle_release(&lib);
+    /* --verify checksum: librle también compara cada banda con su raw_checksum */
+    r->verified = lrc == RLE_LIB_OK && memcmp(decoded, img->data, r->raw_bytes) == 0;
+    rle_bench_stats(samples, g_bench_iters, &r->decompress);
+
+    librle_buffer_free(&compressed);
+    free(samples);
+    free(chunks);
+    free(decoded);
+    /* ru_maxrss y statm se muestrean distinto: el pico nunca por debajo de la última RSS */
+    r->peak_rss_bytes = get_peak_rss();
+    if (r->peak_rss_bytes < r->rss_bytes) r->peak_rss_bytes = r->rss_bytes;
+    return 0;
+}
+
+static int run_bench(const char *const *photos, int num_photos,
+                     const RLESynthParams *synth, int num_synth) {
+    /* flat, gradient y noise; después las SPEC del generador; después las fotos */
+    int num_fixed = RLE_BENCH_SYNTH, num_inputs = num_fixed + num_synth + num_photos;
+    char synth_names[RLE_BENCH_MAX_SYNTH][160];
+    RLEBenchResult *res = calloc(num_inputs, sizeof(RLEBenchResult));
+    if (!res) { perror("calloc"); return 1; }
+    int num_res = 0, failed = 0;
+
+    for (int k = 0; k < num_inputs; k++) {
+        int cls = k < num_fixed ? k : k < num_fixed + num_synth ? RLE_BENCH_SYNTH : RLE_BENCH_PHOTO;
+        const RLESynthParams *sp = cls == RLE_BENCH_SYNTH ? &synth[k - num_fixed] : NULL;
+        const char *name = rle_bench_class_name(cls);
+        if (sp) {
+            rle_synth_describe(sp, synth_names[k - num_fixed], sizeof(synth_names[0]));
+            name = synth_names[k - num_fixed];
+        } else if (cls == RLE_BENCH_PHOTO) {
+            name = photos[k - num_fixed - num_synth];
+        }
+        RLELibImage img = {0};
+        if (cls == RLE_BENCH_PHOTO) {
+            if (librle_image_load(&g_lib, &img, name, g_raw_width, g_raw_height) != RLE_LIB_OK) {
+                fprintf(stderr, "  [bench] %s, se omite\n", librle_error(&g_lib));
+                failed = 1;
+                continue;
+            }
+        } else if (sp) {
+            img.width = sp->width;
+            img.height = sp->height;
+            img.data = rle_synth_generate(sp);
+            if (!img.data) { perror("malloc"); failed = 1; continue; }
+        } else {
+            img.width = g_bench_width;
+            img.height = g_bench_height;
+            img.data = malloc((size_t)img.width * img.height * 3);
+            if (!img.data) { perror("malloc"); failed = 1; continue; }
+            rle_bench_fill(img.data, img.width, img.height, cls);
+        }
+
+        RLEBenchResult *r = &res[num_res];
+        r->input = name;
+        r->cls = cls;
+        r->width = img.width;
+        r->height = img.height;
+        if (bench_case(&img, r) == 0) {
+            num_res++;
+            if (!r->verified) failed = 1;
+            fprintf(stderr, "  [bench] %-32.32s %5ux%-5u %3d hilos  RLE %9.1f MB/s  "
+                    "descompr. %9.1f MB/s  %7.2f:1  desbalance %.2f%s\n",
+                    name, img.width, img.height, r->threads,
+                    rle_bench_mbps(r->raw_bytes, r->compress.median),
+                    rle_bench_mbps(r->raw_bytes, r->decompress.median),
+                    r->rle_bytes ? (double)r->raw_bytes / r->rle_bytes : 0.0, r->imbalance,
+                    r->verified ? "" : "  ERROR: round-trip distinto");
+        } else {
+            failed = 1;
+        }
+
+        librle_image_free(&img);
+    }
+
+    FILE *out = g_bench_out ? fopen(g_bench_out, "w") : stdout;
+    if (!out) {
+        perror(g_bench_out);
+        free(res);
+        return 1;
+    }
+    char variant[96];
+    rle_variant_name(variant, sizeof(variant), &g_scan, g_rle_mode, g_rle_flags);
+    RLEBenchConfig cfg = { "rle_secuencial", rle_mode_name(g_rle_mode), rle_count_name(g_rle_flags),
+                           g_scan.name, variant, g_alloc_names[g_alloc_mode], g_tile_rows,
+                           g_bench_warmup, g_bench_iters };
+    if (g_bench_csv) rle_bench_csv(out, &cfg, res, num_res);
+    else rle_bench_json(out, &cfg, res, num_res);
+    if (out != stdout && fclose(out) != 0) {
+        perror(g_bench_out);
+        failed = 1;
+    }
+    free(res);
+    return failed ? 1 : 0;
+}
+
 /* ═══════════════════════════════════════════════════════════════════════════
  *  FUNCIÓN PRINCIPAL
  * ═══════════════════════════════════════════════════════════════════════════ */
@@ -1074,20 +2124,193 @@ int main(int argc, char *argv[]) {
     g_current_phase = PHASE_INIT;
 
     /* Variables en STACK */
-    Image img;
-    Buffer compressed;
+    RLELibImage img = {0};
+    RLELibBuffer compressed;
     Progress prog;
     int stack_marker_top = 0;    /* Para medir tope de pila */
-    int used_stb = 0;            /* Flag para saber si liberar con stbi_image_free */
     char input_path[512] = {0};
 
+    /*
+     * Opciones: ./rle_secuencial [--scalar] [--mode byte|pixel|planar] [--varint] [--adaptive]
+     *           [--alloc grow|bound|exact|arena] [--raw-size WxH] [--no-raw]
+     *           [--tile ROWS] [--stream ROWS [--inflight N]] [--profile HZ] [--perf]
+     *           [--bench [--bench-iters K] [--bench-warmup W] [--bench-size WxH]
+     *                    [--bench-csv] [--bench-out ARCHIVO] [--bench-synth SPEC ...] [foto ...]]
+     *           [--synth SPEC] [--verify decode|stream|checksum] [--decode-bgr]
+     *           [-d archivo.rle [--rows Y0:Y1] | [--update] imagen]
+     */
+    const char *arg_input = NULL;
+    const char *bench_photos[RLE_BENCH_MAX_INPUTS];
+    int num_bench_photos = 0;
+    RLESynthParams bench_synth[RLE_BENCH_MAX_SYNTH];
+    int num_bench_synth = 0;
+    const char *arg_decompress = NULL;
+    int arg_scalar = 0;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--scalar") == 0) {
+            arg_scalar = 1;
+        } else if (strcmp(argv[a], "--mode") == 0 && a + 1 < argc) {
+            int m = rle_mode_parse(argv[++a]);
+            if (m < 0) {
+                fprintf(stderr, "Modo desconocido: %s (byte, pixel o planar)\n", argv[a]);
+                return 1;
+            }
+            g_rle_mode = (uint8_t)m;
+        } else if (strcmp(argv[a], "--varint") == 0) {
+            g_rle_flags |= RLE_FLAG_VARINT;
+        } else if (strcmp(argv[a], "--adaptive") == 0) {
+            g_rle_flags |= RLE_FLAG_CODEC;
+        } else if (strcmp(argv[a], "--raw-size") == 0 && a + 1 < argc) {
+            if (sscanf(argv[++a], "%ux%u", &g_raw_width, &g_raw_height) != 2 ||
+                g_raw_width == 0 || g_raw_height == 0) {
+                fprintf(stderr, "Tamaño RAW inválido: %s (formato WxH)\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--no-raw") == 0) {
+            g_write_raw = 0;
+        } else if (strcmp(argv[a], "--tile") == 0 && a + 1 < argc) {
+            int rows = atoi(argv[++a]);
+            if (rows <= 0) {
+                fprintf(stderr, "Filas por tile inválidas: %s\n", argv[a]);
+                return 1;
+            }
+            g_tile_rows = (uint32_t)rows;
+        } else if (strcmp(argv[a], "--stream") == 0 && a + 1 < argc) {
+            int rows = atoi(argv[++a]);
+            if (rows <= 0) {
+                fprintf(stderr, "Filas por strip inválidas: %s\n", argv[a]);
+                return 1;
+            }
+            g_stream_rows = (uint32_t)rows;
+        } else if (strcmp(argv[a], "--inflight") == 0 && a + 1 < argc) {
+            g_stream_inflight = atoi(argv[++a]);
+            if (g_stream_inflight <= 0) {
+                fprintf(stderr, "Strips en vuelo inválidos: %s\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--alloc") == 0 && a + 1 < argc) {
+            int m = -1;
+            for (int k = 0; k < ALLOC_COUNT; k++)
+                if (strcmp(argv[a + 1], g_alloc_names[k]) == 0) m = k;
+            if (m < 0) {
+                fprintf(stderr, "Reserva desconocida: %s (grow, bound, exact o arena)\n", argv[a + 1]);
+                return 1;
+            }
+            g_alloc_mode = (AllocMode)m;
+            a++;
+        } else if (strcmp(argv[a], "--perf") == 0) {
+            g_perf = 1;
+        } else if (strcmp(argv[a], "--profile") == 0 && a + 1 < argc) {
+            g_profile_hz = atoi(argv[++a]);
+            if (g_profile_hz <= 0 || g_profile_hz > RLE_PROF_MAX_HZ) {
+                fprintf(stderr, "Frecuencia de muestreo inválida: %s (1-%d Hz)\n", argv[a],
+                        RLE_PROF_MAX_HZ);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--bench") == 0) {
+            g_bench = 1;
+        } else if (strcmp(argv[a], "--bench-iters") == 0 && a + 1 < argc) {
+            g_bench_iters = atoi(argv[++a]);
+            if (g_bench_iters <= 0 || g_bench_iters > RLE_BENCH_MAX_ITERS) {
+                fprintf(stderr, "Iteraciones inválidas: %s (1-%d)\n", argv[a], RLE_BENCH_MAX_ITERS);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--bench-warmup") == 0 && a + 1 < argc) {
+            g_bench_warmup = atoi(argv[++a]);
+            if (g_bench_warmup < 0 || g_bench_warmup > RLE_BENCH_MAX_ITERS) {
+                fprintf(stderr, "Calentamiento inválido: %s (0-%d)\n", argv[a], RLE_BENCH_MAX_ITERS);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--bench-size") == 0 && a + 1 < argc) {
+            if (sscanf(argv[++a], "%ux%u", &g_bench_width, &g_bench_height) != 2 ||
+                g_bench_width == 0 || g_bench_height == 0) {
+                fprintf(stderr, "Tamaño sintético inválido: %s (formato WxH)\n", argv[a]);
+                return 1;
+            }
+        } else if (strcmp(argv[a], "--bench-csv") == 0) {
+            g_bench_csv = 1;
+        } else if (strcmp(argv[a], "--bench-out") == 0 && a + 1 < argc) {
+            g_bench_out = argv[++a];
+        } else if (strcmp(argv[a], "--bench-synth") == 0 && a + 1 < argc) {
+            if (num_bench_synth == RLE_BENCH_MAX_SYNTH) {
+                fprintf(stderr, "Demasiadas --bench-synth (máximo %d)\n", RLE_BENCH_MAX_SYNTH);
+                return 1;
+            }
+            if (rle_synth_parse(argv[++a], &bench_synth[num_bench_synth++]) != 0)
+                return 1;
+        } else if (strcmp(argv[a], "--synth") == 0 && a + 1 < argc) {
+            if (rle_synth_parse(argv[++a], &g_synth) != 0)
+                return 1;
+            g_use_synth = 1;
+        } else if (strcmp(argv[a], "--decode-bgr") == 0) {
+            g_decode_bgr = 1;
+        } else if (strcmp(argv[a], "--rows") == 0 && a + 1 < argc) {
+            if (sscanf(argv[++a], "%u:%u", &g_rows_y0, &g_rows_y1) != 2 || g_rows_y0 >= g_rows_y1) {
+                fprintf(stderr, "Filas inválidas: %s (formato Y0:Y1, Y1 excluida)\n", argv[a]);
+                return 1;
+            }
+            g_rows = 1;
+        } else if (strcmp(argv[a], "--update") == 0) {
+            g_update = 1;
+        } else if (strcmp(argv[a], "--verify") == 0 && a + 1 < argc) {
+            g_verify = rle_verify_parse(argv[++a]);
+            if (g_verify < 0) {
+                fprintf(stderr, "Verificación desconocida: %s (decode, stream o checksum)\n", argv[a]);
+                return 1;
+            }
+            if (g_verify == RLE_VERIFY_CHECKSUM)
+                g_rle_flags |= RLE_FLAG_RAW_CRC;
+        } else if (strcmp(argv[a], "-d") == 0 && a + 1 < argc) {
+            arg_decompress = argv[++a];
+        } else if (argv[a][0] == '-' && argv[a][1] == '-') {
+            fprintf(stderr, "Opción desconocida: %s\n", argv[a]);
+            return 1;
+        } else {
+            if (!arg_input) arg_input = argv[a];
+            if (num_bench_photos < RLE_BENCH_MAX_INPUTS) bench_photos[num_bench_photos++] = argv[a];
+        }
+    }
+    g_scan = rle_scan_select(arg_scalar);
+    lib_init();
+    if (g_profile_hz) {
+        g_prof = rle_cacheline_calloc(1, sizeof(RLEProfRing));
+        if (!g_prof) { perror("malloc"); return 1; }
+        if (rle_prof_install(g_profile_hz) != 0) return 1;
+    }
+
+    /* Benchmark: ./rle_secuencial --bench [foto ...] > bench.json */
+    if (g_bench)
+        return run_bench(bench_photos, num_bench_photos, bench_synth, num_bench_synth);
+
+    /* Modo descompresión: ./rle_secuencial -d archivo.rle */
+    if (arg_decompress)
+        return g_rows ? decompress_rows(arg_decompress, g_rows_y0, g_rows_y1)
+                      : decompress_file(arg_decompress);
+
+    /* Modo streaming: ./rle_secuencial --stream ROWS imagen.ppm */
+    if (g_stream_rows > 0) {
+        if (!arg_input) {
+            fprintf(stderr, "--stream requiere un archivo de entrada\n");
+            return 1;
+        }
+        return stream_compress(arg_input);
+    }
+
     /* Cargar imagen: argumento, menú interactivo, o sintética */
-    if (argc >= 2) {
-        strncpy(input_path, argv[1], sizeof(input_path) - 1);
-        if (load_image(input_path, &img) != 0) {
+    if (arg_input) {
+        strncpy(input_path, arg_input, sizeof(input_path) - 1);
+        if (open_image(input_path, &img) != 0) {
             return 1;
         }
-        used_stb = 1;
+    } else if (g_use_synth) {
+        char spec[160];
+        rle_synth_describe(&g_synth, spec, sizeof(spec));
+        printf("  \033[33mGenerando imagen sintética %s...\033[0m\n", spec);
+        img.width = g_synth.width;
+        img.height = g_synth.height;
+        img.data = rle_synth_generate(&g_synth);
+        if (!img.data) { perror("malloc"); return 1; }
+        track_heap_alloc(img.data, (size_t)img.width * img.height * 3, "Imagen sintética (--synth)");
     } else {
         /* Escanear carpeta image/ y listar imágenes disponibles */
         const char *img_dir = "image";
@@ -1107,8 +2330,7 @@ int main(int argc, char *argv[]) {
                     strcasecmp(ext, ".bmp") == 0 || strcasecmp(ext, ".gif") == 0 ||
                     strcasecmp(ext, ".tga") == 0 || strcasecmp(ext, ".psd") == 0 ||
                     strcasecmp(ext, ".hdr") == 0 || strcasecmp(ext3, ".jpeg") == 0) {
-                    strncpy(files[nfiles], name, 255);
-                    files[nfiles][255] = '\0';
+                    snprintf(files[nfiles], sizeof(files[nfiles]), "%s", name);
                     nfiles++;
                 }
             }
@@ -1171,11 +2393,9 @@ int main(int argc, char *argv[]) {
                 if (ret != 0 || input_path[0] == '\0') {
                     printf("  \033[33mNo se seleccionó archivo. Usando imagen sintética...\033[0m\n");
                     generate_synthetic(&img, 4096, 4096);
-                } else if (load_image(input_path, &img) != 0) {
+                } else if (open_image(input_path, &img) != 0) {
                     printf("  \033[33mUsando imagen sintética como respaldo...\033[0m\n");
                     generate_synthetic(&img, 4096, 4096);
-                } else {
-                    used_stb = 1;
                 }
             } else {
                 printf("  \033[33mNo se pudo abrir el explorador. Usando imagen sintética...\033[0m\n");
@@ -1183,11 +2403,9 @@ int main(int argc, char *argv[]) {
             }
         } else if (sel >= 1 && sel <= nfiles) {
             snprintf(input_path, sizeof(input_path), "%s/%s", img_dir, files[sel - 1]);
-            if (load_image(input_path, &img) != 0) {
+            if (open_image(input_path, &img) != 0) {
                 printf("  \033[33mUsando imagen sintética como respaldo...\033[0m\n");
                 generate_synthetic(&img, 4096, 4096);
-            } else {
-                used_stb = 1;
             }
         } else {
             printf("  \033[33mGenerando imagen sintética 4096x4096...\033[0m\n");
@@ -1195,6 +2413,18 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    /* --update con un .rle previo: solo las bandas cambiadas; si no existe, compresión completa */
+    if (g_update && input_path[0]) {
+        char update_path[600];
+        snprintf(update_path, sizeof(update_path), "%s_secuencial.rle", input_path);
+        if (access(update_path, F_OK) == 0) {
+            int r = update_file(&img, update_path);
+            librle_image_free(&img);
+            return r;
+        }
+        printf("  \033[33m--update: %s no existe, compresión completa\033[0m\n", update_path);
+    }
+
     size_t total_pixels = (size_t)img.width * img.height;
     size_t raw_size = total_pixels * 3;
 
@@ -1205,19 +2435,15 @@ int main(int argc, char *argv[]) {
     else
         snprintf(rawpath, sizeof(rawpath), "output.raw");
 
-    FILE *fraw = fopen(rawpath, "wb");
+    FILE *fraw = g_write_raw ? fopen(rawpath, "wb") : NULL;
     if (fraw) {
         fwrite(img.data, 1, raw_size, fraw);
         fclose(fraw);
         printf("  \033[32mArchivo RAW guardado:\033[0m %s (%.2f KB)\n", rawpath, raw_size / 1024.0);
     }
 
-    /* Inicializar buffer (asigna en HEAP) */
-    buffer_init(&compressed, raw_size / 2);
-
     /* Inicializar progreso */
-    atomic_init(&prog.pixels_processed, 0);
-    atomic_init(&prog.compressed_bytes, 0);
+    rle_progress_reset(&prog.counters);
     prog.total_pixels = total_pixels;
     atomic_init(&prog.done, 0);
 
@@ -1232,11 +2458,32 @@ int main(int argc, char *argv[]) {
     /* Medir tiempo */
     struct timespec t_start, t_end;
     clock_gettime(CLOCK_MONOTONIC, &t_start);
-    g_t0_compress = t_start;  /* Tiempo base para muestreo del PC */
+    g_t0_compress = t_start;  /* Tiempo base de las marcas y muestras del PC */
     g_num_pc_samples = 0;
-
-    /* COMPRESIÓN */
-    rle_compress(img.data, raw_size, &compressed, &prog);
+    if (g_prof)
+        rle_prof_thread_start(g_prof, &prog.counters);
+    if (g_perf)
+        rle_perf_start(&g_perf_counters);
+
+    /*
+     * COMPRESIÓN por tiles: mismo corte en tiles de filas que rle_paralelo
+     * (rle_tile_rows, 1 tile = 1 chunk independiente del contenedor) para que
+     * ambos archivos .rle resulten idénticos. Aquí los tiles se procesan uno
+     * tras otro en el único hilo.
+     */
+    uint32_t tile_rows = rle_tile_rows(img.width, img.height, g_tile_rows);
+    uint32_t num_chunks = rle_tile_count(img.height, tile_rows);
+    RLEChunkEntry *chunks = calloc(num_chunks, sizeof(RLEChunkEntry));
+    if (!chunks) { perror("calloc"); return 1; }
+
+    for (uint32_t c = 0; c < num_chunks; c++)
+        rle_tile_range(img.height, tile_rows, c, &chunks[c].start_row, &chunks[c].num_rows);
+
+    compress_image(&img, chunks, num_chunks, &compressed, &prog);
+    if (g_perf)
+        rle_perf_stop(&g_perf_counters);
+    if (g_prof)
+        rle_prof_thread_stop(g_prof);
 
     clock_gettime(CLOCK_MONOTONIC, &t_end);
     double elapsed = (t_end.tv_sec - t_start.tv_sec) +
@@ -1247,7 +2494,12 @@ int main(int argc, char *argv[]) {
     get_process_cpu_times(&user_t, &sys_t);
 
     /* Mostrar resultados */
-    print_execution_results(elapsed, user_t, sys_t, compressed.size + 8, raw_size);
+    print_execution_results(elapsed, user_t, sys_t,
+                            rle_container_size(num_chunks, compressed.size), raw_size);
+    if (g_prof)
+        print_profile();
+    if (g_perf)
+        print_perf_counters(&g_perf_counters, raw_size);
 
     /* Mostrar variables globales */
     print_global_variables();
@@ -1262,31 +2514,81 @@ int main(int argc, char *argv[]) {
 
     FILE *fout = fopen(outpath, "wb");
     if (fout) {
-        uint32_t header[2] = { img.width, img.height };
-        fwrite(header, sizeof(uint32_t), 2, fout);
-        fwrite(compressed.data, 1, compressed.size, fout);
+        /* Los chunks son tramos consecutivos del único buffer de salida */
+        const uint8_t **chunk_data = malloc(num_chunks * sizeof(*chunk_data));
+        if (!chunk_data) { perror("malloc"); return 1; }
+        size_t off = 0;
+        for (uint32_t c = 0; c < num_chunks; c++) {
+            chunk_data[c] = compressed.data + off;
+            off += chunks[c].length;
+        }
+        int wr;
+        if (g_alloc_mode == ALLOC_ARENA) {
+            /* Arena: header y tabla van delante de los datos, un solo fwrite */
+            size_t total = rle_container_size(num_chunks, compressed.size);
+            rle_container_finish(compressed.block, img.width, img.height, g_rle_mode,
+                                 g_rle_flags, chunks, chunk_data, num_chunks);
+            wr = fwrite(compressed.block, 1, total, fout) == total ? 0 : -1;
+        } else {
+            wr = rle_container_write(fout, img.width, img.height, g_rle_mode, g_rle_flags,
+                                     chunks, chunk_data, num_chunks);
+        }
+        free(chunk_data);
         fclose(fout);
-        printf("\n  \033[32mArchivo comprimido guardado:\033[0m %s\n", outpath);
+        if (wr == 0)
+            printf("\n  \033[32mArchivo comprimido guardado:\033[0m %s (%u chunks indexados)\n",
+                   outpath, num_chunks);
+        else
+            fprintf(stderr, "  Error escribiendo '%s'\n", outpath);
     }
 
     /* ═══════════════════════════════════════════════════════════════════
      *  DESCOMPRESIÓN Y GENERACIÓN DE IMAGEN BMP
      * ═══════════════════════════════════════════════════════════════════ */
     g_current_phase = PHASE_DECOMPRESS;
-    printf("\n\033[33m  Descomprimiendo datos RLE...\033[0m\n");
-
-    struct timespec td_start, td_end;
-    clock_gettime(CLOCK_MONOTONIC, &td_start);
-
-    uint8_t *decoded = rle_decompress(compressed.data, compressed.size, raw_size);
 
-    clock_gettime(CLOCK_MONOTONIC, &td_end);
-    double decomp_time = (td_end.tv_sec - td_start.tv_sec) +
-                         (td_end.tv_nsec - td_start.tv_nsec) / 1e9;
+    /*
+     * decode: imagen completa (para el BMP) y comparación banda por banda;
+     * stream: runs contra la original sin reservar la imagen; checksum: los
+     * raw_checksum ya están en la tabla, no se decodifica nada.
+     */
+    uint8_t *decoded = NULL;
+    uint32_t bad_chunk = UINT32_MAX;
+    size_t bad_offset = 0, verified = 0;
+    double decomp_time = -1;
+    if (g_verify != RLE_VERIFY_CHECKSUM) {
+        printf(g_verify == RLE_VERIFY_STREAM ? "\n\033[33m  Verificando runs contra el original...\033[0m\n"
+                                             : "\n\033[33m  Descomprimiendo datos RLE...\033[0m\n");
+        struct timespec td_start, td_end;
+        clock_gettime(CLOCK_MONOTONIC, &td_start);
+        if (g_verify == RLE_VERIFY_STREAM) {
+            verified = rle_verify_stream(compressed.data, chunks, num_chunks, img.width, img.data,
+                                         &bad_chunk, &bad_offset);
+        } else if ((decoded = rle_decompress(compressed.data, chunks, num_chunks, img.width,
+                                             raw_size)) != NULL) {
+            for (uint32_t c = 0; c < num_chunks && bad_chunk == UINT32_MAX; c++) {
+                size_t band_off = (size_t)chunks[c].start_row * img.width * 3;
+                size_t band_size = (size_t)chunks[c].num_rows * img.width * 3;
+                size_t diff = g_decode_bgr
+                    ? rle_bgr_first_diff(decoded + band_off, img.data + band_off, band_size)
+                    : memcmp(decoded + band_off, img.data + band_off, band_size) == 0 ? band_size
+                    : rle_first_diff(decoded + band_off, img.data + band_off, band_size);
+                if (diff < band_size) {
+                    bad_chunk = c;
+                    bad_offset = diff;
+                } else {
+                    verified += band_size;
+                }
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &td_end);
+        if (decoded || g_verify == RLE_VERIFY_STREAM)
+            decomp_time = (td_end.tv_sec - td_start.tv_sec) +
+                          (td_end.tv_nsec - td_start.tv_nsec) / 1e9;
+    }
 
-    if (decoded) {
-        /* Verificar integridad: comparar con imagen original */
-        int match = (memcmp(decoded, img.data, raw_size) == 0);
+    if (decomp_time >= 0) {
+        int match = bad_chunk == UINT32_MAX && verified == raw_size;
 
         /* Guardar como BMP */
         char bmppath[512];
@@ -1294,8 +2596,21 @@ int main(int argc, char *argv[]) {
             snprintf(bmppath, sizeof(bmppath), "%s_secuencial_descomprimida.bmp", input_path);
         else
             snprintf(bmppath, sizeof(bmppath), "output_secuencial_descomprimida.bmp");
-
-        save_bmp(bmppath, decoded, img.width, img.height);
+        if (decoded && librle_bmp_save(&g_lib, bmppath, decoded, img.width, img.height,
+                                       g_decode_bgr) != RLE_LIB_OK)
+            fprintf(stderr, "  %s\n", librle_error(&g_lib));
+
+        char verdict[96];
+        if (match) {
+            snprintf(verdict, sizeof(verdict), "CORRECTA - Imagen idéntica al original");
+        } else if (bad_chunk != UINT32_MAX) {
+            size_t row_bytes = (size_t)img.width * 3;
+            snprintf(verdict, sizeof(verdict), "ERROR - chunk %u, fila %zu, byte %zu", bad_chunk,
+                     chunks[bad_chunk].start_row + bad_offset / row_bytes, bad_offset % row_bytes);
+        } else {
+            snprintf(verdict, sizeof(verdict), "ERROR - %zu de %zu bytes decodificados",
+                     verified, raw_size);
+        }
 
         const char *CYAN = "\033[36m";
         const char *GREEN = "\033[32m";
@@ -1313,24 +2628,34 @@ int main(int argc, char *argv[]) {
                CYAN, RESET, WHITE, RESET, GREEN, decomp_time, RESET, CYAN, RESET);
         printf("%s║%s  %sPíxeles decodificados:%s    %s%12zu%s                                              %s║%s\n",
                CYAN, RESET, WHITE, RESET, GREEN, total_pixels, RESET, CYAN, RESET);
-        printf("%s║%s  %sBytes decodificados:%s      %s%12zu%s (%.2f MB)                                    %s║%s\n",
-               CYAN, RESET, WHITE, RESET, GREEN, raw_size, RESET, raw_size / (1024.0 * 1024.0), CYAN, RESET);
-        printf("%s║%s  %sIntegridad:%s               %s%s%s                                                    %s║%s\n",
-               CYAN, RESET, WHITE, RESET,
-               match ? GREEN : RED,
-               match ? "CORRECTA - Imagen idéntica al original" : "ERROR - Diferencias detectadas",
+        printf("%s║%s  %s%-26s%s%s%12zu%s (%.2f MB)                                    %s║%s\n",
+               CYAN, RESET, WHITE, decoded ? "Bytes decodificados:" : "Bytes verificados:", RESET,
+               GREEN, verified, RESET, verified / (1024.0 * 1024.0), CYAN, RESET);
+        printf("%s║%s  %sVerificación:%s             %s%-53s%s     %s║%s\n",
+               CYAN, RESET, WHITE, RESET, GREEN,
+               decoded ? "decode (decodificar y comparar banda por banda)"
+                       : "stream (runs contra el original, sin buffer)",
+               RESET, CYAN, RESET);
+        /* "é" de "idéntica" ocupa 2 bytes: ancho 53 + 1 */
+        printf("%s║%s  %sIntegridad:%s               %s%-*s%s     %s║%s\n",
+               CYAN, RESET, WHITE, RESET, match ? GREEN : RED, match ? 54 : 53, verdict,
                RESET, CYAN, RESET);
         printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
-        printf("%s║%s  %sImagen descomprimida:%s     %s%-50s%s     %s║%s\n",
-               CYAN, RESET, WHITE, RESET, GREEN, bmppath, RESET, CYAN, RESET);
-        printf("%s║%s  %sFormato:%s                  BMP (24-bit RGB, sin compresión)                       %s║%s\n",
-               CYAN, RESET, WHITE, RESET, CYAN, RESET);
-        printf("%s║%s  %sDimensiones:%s              %u x %u px                                             %s║%s\n",
-               CYAN, RESET, WHITE, RESET, img.width, img.height, CYAN, RESET);
-        printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+        if (decoded) {
+            printf("%s║%s  %sImagen descomprimida:%s     %s%-53s%s     %s║%s\n",
+                   CYAN, RESET, WHITE, RESET, GREEN, bmppath, RESET, CYAN, RESET);
+            printf("%s║%s  %sFormato:%s                  BMP (24-bit RGB, sin compresión)                          %s║%s\n",
+                   CYAN, RESET, WHITE, RESET, CYAN, RESET);
+            printf("%s║%s  %sDimensiones:%s              %u x %u px                                             %s║%s\n",
+                   CYAN, RESET, WHITE, RESET, img.width, img.height, CYAN, RESET);
+            printf("%s║%s                                                                                      %s║%s\n", CYAN, RESET, CYAN, RESET);
+        }
         printf("%s╚══════════════════════════════════════════════════════════════════════════════════════╝%s\n\n", CYAN, RESET);
 
         free(decoded);
+    } else if (g_verify == RLE_VERIFY_CHECKSUM) {
+        printf("\n  \033[32mVerificación checksum:\033[0m CRC32C de las %u bandas en la tabla "
+               "(se comprueba con -d)\n\n", num_chunks);
     } else {
         printf("  \033[31mError: No se pudo descomprimir los datos RLE.\033[0m\n\n");
     }
@@ -1366,22 +2691,40 @@ int main(int argc, char *argv[]) {
                     getpid(), elapsed * 1000, (user_t + sys_t) * 1000);
             fprintf(csv, "\n");
 
-            fprintf(csv, "thread_id,tid,core,start_ms,end_ms,cpu_user_ms,cpu_sys_ms,pixels,compressed_bytes,stack_addr\n");
-            fprintf(csv, "0,0x%lx,0,0.0000,%.4f,%.4f,%.4f,%zu,%zu,0x%lx\n",
+            /* Contadores de hardware: -1 = no medido o sin --perf */
+            fprintf(csv, "thread_id,tid,core,start_ms,end_ms,cpu_user_ms,cpu_sys_ms,pixels,compressed_bytes,stack_addr");
+            for (int ev = 0; ev < RLE_PERF_COUNT; ev++)
+                fprintf(csv, ",%s", rle_perf_name(ev));
+            fprintf(csv, "\n");
+            fprintf(csv, "0,0x%lx,0,0.0000,%.4f,%.4f,%.4f,%zu,%zu,0x%lx",
                     (unsigned long)main_tid,
                     elapsed * 1000,
                     user_t * 1000, sys_t * 1000,
                     total_pixels, compressed.size,
                     (unsigned long)&stack_marker_top);
+            for (int ev = 0; ev < RLE_PERF_COUNT; ev++)
+                fprintf(csv, ",%lld", rle_perf_csv(&g_perf_counters, ev));
+            fprintf(csv, "\n");
             fprintf(csv, "\n");
 
-            /* Muestras reales del PC durante la compresión */
-            fprintf(csv, "thread_id,sample_idx,timestamp_ms,pc_addr,core_id,pixels_at\n");
-            for (int s = 0; s < g_num_pc_samples; s++) {
-                fprintf(csv, "0,%d,%.4f,0x%lx,0,%zu\n",
-                        s, g_pc_samples[s].timestamp_ms,
-                        (unsigned long)g_pc_samples[s].pc_addr,
-                        g_pc_samples[s].pixels_at);
+            /* Marcas del PC y muestras SIGPROF (--profile), intercaladas por tiempo */
+            fprintf(csv, "thread_id,sample_idx,timestamp_ms,pc_addr,core_id,pixels_at,source\n");
+            unsigned ns = g_prof ? rle_prof_count(g_prof) : 0, k = 0;
+            int m = 0, idx = 0;
+            while (m < g_num_pc_samples || k < ns) {
+                const RLEProfSample *ps = k < ns ? rle_prof_at(g_prof, k) : NULL;
+                double ts = ps ? prof_sample_ms(&t_start, ps) : 0;
+                if (m < g_num_pc_samples && (!ps || g_pc_samples[m].timestamp_ms <= ts)) {
+                    fprintf(csv, "0,%d,%.4f,0x%lx,0,%zu,marca\n", idx++,
+                            g_pc_samples[m].timestamp_ms,
+                            (unsigned long)g_pc_samples[m].pc_addr,
+                            g_pc_samples[m].pixels_at);
+                    m++;
+                } else {
+                    fprintf(csv, "0,%d,%.4f,0x%lx,%d,%zu,sigprof\n", idx++, ts,
+                            (unsigned long)ps->pc, (int)ps->core, ps->bytes_at);
+                    k++;
+                }
             }
 
             fclose(csv);
@@ -1389,11 +2732,9 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    /* Liberar memoria del HEAP */
-    if (used_stb)
-        stbi_image_free(img.data);  /* stb_image usa su propio allocator */
-    else
-        free(img.data);
-    free(compressed.data);
+    /* Liberar memoria del HEAP (la imagen mapeada se desmapea) */
+    librle_image_free(&img);
+    librle_buffer_free(&compressed);
+    free(chunks);
     return 0;
 }
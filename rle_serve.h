@@ -0,0 +1,222 @@
+/*
+ * ============================================================================
+ *  rle_serve.h — Protocolo del servidor de compresión (--serve)
+ *
+ *  Lo incluye rle_paralelo.c. El servidor vive mientras no reciba SIGINT o
+ *  SIGTERM y atiende pedidos enmarcados, por un socket Unix (SOCK_STREAM,
+ *  varios clientes) o por stdin/stdout (un cliente, el proceso padre):
+ *
+ *    pedido     RLEServeRequest (48 bytes) + in_len bytes de entrada
+ *    respuesta  RLEServeResponse (56 bytes) + out_len bytes de salida
+ *
+ *  Todo en little-endian, como el contenedor .rle. Operaciones:
+ *
+ *    COMPRESS     entrada RGB de width x height → salida .rle completo
+ *                 (mode, flags y tile_rows como --mode / --varint / --tile)
+ *    DECOMPRESS   entrada .rle → salida RGB; flags bit 0 = comprobar CRC32C
+ *    STATS        sin entrada → texto con pedidos y latencias p50/p99
+ *
+ *  Memoria compartida (solo socket Unix): con shm = 1 el pedido trae en
+ *  SCM_RIGHTS un memfd con la entrada en el offset 0, y no sigue ningún
+ *  byte inline; con shm = 2 trae además un memfd de salida de out_cap
+ *  bytes donde el servidor escribe el resultado. Los píxeles no pasan por
+ *  el socket ni se copian: el servidor mapea los fds. La entrada tiene que
+ *  llegar sellada con F_SEAL_SHRINK | F_SEAL_WRITE y la salida con
+ *  F_SEAL_SHRINK; un fd sin sellar, o más corto que in_len u out_cap,
+ *  vuelve RLE_LIB_EINVAL.
+ *  Si la salida no entra en out_cap, status RLE_LIB_ENOSPC y resp.need
+ *  dice cuántos bytes hacen falta.
+ *
+ *  La entrada y la salida inline van hasta RLE_SERVE_MAX_INLINE bytes; un
+ *  pedido más grande (o uno que el servidor no puede juntar porque ya tiene
+ *  demasiadas entradas inline pendientes) recibe un error y sus bytes se
+ *  descartan: la conexión sigue sincronizada.
+ *
+ *  Con status < 0 los out_len bytes que siguen son el mensaje de error.
+ *  queue_ns y service_ns son la espera en la cola y el tiempo de servicio
+ *  del pedido, medidos en el servidor.
+ * ============================================================================
+ */
+
+#ifndef RLE_SERVE_H
+#define RLE_SERVE_H
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define RLE_SERVE_REQ_MAGIC   "RLEQ"
+#define RLE_SERVE_RESP_MAGIC  "RLER"
+#define RLE_SERVE_MAX_INLINE  (64ull << 20) /* bytes inline por pedido o respuesta (más: shm) */
+#define RLE_SERVE_MAX_FDS     2
+#define RLE_SERVE_VERIFY_CRC  0x01          /* DECOMPRESS: flags */
+
+enum { RLE_SERVE_COMPRESS = 1, RLE_SERVE_DECOMPRESS = 2, RLE_SERVE_STATS = 3 };
+
+typedef struct {
+    char     magic[4];          /* "RLEQ" */
+    uint8_t  op;                /* RLE_SERVE_* */
+    uint8_t  mode;              /* COMPRESS: RLE_MODE_* */
+    uint8_t  flags;             /* COMPRESS: RLE_FLAG_*; DECOMPRESS: RLE_SERVE_VERIFY_CRC */
+    uint8_t  shm;               /* fds en SCM_RIGHTS: 0, 1 = entrada, 2 = entrada y salida */
+    uint32_t id;                /* vuelve tal cual en la respuesta */
+    uint32_t width;             /* COMPRESS */
+    uint32_t height;
+    uint32_t tile_rows;         /* COMPRESS: filas por chunk (0 = automático) */
+    uint32_t reserved[2];
+    uint64_t in_len;            /* bytes de entrada (inline, o en el fd de entrada) */
+    uint64_t out_cap;           /* shm = 2: bytes del fd de salida */
+} RLEServeRequest;
+
+typedef struct {
+    char     magic[4];          /* "RLER" */
+    int32_t  status;            /* RLE_LIB_OK o RLE_LIB_E* */
+    uint32_t id;
+    uint32_t width;             /* de la imagen (DECOMPRESS: leídas del header) */
+    uint32_t height;
+    uint32_t shm;               /* 1 = la salida quedó en el fd de salida, no sigue inline */
+    uint64_t out_len;
+    uint64_t queue_ns;
+    uint64_t service_ns;
+    uint64_t need;              /* RLE_LIB_ENOSPC: bytes que necesita el fd de salida */
+} RLEServeResponse;
+
+_Static_assert(sizeof(RLEServeRequest) == 48, "RLEServeRequest debe ocupar 48 bytes");
+_Static_assert(sizeof(RLEServeResponse) == 56, "RLEServeResponse debe ocupar 56 bytes");
+
+static inline const char *rle_serve_op_name(int op) {
+    return op == RLE_SERVE_COMPRESS ? "compress" : op == RLE_SERVE_DECOMPRESS ? "decompress"
+         : op == RLE_SERVE_STATS ? "stats" : "?";
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  LECTURA Y ESCRITURA DE TRAMAS
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/*
+ * Una escritura sin bloquear de los iovcnt tramos de iov (fd no
+ * bloqueante). Devuelve los bytes que aceptó el kernel, 0 si todavía no
+ * acepta nada (EAGAIN) o -1 con errno (EPIPE = el otro lado se fue); lo
+ * que no entró lo guarda el llamador para cuando el fd dé POLLOUT.
+ */
+static inline ssize_t rle_serve_send_some(int fd, const struct iovec *iov, int iovcnt) {
+    ssize_t w;
+    do {
+        w = writev(fd, iov, iovcnt);
+    } while (w < 0 && errno == EINTR);
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return w;
+}
+
+/*
+ * Una lectura sin bloquear de hasta n bytes de una trama (fd no
+ * bloqueante). Con is_socket usa recvmsg y agrega a fds[] los que lleguen
+ * en SCM_RIGHTS, hasta RLE_SERVE_MAX_FDS (el resto se cierra; *nfds lleva
+ * la cuenta de la trama y el llamador los cierra). Devuelve los bytes
+ * leídos, 0 si el otro lado cerró, -1 con errno (EAGAIN = nada todavía).
+ */
+static inline ssize_t rle_serve_recv_some(int fd, int is_socket, void *buf, size_t n,
+                                          int *fds, int *nfds) {
+    ssize_t r;
+    if (!is_socket) {
+        do {
+            r = read(fd, buf, n);
+        } while (r < 0 && errno == EINTR);
+        return r;
+    }
+
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int) * RLE_SERVE_MAX_FDS)];
+    } ctl;
+    struct iovec iov = { buf, n };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+    do {
+        r = recvmsg(fd, &msg, 0);
+    } while (r < 0 && errno == EINTR);
+    if (r < 0) return -1;
+
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+        int k = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        int got[RLE_SERVE_MAX_FDS * 2];
+        if (k > RLE_SERVE_MAX_FDS * 2) k = RLE_SERVE_MAX_FDS * 2;
+        memcpy(got, CMSG_DATA(c), (size_t)k * sizeof(int));
+        for (int i = 0; i < k; i++) {
+            if (*nfds < RLE_SERVE_MAX_FDS) fds[(*nfds)++] = got[i];
+            else close(got[i]);
+        }
+    }
+    if (msg.msg_flags & MSG_CTRUNC) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    return r;
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  LATENCIAS
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+/* Muestras en ms; crece duplicando (un double por pedido) */
+typedef struct {
+    double *ms;
+    size_t  n;
+    size_t  cap;
+} RLEServeLatency;
+
+static inline void rle_serve_latency_add(RLEServeLatency *l, double ms) {
+    if (l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 1024;
+        double *p = realloc(l->ms, cap * sizeof(double));
+        if (!p) return;
+        l->ms = p;
+        l->cap = cap;
+    }
+    l->ms[l->n++] = ms;
+}
+
+static inline int rle_serve_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    size_t n;
+    double p50, p90, p99, p999, max, mean;  /* ms */
+} RLEServePercentiles;
+
+/* Percentiles por rango más cercano (como --bench); ordena una copia */
+static inline void rle_serve_percentiles(const RLEServeLatency *l, RLEServePercentiles *out) {
+    memset(out, 0, sizeof(*out));
+    if (l->n == 0) return;
+    double *s = malloc(l->n * sizeof(double));
+    if (!s) return;
+    memcpy(s, l->ms, l->n * sizeof(double));
+    qsort(s, l->n, sizeof(double), rle_serve_cmp);
+    double sum = 0;
+    for (size_t i = 0; i < l->n; i++) sum += s[i];
+    const double q[4] = { 0.50, 0.90, 0.99, 0.999 };
+    double *dst[4] = { &out->p50, &out->p90, &out->p99, &out->p999 };
+    for (int k = 0; k < 4; k++) {
+        size_t rank = (size_t)ceil(q[k] * (double)l->n);
+        *dst[k] = s[rank > 0 ? rank - 1 : 0];
+    }
+    out->n = l->n;
+    out->max = s[l->n - 1];
+    out->mean = sum / (double)l->n;
+    free(s);
+}
+
+#endif /* RLE_SERVE_H */
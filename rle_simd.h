@@ -0,0 +1,213 @@
+/*
+ * ============================================================================
+ *  rle_simd.h — Kernel vectorizado para encontrar la longitud de un run
+ *
+ *  Lo incluyen rle_secuencial.c y rle_paralelo.c. El bucle interno del RLE
+ *  compara byte a byte `pixels[i + count] == valor`; en imágenes con fondos
+ *  planos (runs largos) ese bucle es prácticamente todo el perfil de CPU.
+ *
+ *  rle_scan_run(k, p, n) devuelve cuántos bytes consecutivos desde p[0] son
+ *  iguales a p[0], sin pasar de n (n >= 1). rle_scan_select() elige el kernel:
+ *
+ *    AVX2   (x86_64, detectado en tiempo de ejecución)   64 bytes por paso
+ *    SSE2   (x86_64, siempre disponible)                 16 bytes por paso
+ *    NEON   (AArch64 / Apple Silicon)                    16 bytes por paso
+ *    Escalar (cualquier otra arquitectura o --scalar)      1 byte por paso
+ *
+ *  Cada paso compara un bloque contra el valor replicado, arma una máscara
+ *  de "distintos" y usa un bit-scan (ctz) para ubicar el primer mismatch.
+ *  Todas las variantes producen exactamente el mismo resultado.
+ *
+ *  Para el modo píxel (RGB de 3 bytes) se usa la misma idea: k píxeles son
+ *  iguales al primero si y solo si p[b] == p[b - 3] para todo b en [3, 3k),
+ *  así que basta comparar el bloque en p+3 contra el bloque en p.
+ * ============================================================================
+ */
+
+#ifndef RLE_SIMD_H
+#define RLE_SIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define RLE_SIMD_X86 1
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RLE_SIMD_NEON 1
+#endif
+
+typedef size_t (*rle_scan_fn)(const uint8_t *p, size_t n);
+
+typedef struct {
+    rle_scan_fn fn;         /* runs de bytes:   p[k] == p[0]                 */
+    rle_scan_fn fn_px;      /* runs de píxeles: p[3k..3k+3) == p[0..3), n en píxeles */
+    const char *name;       /* "AVX2", "SSE2", "NEON", "escalar" */
+    int bytes_per_step;
+} RLEScanKernel;
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  ESCALAR (referencia)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static inline size_t rle_scan_scalar(const uint8_t *p, size_t n) {
+    const uint8_t v = p[0];
+    size_t k = 1;
+    while (k < n && p[k] == v) k++;
+    return k;
+}
+
+/* Bytes iniciales b < limit con p[b + 3] == p[b], desde b = from */
+static inline size_t rle_shift3_tail(const uint8_t *p, size_t from, size_t limit) {
+    while (from < limit && p[from + 3] == p[from]) from++;
+    return from;
+}
+
+static inline size_t rle_scan_px_scalar(const uint8_t *p, size_t n) {
+    return 1 + rle_shift3_tail(p, 0, 3 * (n - 1)) / 3;
+}
+
+#ifdef RLE_SIMD_X86
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  x86_64: SSE2 (baseline) y AVX2 (target attribute + cpuid)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static inline size_t rle_scan_sse2(const uint8_t *p, size_t n) {
+    const __m128i v = _mm_set1_epi8((char)p[0]);
+    size_t k = 0;
+    while (k + 16 <= n) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + k));
+        unsigned diff = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, v)) ^ 0xFFFFu;
+        if (diff) return k + (size_t)__builtin_ctz(diff);
+        k += 16;
+    }
+    while (k < n && p[k] == p[0]) k++;
+    return k;
+}
+
+static inline size_t rle_scan_px_sse2(const uint8_t *p, size_t n) {
+    const size_t limit = 3 * (n - 1);
+    size_t b = 0;
+    while (b + 16 <= limit) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + b));
+        __m128i y = _mm_loadu_si128((const __m128i *)(p + b + 3));
+        unsigned diff = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFFu;
+        if (diff) return 1 + (b + (size_t)__builtin_ctz(diff)) / 3;
+        b += 16;
+    }
+    return 1 + rle_shift3_tail(p, b, limit) / 3;
+}
+
+__attribute__((target("avx2")))
+static size_t rle_scan_px_avx2(const uint8_t *p, size_t n) {
+    const size_t limit = 3 * (n - 1);
+    size_t b = 0;
+    while (b + 32 <= limit) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + b));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(p + b + 3));
+        uint32_t diff = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (diff) return 1 + (b + (size_t)__builtin_ctz(diff)) / 3;
+        b += 32;
+    }
+    return 1 + rle_shift3_tail(p, b, limit) / 3;
+}
+
+__attribute__((target("avx2")))
+static size_t rle_scan_avx2(const uint8_t *p, size_t n) {
+    const __m256i v = _mm256_set1_epi8((char)p[0]);
+    size_t k = 0;
+    while (k + 64 <= n) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + k)), v);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + k + 32)), v);
+        uint64_t eq = (uint64_t)(uint32_t)_mm256_movemask_epi8(a) |
+                      ((uint64_t)(uint32_t)_mm256_movemask_epi8(b) << 32);
+        if (~eq) return k + (size_t)__builtin_ctzll(~eq);
+        k += 64;
+    }
+    while (k + 32 <= n) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + k)), v);
+        uint32_t diff = ~(uint32_t)_mm256_movemask_epi8(a);
+        if (diff) return k + (size_t)__builtin_ctz(diff);
+        k += 32;
+    }
+    while (k < n && p[k] == p[0]) k++;
+    return k;
+}
+#endif
+
+#ifdef RLE_SIMD_NEON
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  AArch64: NEON (sin movemask; vshrn deja 4 bits por byte comparado)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static inline size_t rle_scan_neon(const uint8_t *p, size_t n) {
+    const uint8x16_t v = vdupq_n_u8(p[0]);
+    size_t k = 0;
+    while (k + 16 <= n) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8(p + k), v);
+        uint8x8_t nib = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+        uint64_t diff = ~vget_lane_u64(vreinterpret_u64_u8(nib), 0);
+        if (diff) return k + ((size_t)__builtin_ctzll(diff) >> 2);
+        k += 16;
+    }
+    while (k < n && p[k] == p[0]) k++;
+    return k;
+}
+
+static inline size_t rle_scan_px_neon(const uint8_t *p, size_t n) {
+    const size_t limit = 3 * (n - 1);
+    size_t b = 0;
+    while (b + 16 <= limit) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8(p + b), vld1q_u8(p + b + 3));
+        uint8x8_t nib = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+        uint64_t diff = ~vget_lane_u64(vreinterpret_u64_u8(nib), 0);
+        if (diff) return 1 + (b + ((size_t)__builtin_ctzll(diff) >> 2)) / 3;
+        b += 16;
+    }
+    return 1 + rle_shift3_tail(p, b, limit) / 3;
+}
+#endif
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  SELECCIÓN DEL KERNEL (una vez, al inicio del programa)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static inline RLEScanKernel rle_scan_select(int force_scalar) {
+    RLEScanKernel k = { rle_scan_scalar, rle_scan_px_scalar, "escalar", 1 };
+    if (force_scalar) return k;
+#if defined(RLE_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        k.fn = rle_scan_avx2; k.fn_px = rle_scan_px_avx2;
+        k.name = "AVX2"; k.bytes_per_step = 64;
+    } else {
+        k.fn = rle_scan_sse2; k.fn_px = rle_scan_px_sse2;
+        k.name = "SSE2"; k.bytes_per_step = 16;
+    }
+#elif defined(RLE_SIMD_NEON)
+    k.fn = rle_scan_neon; k.fn_px = rle_scan_px_neon;
+    k.name = "NEON"; k.bytes_per_step = 16;
+#endif
+    return k;
+}
+
+/*
+ * Punto de entrada del bucle de compresión. Los runs de 1-2 bytes (ruido,
+ * bordes, RGB intercalado) se resuelven aquí sin llamada indirecta; solo los
+ * runs más largos pagan la llamada al kernel vectorizado.
+ */
+static inline size_t rle_scan_run(const RLEScanKernel *k, const uint8_t *p, size_t n) {
+    if (n < 2 || p[1] != p[0]) return 1;
+    if (n < 3 || p[2] != p[0]) return 2;
+    return k->fn(p, n);
+}
+
+/* Igual que rle_scan_run pero sobre píxeles RGB de 3 bytes (n en píxeles) */
+static inline size_t rle_scan_px_run(const RLEScanKernel *k, const uint8_t *p, size_t n) {
+    if (n < 2 || memcmp(p, p + 3, 3) != 0) return 1;
+    return k->fn_px(p, n);
+}
+
+#endif /* RLE_SIMD_H */
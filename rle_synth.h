@@ -0,0 +1,186 @@
+/*
+ * ============================================================================
+ *  rle_synth.h — Generador de imágenes sintéticas con entropía controlada
+ *
+ *  Lo incluyen rle_secuencial.c y rle_paralelo.c (--synth SPEC para comprimir
+ *  una imagen generada, --bench-synth SPEC para sumarla al benchmark). La
+ *  imagen se describe con una lista clave=valor separada por comas:
+ *
+ *    size=WxH    resolución, hasta RLE_SYNTH_MAX_DIM x RLE_SYNTH_MAX_DIM
+ *    run=L       largo medio de los runs en píxeles (geométrico, L >= 1)
+ *    noise=F     fracción de píxeles reemplazados por ruido al azar (0..1)
+ *    corr=C      correlación entre canales (1 = gris, R = G = B; 0 = canales
+ *                independientes: en modo byte los runs se cortan en cada canal)
+ *    skew=S      las filas de abajo tienen runs S veces más cortos que las de
+ *                arriba (rampa geométrica): bandas de filas desparejas
+ *    seed=N      semilla; misma SPEC = misma imagen, byte por byte
+ *
+ *  Ejemplo: size=8192x8192,run=32,noise=0.01,corr=0.9,skew=8
+ *
+ *  Cada fila se genera con su propio estado (semilla y número de fila), así
+ *  que se puede generar por strips en cualquier orden con el mismo resultado.
+ * ============================================================================
+ */
+
+#ifndef RLE_SYNTH_H
+#define RLE_SYNTH_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RLE_SYNTH_MAX_DIM 32768u
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    double   run;           /* largo medio de run en la fila 0 */
+    double   noise;         /* probabilidad de ruido por píxel */
+    double   corr;          /* probabilidad de que un canal copie al gris base */
+    double   skew;          /* run de la última fila = run / skew */
+    uint64_t seed;
+} RLESynthParams;
+
+static inline void rle_synth_defaults(RLESynthParams *p) {
+    p->width = 4096;
+    p->height = 4096;
+    p->run = 16;
+    p->noise = 0;
+    p->corr = 1;
+    p->skew = 1;
+    p->seed = 1;
+}
+
+/* Interpreta SPEC sobre los valores por defecto; 0, o -1 con mensaje en stderr */
+static inline int rle_synth_parse(const char *spec, RLESynthParams *p) {
+    rle_synth_defaults(p);
+    char buf[256];
+    if (strlen(spec) >= sizeof(buf)) {
+        fprintf(stderr, "  --synth: especificación demasiado larga\n");
+        return -1;
+    }
+    strcpy(buf, spec);
+    for (char *save = NULL, *kv = strtok_r(buf, ",", &save); kv; kv = strtok_r(NULL, ",", &save)) {
+        char *val = strchr(kv, '=');
+        if (!val) {
+            fprintf(stderr, "  --synth: se esperaba clave=valor en '%s'\n", kv);
+            return -1;
+        }
+        *val++ = '\0';
+        char *end = NULL;
+        int ok;
+        if (strcmp(kv, "size") == 0) {
+            ok = sscanf(val, "%ux%u", &p->width, &p->height) == 2 &&
+                 p->width > 0 && p->height > 0 &&
+                 p->width <= RLE_SYNTH_MAX_DIM && p->height <= RLE_SYNTH_MAX_DIM;
+        } else if (strcmp(kv, "seed") == 0) {
+            p->seed = strtoull(val, &end, 10);
+            ok = end != val && *end == '\0';
+        } else {
+            double v = strtod(val, &end);
+            ok = end != val && *end == '\0';
+            if (strcmp(kv, "run") == 0)        { p->run = v;   ok = ok && v >= 1; }
+            else if (strcmp(kv, "noise") == 0) { p->noise = v; ok = ok && v >= 0 && v <= 1; }
+            else if (strcmp(kv, "corr") == 0)  { p->corr = v;  ok = ok && v >= 0 && v <= 1; }
+            else if (strcmp(kv, "skew") == 0)  { p->skew = v;  ok = ok && v >= 1; }
+            else {
+                fprintf(stderr, "  --synth: clave desconocida '%s' "
+                                "(size, run, noise, corr, skew, seed)\n", kv);
+                return -1;
+            }
+        }
+        if (!ok) {
+            fprintf(stderr, "  --synth: valor inválido %s=%s\n", kv, val);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* SPEC canónica (todas las claves), para reportes y nombres de archivo */
+static inline void rle_synth_describe(const RLESynthParams *p, char *buf, size_t n) {
+    snprintf(buf, n, "size=%ux%u,run=%g,noise=%g,corr=%g,skew=%g,seed=%llu",
+             p->width, p->height, p->run, p->noise, p->corr, p->skew,
+             (unsigned long long)p->seed);
+}
+
+/* Largo medio de run en la fila y: rampa geométrica de run a run / skew */
+static inline double rle_synth_row_run(const RLESynthParams *p, uint32_t y) {
+    double t = p->height > 1 ? (double)y / (p->height - 1) : 0;
+    double l = p->run / pow(p->skew, t);
+    return l < 1 ? 1 : l;
+}
+
+/* splitmix64: estado de cada fila a partir de (seed, y) y números del xorshift */
+static inline uint64_t rle_synth_mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t rle_synth_next(uint64_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/* Uniforme en [0, 1) con 53 bits */
+static inline double rle_synth_unit(uint64_t *s) {
+    return (rle_synth_next(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Genera las filas [row, row + rows) en dst (rows * width * 3 bytes RGB) */
+static inline void rle_synth_rows(const RLESynthParams *p, uint8_t *dst,
+                                  uint32_t row, uint32_t rows) {
+    /* Umbrales enteros: por píxel solo se compara un número de 64 bits */
+    const uint64_t noise_at = p->noise >= 1 ? UINT64_MAX : (uint64_t)(p->noise * 18446744073709551616.0);
+    const uint64_t corr_at = p->corr >= 1 ? UINT64_MAX : (uint64_t)(p->corr * 18446744073709551616.0);
+
+    for (uint32_t y = row; y < row + rows; y++) {
+        uint64_t s = rle_synth_mix(p->seed ^ rle_synth_mix(y)) | 1;
+        uint8_t *out = dst + (size_t)(y - row) * p->width * 3;
+        /* Largo geométrico de media L: 1 + floor(log(u) / log(1 - 1/L)) */
+        double l = rle_synth_row_run(p, y);
+        double inv_log = l > 1 ? 1.0 / log(1.0 - 1.0 / l) : 0;
+        uint8_t color[3] = { 0, 0, 0 };
+        uint64_t left = 0;
+
+        for (uint32_t x = 0; x < p->width; x++) {
+            if (left == 0) {
+                uint64_t r = rle_synth_next(&s);
+                uint8_t base = (uint8_t)(r >> 56);
+                for (int c = 0; c < 3; c++)
+                    color[c] = rle_synth_next(&s) <= corr_at ? base
+                                                             : (uint8_t)(rle_synth_next(&s) >> 56);
+                double u = rle_synth_unit(&s);
+                double extra = inv_log != 0 && u > 0 ? floor(log(u) * inv_log) : 0;
+                left = 1 + (extra < (double)p->width ? (uint64_t)extra : p->width);
+            }
+            left--;
+            uint8_t *px = out + (size_t)x * 3;
+            if (noise_at && rle_synth_next(&s) <= noise_at) {
+                uint64_t r = rle_synth_next(&s);
+                px[0] = (uint8_t)(r >> 56);
+                px[1] = (uint8_t)(r >> 48);
+                px[2] = (uint8_t)(r >> 40);
+            } else {
+                px[0] = color[0];
+                px[1] = color[1];
+                px[2] = color[2];
+            }
+        }
+    }
+}
+
+/* Reserva y genera la imagen completa (malloc, se libera con free); NULL si no hay memoria */
+static inline uint8_t *rle_synth_generate(const RLESynthParams *p) {
+    uint8_t *rgb = malloc((size_t)p->width * p->height * 3);
+    if (rgb) rle_synth_rows(p, rgb, 0, p->height);
+    return rgb;
+}
+
+#endif /* RLE_SYNTH_H */
@@ -0,0 +1,199 @@
+/*
+ * ============================================================================
+ *  rle_trace.h — Trace de planificación en formato Chrome trace-event (--trace)
+ *
+ *  Lo incluye rle_paralelo.c. El CSV de Gantt guarda inicio y fin por hilo
+ *  y a lo sumo MAX_PC_SAMPLES marcas; este trace guarda un evento por tile,
+ *  por robo, por chunk decodificado y por operación de E/S, y se abre tal
+ *  cual en ui.perfetto.dev o chrome://tracing (JSON "traceEvents").
+ *
+ *  Cada hilo escribe solo en su RLETraceBuf (una línea de caché propia para
+ *  los campos de control): agregar un evento es guardar ~100 bytes al final
+ *  de un arreglo que crece duplicando, sin locks ni atómicas. El hilo
+ *  principal recorre los buffers después del join y los vuelca a JSON; nada
+ *  se formatea mientras se comprime. Con el buffer en NULL (sin --trace)
+ *  cada punto de medición es una comparación.
+ *
+ *  Tiempos en ns de CLOCK_MONOTONIC; en el JSON, µs relativos a t0.
+ * ============================================================================
+ */
+
+#ifndef RLE_TRACE_H
+#define RLE_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "rle_progress.h"
+
+#define RLE_TRACE_MAX_ARGS 4
+#define RLE_TRACE_INITIAL  1024         /* eventos reservados por hilo al inicio */
+
+/* name, cat y las claves de args son literales: el evento no copia texto */
+typedef struct {
+    uint64_t    ts_ns;
+    uint64_t    dur_ns;                 /* 'X' */
+    const char *name;
+    const char *cat;
+    const char *keys[RLE_TRACE_MAX_ARGS];
+    int64_t     vals[RLE_TRACE_MAX_ARGS];
+    uint8_t     nargs;
+    char        ph;                     /* 'X' tramo, 'i' instante, 'C' contador */
+} RLETraceEvent;
+
+typedef struct {
+    _Alignas(RLE_CACHE_LINE) RLETraceEvent *ev;
+    size_t  n;
+    size_t  cap;
+    size_t  dropped;                    /* eventos perdidos por falta de memoria */
+    int     tid;                        /* tid del trace (no el del SO) */
+    char    name[40];                   /* thread_name en el visor */
+} RLETraceBuf;
+
+_Static_assert(sizeof(RLETraceBuf) % RLE_CACHE_LINE == 0,
+               "RLETraceBuf debe ocupar líneas de caché completas");
+
+static inline uint64_t rle_trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Reloj solo si hay trace: sin --trace los puntos de medición no leen la hora */
+static inline uint64_t rle_trace_clock(const RLETraceBuf *b) {
+    return b ? rle_trace_now_ns() : 0;
+}
+
+static inline void rle_trace_buf_init(RLETraceBuf *b, int tid, const char *name) {
+    memset(b, 0, sizeof(*b));
+    b->tid = tid;
+    snprintf(b->name, sizeof(b->name), "%s", name);
+    b->ev = malloc(RLE_TRACE_INITIAL * sizeof(RLETraceEvent));
+    if (b->ev) b->cap = RLE_TRACE_INITIAL;
+}
+
+static inline void rle_trace_buf_release(RLETraceBuf *b) {
+    free(b->ev);
+    b->ev = NULL;
+    b->n = b->cap = 0;
+}
+
+/* Un evento nuevo al final del buffer; NULL si b es NULL o no hay memoria */
+static inline RLETraceEvent *rle_trace_push(RLETraceBuf *b, char ph, const char *cat,
+                                            const char *name, uint64_t ts) {
+    if (!b) return NULL;
+    if (b->n == b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : RLE_TRACE_INITIAL;
+        RLETraceEvent *p = realloc(b->ev, cap * sizeof(RLETraceEvent));
+        if (!p) {
+            b->dropped++;
+            return NULL;
+        }
+        b->ev = p;
+        b->cap = cap;
+    }
+    RLETraceEvent *e = &b->ev[b->n++];
+    e->ts_ns = ts;
+    e->dur_ns = 0;
+    e->name = name;
+    e->cat = cat;
+    e->nargs = 0;
+    e->ph = ph;
+    return e;
+}
+
+static inline RLETraceEvent *rle_trace_span(RLETraceBuf *b, const char *cat, const char *name,
+                                            uint64_t t0, uint64_t t1) {
+    RLETraceEvent *e = rle_trace_push(b, 'X', cat, name, t0);
+    if (e) e->dur_ns = t1 > t0 ? t1 - t0 : 0;
+    return e;
+}
+
+static inline RLETraceEvent *rle_trace_instant(RLETraceBuf *b, const char *cat, const char *name) {
+    return rle_trace_push(b, 'i', cat, name, rle_trace_clock(b));
+}
+
+static inline void rle_trace_arg(RLETraceEvent *e, const char *key, int64_t val) {
+    if (!e || e->nargs == RLE_TRACE_MAX_ARGS) return;
+    e->keys[e->nargs] = key;
+    e->vals[e->nargs++] = val;
+}
+
+/*
+ * Contador de cambios de contexto del hilo que llama (voluntarios e
+ * involuntarios, acumulados desde que nació). Necesita RUSAGE_THREAD
+ * (Linux); en otros sistemas no agrega nada.
+ */
+static inline void rle_trace_ctxsw(RLETraceBuf *b) {
+#ifdef RUSAGE_THREAD
+    struct rusage ru;
+    if (!b || getrusage(RUSAGE_THREAD, &ru) != 0) return;
+    RLETraceEvent *e = rle_trace_push(b, 'C', "sched", "cambios de contexto", rle_trace_now_ns());
+    rle_trace_arg(e, "voluntarios", ru.ru_nvcsw);
+    rle_trace_arg(e, "involuntarios", ru.ru_nivcsw);
+#else
+    (void)b;
+#endif
+}
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ *  VOLCADO A JSON (después del join, un solo hilo)
+ * ═══════════════════════════════════════════════════════════════════════════ */
+
+static inline void rle_trace_write_event(FILE *f, const RLETraceBuf *b, const RLETraceEvent *e,
+                                         uint64_t t0_ns, int pid) {
+    double ts = e->ts_ns >= t0_ns ? (double)(e->ts_ns - t0_ns) / 1e3 : 0.0;
+    /* Los contadores son por proceso en el visor: el nombre del hilo separa las series */
+    if (e->ph == 'C')
+        fprintf(f, ",\n{\"name\":\"%s (%s)\",\"ph\":\"C\"", e->name, b->name);
+    else
+        fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\"", e->name, e->cat, e->ph);
+    fprintf(f, ",\"ts\":%.3f,\"pid\":%d,\"tid\":%d", ts, pid, b->tid);
+    if (e->ph == 'X') fprintf(f, ",\"dur\":%.3f", (double)e->dur_ns / 1e3);
+    if (e->ph == 'i') fprintf(f, ",\"s\":\"t\"");
+    if (e->nargs) {
+        fprintf(f, ",\"args\":{");
+        for (int k = 0; k < e->nargs; k++)
+            fprintf(f, "%s\"%s\":%lld", k ? "," : "", e->keys[k], (long long)e->vals[k]);
+        fputc('}', f);
+    }
+    fputc('}', f);
+}
+
+/*
+ * Documento completo: metadatos (proceso, nombre y orden de cada hilo),
+ * los eventos de cada buffer y otherData con los pares clave/valor de meta
+ * (n_meta pares de cadenas). Devuelve los eventos escritos, -1 si falló.
+ */
+static inline long rle_trace_write(FILE *f, RLETraceBuf *const *bufs, int n, uint64_t t0_ns,
+                                   int pid, const char *process, const char *const (*meta)[2],
+                                   int n_meta) {
+    long count = 0;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"otherData\":{");
+    for (int i = 0; i < n_meta; i++)
+        fprintf(f, "%s\"%s\":\"%s\"", i ? "," : "", meta[i][0], meta[i][1]);
+    fprintf(f, "},\n\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"%s\"}}",
+            pid, process);
+    for (int i = 0; i < n; i++) {
+        const RLETraceBuf *b = bufs[i];
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                   "\"args\":{\"name\":\"%s\"}}", pid, b->tid, b->name);
+        fprintf(f, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                   "\"args\":{\"sort_index\":%d}}", pid, b->tid, b->tid);
+    }
+    for (int i = 0; i < n; i++) {
+        const RLETraceBuf *b = bufs[i];
+        for (size_t k = 0; k < b->n; k++)
+            rle_trace_write_event(f, b, &b->ev[k], t0_ns, pid);
+        count += (long)b->n;
+    }
+    fprintf(f, "\n]}\n");
+    return ferror(f) ? -1 : count;
+}
+
+#endif /* RLE_TRACE_H */
@@ -94,6 +94,7 @@ echo ""
 CSV_SEQ="${IMAGE_PATH}_secuencial_gantt.csv"
 CSV_PAR="${IMAGE_PATH}_paralelo_gantt.csv"
 GANTT_PNG="${IMAGE_PATH}_gantt_scheduling.png"
+CSV_SCALING="${IMAGE_PATH}_scaling.csv"     # de ./rle_paralelo --scaling, si se corrió antes
 
 echo ""
 echo -e "${CYAN}══════════════════════════════════════════════════════════════════════${RESET}"
@@ -102,7 +103,11 @@ echo -e "${CYAN}═════════════════════
 echo ""
 
 if [ -f "$CSV_SEQ" ] && [ -f "$CSV_PAR" ]; then
-    python3 "$SCRIPT_DIR/gantt_chart.py" "$CSV_SEQ" "$CSV_PAR" "$GANTT_PNG"
+    if [ -f "$CSV_SCALING" ]; then
+        python3 "$SCRIPT_DIR/gantt_chart.py" "$CSV_SEQ" "$CSV_PAR" "$GANTT_PNG" "$CSV_SCALING"
+    else
+        python3 "$SCRIPT_DIR/gantt_chart.py" "$CSV_SEQ" "$CSV_PAR" "$GANTT_PNG"
+    fi
 
     if [ $? -eq 0 ] && [ -f "$GANTT_PNG" ]; then
         echo -e "  ${GREEN}Diagrama generado exitosamente.${RESET}"